@@ -1,7 +1,8 @@
 ﻿#include "Album.h"
 #include "ItemNotFoundException.h"
+#include "Timestamp.h"
 #include <iomanip>
-#include <sstream>
+#include <iterator>
 
 
 Album::Album(int ownerId, const std::string& name) :
@@ -10,21 +11,83 @@ Album::Album(int ownerId, const std::string& name) :
 	setCreationDateNow();
 }
 
-Album::Album(int ownerId, const std::string & name, const std::string & creationTime) :
-	m_ownerId(ownerId), m_name(name), m_creationDate(creationTime), m_pictures{}
+Album::Album(int ownerId, const std::string & name, std::string creationTime) :
+	m_ownerId(ownerId), m_name(name),
+	m_creationTime(Timestamp::parse(creationTime)), m_creationDate(std::move(creationTime)), m_pictures{}
 {
 	// Left empty
 }
 
+Album::Album(const Album& other) :
+	m_ownerId(other.m_ownerId), m_name(other.m_name), _id(other._id), m_creationTime(other.m_creationTime),
+	m_creationDate(other.m_creationDate), m_pictures(other.m_pictures)
+{
+	indexPictures();
+}
+
+Album& Album::operator=(const Album& other)
+{
+	if (this != &other) {
+		m_ownerId = other.m_ownerId;
+		m_name = other.m_name;
+		_id = other._id;
+		m_creationTime = other.m_creationTime;
+		m_creationDate = other.m_creationDate;
+		m_pictures = other.m_pictures;
+		indexPictures();
+	}
+	return *this;
+}
+
+/**
+ * indexPictures - Builds the name index from scratch out of the picture list.
+ */
+void Album::indexPictures()
+{
+	m_picturesByName.clear();
+	m_duplicates.clear();
+	m_picturesByName.reserve(m_pictures.size());
+	for (auto picture = m_pictures.begin(); picture != m_pictures.end(); ++picture) {
+		indexPicture(picture);
+	}
+}
+
+/**
+ * indexPicture - Adds a picture to the name index, after the pictures before it in the list.
+ *                A name given twice keeps its first picture, like the scan the index replaces.
+ */
+void Album::indexPicture(std::list<Picture>::iterator picture)
+{
+	if (!m_picturesByName.emplace(picture->getNameSymbol(), picture).second) {
+		m_duplicates[picture->getNameSymbol()].push_back(picture);
+	}
+}
+
+/**
+ * indexLastPicture - Adds the picture just appended to the list to the name index.
+ * Returns: The picture as stored.
+ */
+const Picture& Album::indexLastPicture()
+{
+	auto added = std::prev(m_pictures.end());
+	indexPicture(added);
+	return *added;
+}
+
 
 const std::string& Album::getName() const
 {
-	return m_name;
+	return m_name.get();
+}
+
+Symbol Album::getNameSymbol() const
+{
+	return m_name.getSymbol();
 }
 
 void Album::setName(const std::string& name)
 {
-	m_name = name;
+	m_name = InternedName(name);
 }
 
 int Album::getOwnerId() const
@@ -42,36 +105,59 @@ std::string Album::getCreationDate() const
 	return m_creationDate;
 }
 
-void Album::setCreationDate(const std::string& creationTime)
+int64_t Album::getCreationTime() const
 {
-	m_creationDate = creationTime;
+	return m_creationTime;
+}
+
+void Album::setCreationDate(std::string creationTime)
+{
+	m_creationTime = Timestamp::parse(creationTime);
+	m_creationDate = std::move(creationTime);
 }
 
 void Album::setCreationDateNow()
 {
-	time_t now = time(nullptr);
-	std::stringstream oss;
-	oss << std::put_time(localtime(&now), "%d/%m/%Y %H:%M:%S");
-	m_creationDate = oss.str();
+	m_creationTime = Timestamp::now();
+	m_creationDate = Timestamp::format(m_creationTime);
 }
 
 
 Picture Album::getPicture(const std::string& pictureName) const
 {
-	for (auto& picture: m_pictures) {
-		if (pictureName == picture.getName()) {
-			return picture;
-		}
+	const Picture* picture = findPicture(pictureName);
+	if (picture != nullptr) {
+		return *picture;
 	}
 	throw ItemNotFoundException("Picture", pictureName);
 }
 
+/**
+ * findPicture - Looks a picture up without copying it.
+ * Returns: Pointer to the picture inside the album (valid until it is removed), nullptr if there is none.
+ */
+const Picture* Album::findPicture(const std::string& pictureName) const
+{
+	return findPicture(SymbolTable::find(pictureName));
+}
+
+const Picture* Album::findPicture(Symbol pictureName) const
+{
+	auto found = m_picturesByName.find(pictureName);
+	return found == m_picturesByName.end() ? nullptr : &*found->second;
+}
+
 
 std::list<Picture> Album::getPictures() const
 {
 	return m_pictures;
 }
 
+const std::list<Picture>& Album::pictures() const
+{
+	return m_pictures;
+}
+
 void Album::untagUserInAlbum(int userId)
 {
 	for(auto& picture: m_pictures) {
@@ -88,50 +174,58 @@ void Album::tagUserInAlbum(int userId)
 
 void Album::untagUserInPicture(int userId, const std::string & pictureName)
 {
-	for (auto& picture : m_pictures) {
-		if (picture.getName() == pictureName) {
-			picture.untagUser(userId);
-		}
-	}
+	forEachStoredPicture(SymbolTable::find(pictureName), [userId](Picture& picture) {
+		picture.untagUser(userId);
+	});
 }
 
 void Album::tagUserInPicture(int userId, const std::string & pictureName)
 {
-	for (auto& picture : m_pictures) {
-		if (picture.getName() == pictureName) {
-			picture.tagUser(userId);
-		}
-	}
+	forEachStoredPicture(SymbolTable::find(pictureName), [userId](Picture& picture) {
+		picture.tagUser(userId);
+	});
 }
 
-void Album::addPicture(const Picture& picture)
+const Picture& Album::addPicture(const Picture& picture)
 {
 	m_pictures.push_back(picture);
+	return indexLastPicture();
+}
+
+const Picture& Album::addPicture(Picture&& picture)
+{
+	m_pictures.push_back(std::move(picture));
+	return indexLastPicture();
 }
 
 
 void Album::removePicture(const std::string& pictureName)
 {
-	for (const auto& picture : m_pictures) {
-		if (pictureName == picture.getName()) {
-			m_pictures.remove(picture);
-			return;
-		}
+	auto found = m_picturesByName.find(SymbolTable::find(pictureName));
+	if (found == m_picturesByName.end()) {
+		throw ItemNotFoundException("Picture", pictureName);
+	}
+
+	m_pictures.erase(found->second);
+
+	// the next picture with the name, if it was given twice, becomes the first one
+	auto duplicates = m_duplicates.find(found->first);
+	if (duplicates == m_duplicates.end()) {
+		m_picturesByName.erase(found);
+		return;
+	}
+
+	found->second = duplicates->second.front();
+	duplicates->second.pop_front();
+	if (duplicates->second.empty()) {
+		m_duplicates.erase(duplicates);
 	}
-	
-	throw ItemNotFoundException("Picture", pictureName);
 }
 
 
 bool Album::doesPictureExists(const std::string& name) const
 {
-	//If it does not point to end, it means element exists in list
-	for (const auto& picture : m_pictures) {
-		if (name == picture.getName()) {
-			return true;
-		}
-	}
-	return false;
+	return findPicture(name) != nullptr;
 }
 
 bool Album::operator==(const Album& other) const
@@ -149,11 +243,26 @@ void Album::setId(const int& val)
 	this->_id = val;
 }
 
+size_t Album::getMemoryUsage() const
+{
+	size_t bytes = sizeof(Album) + LIST_NODE_OVERHEAD + m_creationDate.capacity();
+	// the name index: a node (entry and next link) per picture and the bucket array
+	bytes += m_picturesByName.size() * (sizeof(std::pair<const Symbol, std::list<Picture>::iterator>) + sizeof(void*));
+	bytes += m_picturesByName.bucket_count() * sizeof(void*);
+	for (const auto& duplicates : m_duplicates) {
+		bytes += sizeof(duplicates) + sizeof(void*) + duplicates.second.size() * sizeof(std::list<Picture>::iterator);
+	}
+	for (const auto& picture : m_pictures) {
+		bytes += picture.getMemoryUsage();
+	}
+	return bytes;
+}
+
 
 
 std::ostream& operator<<(std::ostream& strOut, const Album& album)
 {
-	strOut << "[" << album.m_name << "] - created by user@"
+	strOut << "[" << album.getName() << "] - created by user@"
 		<< const_cast<Album&>(album).getOwnerId() << ", Created at " << album.getCreationDate() << std::endl;
 	
 	return strOut;
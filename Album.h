@@ -1,7 +1,11 @@
 ﻿#pragma once
 #include "Picture.h"
+#include "SymbolTable.h"
+#include <deque>
 #include <list>
 #include <memory>
+#include <unordered_map>
+#include <utility>
 
 
 class Album
@@ -9,28 +13,76 @@ class Album
 public:
     Album() = default;
 	Album(int ownerId, const std::string& name);
-	Album(int ownerId, const std::string& name, const std::string& creationTime);
+	Album(int ownerId, const std::string& name, std::string creationTime);
+
+	// the name index points into the picture list, a copy builds its own; list nodes move with
+	// the list, so a move takes the index along as it is (and throws only if the list move does)
+	Album(const Album& other);
+	Album& operator=(const Album& other);
+	Album(Album&& other) = default;
+	Album& operator=(Album&& other) = default;
 
 	const std::string& getName() const;
+	Symbol getNameSymbol() const;
 	void setName(const std::string& name);
 
 	int getOwnerId() const;
 	void setOwner(int userId);
 
 	std::string getCreationDate() const;
-	void setCreationDate(const std::string& creationTime);
+	// the creation date as a number, see Timestamp
+	int64_t getCreationTime() const;
+	void setCreationDate(std::string creationTime);
 	void setCreationDateNow();
 
 	bool doesPictureExists(const std::string& name) const;
-	void addPicture(const Picture& picture);
+	// the adders return the picture as stored, valid until it is removed
+	const Picture& addPicture(const Picture& picture);
+	const Picture& addPicture(Picture&& picture);
+
+	// builds the picture in place from Picture constructor arguments
+	template <typename... Args>
+	const Picture& emplacePicture(Args&&... args)
+	{
+		m_pictures.emplace_back(std::forward<Args>(args)...);
+		return indexLastPicture();
+	}
+
 	void removePicture(const std::string& pictureName);
 
 	Picture getPicture(const std::string& name) const;
+	const Picture* findPicture(const std::string& name) const;
+	const Picture* findPicture(Symbol name) const;
 	std::list<Picture> getPictures() const;
+	// the pictures in place, valid as long as the album is not changed; getPictures() is the owned copy
+	const std::list<Picture>& pictures() const;
+
+	// visits the pictures in place, without the copy getPictures() makes
+	template <typename Function>
+	void forEachPicture(Function fn) const
+	{
+		for (const auto& picture : m_pictures) {
+			fn(picture);
+		}
+	}
+
+	// visits every picture with the name (it may be given more than once), in list order
+	template <typename Function>
+	void forEachPicture(const std::string& name, Function fn) const
+	{
+		forEachPicture(SymbolTable::find(name), fn);
+	}
+
+	template <typename Function>
+	void forEachPicture(Symbol name, Function fn) const
+	{
+		forEachStoredPicture(name, [&fn](const Picture& picture) { fn(picture); });
+	}
 
 	void untagUserInAlbum(int userId);
 	void tagUserInAlbum(int userId);
 
+	// every picture with the name is tagged (untagged), not only the one findPicture returns
 	void untagUserInPicture(int userId, const std::string& pictureName);
 	void tagUserInPicture(int userId, const std::string& pictureName);
 	
@@ -40,10 +92,40 @@ public:
 	int getId() const;
 	void setId(const int& val);
 
+	// estimated bytes of the album and its pictures, see Picture::getMemoryUsage
+	size_t getMemoryUsage() const;
+
 private:
     int m_ownerId { 0 };
-	std::string m_name;
-	int _id;
+	InternedName m_name;
+	int _id { 0 };
+	int64_t m_creationTime { 0 };
 	std::string m_creationDate;
 	std::list<Picture> m_pictures;
+	// name -> the first picture with that name; list nodes never move, so the entries stay valid
+	std::unordered_map<Symbol, std::list<Picture>::iterator> m_picturesByName;
+	// name given more than once -> its other pictures in list order, the next one to be first in front
+	std::unordered_map<Symbol, std::deque<std::list<Picture>::iterator>> m_duplicates;
+
+	void indexPictures();
+	void indexPicture(std::list<Picture>::iterator picture);
+	const Picture& indexLastPicture();
+
+	// the pictures in place, through the stored (non const) iterators
+	template <typename Function>
+	void forEachStoredPicture(Symbol name, Function fn) const
+	{
+		auto first = m_picturesByName.find(name);
+		if (first == m_picturesByName.end()) {
+			return;
+		}
+
+		fn(*first->second);
+		auto duplicates = m_duplicates.find(name);
+		if (duplicates != m_duplicates.end()) {
+			for (auto picture : duplicates->second) {
+				fn(*picture);
+			}
+		}
+	}
 };
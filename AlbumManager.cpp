@@ -1,8 +1,14 @@
 ﻿#include "AlbumManager.h"
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 #include "Constants.h"
 #include "MyException.h"
 #include "AlbumNotOpenException.h"
+#include "PerceptualHash.h"
 #include <Windows.h>
 
 #define PICTURE_TABLE "PICTURES"
@@ -174,13 +180,37 @@ void AlbumManager::deleteAlbum()
 		closeAlbum();
 	}
 
+	// the stored files of its pictures, counted before the pictures go
+	std::vector<std::string> paths;
+	loadStoreReferences();
+	m_dataAccess.forEachPictureOfUser(m_dataAccess.getUser(userId), [&paths, &albumName](const Album& album, const Picture& picture) {
+		if (album.getName() == albumName) {
+			paths.push_back(picture.getPath());
+		}
+	});
+
 	m_dataAccess.deleteAlbum(albumName, userId);
+	releaseStoredFiles(paths);
 	std::cout << "Album [" << albumName << "] @"<< userId <<" deleted successfully." << std::endl;
 }
 
 void AlbumManager::listAlbums()
 {
-	m_dataAccess.printAlbums();
+	ListingOrder order;
+	if (!readListingOrder(order)) {
+		m_dataAccess.printAlbums();
+		return;
+	}
+
+	const std::list<Album> albums = m_dataAccess.getAlbumsSorted(order);
+	if (albums.empty()) {
+		throw MyException("There are no existing albums.");
+	}
+	std::cout << "Album list:" << std::endl;
+	std::cout << "-----------" << std::endl;
+	for (const Album& album : albums) {
+		std::cout << std::setw(5) << "* " << album;
+	}
 }
 
 void AlbumManager::listAlbumsOfUser()
@@ -192,14 +222,13 @@ void AlbumManager::listAlbumsOfUser()
 	}
 
 	const User& user = m_dataAccess.getUser(userId);
-	const std::list<Album>& albums = m_dataAccess.getAlbumsOfUser(user);
 
 	std::cout << "Albums list of user@" << user.getId() << ":" << std::endl;
 	std::cout << "-----------------------" << std::endl;
 
-	for (const auto& album : albums) {
+	m_dataAccess.forEachAlbumOfUser(user, [](const Album& album) {
 		std::cout <<"   + [" << album.getName() <<"] - created on "<< album.getCreationDate() << std::endl;
-	}
+	});
 }
 
 
@@ -217,7 +246,23 @@ void AlbumManager::addPictureToAlbum()
 	std::string picPath = getInputFromConsole("Enter picture path: ");
 	picture.setPath(picPath);
 
+	// counted before the picture is added, so the count does not include it yet
+	loadStoreReferences();
 	m_dataAccess.addPictureToAlbumByName(m_openAlbum.getName(), picture);
+	if (m_store.isStored(picPath)) {
+		m_store.addReference(picPath);
+	}
+
+	// recorded now so listings never have to open the file, and the thumbnail is made from
+	// the same decode
+	FileMetadata metadata;
+	Image image;
+	if (FileMetadata::read(picPath, metadata, &image)) {
+		m_dataAccess.storeFileMetadata({ metadata });
+	}
+	if (image.width > 0) {
+		m_thumbnails.add(picPath, std::move(image));
+	}
 
 	std::cout << "Picture [" << picture.getId() << "] successfully added to Album [" << m_openAlbum.getName() << "]." << std::endl;
 }
@@ -231,7 +276,14 @@ void AlbumManager::removePictureFromAlbum()
 		throw MyException("Error: There is no picture with name <" + picName + ">.\n");
 	}
 	
+	loadStoreReferences();
+	std::string picPath;
+	m_dataAccess.visitPicture(m_openAlbum.getName(), picName, [&picPath](const Picture& pic) {
+		picPath = pic.getPath();
+	});
+
 	m_dataAccess.removePictureFromAlbumByName(m_openAlbum.getName(), picName);
+	releaseStoredFiles({ picPath });
 	std::cout << "Picture <" << picName << "> successfully removed from Album [" << m_openAlbum.getName() << "]." << std::endl;
 }
 
@@ -239,16 +291,39 @@ void AlbumManager::listPicturesInAlbum()
 {
 	refreshOpenAlbum();
 
+	ListingOrder order;
+	bool isSorted = readListingOrder(order);
+	std::list<Picture> sortedPictures;
+	if (isSorted) {
+		sortedPictures = m_dataAccess.getPicturesSorted(m_openAlbum.getName(), order);
+	}
+
 	std::cout << "List of pictures in Album [" << m_openAlbum.getName() 
 			  << "] of user@" << m_openAlbum.getOwnerId() <<":" << std::endl;
 	
-	const std::list<Picture>& albumPictures = m_openAlbum.getPictures();
+	const std::list<Picture>& albumPictures = isSorted ? sortedPictures : m_openAlbum.pictures();
+	std::vector<std::string> paths;
+	for (const Picture& picture : albumPictures) {
+		paths.push_back(picture.getPath());
+	}
+
+	// the records of the whole album in one lookup, not one query per picture
+	std::unordered_map<std::string, std::string> files;
+	m_dataAccess.getFilesMetadata(paths, [&files](const FileMetadata& metadata) {
+		files.emplace(metadata.path, metadata.describe());
+	});
+
 	for (auto iter = albumPictures.begin(); iter != albumPictures.end(); ++iter) {
+		auto recorded = files.find(iter->getPath());
+		std::string file = recorded != files.end() ? recorded->second : "not recorded";
 		std::cout << "   + Picture [" << iter->getId() << "] - " << iter->getName() << 
 			"\tLocation: [" << iter->getPath() << "]\tCreation Date: [" <<
-				iter->getCreationDate() << "]\tTags: [" << iter->getTagsCount() << "]" << std::endl;
+				iter->getCreationDate() << "]\tTags: [" << iter->getTagsCount() << "]\tFile: [" << file << "]" << std::endl;
 	}
 	std::cout << std::endl;
+
+	// the thumbnails of the album are likely next, they are made in the background
+	m_thumbnails.prefetch(paths);
 }
 
 void AlbumManager::showPicture()
@@ -256,19 +331,135 @@ void AlbumManager::showPicture()
 	refreshOpenAlbum();
 
 	std::string picName = getInputFromConsole("Enter picture name: ");
-	if ( !m_openAlbum.doesPictureExists(picName) ) {
+	const Picture* pic = m_openAlbum.findPicture(picName);
+	if ( pic == nullptr ) {
 		throw MyException("Error: There is no picture with name <" + picName + ">.\n");
 	}
 	
-	auto pic = m_openAlbum.getPicture(picName);
-	if ( !fileExistsOnDisk(pic.getPath()) ) {
+	if ( !fileExistsOnDisk(pic->getPath()) ) {
 		throw MyException("Error: Can't open <" + picName+ "> since it doesnt exist on disk.\n");
 	}
 
 	// Bad practice!!!
 	// Can lead to privileges escalation
 	// You will replace it on WinApi Lab(bonus)
-	system(pic.getPath().c_str()); 
+	system(pic->getPath().c_str()); 
+}
+
+void AlbumManager::showThumbnail()
+{
+	refreshOpenAlbum();
+
+	std::string picName = getInputFromConsole("Enter picture name: ");
+	const Picture* pic = m_openAlbum.findPicture(picName);
+	if ( pic == nullptr ) {
+		throw MyException("Error: There is no picture with name <" + picName + ">.\n");
+	}
+
+	if ( !fileExistsOnDisk(pic->getPath()) ) {
+		throw MyException("Error: Can't open <" + picName + "> since it doesnt exist on disk.\n");
+	}
+
+	// ready at once when listing the album or adding the picture already made it
+	std::string thumbnail = m_thumbnails.request(pic->getPath()).get();
+	if (thumbnail.empty()) {
+		throw MyException("Error: Can't make a thumbnail of <" + picName + ">, its format can not be decoded.\n");
+	}
+	system(thumbnail.c_str());
+}
+
+void AlbumManager::importFolder()
+{
+	refreshOpenAlbum();
+
+	std::string folder = getInputFromConsole("Enter folder path: ");
+	std::error_code error;
+	if (!std::filesystem::is_directory(folder, error)) {
+		throw MyException("Error: There is no folder <" + folder + ">.\n");
+	}
+
+	// every file under the folder, in a stable order, but the store's own
+	std::vector<std::string> sources;
+	std::filesystem::path root = std::filesystem::absolute(folder, error).lexically_normal();
+	auto entry = std::filesystem::recursive_directory_iterator(root, std::filesystem::directory_options::skip_permission_denied, error);
+	for (; entry != std::filesystem::recursive_directory_iterator(); entry.increment(error)) {
+		if (entry->path().string() == m_store.getRoot()) {
+			entry.disable_recursion_pending();
+		}
+		else if (entry->is_regular_file(error)) {
+			sources.push_back(entry->path().string());
+		}
+	}
+	std::sort(sources.begin(), sources.end());
+
+	loadStoreReferences();
+	Parallelism parallelism;
+	parallelism.threshold = CONTENT_IMPORT_THRESHOLD;
+	ContentStore::ImportStats stats;
+	std::vector<ContentStore::ImportedFile> imported = m_store.import(sources, parallelism, stats);
+
+	// the path of the first picture with every name the album has, as findPicture would give it
+	std::unordered_map<std::string, std::string> existingPaths;
+	ListingOrder byName;
+	byName.key = ListingKey::BY_NAME;
+	for (const Picture& picture : m_dataAccess.getPicturesSorted(m_openAlbum.getName(), byName)) {
+		existingPaths.emplace(picture.getName(), picture.getPath());
+	}
+
+	// a picture per file, named after it; a file whose name the album has is left out
+	std::unordered_set<std::string> names;
+	std::vector<FileMetadata> records;
+	size_t present = 0;
+	size_t skipped = 0;
+	for (const ContentStore::ImportedFile& file : imported) {
+		if (file.storedPath.empty()) {
+			continue;
+		}
+		std::string name = std::filesystem::path(file.source).stem().string();
+		auto existing = existingPaths.find(name);
+		if (existing != existingPaths.end() || !names.insert(name).second) {
+			if (existing != existingPaths.end() && existing->second == file.storedPath) {
+				++present;
+			}
+			else {
+				++skipped;
+			}
+			if (file.isNew) {
+				m_store.removeUnreferenced(file.storedPath);
+			}
+			continue;
+		}
+
+		Picture picture(m_dataAccess.getTheNextId(PICTURE_TABLE), name);
+		picture.setPath(file.storedPath);
+		m_dataAccess.addPictureToAlbumByName(m_openAlbum.getName(), std::move(picture));
+		m_store.addReference(file.storedPath);
+
+		FileMetadata record;
+		if (!m_dataAccess.getFileMetadata(file.storedPath, record)) {
+			record.path = file.storedPath;
+			records.push_back(std::move(record));
+		}
+	}
+
+	// the records of the new copies, read on the pool's threads like verify picture files does
+	Parallelism fileParallelism;
+	fileParallelism.threshold = FILE_VERIFY_THRESHOLD;
+	std::vector<FileState> states;
+	FileMetadata::verifyAll(records, states, fileParallelism);
+	std::vector<FileMetadata> refreshed;
+	for (size_t i = 0; i < records.size(); ++i) {
+		if (states[i] == FileState::REFRESHED) {
+			refreshed.push_back(std::move(records[i]));
+		}
+	}
+	m_dataAccess.storeFileMetadata(refreshed);
+
+	std::cout << "Imported " << sources.size() << " files into Album [" << m_openAlbum.getName() << "]: " <<
+		names.size() << " added, " << present << " already there, " << skipped << " left out (name taken), " <<
+		stats.failed << " failed." << std::endl;
+	std::cout << "   " << stats.hashed << " hashed, " << stats.remembered << " unchanged since their last import, " <<
+		stats.copied << " copied to the store (" << stats.bytesCopied << " bytes)." << std::endl;
 }
 
 void AlbumManager::tagUserInPicture()
@@ -379,7 +570,15 @@ void AlbumManager::removeUser()
 		closeAlbum();
 	}
 
+	// the stored files of the pictures in the user's albums, which go with the user
+	std::vector<std::string> paths;
+	loadStoreReferences();
+	m_dataAccess.forEachPictureOfUser(user, [&paths](const Album&, const Picture& picture) {
+		paths.push_back(picture.getPath());
+	});
+
 	m_dataAccess.deleteUser(user);
+	releaseStoredFiles(paths);
 	std::cout << "User @" << userId << " deleted successfully." << std::endl;
 }
 
@@ -465,10 +664,201 @@ std::string AlbumManager::getInputFromConsole(const std::string& message)
 	return input;
 }
 
+/**
+ * readListingOrder - Asks how to order a listing: "stored", or a key (creation, name, tags)
+ *                    optionally followed by asc / desc and by the number of entries to list.
+ * Params: order - filled from the answer
+ * Returns: false if the listing keeps the stored order.
+ */
+bool AlbumManager::readListingOrder(ListingOrder& order)
+{
+	static const std::map<std::string, ListingKey> keys = {
+		{ "creation", ListingKey::BY_CREATION },
+		{ "name", ListingKey::BY_NAME },
+		{ "tags", ListingKey::BY_TAGS }
+	};
+
+	std::istringstream answer(getInputFromConsole("Order by (stored/creation/name/tags) [asc/desc] [count]: "));
+	std::string word;
+	answer >> word;
+	if (word == "stored") {
+		return false;
+	}
+
+	auto key = keys.find(word);
+	if (key == keys.end()) {
+		throw MyException("Error: Unknown order <" + word + ">.\n");
+	}
+	order.key = key->second;
+
+	while (answer >> word) {
+		if (word == "asc" || word == "desc") {
+			order.descending = word == "desc";
+		}
+		else if (std::all_of(word.begin(), word.end(), ::isdigit)) {
+			order.limit = std::stoul(word);
+		}
+		else {
+			throw MyException("Error: Unknown order option <" + word + ">.\n");
+		}
+	}
+	return true;
+}
+
+/**
+ * fileExistsOnDisk - Checks a picture file against its record: a stat when the record is still
+ * current, the header is read again (and the record stored) only when the file changed.
+ * Params: filename - full path of the file
+ * Returns: true when the file is on disk.
+ */
 bool AlbumManager::fileExistsOnDisk(const std::string& filename)
 {
-	struct stat buffer;   
-	return (stat(filename.c_str(), &buffer) == 0); 
+	FileMetadata metadata;
+	if (!m_dataAccess.getFileMetadata(filename, metadata)) {
+		metadata.path = filename;
+	}
+
+	FileState state = metadata.revalidate();
+	if (state == FileState::REFRESHED) {
+		m_dataAccess.storeFileMetadata({ metadata });
+	}
+	return state != FileState::MISSING;
+}
+
+void AlbumManager::verifyPictureFiles()
+{
+	// every file once, however many pictures show it
+	std::vector<std::string> paths;
+	std::unordered_set<std::string> seen;
+	m_dataAccess.forEachPicture([&paths, &seen](const Album&, const Picture& picture) {
+		std::string path = picture.getPath();
+		if (seen.insert(path).second) {
+			paths.push_back(std::move(path));
+		}
+	});
+
+	// the records there are, in one lookup; the files without one are read from scratch
+	std::unordered_map<std::string, FileMetadata> recorded;
+	m_dataAccess.getFilesMetadata(paths, [&recorded](const FileMetadata& metadata) {
+		recorded.emplace(metadata.path, metadata);
+	});
+	std::vector<FileMetadata> files(paths.size());
+	for (size_t i = 0; i < paths.size(); ++i) {
+		auto found = recorded.find(paths[i]);
+		if (found != recorded.end()) {
+			files[i] = std::move(found->second);
+		}
+		else {
+			files[i].path = paths[i];
+		}
+	}
+
+	// the stats and header reads wait on the disk, so they overlap on the pool's threads
+	Parallelism parallelism;
+	parallelism.threshold = FILE_VERIFY_THRESHOLD;
+	std::vector<FileState> states;
+	FileMetadata::VerifyStats stats = FileMetadata::verifyAll(files, states, parallelism);
+
+	std::vector<FileMetadata> refreshed;
+	for (size_t i = 0; i < files.size(); ++i) {
+		if (states[i] == FileState::REFRESHED) {
+			refreshed.push_back(std::move(files[i]));
+		}
+	}
+	m_dataAccess.storeFileMetadata(refreshed);
+
+	std::cout << "Verified " << files.size() << " picture files: " << stats.current << " unchanged, " <<
+		stats.refreshed << " refreshed, " << stats.missing.size() << " missing." << std::endl;
+	for (const std::string& path : stats.missing) {
+		std::cout << "   - Missing: [" << path << "]" << std::endl;
+	}
+}
+
+void AlbumManager::findDuplicates()
+{
+	int radius = std::stoi(getInputFromConsole("Enter the most bits near duplicates may differ in (0 - 64, " +
+		std::to_string(PERCEPTUAL_DUPLICATE_DISTANCE) + " is a good start): "));
+	if (radius < 0 || radius > 64) {
+		throw MyException("Error: The distance must be between 0 and 64.\n");
+	}
+
+	std::unordered_map<std::string, uint64_t> hashesByPath;
+	m_dataAccess.forEachFileMetadata([&hashesByPath](const FileMetadata& metadata) {
+		if (metadata.hasPerceptualHash) {
+			hashesByPath.emplace(metadata.path, metadata.perceptualHash);
+		}
+	});
+
+	// the hashed pictures, in album order
+	struct HashedPicture
+	{
+		size_t album;
+		std::string name;
+		std::string path;
+	};
+	std::vector<std::string> albumNames;
+	std::vector<HashedPicture> pictures;
+	std::vector<uint64_t> hashes;
+	size_t unhashed = 0;
+	const Album* lastAlbum = nullptr;
+	m_dataAccess.forEachPicture([&](const Album& album, const Picture& picture) {
+		// the pictures of an album come one after the other
+		if (&album != lastAlbum) {
+			albumNames.push_back(album.getName());
+			lastAlbum = &album;
+		}
+		std::string path = picture.getPath();
+		auto found = hashesByPath.find(path);
+		if (found == hashesByPath.end()) {
+			++unhashed;
+			return;
+		}
+		pictures.push_back({ albumNames.size() - 1, picture.getName(), std::move(path) });
+		hashes.push_back(found->second);
+	});
+
+	PerceptualIndex index(std::move(hashes));
+	std::vector<std::vector<uint32_t>> groups = index.findGroups(radius, Parallelism());
+
+	std::cout << "Found " << groups.size() << " groups of near duplicates among " << pictures.size() << " hashed pictures";
+	if (unhashed != 0) {
+		std::cout << " (" << unhashed << " pictures have no hash, verify the picture files to hash them)";
+	}
+	std::cout << ":" << std::endl;
+	for (size_t group = 0; group < groups.size(); ++group) {
+		std::cout << "   Group " << group + 1 << ":" << std::endl;
+		uint64_t first = index.getHash(groups[group].front());
+		for (uint32_t position : groups[group]) {
+			const HashedPicture& picture = pictures[position];
+			std::cout << "      + [" << albumNames[picture.album] << "] " << picture.name << "\tLocation: [" << picture.path <<
+				"]\tDistance: [" << PerceptualHash::distance(first, index.getHash(position)) << "]" << std::endl;
+		}
+	}
+}
+
+/**
+ * loadStoreReferences - Counts the pictures referring to every stored file, once, before the
+ * first change that may add or remove such pictures.
+ */
+void AlbumManager::loadStoreReferences()
+{
+	if (m_store.hasReferences()) {
+		return;
+	}
+	std::vector<std::string> paths;
+	if (!m_store.isEmpty()) {
+		m_dataAccess.forEachPicture([&paths](const Album&, const Picture& picture) {
+			paths.push_back(picture.getPath());
+		});
+	}
+	m_store.setReferences(paths);
+}
+
+void AlbumManager::releaseStoredFiles(const std::vector<std::string>& paths)
+{
+	for (const std::string& path : paths) {
+		m_store.releaseReference(path);
+	}
 }
 
 void AlbumManager::refreshOpenAlbum() {
@@ -514,7 +904,10 @@ void AlbumManager::openPictureInApp()
 		throw std::invalid_argument("Not valid choice was entered \n");
 		break;
 	}
-	Picture pic = m_dataAccess.getPictureFromAlbum(m_openAlbum.getName(), picture);
+	std::string location;
+	m_dataAccess.visitPicture(m_openAlbum.getName(), picture, [&location](const Picture& pic) {
+		location = pic.getLocation();
+	});
 	// Set up structures for process creation
 	STARTUPINFO si;
 	PROCESS_INFORMATION pi;
@@ -522,7 +915,7 @@ void AlbumManager::openPictureInApp()
 	ZeroMemory(&pi, sizeof(pi));
 	si.cb = sizeof(si);
 
-	std::string commandLineStr = appLocation + pic.getLocation();
+	std::string commandLineStr = appLocation + location;
 	LPSTR commandLine =  const_cast<LPSTR>(commandLineStr.c_str());
 	// Create the process
 	if (!CreateProcess(
@@ -570,6 +963,8 @@ const std::vector<struct CommandGroup> AlbumManager::m_prompts  = {
 			{ ADD_PICTURE    , "Add picture." },
 			{ REMOVE_PICTURE , "Remove picture." },
 			{ SHOW_PICTURE   , "Show picture." },
+			{ SHOW_THUMBNAIL , "Show picture thumbnail." },
+			{ IMPORT_FOLDER  , "Import folder." },
 			{ LIST_PICTURES  , "List pictures." },
 			{ TAG_USER		 , "Tag user." },
 			{ UNTAG_USER	 , "Untag user." },
@@ -597,6 +992,8 @@ const std::vector<struct CommandGroup> AlbumManager::m_prompts  = {
 	{
 		"Supported Operations:",
 		{
+			{ VERIFY_FILES , "Verify picture files." },
+			{ FIND_DUPLICATES , "Find duplicate pictures." },
 			{ HELP , "Help (clean screen)" },
 			{ EXIT , "Exit." },
 		}
@@ -614,6 +1011,8 @@ const std::map<CommandType, AlbumManager::handler_func_t> AlbumManager::m_comman
 	{ REMOVE_PICTURE, &AlbumManager::removePictureFromAlbum },
 	{ LIST_PICTURES, &AlbumManager::listPicturesInAlbum },
 	{ SHOW_PICTURE, &AlbumManager::showPicture },
+	{ SHOW_THUMBNAIL, &AlbumManager::showThumbnail },
+	{ IMPORT_FOLDER, &AlbumManager::importFolder },
 	{ TAG_USER, &AlbumManager::tagUserInPicture, },
 	{ UNTAG_USER, &AlbumManager::untagUserInPicture },
 	{ LIST_TAGS, &AlbumManager::listUserTags },
@@ -625,6 +1024,8 @@ const std::map<CommandType, AlbumManager::handler_func_t> AlbumManager::m_comman
 	{ TOP_TAGGED_PICTURE, &AlbumManager::topTaggedPicture },
 	{ PICTURES_TAGGED_USER, &AlbumManager::picturesTaggedUser },
 	{ OPEN_PICTURE_IN_APP, &AlbumManager::openPictureInApp },
+	{ VERIFY_FILES, &AlbumManager::verifyPictureFiles },
+	{ FIND_DUPLICATES, &AlbumManager::findDuplicates },
 	{ HELP, &AlbumManager::help },
 	{ EXIT, &AlbumManager::exit }
 };
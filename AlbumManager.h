@@ -3,6 +3,8 @@
 #include "Constants.h"
 #include "MemoryAccess.h"
 #include "Album.h"
+#include "ContentStore.h"
+#include "ThumbnailCache.h"
 #include <Windows.h>
 
 class AlbumManager
@@ -21,6 +23,8 @@ private:
     std::string m_currentAlbumName{};
 	IDataAccess& m_dataAccess;
 	Album m_openAlbum;
+	ThumbnailCache m_thumbnails;
+	ContentStore m_store;
 
 	void help();
 	// albums management
@@ -36,6 +40,8 @@ private:
 	void removePictureFromAlbum();
 	void listPicturesInAlbum();
 	void showPicture();
+	void showThumbnail();
+	void importFolder();
 
 	// tags related
 	void tagUserInPicture();
@@ -51,11 +57,16 @@ private:
 	void topTaggedUser();
 	void topTaggedPicture();
 	void picturesTaggedUser();
+	void verifyPictureFiles();
+	void findDuplicates();
 	void exit();
 
 	std::string getInputFromConsole(const std::string& message);
+	bool readListingOrder(ListingOrder& order);
 	bool fileExistsOnDisk(const std::string& filename);
 	void refreshOpenAlbum();
+	void loadStoreReferences();
+	void releaseStoredFiles(const std::vector<std::string>& paths);
     bool isCurrentAlbumSet() const;
 
 	void openPictureInApp();
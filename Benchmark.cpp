@@ -0,0 +1,134 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// every block carries its size in front of it, so the live bytes can be kept up to date
+#define ALLOCATION_HEADER_SIZE 16
+
+static std::atomic<size_t> allocations { 0 };
+static std::atomic<size_t> allocatedBytes { 0 };
+static std::atomic<long long> liveBytes { 0 };
+
+void* operator new(size_t size)
+{
+	void* block = std::malloc(size + ALLOCATION_HEADER_SIZE);
+	if (block == nullptr) {
+		throw std::bad_alloc();
+	}
+
+	*static_cast<size_t*>(block) = size;
+	++allocations;
+	allocatedBytes += size;
+	liveBytes += size;
+	return static_cast<char*>(block) + ALLOCATION_HEADER_SIZE;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+	if (pointer == nullptr) {
+		return;
+	}
+
+	void* block = static_cast<char*>(pointer) - ALLOCATION_HEADER_SIZE;
+	liveBytes -= *static_cast<size_t*>(block);
+	std::free(block);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+	operator delete(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+	operator delete(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+	operator delete(pointer);
+}
+
+AllocationCounter::Counts AllocationCounter::now()
+{
+	Counts counts;
+	counts.allocations = allocations;
+	counts.bytes = allocatedBytes;
+	counts.liveBytes = liveBytes;
+	return counts;
+}
+
+
+void LatencyRecorder::record(const std::string& operation, std::chrono::nanoseconds elapsed)
+{
+	m_samples[operation].push_back(elapsed.count());
+}
+
+// adds the samples of another recorder, e.g. one per worker thread
+void LatencyRecorder::merge(const LatencyRecorder& other)
+{
+	for (const auto& entry : other.m_samples) {
+		auto& samples = m_samples[entry.first];
+		samples.insert(samples.end(), entry.second.begin(), entry.second.end());
+	}
+}
+
+/**
+ * summarize - Computes count, throughput and nearest rank p50/p99 of every operation.
+ * Params: None
+ * Returns: Map from operation name to its summary.
+ */
+std::map<std::string, LatencyRecorder::Summary> LatencyRecorder::summarize() const
+{
+	std::map<std::string, Summary> summaries;
+
+	for (const auto& entry : m_samples) {
+		std::vector<long long> sorted = entry.second;
+		std::sort(sorted.begin(), sorted.end());
+
+		long long total = 0;
+		for (auto sample : sorted) {
+			total += sample;
+		}
+
+		auto percentile = [&sorted](double p) {
+			size_t rank = static_cast<size_t>(p * sorted.size() + 0.999999);
+			rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+			return sorted[rank - 1] / 1000.0;
+		};
+
+		Summary summary;
+		summary.count = sorted.size();
+		summary.totalSeconds = total / 1e9;
+		summary.opsPerSecond = total == 0 ? 0 : sorted.size() / summary.totalSeconds;
+		summary.p50Micros = percentile(0.50);
+		summary.p99Micros = percentile(0.99);
+		summaries.emplace(entry.first, summary);
+	}
+
+	return summaries;
+}
+
+void LatencyRecorder::writeJson(std::ostream& out, const std::string& indent) const
+{
+	auto summaries = summarize();
+	out << "{";
+
+	bool first = true;
+	for (const auto& entry : summaries) {
+		out << (first ? "\n" : ",\n") << indent << "  \"" << entry.first << "\": { "
+			<< "\"count\": " << entry.second.count
+			<< ", \"ops_per_sec\": " << entry.second.opsPerSecond
+			<< ", \"p50_us\": " << entry.second.p50Micros
+			<< ", \"p99_us\": " << entry.second.p99Micros << " }";
+		first = false;
+	}
+	out << "\n" << indent << "}";
+}
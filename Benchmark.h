@@ -0,0 +1,48 @@
+#pragma once
+#include <chrono>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+ * AllocationCounter - what went through the global operator new of the benchmark binary so far
+ * (Benchmark.cpp replaces it).
+ */
+class AllocationCounter
+{
+public:
+	struct Counts
+	{
+		size_t allocations;
+		size_t bytes;			// every byte ever allocated
+		long long liveBytes;	// allocated and not freed yet
+	};
+
+	static Counts now();
+};
+
+/*
+ * LatencyRecorder - collects per operation latencies and reports throughput and percentiles.
+ */
+class LatencyRecorder
+{
+public:
+	struct Summary
+	{
+		size_t count;
+		double totalSeconds;
+		double opsPerSecond;
+		double p50Micros;
+		double p99Micros;
+	};
+
+	void record(const std::string& operation, std::chrono::nanoseconds elapsed);
+	void merge(const LatencyRecorder& other);
+	std::map<std::string, Summary> summarize() const;
+
+	void writeJson(std::ostream& out, const std::string& indent) const;
+
+private:
+	std::map<std::string, std::vector<long long>> m_samples;
+};
@@ -0,0 +1,468 @@
+#include "BinaryFormat.h"
+#include <algorithm>
+#include <ostream>
+#include <utility>
+#include "MyException.h"
+
+// ******************* Encoding *******************
+static void putUInt16(std::string& bytes, uint16_t value)
+{
+	const char encoded[2] = { static_cast<char>(value & 0xFF), static_cast<char>(value >> 8) };
+	bytes.append(encoded, sizeof(encoded));
+}
+
+static void putUInt32(std::string& bytes, uint32_t value)
+{
+	char encoded[4];
+	for (int i = 0; i < 4; ++i) {
+		encoded[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+	}
+	bytes.append(encoded, sizeof(encoded));
+}
+
+static void putInt32(std::string& bytes, int32_t value)
+{
+	putUInt32(bytes, static_cast<uint32_t>(value));
+}
+
+static void putString(std::string& bytes, const std::string& value)
+{
+	putUInt32(bytes, static_cast<uint32_t>(value.size()));
+	bytes.append(value);
+}
+
+// overwrites a u32 written earlier, for lengths only known once the payload is written
+static void patchUInt32(std::string& bytes, size_t at, uint32_t value)
+{
+	for (int i = 0; i < 4; ++i) {
+		bytes[at + i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+	}
+}
+
+// ******************* Decoding *******************
+static uint32_t readUInt32(const char* at)
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(at);
+	return static_cast<uint32_t>(bytes[0]) | static_cast<uint32_t>(bytes[1]) << 8
+		| static_cast<uint32_t>(bytes[2]) << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+}
+
+static int32_t readInt32(const char* at)
+{
+	return static_cast<int32_t>(readUInt32(at));
+}
+
+static uint16_t readUInt16(const char* at)
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(at);
+	return static_cast<uint16_t>(bytes[0] | bytes[1] << 8);
+}
+
+/*
+ * BinaryCursor - bounds checked walk over one encoded object, used by the view constructors.
+ */
+class BinaryCursor
+{
+public:
+	BinaryCursor(const char* data, size_t size) :
+		m_data(data), m_size(size)
+	{
+		// Left empty
+	}
+
+	const char* take(size_t bytes)
+	{
+		if (m_size - m_position < bytes) {
+			throw MyException("Binary record is truncated");
+		}
+		const char* at = m_data + m_position;
+		m_position += bytes;
+		return at;
+	}
+
+	uint32_t takeUInt32()
+	{
+		return readUInt32(take(4));
+	}
+
+	std::string_view takeString()
+	{
+		uint32_t length = takeUInt32();
+		return std::string_view(take(length), length);
+	}
+
+	const char* at() const
+	{
+		return m_data + m_position;
+	}
+
+	// how many items of itemBytes each fit in what is left
+	size_t fitting(size_t itemBytes) const
+	{
+		return (m_size - m_position) / itemBytes;
+	}
+
+	void expectEnd() const
+	{
+		if (m_position != m_size) {
+			throw MyException("Binary record has trailing bytes");
+		}
+	}
+
+private:
+	const char* m_data;
+	size_t m_size;
+	size_t m_position { 0 };
+};
+
+// ******************* UserView *******************
+UserView::UserView(const char* data, size_t size) :
+	m_data(data)
+{
+	BinaryCursor cursor(data, size);
+	cursor.take(4);
+	m_name = cursor.takeString();
+	cursor.expectEnd();
+}
+
+int UserView::getId() const
+{
+	return readInt32(m_data);
+}
+
+std::string_view UserView::getName() const
+{
+	return m_name;
+}
+
+User UserView::toUser() const
+{
+	return User(getId(), std::string(m_name));
+}
+
+// ******************* PictureView *******************
+PictureView::PictureView(const char* data, size_t size) :
+	m_data(data)
+{
+	BinaryCursor cursor(data, size);
+	cursor.take(8);
+	uint32_t tagsCount = cursor.takeUInt32();
+	m_name = cursor.takeString();
+	m_path = cursor.takeString();
+	m_creationDate = cursor.takeString();
+
+	if (tagsCount > cursor.fitting(4) || tagsCount > INT32_MAX) {
+		throw MyException("Binary record is truncated");
+	}
+	m_tags = cursor.take(tagsCount * 4);
+	cursor.expectEnd();
+
+	// the tags are a TagSet: ascending and unique
+	for (uint32_t i = 1; i < tagsCount; ++i) {
+		if (readInt32(m_tags + 4 * (i - 1)) >= readInt32(m_tags + 4 * i)) {
+			throw MyException("Binary picture has unsorted tags");
+		}
+	}
+}
+
+int PictureView::getId() const
+{
+	return readInt32(m_data);
+}
+
+int PictureView::getAlbumId() const
+{
+	return readInt32(m_data + 4);
+}
+
+std::string_view PictureView::getName() const
+{
+	return m_name;
+}
+
+std::string_view PictureView::getPath() const
+{
+	return m_path;
+}
+
+std::string_view PictureView::getCreationDate() const
+{
+	return m_creationDate;
+}
+
+int PictureView::getTagsCount() const
+{
+	return static_cast<int>(readUInt32(m_data + 8));
+}
+
+int PictureView::getTag(int index) const
+{
+	return readInt32(m_tags + 4 * static_cast<size_t>(index));
+}
+
+bool PictureView::isUserTagged(int userId) const
+{
+	int low = 0;
+	int high = getTagsCount();
+	while (low < high) {
+		int middle = low + (high - low) / 2;
+		if (getTag(middle) < userId) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	return low < getTagsCount() && getTag(low) == userId;
+}
+
+Picture PictureView::toPicture() const
+{
+	Picture picture(getId(), std::string(m_name), std::string(m_path), std::string(m_creationDate));
+	picture.setAlbumId(getAlbumId());
+	for (int i = 0; i < getTagsCount(); ++i) {
+		picture.tagUser(getTag(i));
+	}
+	return picture;
+}
+
+// ******************* AlbumView *******************
+AlbumView::AlbumView(const char* data, size_t size) :
+	m_data(data)
+{
+	BinaryCursor cursor(data, size);
+	cursor.take(8);
+	uint32_t picturesCount = cursor.takeUInt32();
+	m_name = cursor.takeString();
+	m_creationDate = cursor.takeString();
+
+	// each picture is at least its length, so a count larger than that is cut short
+	if (picturesCount > cursor.fitting(4) || picturesCount > INT32_MAX) {
+		throw MyException("Binary record is truncated");
+	}
+	m_pictures = cursor.at();
+	for (uint32_t i = 0; i < picturesCount; ++i) {
+		uint32_t length = cursor.takeUInt32();
+		PictureView(cursor.take(length), length);	// throws for a malformed picture
+	}
+	cursor.expectEnd();
+}
+
+int AlbumView::getId() const
+{
+	return readInt32(m_data);
+}
+
+int AlbumView::getOwnerId() const
+{
+	return readInt32(m_data + 4);
+}
+
+std::string_view AlbumView::getName() const
+{
+	return m_name;
+}
+
+std::string_view AlbumView::getCreationDate() const
+{
+	return m_creationDate;
+}
+
+int AlbumView::getPicturesCount() const
+{
+	return static_cast<int>(readUInt32(m_data + 8));
+}
+
+void AlbumView::forEachPicture(const std::function<void(const PictureView&)>& fn) const
+{
+	const char* at = m_pictures;
+	for (int i = 0; i < getPicturesCount(); ++i) {
+		uint32_t length = readUInt32(at);
+		fn(PictureView(at + 4, length));
+		at += 4 + static_cast<size_t>(length);
+	}
+}
+
+Album AlbumView::toAlbum() const
+{
+	Album album(getOwnerId(), std::string(m_name), std::string(m_creationDate));
+	album.setId(getId());
+	forEachPicture([&album](const PictureView& picture) {
+		album.addPicture(picture.toPicture());
+	});
+	return album;
+}
+
+// ******************* BinaryWriter *******************
+BinaryWriter::BinaryWriter(Sink sink) :
+	m_sink(std::move(sink))
+{
+	putUInt32(m_buffer, BINARY_MAGIC);
+	putUInt16(m_buffer, BINARY_VERSION);
+	putUInt16(m_buffer, 0);
+}
+
+BinaryWriter::BinaryWriter(std::ostream& out) :
+	BinaryWriter([&out](const char* data, size_t size) { out.write(data, static_cast<std::streamsize>(size)); })
+{
+	// Left empty
+}
+
+BinaryWriter::~BinaryWriter()
+{
+	try {
+		flush();
+	}
+	catch (...) {
+		// a sink that fails here has no one left to tell, call flush() to see it
+	}
+}
+
+void BinaryWriter::beginRecord(BinaryKind kind, size_t& lengthAt)
+{
+	m_buffer.push_back(static_cast<char>(kind));
+	lengthAt = m_buffer.size();
+	putUInt32(m_buffer, 0);
+}
+
+void BinaryWriter::endRecord(size_t lengthAt)
+{
+	patchUInt32(m_buffer, lengthAt, static_cast<uint32_t>(m_buffer.size() - lengthAt - 4));
+	++m_records;
+	if (m_buffer.size() >= BINARY_CHUNK_BYTES) {
+		flush();
+	}
+}
+
+void BinaryWriter::write(const User& user)
+{
+	size_t lengthAt;
+	beginRecord(BinaryKind::USER, lengthAt);
+	encode(user, m_buffer);
+	endRecord(lengthAt);
+}
+
+void BinaryWriter::write(const Picture& picture)
+{
+	size_t lengthAt;
+	beginRecord(BinaryKind::PICTURE, lengthAt);
+	encode(picture, m_buffer);
+	endRecord(lengthAt);
+}
+
+void BinaryWriter::write(const Album& album)
+{
+	size_t lengthAt;
+	beginRecord(BinaryKind::ALBUM, lengthAt);
+	encode(album, m_buffer);
+	endRecord(lengthAt);
+}
+
+void BinaryWriter::flush()
+{
+	if (!m_buffer.empty()) {
+		m_sink(m_buffer.data(), m_buffer.size());
+		m_buffer.clear();
+	}
+}
+
+size_t BinaryWriter::getRecordsCount() const
+{
+	return m_records;
+}
+
+void BinaryWriter::encode(const User& user, std::string& bytes)
+{
+	putInt32(bytes, user.getId());
+	putString(bytes, user.getName());
+}
+
+void BinaryWriter::encode(const Picture& picture, std::string& bytes)
+{
+	putInt32(bytes, picture.getId());
+	putInt32(bytes, picture.getAlbumId());
+	putUInt32(bytes, static_cast<uint32_t>(picture.getTagsCount()));
+	putString(bytes, picture.getName());
+	putString(bytes, picture.getPath());
+	putString(bytes, picture.getCreationDate());
+	for (int userId : picture.getUserTags()) {
+		putInt32(bytes, userId);
+	}
+}
+
+void BinaryWriter::encode(const Album& album, std::string& bytes)
+{
+	const std::list<Picture>& pictures = album.pictures();
+	putInt32(bytes, album.getId());
+	putInt32(bytes, album.getOwnerId());
+	putUInt32(bytes, static_cast<uint32_t>(pictures.size()));
+	putString(bytes, album.getName());
+	putString(bytes, album.getCreationDate());
+
+	for (const auto& picture : pictures) {
+		size_t lengthAt = bytes.size();
+		putUInt32(bytes, 0);
+		encode(picture, bytes);
+		patchUInt32(bytes, lengthAt, static_cast<uint32_t>(bytes.size() - lengthAt - 4));
+	}
+}
+
+// ******************* BinaryReader *******************
+BinaryReader::BinaryReader(const char* data, size_t size) :
+	m_data(data), m_size(size)
+{
+	if (size < BINARY_HEADER_BYTES || readUInt32(data) != BINARY_MAGIC) {
+		throw MyException("Not a binary gallery stream");
+	}
+	uint16_t version = readUInt16(data + 4);
+	if (version == 0 || version > BINARY_VERSION) {
+		throw MyException("Binary gallery stream has unknown version " + std::to_string(version));
+	}
+}
+
+/**
+ * next - Moves to the following record.
+ * Params: None
+ * Returns: false at the end of the buffer.
+ */
+bool BinaryReader::next()
+{
+	if (m_position == m_size) {
+		return false;
+	}
+
+	BinaryCursor cursor(m_data + m_position, m_size - m_position);
+	m_kind = static_cast<BinaryKind>(*cursor.take(1));
+	m_payloadSize = cursor.takeUInt32();
+	m_payload = cursor.take(m_payloadSize);
+	m_position += BINARY_RECORD_HEADER_BYTES + m_payloadSize;
+	return true;
+}
+
+BinaryKind BinaryReader::getKind() const
+{
+	return m_kind;
+}
+
+const char* BinaryReader::expect(BinaryKind kind) const
+{
+	if (m_payload == nullptr || m_kind != kind) {
+		throw MyException("Binary record is of another kind");
+	}
+	return m_payload;
+}
+
+UserView BinaryReader::getUser() const
+{
+	return UserView(expect(BinaryKind::USER), m_payloadSize);
+}
+
+PictureView BinaryReader::getPicture() const
+{
+	return PictureView(expect(BinaryKind::PICTURE), m_payloadSize);
+}
+
+AlbumView BinaryReader::getAlbum() const
+{
+	return AlbumView(expect(BinaryKind::ALBUM), m_payloadSize);
+}
@@ -0,0 +1,168 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include "Album.h"
+#include "User.h"
+
+#define BINARY_MAGIC 0x4E494247		// "GBIN"
+#define BINARY_VERSION 1
+#define BINARY_HEADER_BYTES 8		// [u32 magic][u16 version][u16 flags]
+#define BINARY_RECORD_HEADER_BYTES 5	// [u8 kind][u32 payload length]
+#define BINARY_CHUNK_BYTES (64 * 1024)
+
+/*
+ * The binary format of users, pictures and albums: a header, then records. Every number is
+ * little endian and every string is [u32 length][bytes], so a reader needs no alignment.
+ *
+ *   user     [i32 id][string name]
+ *   picture  [i32 id][i32 album id][u32 tags count][string name][string path][string creation date]
+ *            [i32 user id] * tags count, ascending
+ *   album    [i32 id][i32 owner id][u32 pictures count][string name][string creation date]
+ *            ([u32 length][picture]) * pictures count
+ *
+ * The fixed size fields come first, so the views below read them at fixed offsets.
+ */
+enum class BinaryKind : uint8_t
+{
+	USER = 1,
+	PICTURE,
+	ALBUM
+};
+
+/*
+ * UserView, PictureView, AlbumView - read only views of an encoded object, over a buffer
+ * that must outlive them (a mapped file works). The constructor checks every length and
+ * count against the buffer and throws MyException on malformed input; after that the getters
+ * read straight from the bytes, and toUser/toPicture/toAlbum build the owned object.
+ */
+class UserView
+{
+public:
+	UserView(const char* data, size_t size);
+
+	int getId() const;
+	std::string_view getName() const;
+
+	User toUser() const;
+
+private:
+	const char* m_data;
+	std::string_view m_name;
+};
+
+class PictureView
+{
+public:
+	PictureView(const char* data, size_t size);
+
+	int getId() const;
+	int getAlbumId() const;
+	std::string_view getName() const;
+	std::string_view getPath() const;
+	std::string_view getCreationDate() const;
+
+	int getTagsCount() const;
+	int getTag(int index) const;
+	bool isUserTagged(int userId) const;	// binary search, the tags are ascending
+
+	Picture toPicture() const;
+
+private:
+	const char* m_data;
+	std::string_view m_name;
+	std::string_view m_path;
+	std::string_view m_creationDate;
+	const char* m_tags;
+};
+
+class AlbumView
+{
+public:
+	AlbumView(const char* data, size_t size);
+
+	int getId() const;
+	int getOwnerId() const;
+	std::string_view getName() const;
+	std::string_view getCreationDate() const;
+
+	int getPicturesCount() const;
+	void forEachPicture(const std::function<void(const PictureView&)>& fn) const;
+
+	Album toAlbum() const;
+
+private:
+	const char* m_data;
+	std::string_view m_name;
+	std::string_view m_creationDate;
+	const char* m_pictures;		// the first [u32 length][picture], checked by the constructor
+};
+
+/*
+ * BinaryWriter - streaming encoder. Records gather in a buffer that is handed to the sink
+ * every BINARY_CHUNK_BYTES and on flush(), so a whole gallery is never held in memory twice.
+ * The header goes out with the first chunk.
+ */
+class BinaryWriter
+{
+public:
+	using Sink = std::function<void(const char* data, size_t size)>;
+
+	explicit BinaryWriter(Sink sink);
+	explicit BinaryWriter(std::ostream& out);
+	~BinaryWriter();
+	BinaryWriter(const BinaryWriter&) = delete;
+	BinaryWriter& operator=(const BinaryWriter&) = delete;
+
+	void write(const User& user);
+	void write(const Picture& picture);
+	void write(const Album& album);
+	void flush();
+
+	size_t getRecordsCount() const;
+
+	// the payloads alone, appended to bytes
+	static void encode(const User& user, std::string& bytes);
+	static void encode(const Picture& picture, std::string& bytes);
+	static void encode(const Album& album, std::string& bytes);
+
+private:
+	Sink m_sink;
+	std::string m_buffer;
+	size_t m_records { 0 };
+
+	void beginRecord(BinaryKind kind, size_t& lengthAt);
+	void endRecord(size_t lengthAt);
+};
+
+/*
+ * BinaryReader - walks the records of an encoded buffer without copying it.
+ * The constructor checks the header (MyException for another format or a newer version);
+ * next() moves to the following record and throws MyException if its length runs past the end.
+ */
+class BinaryReader
+{
+public:
+	BinaryReader(const char* data, size_t size);
+
+	bool next();
+	BinaryKind getKind() const;
+
+	// the current record, MyException if it is of another kind
+	UserView getUser() const;
+	PictureView getPicture() const;
+	AlbumView getAlbum() const;
+
+private:
+	const char* m_data;
+	size_t m_size;
+	size_t m_position { BINARY_HEADER_BYTES };
+	BinaryKind m_kind { BinaryKind::USER };
+	const char* m_payload { nullptr };
+	size_t m_payloadSize { 0 };
+
+	const char* expect(BinaryKind kind) const;
+};
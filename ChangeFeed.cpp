@@ -0,0 +1,132 @@
+#include "ChangeFeed.h"
+#include <cstring>
+
+
+/**
+ * attach - Registers the update, commit and rollback hooks of the feed on a connection.
+ * Params: db - SQLite database handle
+ * Returns: None
+ */
+void ChangeFeed::attach(sqlite3* db)
+{
+	sqlite3_update_hook(db, &ChangeFeed::onUpdate, this);
+	sqlite3_commit_hook(db, &ChangeFeed::onCommit, this);
+	sqlite3_rollback_hook(db, &ChangeFeed::onRollback, this);
+}
+
+/**
+ * detach - Removes the hooks of the feed from a connection.
+ * Params: db - SQLite database handle
+ * Returns: None
+ */
+void ChangeFeed::detach(sqlite3* db)
+{
+	sqlite3_update_hook(db, nullptr, nullptr);
+	sqlite3_commit_hook(db, nullptr, nullptr);
+	sqlite3_rollback_hook(db, nullptr, nullptr);
+	m_pending.clear();
+}
+
+/**
+ * subscribe - Adds a listener that is called with every committed batch of changes.
+ * Params: listener - function that receives the changes of one commit
+ * Returns: Id to pass to unsubscribe.
+ */
+int ChangeFeed::subscribe(const Listener& listener)
+{
+	int id = m_nextSubscriptionId++;
+	m_listeners.emplace(id, listener);
+	return id;
+}
+
+void ChangeFeed::unsubscribe(int subscriptionId)
+{
+	m_listeners.erase(subscriptionId);
+}
+
+/**
+ * publish - Delivers the committed changes to the listeners.
+ * Params: None
+ * Returns: None
+ * Note: called by the connection at points where no rows of a query are in use, never from
+ *       inside a sqlite hook, so listeners are free to query the database. Their own statements
+ *       land here again; those changes are delivered by the outer call once the listeners return.
+ */
+void ChangeFeed::publish()
+{
+	if (m_isPublishing) {
+		return;
+	}
+
+	m_isPublishing = true;
+	try {
+		while (!m_committed.empty()) {
+			std::vector<RowChange> changes;
+			changes.swap(m_committed);
+
+			auto listeners = m_listeners;
+			for (const auto& entry : listeners) {
+				entry.second(changes);
+			}
+		}
+	}
+	catch (...) {
+		m_isPublishing = false;
+		throw;
+	}
+	m_isPublishing = false;
+}
+
+void ChangeFeed::onUpdate(void* feed, int operation, const char* /*dbName*/, const char* tableName, sqlite3_int64 rowId)
+{
+	ChangeFeed* self = static_cast<ChangeFeed*>(feed);
+	RowChange change { ChangeTable::USERS, ChangeOperation::ROW_INSERT, rowId };
+
+	if (strcmp(tableName, "USERS") == 0) {
+		change.table = ChangeTable::USERS;
+	}
+	else if (strcmp(tableName, "ALBUMS") == 0) {
+		change.table = ChangeTable::ALBUMS;
+	}
+	else if (strcmp(tableName, "PICTURES") == 0) {
+		change.table = ChangeTable::PICTURES;
+	}
+	else if (strcmp(tableName, "TAGS") == 0) {
+		change.table = ChangeTable::TAGS;
+	}
+	else {
+		return;
+	}
+
+	switch (operation)
+	{
+	case SQLITE_INSERT:
+		change.operation = ChangeOperation::ROW_INSERT;
+		break;
+	case SQLITE_UPDATE:
+		change.operation = ChangeOperation::ROW_UPDATE;
+		break;
+	case SQLITE_DELETE:
+		change.operation = ChangeOperation::ROW_DELETE;
+		break;
+	default:
+		return;
+	}
+
+	self->m_pending.push_back(change);
+}
+
+int ChangeFeed::onCommit(void* feed)
+{
+	ChangeFeed* self = static_cast<ChangeFeed*>(feed);
+	self->m_committed.insert(self->m_committed.end(), self->m_pending.begin(), self->m_pending.end());
+	self->m_pending.clear();
+
+	// 0 lets the commit go on
+	return 0;
+}
+
+void ChangeFeed::onRollback(void* feed)
+{
+	static_cast<ChangeFeed*>(feed)->m_pending.clear();
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "sqlite3.h"
+#include <functional>
+#include <map>
+#include <vector>
+
+enum class ChangeTable
+{
+	USERS,
+	ALBUMS,
+	PICTURES,
+	TAGS
+};
+
+enum class ChangeOperation
+{
+	ROW_INSERT,
+	ROW_UPDATE,
+	ROW_DELETE
+};
+
+struct RowChange
+{
+	ChangeTable table;
+	ChangeOperation operation;
+	sqlite3_int64 rowId;
+};
+
+/*
+ * ChangeFeed - publishes the row level changes a sqlite connection commits.
+ * sqlite3_update_hook collects the changes of the running transaction, the commit hook
+ * moves them to the committed batch and the rollback hook drops them, so listeners
+ * only ever see changes that made it to the database.
+ */
+class ChangeFeed
+{
+public:
+	using Listener = std::function<void(const std::vector<RowChange>& changes)>;
+
+	ChangeFeed() = default;
+	ChangeFeed(const ChangeFeed&) = delete;
+	ChangeFeed& operator=(const ChangeFeed&) = delete;
+
+	void attach(sqlite3* db);
+	void detach(sqlite3* db);
+
+	int subscribe(const Listener& listener);
+	void unsubscribe(int subscriptionId);
+
+	void publish();
+
+private:
+	static void onUpdate(void* feed, int operation, const char* dbName, const char* tableName, sqlite3_int64 rowId);
+	static int onCommit(void* feed);
+	static void onRollback(void* feed);
+
+	std::vector<RowChange> m_pending;
+	std::vector<RowChange> m_committed;
+	std::map<int, Listener> m_listeners;
+	int m_nextSubscriptionId { 1 };
+	bool m_isPublishing { false };
+};
@@ -0,0 +1,265 @@
+#include "ConcurrentMemoryAccess.h"
+#include <utility>
+
+
+ConcurrentMemoryAccess::ConcurrentMemoryAccess() :
+	m_current(std::make_shared<VersionedMemoryAccess>())
+{
+	// Left empty
+}
+
+ConcurrentMemoryAccess::Version ConcurrentMemoryAccess::current() const
+{
+	// a short critical section in the library's lock pool, not a lock on the data
+	return std::atomic_load(&m_current);
+}
+
+// called with m_writeLock held
+void ConcurrentMemoryAccess::publish(Version next)
+{
+	// the previous version is released here unless a reader still holds it, then by that reader
+	std::atomic_store(&m_current, std::move(next));
+	++m_publishedVersions;
+}
+
+/**
+ * update - Applies several changes to one copy of the data and publishes them together.
+ * Params: changes - called with the private copy, may call any of its methods
+ * Returns: None
+ * Note: if changes throws, nothing is published and the data stays as it was.
+ */
+void ConcurrentMemoryAccess::update(const std::function<void(VersionedMemoryAccess&)>& changes)
+{
+	std::lock_guard<std::mutex> guard(m_writeLock);
+
+	// shares the albums of the current version until changes touches them
+	Version next = std::make_shared<VersionedMemoryAccess>(*current());
+	changes(*next);
+	publish(std::move(next));
+}
+
+size_t ConcurrentMemoryAccess::getPublishedVersions() const
+{
+	return m_publishedVersions;
+}
+
+bool ConcurrentMemoryAccess::open()
+{
+	update([](VersionedMemoryAccess& data) { data.open(); });
+	return true;
+}
+
+void ConcurrentMemoryAccess::clear()
+{
+	std::lock_guard<std::mutex> guard(m_writeLock);
+	publish(std::make_shared<VersionedMemoryAccess>());
+	m_files.clear();
+}
+
+// ******************* Album ******************* 
+const std::list<Album> ConcurrentMemoryAccess::getAlbums()
+{
+	return current()->getAlbums();
+}
+
+const std::list<Album> ConcurrentMemoryAccess::getAlbumsOfUser(const User& user)
+{
+	return current()->getAlbumsOfUser(user);
+}
+
+// the version is held until fn returns, later updates publish new versions instead of changing it
+void ConcurrentMemoryAccess::forEachAlbum(const std::function<void(const Album&)>& fn)
+{
+	Version version = current();
+	version->forEachAlbum(fn);
+}
+
+void ConcurrentMemoryAccess::forEachAlbumOfUser(const User& user, const std::function<void(const Album&)>& fn)
+{
+	Version version = current();
+	version->forEachAlbumOfUser(user, fn);
+}
+
+bool ConcurrentMemoryAccess::visitPicture(const std::string& albumName, const std::string& pictureName, const std::function<void(const Picture&)>& fn)
+{
+	Version version = current();
+	return version->visitPicture(albumName, pictureName, fn);
+}
+
+std::list<Album> ConcurrentMemoryAccess::getAlbumsSorted(const ListingOrder& order)
+{
+	return current()->getAlbumsSorted(order);
+}
+
+std::list<Picture> ConcurrentMemoryAccess::getPicturesSorted(const std::string& albumName, const ListingOrder& order)
+{
+	return current()->getPicturesSorted(albumName, order);
+}
+
+void ConcurrentMemoryAccess::createAlbum(const Album& album)
+{
+	update([&album](VersionedMemoryAccess& data) { data.createAlbum(album); });
+}
+
+void ConcurrentMemoryAccess::createAlbum(Album&& album)
+{
+	update([&album](VersionedMemoryAccess& data) { data.createAlbum(std::move(album)); });
+}
+
+void ConcurrentMemoryAccess::deleteAlbum(const std::string& albumName, int userId)
+{
+	update([&albumName, userId](VersionedMemoryAccess& data) { data.deleteAlbum(albumName, userId); });
+}
+
+bool ConcurrentMemoryAccess::doesAlbumExists(const std::string& albumName, int userId)
+{
+	return current()->doesAlbumExists(albumName, userId);
+}
+
+Album ConcurrentMemoryAccess::openAlbum(const std::string& albumName)
+{
+	return current()->openAlbum(albumName);
+}
+
+void ConcurrentMemoryAccess::closeAlbum(Album& pAlbum)
+{
+	current()->closeAlbum(pAlbum);
+}
+
+void ConcurrentMemoryAccess::printAlbums()
+{
+	current()->printAlbums();
+}
+
+// ******************* Picture ******************* 
+void ConcurrentMemoryAccess::addPictureToAlbumByName(const std::string& albumName, const Picture& picture)
+{
+	update([&albumName, &picture](VersionedMemoryAccess& data) { data.addPictureToAlbumByName(albumName, picture); });
+}
+
+void ConcurrentMemoryAccess::addPictureToAlbumByName(const std::string& albumName, Picture&& picture)
+{
+	update([&albumName, &picture](VersionedMemoryAccess& data) { data.addPictureToAlbumByName(albumName, std::move(picture)); });
+}
+
+void ConcurrentMemoryAccess::removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName)
+{
+	update([&albumName, &pictureName](VersionedMemoryAccess& data) { data.removePictureFromAlbumByName(albumName, pictureName); });
+}
+
+void ConcurrentMemoryAccess::tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
+{
+	update([&albumName, &pictureName, userId](VersionedMemoryAccess& data) { data.tagUserInPicture(albumName, pictureName, userId); });
+}
+
+void ConcurrentMemoryAccess::untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
+{
+	update([&albumName, &pictureName, userId](VersionedMemoryAccess& data) { data.untagUserInPicture(albumName, pictureName, userId); });
+}
+
+bool ConcurrentMemoryAccess::getFileMetadata(const std::string& path, FileMetadata& metadata)
+{
+	return m_files.find(path, metadata);
+}
+
+void ConcurrentMemoryAccess::storeFileMetadata(const std::vector<FileMetadata>& files)
+{
+	m_files.store(files);
+}
+
+void ConcurrentMemoryAccess::forEachFileMetadata(const std::function<void(const FileMetadata&)>& fn)
+{
+	m_files.forEach(fn);
+}
+
+bool ConcurrentMemoryAccess::doesPictureExistsInAlbum(const std::string& albumName, const std::string& pictureName)
+{
+	return current()->doesPictureExistsInAlbum(albumName, pictureName);
+}
+
+Picture ConcurrentMemoryAccess::getPictureFromAlbum(const std::string& albumName, const std::string& pictureName)
+{
+	return current()->getPictureFromAlbum(albumName, pictureName);
+}
+
+bool ConcurrentMemoryAccess::isUserTaggedInPicture(const User& user, const Picture& picture)
+{
+	return current()->isUserTaggedInPicture(user, picture);
+}
+
+std::list<User> ConcurrentMemoryAccess::getUsersTaggedInPicture(const Picture& picture)
+{
+	return current()->getUsersTaggedInPicture(picture);
+}
+
+int ConcurrentMemoryAccess::getTheNextId(const std::string& tableName)
+{
+	return current()->getTheNextId(tableName);
+}
+
+// ******************* User ******************* 
+void ConcurrentMemoryAccess::printUsers()
+{
+	current()->printUsers();
+}
+
+void ConcurrentMemoryAccess::createUser(User& user)
+{
+	update([&user](VersionedMemoryAccess& data) { data.createUser(user); });
+}
+
+void ConcurrentMemoryAccess::deleteUser(const User& user)
+{
+	update([&user](VersionedMemoryAccess& data) { data.deleteUser(user); });
+}
+
+bool ConcurrentMemoryAccess::doesUserExists(int userId)
+{
+	return current()->doesUserExists(userId);
+}
+
+bool ConcurrentMemoryAccess::doesUserExists(const std::string& name)
+{
+	return current()->doesUserExists(name);
+}
+
+User ConcurrentMemoryAccess::getUser(int userId)
+{
+	return current()->getUser(userId);
+}
+
+// user statistics
+int ConcurrentMemoryAccess::countAlbumsOwnedOfUser(const User& user)
+{
+	return current()->countAlbumsOwnedOfUser(user);
+}
+
+int ConcurrentMemoryAccess::countAlbumsTaggedOfUser(const User& user)
+{
+	return current()->countAlbumsTaggedOfUser(user);
+}
+
+int ConcurrentMemoryAccess::countTagsOfUser(const User& user)
+{
+	return current()->countTagsOfUser(user);
+}
+
+float ConcurrentMemoryAccess::averageTagsPerAlbumOfUser(const User& user)
+{
+	return current()->averageTagsPerAlbumOfUser(user);
+}
+
+User ConcurrentMemoryAccess::getTopTaggedUser()
+{
+	return current()->getTopTaggedUser();
+}
+
+Picture ConcurrentMemoryAccess::getTopTaggedPicture()
+{
+	return current()->getTopTaggedPicture();
+}
+
+std::list<Picture> ConcurrentMemoryAccess::getTaggedPicturesOfUser(const User& user)
+{
+	return current()->getTaggedPicturesOfUser(user);
+}
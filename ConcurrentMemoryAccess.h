@@ -0,0 +1,100 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include "VersionedMemoryAccess.h"
+
+/*
+ * ConcurrentMemoryAccess - MemoryAccess that many threads can use at once.
+ * Readers take a reference to the current published version and work on it without a lock.
+ * Taking the reference (std::atomic_load of a shared_ptr) is not lock free: the standard
+ * library guards it with a spin lock of its own, held only for the copy of the pointer.
+ * A writer applies its change to a private copy of that version and then publishes
+ * the copy, so a long statistics scan never blocks tagging and never sees half a change.
+ * A version is freed when the last reader holding it drops its reference.
+ *
+ * The versions are VersionedMemoryAccess: a copy shares every album with the version it was
+ * made from, and a write copies only the album it touches and the index nodes leading to it.
+ * update() publishes many changes as one version.
+ */
+class ConcurrentMemoryAccess : public IDataAccess
+{
+public:
+	ConcurrentMemoryAccess();
+	virtual ~ConcurrentMemoryAccess() = default;
+
+	// album related
+	const std::list<Album> getAlbums() override;
+	const std::list<Album> getAlbumsOfUser(const User& user) override;
+	void createAlbum(const Album& album) override;
+	void createAlbum(Album&& album) override;
+	void deleteAlbum(const std::string& albumName, int userId) override;
+	bool doesAlbumExists(const std::string& albumName, int userId) override;
+	Album openAlbum(const std::string& albumName) override;
+	void closeAlbum(Album& pAlbum) override;
+	void printAlbums() override;
+
+	void forEachAlbum(const std::function<void(const Album&)>& fn) override;
+	void forEachAlbumOfUser(const User& user, const std::function<void(const Album&)>& fn) override;
+	bool visitPicture(const std::string& albumName, const std::string& pictureName, const std::function<void(const Picture&)>& fn) override;
+
+	std::list<Album> getAlbumsSorted(const ListingOrder& order) override;
+	std::list<Picture> getPicturesSorted(const std::string& albumName, const ListingOrder& order) override;
+
+	// picture related
+	void addPictureToAlbumByName(const std::string& albumName, const Picture& picture) override;
+	void addPictureToAlbumByName(const std::string& albumName, Picture&& picture) override;
+	void removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName) override;
+	void tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
+	void untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
+
+	// kept next to the versions, storing records does not copy the store
+	bool getFileMetadata(const std::string& path, FileMetadata& metadata) override;
+	void storeFileMetadata(const std::vector<FileMetadata>& files) override;
+	void forEachFileMetadata(const std::function<void(const FileMetadata&)>& fn) override;
+
+	// user related
+	void printUsers() override;
+	void createUser(User& user) override;
+	void deleteUser(const User& user) override;
+	bool doesUserExists(int userId) override;
+	User getUser(int userId) override;
+
+	// user statistics
+	int countAlbumsOwnedOfUser(const User& user) override;
+	int countAlbumsTaggedOfUser(const User& user) override;
+	int countTagsOfUser(const User& user) override;
+	float averageTagsPerAlbumOfUser(const User& user) override;
+
+	// queries
+	User getTopTaggedUser() override;
+	Picture getTopTaggedPicture() override;
+	std::list<Picture> getTaggedPicturesOfUser(const User& user) override;
+
+	bool open() override;
+	void close() override {};
+	void clear() override;
+
+	bool doesPictureExistsInAlbum(const std::string& albumName, const std::string& pictureName) override;
+	int getTheNextId(const std::string& tableName) override;
+	Picture getPictureFromAlbum(const std::string& albumName, const std::string& pictureName) override;
+	bool isUserTaggedInPicture(const User& user, const Picture& picture) override;
+	std::list<User> getUsersTaggedInPicture(const Picture& picture) override;
+	bool doesUserExists(const std::string& name) override;
+
+	void update(const std::function<void(VersionedMemoryAccess&)>& changes);
+	size_t getPublishedVersions() const;
+
+private:
+	// a published version is never changed again, only replaced
+	using Version = std::shared_ptr<VersionedMemoryAccess>;
+
+	Version m_current;
+	std::mutex m_writeLock;
+	std::atomic<size_t> m_publishedVersions { 0 };
+	FileMetadataStore m_files;
+
+	Version current() const;
+	void publish(Version next);
+};
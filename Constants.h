@@ -35,6 +35,10 @@ enum CommandType
 	PICTURES_TAGGED_USER,
 
 	OPEN_PICTURE_IN_APP,
+	VERIFY_FILES,
+	FIND_DUPLICATES,
+	SHOW_THUMBNAIL,
+	IMPORT_FOLDER,
 
 	EXIT = 99
 };
@@ -0,0 +1,507 @@
+#include "ContentStore.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define CONTENT_DIGEST_DIGITS 64
+#define CONTENT_KNOWN_FILES "imports"		// in the root, a line per imported file: size, time, digest, path
+#define CONTENT_MAX_EXTENSION 8
+
+// ******************* Sha256 *******************
+
+static const uint32_t roundConstants[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rotateRight(uint32_t value, int count)
+{
+	return (value >> count) | (value << (32 - count));
+}
+
+Sha256::Sha256()
+{
+	static const uint32_t initial[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+	std::memcpy(m_state, initial, sizeof(m_state));
+}
+
+void Sha256::compress(const uint8_t* block)
+{
+	uint32_t words[64];
+	for (int i = 0; i < 16; ++i) {
+		words[i] = (static_cast<uint32_t>(block[4 * i]) << 24) | (block[4 * i + 1] << 16) | (block[4 * i + 2] << 8) | block[4 * i + 3];
+	}
+	for (int i = 16; i < 64; ++i) {
+		uint32_t s0 = rotateRight(words[i - 15], 7) ^ rotateRight(words[i - 15], 18) ^ (words[i - 15] >> 3);
+		uint32_t s1 = rotateRight(words[i - 2], 17) ^ rotateRight(words[i - 2], 19) ^ (words[i - 2] >> 10);
+		words[i] = words[i - 16] + s0 + words[i - 7] + s1;
+	}
+
+	uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+	uint32_t e = m_state[4], f = m_state[5], g = m_state[6], h = m_state[7];
+	for (int i = 0; i < 64; ++i) {
+		uint32_t t1 = h + (rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25)) + ((e & f) ^ (~e & g)) + roundConstants[i] + words[i];
+		uint32_t t2 = (rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+	m_state[0] += a;
+	m_state[1] += b;
+	m_state[2] += c;
+	m_state[3] += d;
+	m_state[4] += e;
+	m_state[5] += f;
+	m_state[6] += g;
+	m_state[7] += h;
+}
+
+void Sha256::update(const uint8_t* data, size_t size)
+{
+	if (size == 0) {
+		return;
+	}
+	m_length += size;
+	if (m_blockSize > 0) {
+		size_t taken = std::min(size, sizeof(m_block) - m_blockSize);
+		std::memcpy(m_block + m_blockSize, data, taken);
+		m_blockSize += taken;
+		data += taken;
+		size -= taken;
+		if (m_blockSize < sizeof(m_block)) {
+			return;
+		}
+		compress(m_block);
+		m_blockSize = 0;
+	}
+	// whole blocks straight from the input
+	for (; size >= sizeof(m_block); data += sizeof(m_block), size -= sizeof(m_block)) {
+		compress(data);
+	}
+	std::memcpy(m_block, data, size);
+	m_blockSize = size;
+}
+
+std::array<uint8_t, 32> Sha256::finish()
+{
+	// 0x80, zeros up to 56 mod 64, then the length in bits
+	uint64_t bits = m_length * 8;
+	uint8_t padding[72] = { 0x80 };
+	size_t padded = (m_blockSize < 56 ? 56 : 120) - m_blockSize;
+	for (int i = 0; i < 8; ++i) {
+		padding[padded + i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+	}
+	update(padding, padded + 8);
+
+	std::array<uint8_t, 32> digest;
+	for (int i = 0; i < 8; ++i) {
+		for (int j = 0; j < 4; ++j) {
+			digest[4 * i + j] = static_cast<uint8_t>(m_state[i] >> (24 - 8 * j));
+		}
+	}
+	return digest;
+}
+
+std::string Sha256::toHex(const std::array<uint8_t, 32>& digest)
+{
+	static const char digits[] = "0123456789abcdef";
+	std::string text;
+	text.reserve(digest.size() * 2);
+	for (uint8_t byte : digest) {
+		text.push_back(digits[byte >> 4]);
+		text.push_back(digits[byte & 0xF]);
+	}
+	return text;
+}
+
+/*
+ * MappedFile - a file mapped read only, so hashing it reads the page cache in place.
+ */
+class MappedFile
+{
+public:
+	explicit MappedFile(const std::string& path);
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool isOpen() const { return m_isOpen; }
+	const uint8_t* getData() const { return m_data; }
+	size_t getSize() const { return m_size; }
+
+private:
+	const uint8_t* m_data { nullptr };
+	size_t m_size { 0 };
+	bool m_isOpen { false };
+#ifdef _WIN32
+	HANDLE m_file { INVALID_HANDLE_VALUE };
+	HANDLE m_mapping { nullptr };
+#else
+	int m_file { -1 };
+#endif
+};
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path)
+{
+	m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	LARGE_INTEGER size;
+	if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size)) {
+		return;
+	}
+	m_size = static_cast<size_t>(size.QuadPart);
+	if (m_size == 0) {
+		m_isOpen = true;	// nothing to map
+		return;
+	}
+	m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping != nullptr) {
+		m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+		m_isOpen = m_data != nullptr;
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_data != nullptr) {
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mapping != nullptr) {
+		CloseHandle(m_mapping);
+	}
+	if (m_file != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_file);
+	}
+}
+#else
+MappedFile::MappedFile(const std::string& path)
+{
+	m_file = open(path.c_str(), O_RDONLY);
+	struct stat buffer;
+	if (m_file < 0 || fstat(m_file, &buffer) != 0 || !S_ISREG(buffer.st_mode)) {
+		return;
+	}
+	m_size = static_cast<size_t>(buffer.st_size);
+	if (m_size == 0) {
+		m_isOpen = true;	// nothing to map
+		return;
+	}
+	void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+	if (data != MAP_FAILED) {
+		madvise(data, m_size, MADV_SEQUENTIAL);
+		m_data = static_cast<const uint8_t*>(data);
+		m_isOpen = true;
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_data != nullptr) {
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+	}
+	if (m_file >= 0) {
+		close(m_file);
+	}
+}
+#endif
+
+std::string Sha256::hashFile(const std::string& path)
+{
+	MappedFile file(path);
+	if (!file.isOpen()) {
+		return "";
+	}
+	Sha256 hash;
+	hash.update(file.getData(), file.getSize());
+	return toHex(hash.finish());
+}
+
+// ******************* ContentStore *******************
+
+static bool statFile(const std::string& path, uint64_t& size, int64_t& modifiedTime)
+{
+	std::error_code error;
+	if (!std::filesystem::is_regular_file(path, error)) {
+		return false;
+	}
+	size = std::filesystem::file_size(path, error);
+	if (error) {
+		return false;
+	}
+	auto time = std::filesystem::last_write_time(path, error);
+	if (error) {
+		return false;
+	}
+	modifiedTime = static_cast<int64_t>(time.time_since_epoch().count());
+	return true;
+}
+
+ContentStore::ContentStore(const std::string& root)
+{
+	std::error_code error;
+	std::filesystem::create_directories(root, error);
+	std::filesystem::path absolute = std::filesystem::absolute(root, error).lexically_normal();
+	m_root = (absolute.has_filename() ? absolute : absolute.parent_path()).string();
+
+	// the copies: <root>/<2 digits>/<digest><extension>
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(m_root, error)) {
+		std::string path = entry.path().string();
+		std::error_code entryError;
+		if (entry.path().extension() == ".tmp") {
+			std::filesystem::remove(entry.path(), entryError);	// a run stopped while copying it
+			continue;
+		}
+		std::string digest = getDigest(path);
+		if (!digest.empty() && entry.is_regular_file(entryError)) {
+			m_stored[digest] = path;
+		}
+	}
+	loadKnownFiles();
+}
+
+const std::string& ContentStore::getRoot() const
+{
+	return m_root;
+}
+
+/**
+ * getDigest - The digest a path of the store is named after.
+ * Params: path - any path
+ * Returns: the digest, empty when path is not under the root or not named after one.
+ */
+std::string ContentStore::getDigest(const std::string& path) const
+{
+	std::filesystem::path file(path);
+	if (file.parent_path().parent_path().string() != m_root) {
+		return "";
+	}
+	std::string name = file.stem().string();
+	if (name.size() != CONTENT_DIGEST_DIGITS || file.parent_path().filename().string() != name.substr(0, 2)) {
+		return "";
+	}
+	for (char digit : name) {
+		if (!isdigit(static_cast<unsigned char>(digit)) && (digit < 'a' || digit > 'f')) {
+			return "";
+		}
+	}
+	return name;
+}
+
+std::string ContentStore::makeStoredPath(const std::string& digest, const std::string& source) const
+{
+	// the extension of the source stays, the viewers go by it
+	std::string extension = std::filesystem::path(source).extension().string();
+	bool isPlain = extension.size() <= CONTENT_MAX_EXTENSION &&
+		std::all_of(extension.begin() + (extension.empty() ? 0 : 1), extension.end(), [](char c) { return isalnum(static_cast<unsigned char>(c)) != 0; });
+	if (!isPlain) {
+		extension.clear();
+	}
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+	return (std::filesystem::path(m_root) / digest.substr(0, 2) / (digest + extension)).string();
+}
+
+bool ContentStore::isStored(const std::string& path) const
+{
+	std::string digest = getDigest(path);
+	if (digest.empty()) {
+		return false;
+	}
+	auto stored = m_stored.find(digest);
+	return stored != m_stored.end() && stored->second == path;
+}
+
+std::vector<ContentStore::ImportedFile> ContentStore::import(const std::vector<std::string>& sources, const Parallelism& parallelism, ImportStats& stats)
+{
+	stats = ImportStats();
+	std::vector<ImportedFile> results(sources.size());
+	std::vector<KnownFile> files(sources.size());
+
+	// the files that did not change since their last import keep their digest
+	std::vector<size_t> unknown;
+	for (size_t i = 0; i < sources.size(); ++i) {
+		results[i].source = sources[i];
+		if (!statFile(sources[i], files[i].size, files[i].modifiedTime)) {
+			continue;
+		}
+		auto known = m_known.find(sources[i]);
+		if (known != m_known.end() && known->second.size == files[i].size && known->second.modifiedTime == files[i].modifiedTime) {
+			files[i].digest = known->second.digest;
+			++stats.remembered;
+		}
+		else {
+			unknown.push_back(i);
+		}
+	}
+
+	// every chunk hashes its own files, no locking
+	size_t chunks = parallelism.getChunks(unknown.size());
+	parallelism.run(chunks, [&unknown, &sources, &files, chunks](size_t chunk) {
+		size_t end = Parallelism::getChunkBegin(unknown.size(), chunks, chunk + 1);
+		for (size_t i = Parallelism::getChunkBegin(unknown.size(), chunks, chunk); i < end; ++i) {
+			files[unknown[i]].digest = Sha256::hashFile(sources[unknown[i]]);
+		}
+	});
+
+	std::vector<std::pair<std::string, KnownFile>> hashed;
+	for (size_t i : unknown) {
+		if (!files[i].digest.empty()) {
+			hashed.emplace_back(sources[i], files[i]);
+		}
+	}
+	stats.hashed = hashed.size();
+	rememberFiles(hashed);
+
+	// one copy per content, also when it comes twice in this import
+	for (size_t i = 0; i < sources.size(); ++i) {
+		const std::string& digest = files[i].digest;
+		if (digest.empty()) {
+			++stats.failed;
+			continue;
+		}
+		std::error_code error;
+		auto stored = m_stored.find(digest);
+		if (stored != m_stored.end() && std::filesystem::exists(stored->second, error)) {
+			results[i].storedPath = stored->second;
+			continue;
+		}
+
+		// copied aside and renamed, so a copy in the store is always complete
+		std::string path = makeStoredPath(digest, sources[i]);
+		std::string temporary = path + ".tmp";
+		std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+		if (!error) {
+			std::filesystem::copy_file(sources[i], temporary, std::filesystem::copy_options::overwrite_existing, error);
+		}
+		if (!error) {
+			std::filesystem::rename(temporary, path, error);
+		}
+		if (error) {
+			std::error_code ignored;
+			std::filesystem::remove(temporary, ignored);
+			++stats.failed;
+			continue;
+		}
+		m_stored[digest] = path;
+		results[i].storedPath = path;
+		results[i].isNew = true;
+		++stats.copied;
+		stats.bytesCopied += files[i].size;
+	}
+	return results;
+}
+
+bool ContentStore::isEmpty() const
+{
+	return m_stored.empty();
+}
+
+bool ContentStore::hasReferences() const
+{
+	return m_hasReferences;
+}
+
+void ContentStore::setReferences(const std::vector<std::string>& paths)
+{
+	m_references.clear();
+	for (const std::string& path : paths) {
+		if (isStored(path)) {
+			++m_references[getDigest(path)];
+		}
+	}
+	m_hasReferences = true;
+}
+
+void ContentStore::addReference(const std::string& path)
+{
+	if (isStored(path)) {
+		++m_references[getDigest(path)];
+	}
+}
+
+void ContentStore::releaseReference(const std::string& path)
+{
+	if (!isStored(path)) {
+		return;
+	}
+	// a copy nobody counted is kept, deleting it could lose a picture
+	std::string digest = getDigest(path);
+	auto references = m_references.find(digest);
+	if (references == m_references.end() || --references->second > 0) {
+		return;
+	}
+	m_references.erase(references);
+	std::error_code error;
+	std::filesystem::remove(path, error);
+	m_stored.erase(digest);
+}
+
+void ContentStore::removeUnreferenced(const std::string& path)
+{
+	if (!m_hasReferences || !isStored(path) || m_references.count(getDigest(path)) != 0) {
+		return;
+	}
+	std::error_code error;
+	std::filesystem::remove(path, error);
+	m_stored.erase(getDigest(path));
+}
+
+size_t ContentStore::getReferences(const std::string& path) const
+{
+	auto references = m_references.find(getDigest(path));
+	return references == m_references.end() ? 0 : references->second;
+}
+
+void ContentStore::loadKnownFiles()
+{
+	std::ifstream file((std::filesystem::path(m_root) / CONTENT_KNOWN_FILES).string());
+	std::string line;
+	while (std::getline(file, line)) {
+		// appended in order, a later line of the same file replaces an earlier one
+		std::istringstream fields(line);
+		KnownFile known;
+		std::string path;
+		if (fields >> known.size >> known.modifiedTime >> known.digest && fields.get() == ' ' && std::getline(fields, path) &&
+			known.digest.size() == CONTENT_DIGEST_DIGITS) {
+			m_known[path] = std::move(known);
+		}
+	}
+}
+
+void ContentStore::rememberFiles(const std::vector<std::pair<std::string, KnownFile>>& files)
+{
+	if (files.empty()) {
+		return;
+	}
+	std::ofstream file((std::filesystem::path(m_root) / CONTENT_KNOWN_FILES).string(), std::ios::app);
+	for (const auto& known : files) {
+		file << known.second.size << ' ' << known.second.modifiedTime << ' ' << known.second.digest << ' ' << known.first << '\n';
+		m_known[known.first] = known.second;
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ThreadPool.h"
+
+#define CONTENT_STORE_DIR "store"
+#define CONTENT_IMPORT_THRESHOLD 4			// fewer files to hash are hashed on the calling thread
+
+/*
+ * Sha256 - FIPS 180-4 SHA-256, fed in pieces.
+ */
+class Sha256
+{
+public:
+	Sha256();
+	void update(const uint8_t* data, size_t size);
+	std::array<uint8_t, 32> finish();
+
+	static std::string toHex(const std::array<uint8_t, 32>& digest);
+	static std::string hashFile(const std::string& path);	// hex digest, empty when the file can not be read
+
+private:
+	uint32_t m_state[8];
+	uint8_t m_block[64];
+	size_t m_blockSize { 0 };
+	uint64_t m_length { 0 };
+
+	void compress(const uint8_t* block);
+};
+
+/*
+ * ContentStore - the managed copies of imported picture files, one per distinct content, at
+ * <root>/<first 2 digits>/<SHA-256 in hex><extension>. The pictures refer to their copy by that
+ * path, so a file imported twice (or from two folders) is stored once and moving the originals
+ * breaks nothing. The store counts the pictures referring to every copy and deletes a copy with
+ * the last of them. It also remembers the digest of every imported file with its size and
+ * modification time, so importing a folder again only stats the files that did not change.
+ */
+class ContentStore
+{
+public:
+	struct ImportedFile
+	{
+		std::string source;
+		std::string storedPath;		// empty when the file could not be read or copied
+		bool isNew { false };		// copied in now, nothing had the content before
+	};
+
+	struct ImportStats
+	{
+		size_t hashed { 0 };		// read and hashed
+		size_t remembered { 0 };	// unchanged since their last import, not read
+		size_t copied { 0 };
+		size_t failed { 0 };
+		uint64_t bytesCopied { 0 };
+	};
+
+	explicit ContentStore(const std::string& root = CONTENT_STORE_DIR);
+	ContentStore(const ContentStore&) = delete;
+	ContentStore& operator=(const ContentStore&) = delete;
+
+	// hashes the sources split over parallelism and copies the content the store does not have yet
+	std::vector<ImportedFile> import(const std::vector<std::string>& sources, const Parallelism& parallelism, ImportStats& stats);
+
+	bool isStored(const std::string& path) const;
+	bool isEmpty() const;
+	const std::string& getRoot() const;
+
+	// the counts start from the paths of every picture, given once before the first change
+	bool hasReferences() const;
+	void setReferences(const std::vector<std::string>& paths);
+	void addReference(const std::string& path);
+	void releaseReference(const std::string& path);		// the copy is deleted with its last reference
+	void removeUnreferenced(const std::string& path);		// e.g. a copy imported for a picture that was not added
+	size_t getReferences(const std::string& path) const;
+
+private:
+	struct KnownFile
+	{
+		uint64_t size;
+		int64_t modifiedTime;
+		std::string digest;
+	};
+
+	std::string m_root;
+	std::unordered_map<std::string, std::string> m_stored;		// digest -> path of the copy
+	std::unordered_map<std::string, KnownFile> m_known;			// imported file -> its digest
+	std::unordered_map<std::string, size_t> m_references;		// digest -> pictures
+	bool m_hasReferences { false };
+
+	std::string getDigest(const std::string& path) const;
+	std::string makeStoredPath(const std::string& digest, const std::string& source) const;
+	void loadKnownFiles();
+	void rememberFiles(const std::vector<std::pair<std::string, KnownFile>>& files);
+};
@@ -0,0 +1,94 @@
+#include "CreationIndex.h"
+#include <iterator>
+#include <limits>
+
+/**
+ * take - Copies the values of the first entries of a range, from its front or from its back.
+ * Params: begin, end - the range; descending - start from the back; limit - entries to take, 0 for all
+ * Returns: The values, in the order taken.
+ */
+template <typename Iterator>
+static auto take(Iterator begin, Iterator end, bool descending, size_t limit)
+{
+	std::vector<typename std::iterator_traits<Iterator>::value_type::second_type> values;
+	if (limit == 0) {
+		limit = std::numeric_limits<size_t>::max();
+	}
+
+	if (descending) {
+		for (auto entry = std::make_reverse_iterator(end); entry != std::make_reverse_iterator(begin) && values.size() < limit; ++entry) {
+			values.push_back(entry->second);
+		}
+	}
+	else {
+		for (auto entry = begin; entry != end && values.size() < limit; ++entry) {
+			values.push_back(entry->second);
+		}
+	}
+	return values;
+}
+
+void CreationIndex::addAlbum(const Album* album)
+{
+	AlbumKey key(album->getCreationTime(), m_nextSequence++);
+	m_albums.emplace(key, album);
+	m_albumKeys.emplace(album, key);
+}
+
+// its pictures keep their entries until they are removed one by one
+void CreationIndex::removeAlbum(const Album* album)
+{
+	auto found = m_albumKeys.find(album);
+	if (found != m_albumKeys.end()) {
+		m_albums.erase(found->second);
+		m_albumKeys.erase(found);
+	}
+}
+
+void CreationIndex::addPicture(const Album* album, const Picture* picture)
+{
+	auto albumKey = m_albumKeys.find(album);
+	if (albumKey == m_albumKeys.end()) {
+		return;
+	}
+
+	PictureKey key(albumKey->second.second, picture->getCreationTime(), m_nextSequence++);
+	m_pictures.emplace(key, picture);
+	m_pictureKeys.emplace(picture, key);
+}
+
+void CreationIndex::removePicture(const Picture* picture)
+{
+	auto found = m_pictureKeys.find(picture);
+	if (found != m_pictureKeys.end()) {
+		m_pictures.erase(found->second);
+		m_pictureKeys.erase(found);
+	}
+}
+
+void CreationIndex::clear()
+{
+	m_albums.clear();
+	m_albumKeys.clear();
+	m_pictures.clear();
+	m_pictureKeys.clear();
+	m_nextSequence = 0;
+}
+
+std::vector<const Album*> CreationIndex::getAlbums(bool descending, size_t limit) const
+{
+	return take(m_albums.begin(), m_albums.end(), descending, limit);
+}
+
+std::vector<const Picture*> CreationIndex::getPictures(const Album* album, bool descending, size_t limit) const
+{
+	auto albumKey = m_albumKeys.find(album);
+	if (albumKey == m_albumKeys.end()) {
+		return {};
+	}
+
+	uint64_t sequence = albumKey->second.second;
+	auto begin = m_pictures.lower_bound(PictureKey(sequence, std::numeric_limits<int64_t>::min(), 0));
+	auto end = m_pictures.lower_bound(PictureKey(sequence + 1, std::numeric_limits<int64_t>::min(), 0));
+	return take(begin, end, descending, limit);
+}
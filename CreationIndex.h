@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Album.h"
+
+/*
+ * CreationIndex - the albums of a MemoryAccess, and the pictures of each album, ordered by
+ * creation date, kept up to date by MemoryAccess as albums and pictures come and go.
+ * Equal dates keep insertion order. Taking the first or last n entries costs O(log size + n),
+ * so the newest 20 pictures of an album do not look at the others.
+ */
+class CreationIndex
+{
+public:
+	void addAlbum(const Album* album);
+	void removeAlbum(const Album* album);
+	void addPicture(const Album* album, const Picture* picture);
+	void removePicture(const Picture* picture);
+	void clear();
+
+	// limit 0 takes every entry
+	std::vector<const Album*> getAlbums(bool descending, size_t limit) const;
+	std::vector<const Picture*> getPictures(const Album* album, bool descending, size_t limit) const;
+
+private:
+	// (creation time, insertion sequence)
+	using AlbumKey = std::pair<int64_t, uint64_t>;
+	// (album sequence, creation time, insertion sequence): the pictures of an album are one range
+	using PictureKey = std::tuple<uint64_t, int64_t, uint64_t>;
+
+	std::map<AlbumKey, const Album*> m_albums;
+	std::unordered_map<const Album*, AlbumKey> m_albumKeys;
+	std::map<PictureKey, const Picture*> m_pictures;
+	std::unordered_map<const Picture*, PictureKey> m_pictureKeys;
+	uint64_t m_nextSequence { 0 };
+};
@@ -1,22 +1,51 @@
 #include "DatabaseAcses.h"
 #include "sqlite3.h"
 #include <algorithm>
+#include <cstring>
+#include <unordered_map>
 #include <io.h>
 
 #define CREATE_USERS "CREATE TABLE IF NOT EXISTS USERS (ID INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL, NAME TEXT NOT NULL);"
 #define CREATE_ALBUMS "CREATE TABLE IF NOT EXISTS ALBUMS (ID INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL, NAME TEXT NOT NULL, CREATION_DATE INTEGER NOT NULL, USER_ID INTEGER, FOREIGN KEY (USER_ID) REFERENCES USERS (ID));"
-#define CREATE_PICTURES "CREATE TABLE IF NOT EXISTS PICTURES (ID INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL, NAME TEXT NOT NULL, LOCATION TEXT NOT NULL,CREATION_DATE INTEGER NOT NULL, ALBUM_ID INTEGER, FOREIGN KEY (ALBUM_ID) REFERENCES ALBUMS (ID));"
+#define CREATE_PICTURES "CREATE TABLE IF NOT EXISTS PICTURES (ID INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL, NAME TEXT NOT NULL, LOCATION TEXT NOT NULL,CREATION_DATE INTEGER NOT NULL, ALBUM_ID INTEGER, DIRECTORY_ID INTEGER, FOREIGN KEY (ALBUM_ID) REFERENCES ALBUMS (ID), FOREIGN KEY (DIRECTORY_ID) REFERENCES DIRECTORIES (ID));"
+#define CREATE_DIRECTORIES "CREATE TABLE IF NOT EXISTS DIRECTORIES (ID INTEGER PRIMARY KEY NOT NULL, PATH TEXT NOT NULL UNIQUE);"
+#define HAS_DIRECTORY_COLUMN "SELECT COUNT(*) FROM pragma_table_info('PICTURES') WHERE NAME = 'DIRECTORY_ID';"
+#define ADD_DIRECTORY_COLUMN "ALTER TABLE PICTURES ADD COLUMN DIRECTORY_ID INTEGER REFERENCES DIRECTORIES (ID);"
+#define CREATE_PICTURE_FILES "CREATE TABLE IF NOT EXISTS PICTURE_FILES (PATH TEXT PRIMARY KEY NOT NULL, FILE_SIZE INTEGER NOT NULL, MODIFIED_TIME INTEGER NOT NULL, WIDTH INTEGER NOT NULL, HEIGHT INTEGER NOT NULL, FORMAT INTEGER NOT NULL, PERCEPTUAL_HASH INTEGER);"
+#define HAS_PERCEPTUAL_HASH_COLUMN "SELECT COUNT(*) FROM pragma_table_info('PICTURE_FILES') WHERE NAME = 'PERCEPTUAL_HASH';"
+#define ADD_PERCEPTUAL_HASH_COLUMN "ALTER TABLE PICTURE_FILES ADD COLUMN PERCEPTUAL_HASH INTEGER; UPDATE PICTURE_FILES SET MODIFIED_TIME = -1;"
+#define PICTURE_FILES_COLUMNS "PATH, FILE_SIZE, MODIFIED_TIME, WIDTH, HEIGHT, FORMAT, PERCEPTUAL_HASH"
 #define CREATE_TAGS "CREATE TABLE IF NOT EXISTS TAGS (ID INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL, PICTURE_ID INTEGER NOT NULL, USER_ID INTEGER NOT NULL, FOREIGN KEY (USER_ID) REFERENCES USERS (ID), FOREIGN KEY (PICTURE_ID) REFERENCES PICTURES (ID));"
+// "dd/mm/yyyy hh:mm:ss" (stored with padding) as "yyyymmddhh:mm:ss", which sorts like the time.
+// Queries spell it exactly like the indexes on it so SQLite can use them
+#define SORTABLE_DATE(column) "(substr(trim(" column "), 7, 4) || substr(trim(" column "), 4, 2) || substr(trim(" column "), 1, 2) || substr(trim(" column "), 12))"
+#define ALBUM_TAGS_COUNT "(SELECT COUNT(*) FROM TAGS INNER JOIN PICTURES ON TAGS.PICTURE_ID = PICTURES.ID WHERE PICTURES.ALBUM_ID = ALBUMS.ID)"
+#define PICTURE_TAGS_COUNT "(SELECT COUNT(*) FROM TAGS WHERE TAGS.PICTURE_ID = PICTURES.ID)"
+#define CREATE_ALBUMS_BY_CREATION "CREATE INDEX IF NOT EXISTS ALBUMS_BY_CREATION ON ALBUMS (" SORTABLE_DATE("CREATION_DATE") ", ID);"
+#define CREATE_ALBUMS_BY_NAME "CREATE INDEX IF NOT EXISTS ALBUMS_BY_NAME ON ALBUMS (NAME, ID);"
+#define CREATE_PICTURES_BY_CREATION "CREATE INDEX IF NOT EXISTS PICTURES_BY_CREATION ON PICTURES (ALBUM_ID, " SORTABLE_DATE("CREATION_DATE") ", ID);"
+#define CREATE_PICTURES_BY_NAME "CREATE INDEX IF NOT EXISTS PICTURES_BY_NAME ON PICTURES (ALBUM_ID, NAME, ID);"
+#define CREATE_TAGS_BY_PICTURE "CREATE INDEX IF NOT EXISTS TAGS_BY_PICTURE ON TAGS (PICTURE_ID);"
 #define ID "ID"
 #define NAME "NAME"
 #define CREATION_DATE "CREATION_DATE"
 #define USER_ID "USER_ID"
 #define LOCATION "LOCATION"
 #define ALBUM_ID "ALBUM_ID"
+#define DIRECTORY_ID "DIRECTORY_ID"
+#define PATH "PATH"
+#define PICTURE_ID "PICTURE_ID"
+
+/**
+ * DatabaseAccess - Creates an access object for a database file (the file is opened by open()).
+ * Params: dbFileName - path of the SQLite database file
+ */
+DatabaseAccess::DatabaseAccess(const std::string& dbFileName) :
+	_dbFileName(dbFileName)
+{
+	// Left empty
+}
 
-std::list<Album> DatabaseAccess::albums;
-std::list<Picture> DatabaseAccess::pictures;
-std::vector<User> DatabaseAccess::users;
 /**
  * open - Opens a connection to the SQLite database and initializes necessary tables if they don't exist.
  * Params: None
@@ -24,25 +53,65 @@ std::vector<User> DatabaseAccess::users;
  */
 bool DatabaseAccess::open()
 {
-	std::string dbFileName = "Gallery.sqlite";
-	int file_exist = _access(dbFileName.c_str(), 0);
-	int res = sqlite3_open(dbFileName.c_str(), &this->_db);
+	int file_exist = _access(this->_dbFileName.c_str(), 0);
+	int res = sqlite3_open(this->_dbFileName.c_str(), &this->_db);
 
 	// if the opening fails
 	if (res != SQLITE_OK) {
 		this->_db = nullptr;
 		std::cout << "Failed to open DB" << std::endl;
-		return -1;
+		return false;
 	}
 
-	char** errMessage = nullptr;
-	const char* sqlStatement = nullptr;
-	
+	this->_changeFeed.attach(this->_db);
+
 	// creating the tables (they have the IF NOT EXSIST constraint)
 	this->runCommand(CREATE_USERS, this->_db);
 	this->runCommand(CREATE_ALBUMS, this->_db);
 	this->runCommand(CREATE_PICTURES, this->_db);
 	this->runCommand(CREATE_TAGS, this->_db);
+	this->runCommand(CREATE_DIRECTORIES, this->_db);
+	this->runCommand(CREATE_PICTURE_FILES, this->_db);
+
+	// databases created before the directories table store the full path in LOCATION
+	int hasDirectoryColumn = 0;
+	this->runCommand(HAS_DIRECTORY_COLUMN, this->_db, countCallback, &hasDirectoryColumn);
+	if (hasDirectoryColumn == 0) {
+		this->runCommand(ADD_DIRECTORY_COLUMN, this->_db);
+	}
+	// and file records before the perceptual hashes have none, they are marked stale so the next check hashes them
+	int hasPerceptualHashColumn = 0;
+	this->runCommand(HAS_PERCEPTUAL_HASH_COLUMN, this->_db, countCallback, &hasPerceptualHashColumn);
+	if (hasPerceptualHashColumn == 0) {
+		this->runCommand(ADD_PERCEPTUAL_HASH_COLUMN, this->_db);
+	}
+
+	// the orders of the sorted listings, and the per picture tag counts they sort by
+	this->runCommand(CREATE_ALBUMS_BY_CREATION, this->_db);
+	this->runCommand(CREATE_ALBUMS_BY_NAME, this->_db);
+	this->runCommand(CREATE_PICTURES_BY_CREATION, this->_db);
+	this->runCommand(CREATE_PICTURES_BY_NAME, this->_db);
+	this->runCommand(CREATE_TAGS_BY_PICTURE, this->_db);
+
+	// the ids of this database are its own, they are mapped to the ids of the process wide DirectoryTable
+	this->_directories = DirectoryIds();
+	this->runCommand("SELECT ID, PATH FROM DIRECTORIES;", this->_db, loadIntoDirectories, &this->_directories);
+	return true;
+}
+
+/**
+ * close - Closes the connection to the database.
+ * Params: None
+ * Returns: None
+ */
+void DatabaseAccess::close()
+{
+	if (this->_db != nullptr) {
+		this->_changeFeed.publish();
+		this->_changeFeed.detach(this->_db);
+		sqlite3_close(this->_db);
+		this->_db = nullptr;
+	}
 }
 
 /**
@@ -78,8 +147,9 @@ bool DatabaseAccess::doesPictureExistsInAlbum(const std::string& albumName, cons
 {
 	int albumId = this->openAlbum(albumName).getId();
 	std::string query = "SELECT * FROM PICTURES WHERE ALBUM_ID = " + std::to_string(albumId) + " AND NAME = \" " + pictureName + " \" ;";
-	this->runCommand(query, this->_db, loadIntoPictures);
-	return DatabaseAccess::pictures.empty() ? false : true;
+	PictureRows rows = { &this->_pictures, &this->_directories };
+	this->runCommand(query, this->_db, loadIntoPictures, &rows);
+	return this->_pictures.empty() ? false : true;
 }
 
 
@@ -113,23 +183,42 @@ std::string DatabaseAccess::removeWhiteSpacesBeforeAndAfter(const std::string& s
  */
 bool DatabaseAccess::runCommand(const std::string& sqlStatement, sqlite3* db, int(*callback)(void*, int, char**, char**), void* secondParam)
 {
-	// emptieng the data structors, so data from the past would not stay
-	if (!DatabaseAccess::users.empty())
-		DatabaseAccess::users.clear();
-
-	if(!DatabaseAccess::albums.empty())
-		DatabaseAccess::albums.clear();
+	// the rows of the last query are dropped below, so what it committed can go out to the
+	// listeners now, whatever they query
+	this->_changeFeed.publish();
 
-	if(!DatabaseAccess::pictures.empty())
-		DatabaseAccess::pictures.clear();
+	// emptieng the data structors, so data from the past would not stay
+	this->_users.clear();
+	this->_albums.clear();
+	this->_pictures.clear();
 
 	char** errMessage = nullptr;
 	int res = sqlite3_exec(db, sqlStatement.c_str(), callback, secondParam, errMessage);
+
+	// whatever the statement committed goes out to the listeners (rolled back changes never do).
+	// The rows of a query are still to be read by the caller and a listener's query would drop
+	// them, so its changes wait for the next statement
+	if (callback == nullptr) {
+		this->_changeFeed.publish();
+	}
+
 	if (res != SQLITE_OK)
 	{
 		std::cout << "error code: " << res;
 		return false;
 	}
+	return true;
+}
+
+
+/**
+ * getChangeFeed - Returns the feed of committed row changes of this connection.
+ * Params: None
+ * Returns: The change feed, subscribe to it to get every committed insert, update and delete.
+ */
+ChangeFeed& DatabaseAccess::getChangeFeed()
+{
+	return this->_changeFeed;
 }
 
 
@@ -143,12 +232,13 @@ Picture DatabaseAccess::getPictureFromAlbum(const std::string& albumName, const
 	int albumId = this->openAlbum(albumName).getId();
 	std::string command = "SELECT * FROM PICTURES WHERE ALBUM_ID = " + std::to_string(albumId) + " AND NAME = \" " + this->removeWhiteSpacesBeforeAndAfter(picture) + " \" ;";
 
-	this->runCommand(command, this->_db, loadIntoPictures);
+	PictureRows rows = { &this->_pictures, &this->_directories };
+	this->runCommand(command, this->_db, loadIntoPictures, &rows);
 
 	// if the picture exists
-	if (DatabaseAccess::pictures.size() != 0)
+	if (this->_pictures.size() != 0)
 	{
-		return *DatabaseAccess::pictures.begin();
+		return *this->_pictures.begin();
 	}
 	// if the picture dosent exsist
 	else
@@ -180,13 +270,8 @@ bool DatabaseAccess::isUserTaggedInPicture(const User& user, const Picture& pict
 std::list<User> DatabaseAccess::getUsersTaggedInPicture(const Picture& picture)
 {
 	std::string query = "SELECT USERS.ID, USERS.NAME FROM USERS INNER JOIN TAGS ON USERS.ID = TAGS.USER_ID WHERE PICTURE_ID = " + std::to_string(picture.getId()) + " ;";
-	this->runCommand(query, this->_db, loadIntoUsers);
 	std::list<User> res;
-
-	for (const auto& user : DatabaseAccess::users)
-	{
-		res.push_back(user);
-	}
+	this->runCommand(query, this->_db, loadIntoUsers, &res);
 	return res;
 }
 
@@ -212,14 +297,15 @@ bool DatabaseAccess::doesUserExists(const std::string& name)
 Picture DatabaseAccess::getPicture(const int& id)
 {
 	std::string query = "SELECT * FROM PICTURES WHERE ID = " + std::to_string(id) + " ;";
-	this->runCommand(query, this->_db, loadIntoPictures);
-	if (DatabaseAccess::pictures.empty())
+	PictureRows rows = { &this->_pictures, &this->_directories };
+	this->runCommand(query, this->_db, loadIntoPictures, &rows);
+	if (this->_pictures.empty())
 	{
 		throw std::invalid_argument("Picture not found with that id");
 	}
 	else
 	{
-		return *DatabaseAccess::pictures.begin();
+		return *this->_pictures.begin();
 	}
 }
 
@@ -244,8 +330,9 @@ int DatabaseAccess::timesAlbumsOfUserGotTagged(const User& user)
 const std::list<Album> DatabaseAccess::getAlbums()
 {
 	std::string sqlCommand = "SELECT * FROM ALBUMS;";
-	this->runCommand(sqlCommand, this->_db, loadIntoAlbums);
-	return DatabaseAccess::albums;
+	std::list<Album> albums;
+	this->runCommand(sqlCommand, this->_db, loadIntoAlbums, &albums);
+	return albums;
 }
 
 
@@ -257,8 +344,93 @@ const std::list<Album> DatabaseAccess::getAlbums()
 const std::list<Album> DatabaseAccess::getAlbumsOfUser(const User& user)
 {
 	std::string command = "SELECT * FROM ALBUMS WHERE USER_ID = " + std::to_string(user.getId()) + " ;";
-	this->runCommand(command, this->_db, loadIntoAlbums);
-	return DatabaseAccess::albums;
+	std::list<Album> albums;
+	this->runCommand(command, this->_db, loadIntoAlbums, &albums);
+	return albums;
+}
+
+
+/**
+ * forEachAlbum - Hands every album row to fn where the query decoded it.
+ * Params: fn - called with every album (without its pictures, like getAlbums); it must not use this access
+ * Returns: None
+ */
+void DatabaseAccess::forEachAlbum(const std::function<void(const Album&)>& fn)
+{
+	this->runCommand("SELECT * FROM ALBUMS;", this->_db, loadIntoAlbums, &this->_albums);
+	for (const Album& album : this->_albums) {
+		fn(album);
+	}
+}
+
+
+/**
+ * forEachAlbumOfUser - Hands the album rows of a user to fn in place, like forEachAlbum.
+ * Params: user - the owner, fn - called with every album of the user; it must not use this access
+ * Returns: None
+ */
+void DatabaseAccess::forEachAlbumOfUser(const User& user, const std::function<void(const Album&)>& fn)
+{
+	std::string command = "SELECT * FROM ALBUMS WHERE USER_ID = " + std::to_string(user.getId()) + " ;";
+	this->runCommand(command, this->_db, loadIntoAlbums, &this->_albums);
+	for (const Album& album : this->_albums) {
+		fn(album);
+	}
+}
+
+
+/**
+ * forEachPicture - Hands every picture, with its tags, to fn together with its album.
+ * Params: fn - called in album order with the album row (without its pictures) and a picture of it,
+ *         names and dates unpadded; it must not use this access
+ * Returns: None
+ */
+void DatabaseAccess::forEachPicture(const std::function<void(const Album&, const Picture&)>& fn)
+{
+	this->forEachPictureOfAlbums("", fn);
+}
+
+
+/**
+ * forEachPictureOfUser - Hands the pictures of the albums of a user to fn, like forEachPicture.
+ * Params: user - the owner, fn - called with every picture of the user's albums; it must not use this access
+ * Returns: None
+ */
+void DatabaseAccess::forEachPictureOfUser(const User& user, const std::function<void(const Album&, const Picture&)>& fn)
+{
+	this->forEachPictureOfAlbums(" WHERE USER_ID = " + std::to_string(user.getId()), fn);
+}
+
+
+/**
+ * forEachPictureOfAlbums - Reads the albums, their pictures and the tags on them in three queries
+ *                          and hands every picture to fn with its album.
+ * Params: albumsCondition - WHERE clause of the albums (empty for all), fn - see forEachPicture
+ * Returns: None
+ */
+void DatabaseAccess::forEachPictureOfAlbums(const std::string& albumsCondition, const std::function<void(const Album&, const Picture&)>& fn)
+{
+	std::list<Album> albums;
+	this->runCommand("SELECT * FROM ALBUMS" + albumsCondition + " ORDER BY ID ;", this->_db, loadIntoAlbums, &albums);
+	if (albums.empty()) {
+		return;
+	}
+
+	std::string albumIds = "SELECT ID FROM ALBUMS" + albumsCondition;
+	std::list<Picture> pictures;
+	PictureRows rows = { &pictures, &this->_directories };
+	this->runCommand("SELECT * FROM PICTURES WHERE ALBUM_ID IN (" + albumIds + ") ORDER BY ALBUM_ID, ID ;", this->_db, loadIntoPictures, &rows);
+	this->loadTagsOfAlbums(albumIds, pictures);
+
+	// both are in ID order, so the pictures of an album follow each other
+	auto picture = pictures.begin();
+	for (Album& album : albums) {
+		album.setName(this->removeWhiteSpacesBeforeAndAfter(album.getName()));
+		album.setCreationDate(this->removeWhiteSpacesBeforeAndAfter(album.getCreationDate()));
+		for (; picture != pictures.end() && picture->getAlbumId() == album.getId(); ++picture) {
+			fn(album, *picture);
+		}
+	}
 }
 
 
@@ -299,8 +471,8 @@ void DatabaseAccess::deleteAlbum(const std::string& albumName, int userId)
 bool DatabaseAccess::doesAlbumExists(const std::string& albumName, int userId)
 {
 	std::string command = "SELECT * FROM ALBUMS WHERE NAME =  \" " + albumName + " \" AND USER_ID = " + std::to_string(userId) + " ;";
-	this->runCommand(command, this->_db, loadIntoAlbums);
-	return DatabaseAccess::albums.size() != 0 ? true : false;
+	this->runCommand(command, this->_db, loadIntoAlbums, &this->_albums);
+	return this->_albums.size() != 0 ? true : false;
 }
 
 
@@ -313,11 +485,11 @@ Album DatabaseAccess::openAlbum(const std::string& albumName)
 {
 	std::string albumNameWithNoSpaces = this->removeWhiteSpacesBeforeAndAfter(albumName);
 	std::string command = "SELECT * FROM ALBUMS WHERE NAME = \" " + albumNameWithNoSpaces + " \" ;";
-	this->runCommand(command, this->_db, loadIntoAlbums);
+	this->runCommand(command, this->_db, loadIntoAlbums, &this->_albums);
 
-	if (DatabaseAccess::albums.size() != 0)
+	if (this->_albums.size() != 0)
 	{
-		auto begin = DatabaseAccess::albums.begin();
+		auto begin = this->_albums.begin();
 		return *begin;
 	}
 	else
@@ -326,6 +498,111 @@ Album DatabaseAccess::openAlbum(const std::string& albumName)
 	}
 }
 
+/**
+ * loadAlbums - Loads every album with the given name, with its pictures and their tags.
+ * Params: albumName - Name of the albums
+ * Returns: The albums in creation order, empty if there is none. Names and dates come back
+ *          without the padding they are stored with.
+ */
+std::list<Album> DatabaseAccess::loadAlbums(const std::string& albumName)
+{
+	std::string command = "SELECT * FROM ALBUMS WHERE NAME = \" " + this->removeWhiteSpacesBeforeAndAfter(albumName) + " \" ORDER BY ID ;";
+	std::list<Album> loaded;
+	this->runCommand(command, this->_db, loadIntoAlbums, &loaded);
+
+	for (Album& album : loaded) {
+		command = "SELECT * FROM PICTURES WHERE ALBUM_ID = " + std::to_string(album.getId()) + " ORDER BY ID ;";
+		std::list<Picture> pictures;
+		PictureRows rows = { &pictures, &this->_directories };
+		this->runCommand(command, this->_db, loadIntoPictures, &rows);
+		this->loadTagsOfAlbums(std::to_string(album.getId()), pictures);
+
+		album.setName(this->removeWhiteSpacesBeforeAndAfter(album.getName()));
+		album.setCreationDate(this->removeWhiteSpacesBeforeAndAfter(album.getCreationDate()));
+		for (Picture& picture : pictures) {
+			album.addPicture(std::move(picture));
+		}
+	}
+	return loaded;
+}
+
+/**
+ * loadTagsOfAlbums - Unpads the names and dates of pictures read from albums and tags them
+ *                    like the TAGS rows of the albums say.
+ * Params: albumIds - the IDs of the albums, as an SQL list or subquery, pictures - rows of (some of) their pictures
+ * Returns: None
+ */
+void DatabaseAccess::loadTagsOfAlbums(const std::string& albumIds, std::list<Picture>& pictures)
+{
+	std::vector<std::pair<int, int>> tags;
+	std::string command = "SELECT TAGS.PICTURE_ID, TAGS.USER_ID FROM TAGS INNER JOIN PICTURES ON TAGS.PICTURE_ID = PICTURES.ID WHERE PICTURES.ALBUM_ID IN (" + albumIds + ") ;";
+	this->runCommand(command, this->_db, loadIntoTags, &tags);
+
+	std::unordered_map<int, Picture*> picturesById;
+	for (Picture& picture : pictures) {
+		picture.setName(this->removeWhiteSpacesBeforeAndAfter(picture.getName()));
+		picture.setCreationDate(this->removeWhiteSpacesBeforeAndAfter(picture.getCreationDate()));
+		picturesById.emplace(picture.getId(), &picture);
+	}
+	for (const auto& tag : tags) {
+		auto picture = picturesById.find(tag.first);
+		if (picture != picturesById.end()) {
+			picture->second->tagUser(tag.second);
+		}
+	}
+}
+
+/**
+ * getOrderBy - Builds the ORDER BY and LIMIT clauses of a sorted listing, ties by ID.
+ * Params: order - the listing order, creationKey, nameKey, tagsKey - the expressions of the keys
+ * Returns: The clauses.
+ */
+static std::string getOrderBy(const ListingOrder& order, const std::string& creationKey, const std::string& nameKey, const std::string& tagsKey)
+{
+	std::string key = order.key == ListingKey::BY_CREATION ? creationKey : order.key == ListingKey::BY_NAME ? nameKey : tagsKey;
+	std::string direction = order.descending ? " DESC" : " ASC";
+
+	std::string clauses = " ORDER BY " + key + direction + ", ID" + direction;
+	if (order.limit != 0) {
+		clauses += " LIMIT " + std::to_string(order.limit);
+	}
+	return clauses;
+}
+
+/**
+ * getAlbumsSorted - Retrieves the albums in the given order.
+ * Params: order - key, direction and limit
+ * Returns: The albums (without their pictures, like getAlbums), names and dates unpadded.
+ */
+std::list<Album> DatabaseAccess::getAlbumsSorted(const ListingOrder& order)
+{
+	std::string command = "SELECT * FROM ALBUMS" + getOrderBy(order, SORTABLE_DATE("CREATION_DATE"), "NAME", ALBUM_TAGS_COUNT) + " ;";
+	std::list<Album> sorted;
+	this->runCommand(command, this->_db, loadIntoAlbums, &sorted);
+
+	for (Album& album : sorted) {
+		album.setName(this->removeWhiteSpacesBeforeAndAfter(album.getName()));
+		album.setCreationDate(this->removeWhiteSpacesBeforeAndAfter(album.getCreationDate()));
+	}
+	return sorted;
+}
+
+/**
+ * getPicturesSorted - Retrieves the pictures of an album in the given order.
+ * Params: albumName - Name of the album (the first one with that name), order - key, direction and limit
+ * Returns: The pictures with their tags, names and dates unpadded.
+ */
+std::list<Picture> DatabaseAccess::getPicturesSorted(const std::string& albumName, const ListingOrder& order)
+{
+	int albumId = this->openAlbum(albumName).getId();
+	std::string command = "SELECT * FROM PICTURES WHERE ALBUM_ID = " + std::to_string(albumId) + getOrderBy(order, SORTABLE_DATE("CREATION_DATE"), "NAME", PICTURE_TAGS_COUNT) + " ;";
+	std::list<Picture> sorted;
+	PictureRows rows = { &sorted, &this->_directories };
+	this->runCommand(command, this->_db, loadIntoPictures, &rows);
+	this->loadTagsOfAlbums(std::to_string(albumId), sorted);
+	return sorted;
+}
+
 /**
  * closeAlbum - Closes the specified album.
  * Params: pAlbum - Reference to the Album object to be closed
@@ -341,13 +618,13 @@ void DatabaseAccess::closeAlbum(Album& pAlbum) {}
  */
 void DatabaseAccess::printAlbums()
 {
-	this->getAlbums();
-	if (DatabaseAccess::albums.empty()) {
+	const std::list<Album> albums = this->getAlbums();
+	if (albums.empty()) {
 		throw std::invalid_argument("There are no existing albums.");
 	}
 	std::cout << "Album list:" << std::endl;
 	std::cout << "-----------" << std::endl;
-	for (const Album& album : DatabaseAccess::albums) {
+	for (const Album& album : albums) {
 		std::cout << std::setw(5) << "* " << album;
 	}
 }
@@ -361,11 +638,47 @@ void DatabaseAccess::printAlbums()
 void DatabaseAccess::addPictureToAlbumByName(const std::string& albumName, const Picture& picture)
 {
 	int id = this->openAlbum(albumName).getId();
-	std::string command = "INSERT INTO PICTURES (name, LOCATION, CREATION_DATE, ALBUM_ID) VALUES ( \" " + picture.getName() + " \" , \" " + picture.getPath() + " \" , \" " + picture.getCreationDate() + " \" , " + std::to_string(id) + " );";
+	int databaseDirectoryId = this->storeDirectory(picture.getDirectoryId());
+
+	// without a row in DIRECTORIES the full path goes to LOCATION, like the rows from before it
+	std::string directoryId = databaseDirectoryId == NO_DIRECTORY ? "NULL" : std::to_string(databaseDirectoryId);
+	std::string location = databaseDirectoryId == NO_DIRECTORY ? picture.getPath() : picture.getFileName();
+
+	std::string command = "INSERT INTO PICTURES (name, LOCATION, CREATION_DATE, ALBUM_ID, DIRECTORY_ID) VALUES ( \" " + picture.getName() + " \" , \"" + location + "\" , \" " + picture.getCreationDate() + " \" , " + std::to_string(id) + ", " + directoryId + " );";
 	this->runCommand(command, this->_db);
 }
 
 
+/**
+ * storeDirectory - Makes sure an interned directory has its row in the DIRECTORIES table.
+ * Params: directoryId - id of the directory in the DirectoryTable
+ * Returns: The ID of its row, which this database chooses, or NO_DIRECTORY if it could not be stored.
+ */
+int DatabaseAccess::storeDirectory(int directoryId)
+{
+	if (directoryId == NO_DIRECTORY) {
+		return NO_DIRECTORY;
+	}
+	auto stored = this->_directories.toDatabase.find(directoryId);
+	if (stored != this->_directories.toDatabase.end()) {
+		return stored->second;
+	}
+
+	std::string path = DirectoryTable::getPath(directoryId);
+	std::string command = "INSERT OR IGNORE INTO DIRECTORIES (PATH) VALUES ( \"" + path + "\" );";
+	this->runCommand(command, this->_db);
+
+	int databaseId = NO_DIRECTORY;
+	command = "SELECT ID FROM DIRECTORIES WHERE PATH = \"" + path + "\" ;";
+	this->runCommand(command, this->_db, countCallback, &databaseId);
+	if (databaseId != NO_DIRECTORY) {
+		this->_directories.toTable[databaseId] = directoryId;
+		this->_directories.toDatabase[directoryId] = databaseId;
+	}
+	return databaseId;
+}
+
+
 /**
  * removePictureFromAlbumByName - Removes a picture from the specified album by its name.
  * Params: albumName - Name of the album, pictureName - Name of the picture to be removed
@@ -386,12 +699,121 @@ void DatabaseAccess::removePictureFromAlbumByName(const std::string& albumName,
  */
 void DatabaseAccess::untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
 {
-	int pictureId = this->getPictureFromAlbum(albumName, pictureName).getId();
+	this->untagUserInPictureById(this->getPictureFromAlbum(albumName, pictureName).getId(), userId);
+}
+
+/**
+ * untagUserInPictureById - Removes the tag of a user from a picture whose id is already known.
+ * Params: pictureId - ID of the picture, userId - ID of the user to be untagged
+ * Returns: None
+ */
+void DatabaseAccess::untagUserInPictureById(int pictureId, int userId)
+{
 	std::string command = "DELETE FROM TAGS WHERE PICTURE_ID = " + std::to_string(pictureId) + " AND USER_ID = " + std::to_string(userId) + " ;";
 	this->runCommand(command, this->_db);
 }
 
 
+/**
+ * quoteText - Writes text as an SQL string literal.
+ * Params: text - any text, quotes included
+ * Returns: The literal.
+ */
+static std::string quoteText(const std::string& text)
+{
+	std::string quoted = "'";
+	for (char c : text) {
+		quoted += c;
+		if (c == '\'') {
+			quoted += c;
+		}
+	}
+	return quoted + "'";
+}
+
+/**
+ * getFileMetadata - Looks up the stored metadata of a picture file.
+ * Params: path - full path of the file, metadata - receives the record
+ * Returns: false when the file has no record.
+ */
+bool DatabaseAccess::getFileMetadata(const std::string& path, FileMetadata& metadata)
+{
+	std::vector<FileMetadata> found;
+	std::string command = "SELECT " PICTURE_FILES_COLUMNS " FROM PICTURE_FILES WHERE PATH = " + quoteText(path) + " ;";
+	if (!this->runCommand(command, this->_db, loadIntoFileMetadata, &found) || found.empty()) {
+		return false;
+	}
+	metadata = std::move(found.front());
+	return true;
+}
+
+/**
+ * getFilesMetadata - Looks up the stored metadata of many picture files with a single query.
+ * Params: paths - full paths of the files, fn - called once per file that has a record
+ * Returns: None
+ */
+void DatabaseAccess::getFilesMetadata(const std::vector<std::string>& paths, const std::function<void(const FileMetadata&)>& fn)
+{
+	if (paths.empty()) {
+		return;
+	}
+
+	// the PATH primary key serves every value of the list
+	std::string command = "SELECT " PICTURE_FILES_COLUMNS " FROM PICTURE_FILES WHERE PATH IN (";
+	for (size_t i = 0; i < paths.size(); ++i) {
+		command += (i == 0 ? "" : ", ") + quoteText(paths[i]);
+	}
+	command += ");";
+
+	std::vector<FileMetadata> found;
+	this->runCommand(command, this->_db, loadIntoFileMetadata, &found);
+	for (const FileMetadata& metadata : found) {
+		fn(metadata);
+	}
+}
+
+/**
+ * forEachFileMetadata - Reads every row of PICTURE_FILES, then hands the records to fn.
+ * Params: fn - called once per record
+ * Returns: None
+ */
+void DatabaseAccess::forEachFileMetadata(const std::function<void(const FileMetadata&)>& fn)
+{
+	std::vector<FileMetadata> files;
+	this->runCommand("SELECT " PICTURE_FILES_COLUMNS " FROM PICTURE_FILES;", this->_db, loadIntoFileMetadata, &files);
+	for (const FileMetadata& metadata : files) {
+		fn(metadata);
+	}
+}
+
+/**
+ * storeFileMetadata - Inserts or replaces the records of picture files, in one transaction.
+ * Params: files - the records
+ * Returns: None
+ */
+void DatabaseAccess::storeFileMetadata(const std::vector<FileMetadata>& files)
+{
+	if (files.empty()) {
+		return;
+	}
+
+	std::string command = "BEGIN;";
+	for (const FileMetadata& metadata : files) {
+		// SQLite integers are signed, the hash is stored with the same bits
+		std::string perceptualHash = metadata.hasPerceptualHash ? std::to_string(static_cast<int64_t>(metadata.perceptualHash)) : "NULL";
+		command += " INSERT OR REPLACE INTO PICTURE_FILES (" PICTURE_FILES_COLUMNS ") VALUES ( " + quoteText(metadata.path) + ", " +
+			std::to_string(metadata.size) + ", " + std::to_string(metadata.modifiedTime) + ", " + std::to_string(metadata.width) + ", " +
+			std::to_string(metadata.height) + ", " + std::to_string(static_cast<int>(metadata.format)) + ", " + perceptualHash + " );";
+	}
+	command += " COMMIT;";
+
+	// sqlite3_exec stops at the failing statement, the transaction must not stay open
+	if (!this->runCommand(command, this->_db)) {
+		this->runCommand("ROLLBACK;", this->_db);
+	}
+}
+
+
 /**
  * printUsers - Prints the list of users.
  * Params: None
@@ -400,11 +822,11 @@ void DatabaseAccess::untagUserInPicture(const std::string& albumName, const std:
 void DatabaseAccess::printUsers()
 {
 	std::string command = "SELECT * FROM USERS;";
-	this->runCommand(command, this->_db, loadIntoUsers);
+	this->runCommand(command, this->_db, loadIntoUsers, &this->_users);
 
 	std::cout << "Users list:" << std::endl;
 	std::cout << "-----------" << std::endl;
-	for (const auto& user : DatabaseAccess::users) {
+	for (const auto& user : this->_users) {
 		std::cout << user << std::endl;
 	}
 }
@@ -446,9 +868,9 @@ void DatabaseAccess::deleteUser(const User& user)
 bool DatabaseAccess::doesUserExists(int userId)
 {
 	std::string command = "SELECT * FROM USERS WHERE ID = " + std::to_string(userId) + " ;";
-	this->runCommand(command, this->_db, loadIntoUsers);
+	this->runCommand(command, this->_db, loadIntoUsers, &this->_users);
 
-	return DatabaseAccess::users.empty() ? false : true;
+	return this->_users.empty() ? false : true;
 }
 
 
@@ -460,15 +882,15 @@ bool DatabaseAccess::doesUserExists(int userId)
 User DatabaseAccess::getUser(int userId)
 {
 	std::string command = "SELECT * FROM USERS WHERE ID = " + std::to_string(userId) + " ;";
-	this->runCommand(command, this->_db, loadIntoUsers);
+	this->runCommand(command, this->_db, loadIntoUsers, &this->_users);
 
-	if (DatabaseAccess::users.empty())
+	if (this->_users.empty())
 	{
 		throw std::invalid_argument("User does not exist ");
 	}
 	else
 	{
-		return DatabaseAccess::users[0];
+		return this->_users.front();
 	}
 }
 
@@ -536,12 +958,12 @@ float DatabaseAccess::averageTagsPerAlbumOfUser(const User& user)
 User DatabaseAccess::getTopTaggedUser()
 {
 	std::string query = "SELECT USERS.ID, USERS.NAME FROM USERS INNER JOIN TAGS  ON USERS.ID = TAGS.USER_ID GROUP BY USERS.ID ORDER BY count(*) DESC LIMIT 1;";
-	this->runCommand(query, this->_db, loadIntoUsers);
-	if (DatabaseAccess::users.size() == 0)
+	this->runCommand(query, this->_db, loadIntoUsers, &this->_users);
+	if (this->_users.size() == 0)
 	{
 		throw std::invalid_argument("There are no users at all \n");
 	}
-	return *DatabaseAccess::users.begin();
+	return *this->_users.begin();
 }
 
 /**
@@ -565,10 +987,11 @@ Picture DatabaseAccess::getTopTaggedPicture()
  */
 std::list<Picture> DatabaseAccess::getTaggedPicturesOfUser(const User& user)
 {
-	std::string query = "SELECT PICTURES.ALBUM_ID, PICTURES.CREATION_DATE, PICTURES.ID, PICTURES.LOCATION, PICTURES.NAME FROM PICTURES  INNER JOIN TAGS ON PICTURES.ID = TAGS.PICTURE_ID WHERE TAGS.USER_ID =  " + std::to_string(user.getId()) + " ;";
-	this->runCommand(query, this->_db, loadIntoPictures);
-
-	return DatabaseAccess::pictures;
+	std::string query = "SELECT PICTURES.ALBUM_ID, PICTURES.CREATION_DATE, PICTURES.ID, PICTURES.LOCATION, PICTURES.DIRECTORY_ID, PICTURES.NAME FROM PICTURES  INNER JOIN TAGS ON PICTURES.ID = TAGS.PICTURE_ID WHERE TAGS.USER_ID =  " + std::to_string(user.getId()) + " ;";
+	std::list<Picture> pictures;
+	PictureRows rows = { &pictures, &this->_directories };
+	this->runCommand(query, this->_db, loadIntoPictures, &rows);
+	return pictures;
 }
 
 /**
@@ -578,8 +1001,16 @@ std::list<Picture> DatabaseAccess::getTaggedPicturesOfUser(const User& user)
  */
 void DatabaseAccess::tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
 {
-	int pictureId = this->getPictureFromAlbum(albumName, pictureName).getId();
+	this->tagUserInPictureById(this->getPictureFromAlbum(albumName, pictureName).getId(), userId);
+}
 
+/**
+ * tagUserInPictureById - Tags a user in a picture whose id is already known.
+ * Params: pictureId - ID of the picture, userId - ID of the user to be tagged
+ * Returns: None
+ */
+void DatabaseAccess::tagUserInPictureById(int pictureId, int userId)
+{
 	std::string command = "INSERT INTO TAGS (PICTURE_ID, USER_ID) VALUES ( " + std::to_string(pictureId) + ", " + std::to_string(userId) + " );";
 	this->runCommand(command, this->_db);
 }
@@ -587,64 +1018,80 @@ void DatabaseAccess::tagUserInPicture(const std::string& albumName, const std::s
 
 /**
  * loadIntoAlbums - Callback function to load data into the albums list.
- * Params: data - Data pointer, argc - Number of columns, argv - Array of column values,
- *         azColName - Array of column names
+ * Params: data - std::list<Album> that receives the row,
+ *         argc - Number of columns, argv - Array of column values, azColName - Array of column names
  * Returns: 0 to indicate success.
  */
 int loadIntoAlbums(void* data, int argc, char** argv, char** azColName)
 {
 	// Create a new Album object for each row fetched
-	Album albumObj (0, "");
+	Album albumObj;
 
 	for (int i = 0; i < argc; i++) {
-		if (std::string(azColName[i]) == USER_ID) {
+		if (strcmp(azColName[i], USER_ID) == 0) {
 			albumObj.setOwner(std::stoi(argv[i]));
 		}
-		else if (std::string(azColName[i]) == CREATION_DATE) {
+		else if (strcmp(azColName[i], CREATION_DATE) == 0) {
 			albumObj.setCreationDate(argv[i]);
 		}
-		else if (std::string(azColName[i]) == NAME) {
+		else if (strcmp(azColName[i], NAME) == 0) {
 			albumObj.setName(argv[i]);
 		}
-		else if (std::string(azColName[i]) == ID) {
+		else if (strcmp(azColName[i], ID) == 0) {
 			albumObj.setId(std::stoi(argv[i]));
 		}
 		// Add the newly created Album object to the passed-in vector
 	}
-	DatabaseAccess::albums.push_back(albumObj);
+	static_cast<std::list<Album>*>(data)->push_back(std::move(albumObj));
 	return 0; // Return 0 to indicate success
 }
 
 /**
  * loadIntoPictures - Callback function to load data into the pictures list.
- * Params: data - Data pointer, argc - Number of columns, argv - Array of column values,
- *         azColName - Array of column names
+ * Params: data - PictureRows with the list that receives the row and the directories of the database,
+ *         argc - Number of columns, argv - Array of column values, azColName - Array of column names
  * Returns: 0 to indicate success.
  */
 int loadIntoPictures(void* data, int argc, char** argv, char** azColName)
 {
+	const PictureRows* rows = static_cast<const PictureRows*>(data);
+
 	// Create a new Album object for each row fetched
-	Picture picture(0, "");
+	Picture picture;
+	const char* location = "";
+	int directoryId = NO_DIRECTORY;
 
 	for (int i = 0; i < argc; i++) {
-		if (std::string(azColName[i]) == NAME) {
+		if (strcmp(azColName[i], NAME) == 0) {
 			picture.setName(argv[i]);
 		}
-		else if (std::string(azColName[i]) == CREATION_DATE) {
+		else if (strcmp(azColName[i], CREATION_DATE) == 0) {
 			picture.setCreationDate(argv[i]);
 		}
-		else if (std::string(azColName[i]) == LOCATION) {
-			picture.setLocation(argv[i]);
+		else if (strcmp(azColName[i], LOCATION) == 0) {
+			location = argv[i];
+		}
+		else if (strcmp(azColName[i], DIRECTORY_ID) == 0) {
+			directoryId = argv[i] ? std::stoi(argv[i]) : NO_DIRECTORY;
 		}
-		else if (std::string(azColName[i]) == ALBUM_ID) {
+		else if (strcmp(azColName[i], ALBUM_ID) == 0) {
 			picture.setAlbumId(std::stoi(argv[i]));
 		}
-		else if (std::string(azColName[i]) == ID) {
+		else if (strcmp(azColName[i], ID) == 0) {
 			picture.setId(std::stoi(argv[i]));
 		}
 		// Add the newly created Album object to the passed-in vector
 	}
-	DatabaseAccess::pictures.push_back(picture);
+
+	// rows without a directory are from before DIRECTORIES existed and hold the full path
+	auto directory = rows->directories->toTable.find(directoryId);
+	if (directory == rows->directories->toTable.end()) {
+		picture.setPath(location);
+	}
+	else {
+		picture.setFileLocation(directory->second, location);
+	}
+	rows->rows->push_back(std::move(picture));
 
 
 	return 0; // Return 0 to indicate success
@@ -653,8 +1100,8 @@ int loadIntoPictures(void* data, int argc, char** argv, char** azColName)
 
 /**
  * loadIntoUsers - Callback function to load data into the users list.
- * Params: data - Data pointer, argc - Number of columns, argv - Array of column values,
- *         azColName - Array of column names
+ * Params: data - std::list<User> that receives the row,
+ *         argc - Number of columns, argv - Array of column values, azColName - Array of column names
  * Returns: 0 to indicate success.
  */
 int loadIntoUsers(void* data, int argc, char** argv, char** azColName)
@@ -662,18 +1109,100 @@ int loadIntoUsers(void* data, int argc, char** argv, char** azColName)
 	User user (0, "");
 
 	for (int i = 0; i < argc; i++) {
-		if (std::string(azColName[i]) == NAME) {
+		if (strcmp(azColName[i], NAME) == 0) {
 			user.setName(argv[i]);
 		}
-		else if (std::string(azColName[i]) == ID) {
+		else if (strcmp(azColName[i], ID) == 0) {
 			user.setId(std::stoi(argv[i]));
 		}
 	}
-	DatabaseAccess::users.push_back(user);
+	static_cast<std::list<User>*>(data)->push_back(std::move(user));
+
+	return 0;
+}
+
+/**
+ * loadIntoDirectories - Callback function to map the rows of DIRECTORIES to the DirectoryTable.
+ * Params: data - DirectoryIds of the database that receives the row, argc - Number of columns,
+ *         argv - Array of column values, azColName - Array of column names
+ * Returns: 0 to indicate success.
+ */
+int loadIntoDirectories(void* data, int argc, char** argv, char** azColName)
+{
+	DirectoryIds* directories = static_cast<DirectoryIds*>(data);
+	int id = NO_DIRECTORY;
+	const char* path = "";
+
+	for (int i = 0; i < argc; i++) {
+		if (strcmp(azColName[i], ID) == 0) {
+			id = std::stoi(argv[i]);
+		}
+		else if (strcmp(azColName[i], PATH) == 0) {
+			path = argv[i];
+		}
+	}
+	// the table may already have the directory under another id (interned before the database was
+	// opened, or by another database), so the id of the row is only ever used with this database
+	int tableId = DirectoryTable::intern(path);
+	directories->toTable[id] = tableId;
+	directories->toDatabase[tableId] = id;
 
 	return 0;
 }
 
+/**
+ * loadIntoTags - Callback function to collect (picture id, user id) rows of TAGS.
+ * Params: data - vector that receives the pairs, argc - Number of columns, argv - Array of column values,
+ *         azColName - Array of column names
+ * Returns: 0 to indicate success.
+ */
+int loadIntoTags(void* data, int argc, char** argv, char** azColName)
+{
+	std::vector<std::pair<int, int>>* tags = static_cast<std::vector<std::pair<int, int>>*>(data);
+	int pictureId = 0;
+	int userId = 0;
+
+	for (int i = 0; i < argc; i++) {
+		if (strcmp(azColName[i], PICTURE_ID) == 0) {
+			pictureId = std::stoi(argv[i]);
+		}
+		else if (strcmp(azColName[i], USER_ID) == 0) {
+			userId = std::stoi(argv[i]);
+		}
+	}
+	tags->emplace_back(pictureId, userId);
+
+	return 0;
+}
+
+/**
+ * loadIntoFileMetadata - Callback function to read a row of PICTURE_FILES.
+ * Params: data - vector of FileMetadata that receives the row, argc - Number of columns (PICTURE_FILES_COLUMNS
+ *         in this order), argv - Array of column values, azColName - Array of column names
+ * Returns: 0 to indicate success.
+ */
+int loadIntoFileMetadata(void* data, int argc, char** argv, char** azColName)
+{
+	std::vector<FileMetadata>* files = static_cast<std::vector<FileMetadata>*>(data);
+	if (argc < 7 || argv[0] == nullptr || argv[1] == nullptr || argv[2] == nullptr) {
+		return 0;
+	}
+
+	FileMetadata metadata;
+	metadata.path = argv[0];
+	metadata.size = std::stoull(argv[1]);
+	metadata.modifiedTime = std::stoll(argv[2]);
+	metadata.width = argv[3] != nullptr ? std::stoi(argv[3]) : 0;
+	metadata.height = argv[4] != nullptr ? std::stoi(argv[4]) : 0;
+	metadata.format = argv[5] != nullptr ? static_cast<ImageFormat>(std::stoi(argv[5])) : ImageFormat::UNKNOWN;
+	if (argv[6] != nullptr) {
+		metadata.hasPerceptualHash = true;
+		metadata.perceptualHash = static_cast<uint64_t>(std::stoll(argv[6]));
+	}
+	files->push_back(std::move(metadata));
+	return 0;
+}
+
 /**
  * countCallback - Callback function to count results.
  * Params: data - Data pointer, argc - Number of columns, argv - Array of column values,
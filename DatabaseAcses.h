@@ -2,23 +2,42 @@
 #include "IDataAccess.h"
 #include "DatabaseAcses.h"
 #include "sqlite3.h"
+#include "DirectoryTable.h"
+#include "ChangeFeed.h"
 #include <list>
 #include <vector>
+#include <set>
+#include <unordered_map>
 #include <io.h>
 
+#define DEFAULT_DB_FILE "Gallery.sqlite"
+
 int loadIntoAlbums(void* data, int argc, char** argv, char** azColName);
 int loadIntoPictures(void* data, int argc, char** argv, char** azColName);
 int loadIntoUsers(void* data, int argc, char** argv, char** azColName);
+int loadIntoDirectories(void* data, int argc, char** argv, char** azColName);
+int loadIntoTags(void* data, int argc, char** argv, char** azColName);
+int loadIntoFileMetadata(void* data, int argc, char** argv, char** azColName);
 int countCallback(void* data, int argc, char** argv, char** azColName);
 
+// the DIRECTORIES rows of one database: their ids are its own, not the ids of the DirectoryTable
+struct DirectoryIds
+{
+	std::unordered_map<int, int> toTable;		// DIRECTORIES.ID -> DirectoryTable id
+	std::unordered_map<int, int> toDatabase;	// DirectoryTable id -> DIRECTORIES.ID
+};
+
+// what loadIntoPictures decodes into
+struct PictureRows
+{
+	std::list<Picture>* rows;
+	const DirectoryIds* directories;
+};
+
 class DatabaseAccess : public IDataAccess
 {
 public:
-	static std::list<Album> albums;	
-	static std::list<Picture> pictures;
-	static std::vector<User> users;
-
-	DatabaseAccess() = default;
+	DatabaseAccess(const std::string& dbFileName = DEFAULT_DB_FILE);
 	virtual ~DatabaseAccess() = default;
 
 	// album related
@@ -30,6 +49,12 @@ public:
 	Album openAlbum(const std::string& albumName) override;
 	void closeAlbum(Album& pAlbum) override;
 	void printAlbums() override;
+	// the rows of a query of its own, fn must not use this access
+	void forEachAlbum(const std::function<void(const Album&)>& fn) override;
+	void forEachAlbumOfUser(const User& user, const std::function<void(const Album&)>& fn) override;
+	// the album rows carry no pictures, these read the picture rows of all the albums at once
+	void forEachPicture(const std::function<void(const Album&, const Picture&)>& fn) override;
+	void forEachPictureOfUser(const User& user, const std::function<void(const Album&, const Picture&)>& fn) override;
 
 	// picture related
 	void addPictureToAlbumByName(const std::string& albumName, const Picture& picture) override;
@@ -37,6 +62,12 @@ public:
 	void tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
 	void untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
 
+	// in the PICTURE_FILES table, keyed by path
+	bool getFileMetadata(const std::string& path, FileMetadata& metadata) override;
+	void getFilesMetadata(const std::vector<std::string>& paths, const std::function<void(const FileMetadata&)>& fn) override;
+	void storeFileMetadata(const std::vector<FileMetadata>& files) override;
+	void forEachFileMetadata(const std::function<void(const FileMetadata&)>& fn) override;
+
 	// user related
 	void printUsers() override;
 	void createUser(User& user) override;
@@ -56,7 +87,7 @@ public:
 	std::list<Picture> getTaggedPicturesOfUser(const User& user) override;
 
 	bool open() override;
-	void close() override {};
+	void close() override;
 	void clear() override;
 
 	virtual int getTheNextId(const std::string& tableName) override;
@@ -70,10 +101,31 @@ public:
 	virtual std::list<User> getUsersTaggedInPicture(const Picture& picture) override;
 
 	virtual bool doesUserExists(const std::string& name) override;
+
+	// ordered with ORDER BY ... LIMIT on the indexes open() creates
+	std::list<Album> getAlbumsSorted(const ListingOrder& order) override;
+	std::list<Picture> getPicturesSorted(const std::string& albumName, const ListingOrder& order) override;
+
+	// for callers that keep the rows in memory and already know the picture ids
+	std::list<Album> loadAlbums(const std::string& albumName);
+	void tagUserInPictureById(int pictureId, int userId);
+	void untagUserInPictureById(int pictureId, int userId);
+
+	ChangeFeed& getChangeFeed();
 private:
 	std::string removeWhiteSpacesBeforeAndAfter(const std::string& str);
 	bool runCommand(const std::string& sqlStatement, sqlite3* db, int (*callback)(void*, int, char**, char**) = nullptr, void* secondParam = nullptr);
 	Picture getPicture(const int& id);
+	void loadTagsOfAlbums(const std::string& albumIds, std::list<Picture>& pictures);
+	void forEachPictureOfAlbums(const std::string& albumsCondition, const std::function<void(const Album&, const Picture&)>& fn);
 	int timesAlbumsOfUserGotTagged(const User& user);
-	sqlite3* _db;
+	int storeDirectory(int directoryId);
+	std::string _dbFileName;
+	sqlite3* _db { nullptr };
+	DirectoryIds _directories;
+	ChangeFeed _changeFeed;
+	// rows of the last query that stay inside this access, dropped by the next one
+	std::list<Album> _albums;
+	std::list<Picture> _pictures;
+	std::list<User> _users;
 };
@@ -0,0 +1,71 @@
+#include "DirectoryTable.h"
+
+std::mutex DirectoryTable::m_lock;
+std::unordered_map<std::string, int> DirectoryTable::m_ids;
+std::unordered_map<int, const std::string*> DirectoryTable::m_paths;
+std::deque<std::string> DirectoryTable::m_storage;
+int DirectoryTable::m_nextId = 1;
+
+
+/**
+ * intern - Returns the id of a directory, registering it if it was not seen before.
+ * Params: directory - directory prefix (including the trailing separator)
+ * Returns: The id of the directory.
+ */
+int DirectoryTable::intern(const std::string& directory)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	auto found = m_ids.find(directory);
+	if (found != m_ids.end()) {
+		return found->second;
+	}
+
+	int id = m_nextId++;
+	m_storage.push_back(directory);
+	m_ids.emplace(directory, id);
+	m_paths.emplace(id, &m_storage.back());
+	return id;
+}
+
+/**
+ * find - Looks a directory up without registering it.
+ * Params: directory - directory prefix
+ * Returns: The id of the directory or NO_DIRECTORY.
+ */
+int DirectoryTable::find(const std::string& directory)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	auto found = m_ids.find(directory);
+	return found == m_ids.end() ? NO_DIRECTORY : found->second;
+}
+
+/**
+ * getPath - Returns the directory prefix of an id.
+ * Params: id - id of the directory
+ * Returns: The directory prefix, empty for NO_DIRECTORY or unknown ids.
+ */
+std::string DirectoryTable::getPath(int id)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	auto found = m_paths.find(id);
+	return found == m_paths.end() ? "" : *found->second;
+}
+
+/**
+ * splitPath - Splits a path into its directory prefix and its file name.
+ * Params: path - full path, directory - receives everything up to and including the last separator,
+ *         fileName - receives the rest
+ * Returns: None
+ */
+void DirectoryTable::splitPath(const std::string& path, std::string& directory, std::string& fileName)
+{
+	size_t separator = path.find_last_of("\\/");
+	if (separator == std::string::npos) {
+		directory.clear();
+		fileName = path;
+		return;
+	}
+
+	directory = path.substr(0, separator + 1);
+	fileName = path.substr(separator + 1);
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+#define NO_DIRECTORY -1
+
+/*
+ * DirectoryTable - process wide intern table of picture directories.
+ * Pictures keep the compact id of their directory and only their own file name,
+ * the full path is rebuilt when it is asked for. The ids are only meaningful in this
+ * process: a database keeps its own ids for its DIRECTORIES rows and maps them on load.
+ */
+class DirectoryTable
+{
+public:
+	static int intern(const std::string& directory);
+	static int find(const std::string& directory);
+	static std::string getPath(int id);
+
+	static void splitPath(const std::string& path, std::string& directory, std::string& fileName);
+
+private:
+	static std::mutex m_lock;
+	static std::unordered_map<std::string, int> m_ids;
+	static std::unordered_map<int, const std::string*> m_paths;
+	static std::deque<std::string> m_storage;
+	static int m_nextId;
+};
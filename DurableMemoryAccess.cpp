@@ -0,0 +1,512 @@
+#include "DurableMemoryAccess.h"
+#include "BinaryFormat.h"
+#include "MyException.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <utility>
+
+#define SNAPSHOT_MAGIC 0x504E5347	// "GSNP"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_VERSION_RECORDS 1		// users and albums written by RecordWriter, still read
+#define SNAPSHOT_HEADER_BYTES 16		// [u32 magic][u32 version][u64 generation]
+#define COMPACTOR_POLL std::chrono::seconds(1)
+
+/*
+ * SnapshotState - the private state a snapshot is rebuilt into, with the stored lists in reach.
+ */
+class SnapshotState : public MemoryAccess
+{
+public:
+	using MemoryAccess::users;
+	using MemoryAccess::albums;
+};
+
+
+DurableMemoryAccess::DurableMemoryAccess(const DurabilityOptions& options) :
+	m_options(options), m_journal(options.groupCommitWindow)
+{
+	// Left empty
+}
+
+DurableMemoryAccess::~DurableMemoryAccess()
+{
+	close();
+}
+
+/**
+ * open - Restores the state from the latest snapshot and the journals after it,
+ *        then starts a new journal generation and the background compactor.
+ * Params: None
+ * Returns: true on success.
+ */
+bool DurableMemoryAccess::open()
+{
+	if (m_isOpen) {
+		return true;
+	}
+
+	uint64_t firstGeneration = loadSnapshot(*this);
+	uint64_t lastGeneration = firstGeneration;
+
+	for (uint64_t generation : listJournalGenerations()) {
+		if (generation < firstGeneration) {
+			continue;
+		}
+		MemoryJournal::replay(journalPath(generation), [this](RecordReader& record) { applyRecord(*this, record); });
+		lastGeneration = std::max(lastGeneration, generation);
+	}
+
+	m_generation = lastGeneration + 1;
+	m_journal.open(journalPath(m_generation));
+	m_isOpen = true;
+
+	m_stopCompactor = false;
+	m_compactor = std::thread(&DurableMemoryAccess::compactorLoop, this);
+	return true;
+}
+
+void DurableMemoryAccess::close()
+{
+	if (!m_isOpen) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(m_compactorLock);
+		m_stopCompactor = true;
+	}
+	m_compactorWakeup.notify_all();
+	m_compactor.join();
+
+	m_journal.close();
+	m_isOpen = false;
+}
+
+/**
+ * clear - Drops all data, durably (an empty snapshot replaces everything on disk).
+ */
+void DurableMemoryAccess::clear()
+{
+	std::lock_guard<std::mutex> compactionGuard(m_compactionLock);
+	uint64_t generation;
+	{
+		std::lock_guard<std::mutex> guard(m_stateLock);
+		MemoryAccess::clear();
+		if (!m_isOpen) {
+			return;
+		}
+		generation = ++m_generation;
+		m_journal.rotate(journalPath(generation));
+	}
+	SnapshotState empty;
+	writeSnapshot(empty, generation);
+}
+
+// ******************* Mutations ******************* 
+void DurableMemoryAccess::createAlbum(const Album& album)
+{
+	createAlbum(Album(album));
+}
+
+// the record is written before the album is moved into the state, and journaled once the change succeeded
+void DurableMemoryAccess::createAlbum(Album&& album)
+{
+	RecordWriter record;
+	record.putUInt8(CREATE_ALBUM);
+	record.putAlbum(album);
+
+	std::unique_lock<std::mutex> guard(m_stateLock);
+	MemoryAccess::createAlbum(std::move(album));
+	journal(record, guard);
+}
+
+void DurableMemoryAccess::deleteAlbum(const std::string& albumName, int userId)
+{
+	std::unique_lock<std::mutex> guard(m_stateLock);
+	MemoryAccess::deleteAlbum(albumName, userId);
+
+	RecordWriter record;
+	record.putUInt8(DELETE_ALBUM);
+	record.putString(albumName);
+	record.putInt32(userId);
+	journal(record, guard);
+}
+
+void DurableMemoryAccess::addPictureToAlbumByName(const std::string& albumName, const Picture& picture)
+{
+	addPictureToAlbumByName(albumName, Picture(picture));
+}
+
+void DurableMemoryAccess::addPictureToAlbumByName(const std::string& albumName, Picture&& picture)
+{
+	RecordWriter record;
+	record.putUInt8(ADD_PICTURE);
+	record.putString(albumName);
+	record.putPicture(picture);
+
+	std::unique_lock<std::mutex> guard(m_stateLock);
+	MemoryAccess::addPictureToAlbumByName(albumName, std::move(picture));
+	journal(record, guard);
+}
+
+void DurableMemoryAccess::removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName)
+{
+	std::unique_lock<std::mutex> guard(m_stateLock);
+	MemoryAccess::removePictureFromAlbumByName(albumName, pictureName);
+
+	RecordWriter record;
+	record.putUInt8(REMOVE_PICTURE);
+	record.putString(albumName);
+	record.putString(pictureName);
+	journal(record, guard);
+}
+
+void DurableMemoryAccess::tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
+{
+	std::unique_lock<std::mutex> guard(m_stateLock);
+	MemoryAccess::tagUserInPicture(albumName, pictureName, userId);
+
+	RecordWriter record;
+	record.putUInt8(TAG_USER);
+	record.putString(albumName);
+	record.putString(pictureName);
+	record.putInt32(userId);
+	journal(record, guard);
+}
+
+void DurableMemoryAccess::untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
+{
+	std::unique_lock<std::mutex> guard(m_stateLock);
+	MemoryAccess::untagUserInPicture(albumName, pictureName, userId);
+
+	RecordWriter record;
+	record.putUInt8(UNTAG_USER);
+	record.putString(albumName);
+	record.putString(pictureName);
+	record.putInt32(userId);
+	journal(record, guard);
+}
+
+void DurableMemoryAccess::createUser(User& user)
+{
+	std::unique_lock<std::mutex> guard(m_stateLock);
+	MemoryAccess::createUser(user);
+
+	RecordWriter record;
+	record.putUInt8(CREATE_USER);
+	record.putUser(user);
+	journal(record, guard);
+}
+
+void DurableMemoryAccess::deleteUser(const User& user)
+{
+	std::unique_lock<std::mutex> guard(m_stateLock);
+	MemoryAccess::deleteUser(user);
+
+	RecordWriter record;
+	record.putUInt8(DELETE_USER);
+	record.putInt32(user.getId());
+	journal(record, guard);
+}
+
+/**
+ * journal - Appends the record of a call that was just applied.
+ * Params: record - encoded call, stateGuard - held state lock, released before waiting for the disk
+ * Returns: None
+ * Note: records are appended under the state lock, so their order is the order the calls were applied in.
+ */
+void DurableMemoryAccess::journal(const RecordWriter& record, std::unique_lock<std::mutex>& stateGuard)
+{
+	if (!m_isOpen) {
+		return;
+	}
+
+	uint64_t ticket = m_journal.append(record.getBytes());
+	stateGuard.unlock();
+
+	if (m_options.waitForDurability) {
+		m_journal.waitDurable(ticket);
+	}
+}
+
+/**
+ * applyRecord - Replays one journal record on an in-memory state.
+ * Params: state - this object on open, the private state of a snapshot when compacting;
+ *         the MemoryAccess calls are not virtual, so nothing is journaled again
+ */
+void DurableMemoryAccess::applyRecord(MemoryAccess& state, RecordReader& record)
+{
+	try {
+		switch (record.getUInt8())
+		{
+		case CREATE_USER:
+		{
+			User user = record.getUser();
+			state.MemoryAccess::createUser(user);
+			break;
+		}
+		case DELETE_USER:
+			state.MemoryAccess::deleteUser(User(record.getInt32(), ""));
+			break;
+		case CREATE_ALBUM:
+			state.MemoryAccess::createAlbum(record.getAlbum());
+			break;
+		case DELETE_ALBUM:
+		{
+			std::string albumName = record.getString();
+			state.MemoryAccess::deleteAlbum(albumName, record.getInt32());
+			break;
+		}
+		case ADD_PICTURE:
+		{
+			std::string albumName = record.getString();
+			state.MemoryAccess::addPictureToAlbumByName(albumName, record.getPicture());
+			break;
+		}
+		case REMOVE_PICTURE:
+		{
+			std::string albumName = record.getString();
+			state.MemoryAccess::removePictureFromAlbumByName(albumName, record.getString());
+			break;
+		}
+		case TAG_USER:
+		{
+			std::string albumName = record.getString();
+			std::string pictureName = record.getString();
+			state.MemoryAccess::tagUserInPicture(albumName, pictureName, record.getInt32());
+			break;
+		}
+		case UNTAG_USER:
+		{
+			std::string albumName = record.getString();
+			std::string pictureName = record.getString();
+			state.MemoryAccess::untagUserInPicture(albumName, pictureName, record.getInt32());
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	catch (const MyException&) {
+		// the call failed the same way when it was made, nothing to restore
+	}
+}
+
+// ******************* Snapshots ******************* 
+
+/**
+ * compact - Writes a snapshot up to a new journal generation and drops the journals it covers.
+ * Params: None
+ * Returns: None
+ * Note: the live state is never read: the snapshot is rebuilt, on the calling thread, from the
+ *       last snapshot and the journals before the new generation. Only the switch to the new
+ *       generation holds the state lock, so changes go on while the snapshot is made (which
+ *       takes memory for a second copy of the data meanwhile).
+ */
+void DurableMemoryAccess::compact()
+{
+	std::lock_guard<std::mutex> compactionGuard(m_compactionLock);
+	uint64_t generation;
+	{
+		std::lock_guard<std::mutex> guard(m_stateLock);
+		if (!m_isOpen) {
+			return;
+		}
+		// the snapshot holds everything journaled up to here, the journal of the next generation the rest
+		generation = ++m_generation;
+		m_journal.rotate(journalPath(generation));
+	}
+
+	SnapshotState state;
+	uint64_t firstGeneration = loadSnapshot(state);
+	for (uint64_t old : listJournalGenerations()) {
+		if (old >= firstGeneration && old < generation) {
+			MemoryJournal::replay(journalPath(old), [this, &state](RecordReader& record) { applyRecord(state, record); });
+		}
+	}
+	writeSnapshot(state, generation);
+}
+
+/**
+ * writeSnapshot - Replaces the snapshot file and then drops the journals before its generation.
+ * Params: state - the data up to generation, generation - the first journal generation not in it
+ * Returns: None
+ * Note: the journals go only once the new snapshot and its name are synced to the disk.
+ */
+void DurableMemoryAccess::writeSnapshot(SnapshotState& state, uint64_t generation)
+{
+	RecordWriter header;
+	header.putUInt32(SNAPSHOT_MAGIC);
+	header.putUInt32(SNAPSHOT_VERSION);
+	header.putUInt64(generation);
+	std::string snapshot = header.getBytes();
+
+	// then the users and the albums as one binary stream, see BinaryFormat; the stored lists may
+	// hold tombstones, which the replay left and the compaction frees
+	state.compactTombstones();
+	BinaryWriter writer([&snapshot](const char* data, size_t size) { snapshot.append(data, size); });
+	for (const auto& user : state.users()) {
+		writer.write(user);
+	}
+	for (const auto& album : state.albums()) {
+		writer.write(album);
+	}
+	writer.flush();
+
+	RecordWriter trailer;
+	trailer.putUInt32(MemoryJournal::checksum(snapshot.data(), snapshot.size()));
+	snapshot += trailer.getBytes();
+
+	std::string temporaryPath = snapshotPath() + ".tmp";
+	FILE* file = fopen(temporaryPath.c_str(), "wb");
+	if (file == nullptr) {
+		return;
+	}
+	bool written = fwrite(snapshot.data(), 1, snapshot.size(), file) == snapshot.size();
+	written = fflush(file) == 0 && written;
+	written = MemoryJournal::syncFile(file) && written;
+	fclose(file);
+	if (!written) {
+		std::remove(temporaryPath.c_str());
+		return;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, snapshotPath(), error);
+	if (error || !MemoryJournal::syncDirectory(MemoryJournal::getDirectory(snapshotPath()))) {
+		return;
+	}
+
+	for (uint64_t old : listJournalGenerations()) {
+		if (old < generation) {
+			std::remove(journalPath(old).c_str());
+		}
+	}
+}
+
+/**
+ * loadSnapshot - Loads the snapshot file, if there is a valid one.
+ * Params: state - receives the users and albums (this object on open)
+ * Returns: The first journal generation that is not part of the snapshot.
+ */
+uint64_t DurableMemoryAccess::loadSnapshot(MemoryAccess& state)
+{
+	FILE* file = fopen(snapshotPath().c_str(), "rb");
+	if (file == nullptr) {
+		return 0;
+	}
+
+	std::string contents;
+	char chunk[1 << 16];
+	size_t read;
+	while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+		contents.append(chunk, read);
+	}
+	fclose(file);
+
+	if (contents.size() < 4) {
+		return 0;
+	}
+	size_t payloadSize = contents.size() - 4;
+	RecordReader trailer(contents.data() + payloadSize, 4);
+	if (trailer.getUInt32() != MemoryJournal::checksum(contents.data(), payloadSize)) {
+		throw MyException("Snapshot " + snapshotPath() + " is corrupt");
+	}
+
+	RecordReader reader(contents.data(), payloadSize);
+	uint32_t magic = reader.getUInt32();
+	uint32_t version = reader.getUInt32();
+	if (magic != SNAPSHOT_MAGIC || (version != SNAPSHOT_VERSION && version != SNAPSHOT_VERSION_RECORDS)) {
+		throw MyException("Snapshot " + snapshotPath() + " has an unknown format");
+	}
+
+	uint64_t generation = reader.getUInt64();
+	if (version == SNAPSHOT_VERSION) {
+		BinaryReader records(contents.data() + SNAPSHOT_HEADER_BYTES, payloadSize - SNAPSHOT_HEADER_BYTES);
+		while (records.next()) {
+			switch (records.getKind())
+			{
+			case BinaryKind::USER:
+			{
+				User user = records.getUser().toUser();
+				state.MemoryAccess::createUser(user);
+				break;
+			}
+			case BinaryKind::ALBUM:
+				state.MemoryAccess::createAlbum(records.getAlbum().toAlbum());
+				break;
+			default:
+				throw MyException("Snapshot " + snapshotPath() + " has an unexpected record");
+			}
+		}
+		return generation;
+	}
+
+	uint32_t users = reader.getUInt32();
+	for (uint32_t i = 0; i < users; ++i) {
+		User user = reader.getUser();
+		state.MemoryAccess::createUser(user);
+	}
+	uint32_t albums = reader.getUInt32();
+	for (uint32_t i = 0; i < albums; ++i) {
+		state.MemoryAccess::createAlbum(reader.getAlbum());
+	}
+
+	return generation;
+}
+
+void DurableMemoryAccess::compactorLoop()
+{
+	auto lastCompaction = std::chrono::steady_clock::now();
+	std::unique_lock<std::mutex> guard(m_compactorLock);
+
+	while (!m_stopCompactor) {
+		m_compactorWakeup.wait_for(guard, std::min<std::chrono::steady_clock::duration>(COMPACTOR_POLL, m_options.compactionInterval));
+		if (m_stopCompactor) {
+			break;
+		}
+
+		bool intervalPassed = std::chrono::steady_clock::now() - lastCompaction >= m_options.compactionInterval;
+		bool journalTooBig = m_journal.getFileBytes() >= m_options.compactionJournalBytes;
+		if ((intervalPassed && m_journal.getFileBytes() > 0) || journalTooBig) {
+			guard.unlock();
+			compact();
+			guard.lock();
+			lastCompaction = std::chrono::steady_clock::now();
+		}
+	}
+}
+
+std::string DurableMemoryAccess::snapshotPath() const
+{
+	return m_options.basePath + ".snapshot";
+}
+
+std::string DurableMemoryAccess::journalPath(uint64_t generation) const
+{
+	return m_options.basePath + ".journal." + std::to_string(generation);
+}
+
+std::vector<uint64_t> DurableMemoryAccess::listJournalGenerations() const
+{
+	std::filesystem::path base(m_options.basePath);
+	std::filesystem::path directory = base.has_parent_path() ? base.parent_path() : std::filesystem::path(".");
+	std::string prefix = base.filename().string() + ".journal.";
+
+	std::vector<uint64_t> generations;
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+		std::string name = entry.path().filename().string();
+		if (name.compare(0, prefix.size(), prefix) != 0 || name.size() == prefix.size()) {
+			continue;
+		}
+		std::string suffix = name.substr(prefix.size());
+		if (suffix.find_first_not_of("0123456789") == std::string::npos) {
+			generations.push_back(std::stoull(suffix));
+		}
+	}
+
+	std::sort(generations.begin(), generations.end());
+	return generations;
+}
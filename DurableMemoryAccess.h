@@ -0,0 +1,95 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "MemoryAccess.h"
+#include "MemoryJournal.h"
+
+struct DurabilityOptions
+{
+	std::string basePath { "gallery" };				// <basePath>.snapshot and <basePath>.journal.<generation>
+	std::chrono::milliseconds groupCommitWindow { 2 };
+	bool waitForDurability { true };				// a mutating call returns only once its record is on disk
+	std::chrono::seconds compactionInterval { 60 };
+	uint64_t compactionJournalBytes { 64 * 1024 * 1024 };
+};
+
+/*
+ * DurableMemoryAccess - MemoryAccess that survives restarts.
+ * Every mutating call is appended to a MemoryJournal, and a background compactor
+ * periodically starts a new journal generation and writes a full snapshot of the ones before.
+ * open() loads the latest snapshot and replays the journal generations after it.
+ *
+ * Like MemoryAccess it is meant to be used from one thread. The compactor never touches the
+ * live state: it rebuilds the snapshot from the previous one and the journals it replaces.
+ * The state lock keeps every change together with its record, so the journal has them in the
+ * order they were applied and a new generation never starts between the two.
+ */
+class SnapshotState;
+
+class DurableMemoryAccess : public MemoryAccess
+{
+public:
+	explicit DurableMemoryAccess(const DurabilityOptions& options = DurabilityOptions());
+	virtual ~DurableMemoryAccess();
+
+	// album related
+	void createAlbum(const Album& album) override;
+	void createAlbum(Album&& album) override;
+	void deleteAlbum(const std::string& albumName, int userId) override;
+
+	// picture related
+	void addPictureToAlbumByName(const std::string& albumName, const Picture& picture) override;
+	void addPictureToAlbumByName(const std::string& albumName, Picture&& picture) override;
+	void removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName) override;
+	void tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
+	void untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
+
+	// user related
+	void createUser(User& user) override;
+	void deleteUser(const User& user) override;
+
+	bool open() override;
+	void close() override;
+	void clear() override;
+
+	void compact();
+
+private:
+	enum JournalOperation : uint8_t
+	{
+		CREATE_USER = 1,
+		DELETE_USER,
+		CREATE_ALBUM,
+		DELETE_ALBUM,
+		ADD_PICTURE,
+		REMOVE_PICTURE,
+		TAG_USER,
+		UNTAG_USER
+	};
+
+	DurabilityOptions m_options;
+	MemoryJournal m_journal;
+	std::mutex m_stateLock;
+	std::mutex m_compactionLock;	// one snapshot at a time, so an older one never replaces a newer
+	uint64_t m_generation { 0 };
+	bool m_isOpen { false };
+
+	std::thread m_compactor;
+	std::mutex m_compactorLock;
+	std::condition_variable m_compactorWakeup;
+	bool m_stopCompactor { false };
+
+	void journal(const RecordWriter& record, std::unique_lock<std::mutex>& stateGuard);
+	void applyRecord(MemoryAccess& state, RecordReader& record);
+	uint64_t loadSnapshot(MemoryAccess& state);
+	void writeSnapshot(SnapshotState& state, uint64_t generation);
+	void compactorLoop();
+
+	std::string snapshotPath() const;
+	std::string journalPath(uint64_t generation) const;
+	std::vector<uint64_t> listJournalGenerations() const;
+};
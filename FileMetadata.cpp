@@ -0,0 +1,354 @@
+#include "FileMetadata.h"
+#include "ImageDecoder.h"
+#include "PerceptualHash.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define JPEG_MAX_SEGMENTS 256		// markers walked looking for the frame header
+
+/**
+ * statFile - Reads the size and modification time of a regular file.
+ * Params: path - the file; size, modifiedTime - receive them
+ * Returns: false when there is no such file (or it is not a regular file).
+ */
+static bool statFile(const std::string& path, uint64_t& size, int64_t& modifiedTime)
+{
+#ifdef _WIN32
+	struct _stat64 buffer;
+	if (_stat64(path.c_str(), &buffer) != 0) {
+		return false;
+	}
+#else
+	struct stat buffer;
+	if (stat(path.c_str(), &buffer) != 0) {
+		return false;
+	}
+#endif
+	if ((buffer.st_mode & S_IFMT) != S_IFREG) {
+		return false;
+	}
+	size = static_cast<uint64_t>(buffer.st_size);
+	modifiedTime = static_cast<int64_t>(buffer.st_mtime);
+	return true;
+}
+
+static uint32_t readBigEndian(const unsigned char* bytes, int count)
+{
+	uint32_t value = 0;
+	for (int i = 0; i < count; ++i) {
+		value = (value << 8) | bytes[i];
+	}
+	return value;
+}
+
+static uint32_t readLittleEndian(const unsigned char* bytes, int count)
+{
+	uint32_t value = 0;
+	for (int i = count - 1; i >= 0; --i) {
+		value = (value << 8) | bytes[i];
+	}
+	return value;
+}
+
+/**
+ * readPnmDimensions - Reads the width and height that follow the "Pn" of a PBM / PGM / PPM header.
+ * Params: header, length - the first bytes of the file; metadata - receives the dimensions
+ * Returns: None (the dimensions stay 0 when the header does not hold them)
+ */
+static void readPnmDimensions(const unsigned char* header, size_t length, FileMetadata& metadata)
+{
+	int values[2] = { 0, 0 };
+	size_t position = 2;
+	for (int& value : values) {
+		// whitespace and comments up to the end of their line
+		while (position < length && (header[position] == '#' || isspace(header[position]))) {
+			if (header[position] == '#') {
+				while (position < length && header[position] != '\n') {
+					++position;
+				}
+			}
+			else {
+				++position;
+			}
+		}
+		size_t start = position;
+		while (position < length && header[position] >= '0' && header[position] <= '9' && value < 1000000) {
+			value = value * 10 + (header[position] - '0');
+			++position;
+		}
+		if (position == start || position == length) {
+			return;
+		}
+	}
+	metadata.width = values[0];
+	metadata.height = values[1];
+}
+
+/**
+ * readJpegDimensions - Walks the JPEG segments up to the frame header, which holds the dimensions.
+ * Params: file - positioned anywhere; metadata - receives the dimensions
+ * Returns: None (the dimensions stay 0 when no frame header comes before the image data)
+ */
+static void readJpegDimensions(std::ifstream& file, FileMetadata& metadata)
+{
+	std::streamoff position = 2;	// after the start of image marker
+	for (int segment = 0; segment < JPEG_MAX_SEGMENTS; ++segment) {
+		unsigned char marker[4];
+		file.clear();
+		file.seekg(position);
+		if (!file.read(reinterpret_cast<char*>(marker), 2) || marker[0] != 0xFF) {
+			return;
+		}
+		// markers may be padded with any number of 0xFF
+		while (marker[1] == 0xFF) {
+			if (!file.read(reinterpret_cast<char*>(marker + 1), 1)) {
+				return;
+			}
+			++position;
+		}
+
+		unsigned char type = marker[1];
+		if (type == 0xD9 || type == 0xDA) {
+			return;		// end of image or start of scan, the frame header would have come first
+		}
+		if (type == 0x01 || (type >= 0xD0 && type <= 0xD8)) {
+			position += 2;	// no length
+			continue;
+		}
+
+		unsigned char fields[7];	// [u16 length][u8 precision][u16 height][u16 width]
+		if (!file.read(reinterpret_cast<char*>(fields), sizeof(fields))) {
+			return;
+		}
+		// SOF0 - SOF15, but C4 (Huffman tables), C8 (reserved) and CC (arithmetic coding) are not frames
+		if (type >= 0xC0 && type <= 0xCF && type != 0xC4 && type != 0xC8 && type != 0xCC) {
+			metadata.height = static_cast<int>(readBigEndian(fields + 3, 2));
+			metadata.width = static_cast<int>(readBigEndian(fields + 5, 2));
+			return;
+		}
+		position += 2 + readBigEndian(fields, 2);
+	}
+}
+
+/**
+ * readHeader - Finds the format and dimensions of an image from its first bytes.
+ * Params: file - open at the beginning; metadata - receives format, width and height
+ * Returns: None (UNKNOWN and 0 x 0 for other files)
+ */
+static void readHeader(std::ifstream& file, FileMetadata& metadata)
+{
+	unsigned char header[FILE_HEADER_BYTES] = { 0 };
+	file.read(reinterpret_cast<char*>(header), sizeof(header));
+	size_t length = static_cast<size_t>(file.gcount());
+
+	metadata.format = ImageFormat::UNKNOWN;
+	metadata.width = 0;
+	metadata.height = 0;
+
+	static const unsigned char pngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	if (length >= 24 && std::equal(pngSignature, pngSignature + 8, header)) {
+		// the IHDR chunk always comes first: [u32 length]["IHDR"][u32 width][u32 height]
+		metadata.format = ImageFormat::PNG;
+		metadata.width = static_cast<int>(readBigEndian(header + 16, 4));
+		metadata.height = static_cast<int>(readBigEndian(header + 20, 4));
+	}
+	else if (length >= 10 && header[0] == 'G' && header[1] == 'I' && header[2] == 'F') {
+		metadata.format = ImageFormat::GIF;
+		metadata.width = static_cast<int>(readLittleEndian(header + 6, 2));
+		metadata.height = static_cast<int>(readLittleEndian(header + 8, 2));
+	}
+	else if (length >= 26 && header[0] == 'B' && header[1] == 'M') {
+		// BITMAPINFOHEADER, a negative height means the rows are stored top down
+		metadata.format = ImageFormat::BMP;
+		metadata.width = std::abs(static_cast<int32_t>(readLittleEndian(header + 18, 4)));
+		metadata.height = std::abs(static_cast<int32_t>(readLittleEndian(header + 22, 4)));
+	}
+	else if (length >= 3 && header[0] == 0xFF && header[1] == 0xD8 && header[2] == 0xFF) {
+		metadata.format = ImageFormat::JPEG;
+		readJpegDimensions(file, metadata);
+	}
+	else if (length >= 3 && header[0] == 'P' && header[1] >= '1' && header[1] <= '6' && isspace(header[2])) {
+		metadata.format = ImageFormat::PNM;
+		readPnmDimensions(header, length, metadata);
+	}
+}
+
+bool FileMetadata::read(const std::string& path, FileMetadata& metadata, Image* image)
+{
+	FileMetadata result;
+	result.path = path;
+	if (!statFile(path, result.size, result.modifiedTime)) {
+		return false;
+	}
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	readHeader(file, result);
+	file.close();
+
+	Image decoded;
+	if (ImageDecoder::canDecode(result.format) && ImageDecoder::decode(path, decoded)) {
+		result.perceptualHash = PerceptualHash::compute(decoded);
+		result.hasPerceptualHash = true;
+		if (image != nullptr) {
+			*image = std::move(decoded);
+		}
+	}
+
+	metadata = std::move(result);
+	return true;
+}
+
+FileState FileMetadata::revalidate()
+{
+	uint64_t currentSize = 0;
+	int64_t currentModifiedTime = 0;
+	if (!statFile(path, currentSize, currentModifiedTime)) {
+		return FileState::MISSING;
+	}
+	if (currentSize == size && currentModifiedTime == modifiedTime) {
+		return FileState::CURRENT;
+	}
+	return read(path, *this) ? FileState::REFRESHED : FileState::MISSING;
+}
+
+const char* FileMetadata::getFormatName() const
+{
+	switch (format) {
+	case ImageFormat::BMP:
+		return "BMP";
+	case ImageFormat::GIF:
+		return "GIF";
+	case ImageFormat::JPEG:
+		return "JPEG";
+	case ImageFormat::PNG:
+		return "PNG";
+	case ImageFormat::PNM:
+		return "PNM";
+	default:
+		return "unknown format";
+	}
+}
+
+std::string FileMetadata::describe() const
+{
+	static const char* units[] = { "B", "KB", "MB", "GB", "TB" };
+	double scaled = static_cast<double>(size);
+	size_t unit = 0;
+	while (scaled >= 1024 && unit + 1 < sizeof(units) / sizeof(units[0])) {
+		scaled /= 1024;
+		++unit;
+	}
+
+	char text[96];
+	if (unit == 0) {
+		std::snprintf(text, sizeof(text), "%llu B", static_cast<unsigned long long>(size));
+	}
+	else {
+		std::snprintf(text, sizeof(text), "%.1f %s", scaled, units[unit]);
+	}
+
+	if (width == 0 || height == 0) {
+		return std::string(getFormatName()) + ", " + text;
+	}
+	return std::string(getFormatName()) + " " + std::to_string(width) + "x" + std::to_string(height) + ", " + text;
+}
+
+FileMetadata::VerifyStats FileMetadata::verifyAll(std::vector<FileMetadata>& files, std::vector<FileState>& states, const Parallelism& parallelism)
+{
+	states.assign(files.size(), FileState::MISSING);
+
+	// every chunk writes its own slots, no locking
+	size_t chunks = parallelism.getChunks(files.size());
+	parallelism.run(chunks, [&files, &states, chunks](size_t chunk) {
+		size_t end = Parallelism::getChunkBegin(files.size(), chunks, chunk + 1);
+		for (size_t i = Parallelism::getChunkBegin(files.size(), chunks, chunk); i < end; ++i) {
+			states[i] = files[i].revalidate();
+		}
+	});
+
+	VerifyStats stats;
+	for (size_t i = 0; i < files.size(); ++i) {
+		switch (states[i]) {
+		case FileState::CURRENT:
+			++stats.current;
+			break;
+		case FileState::REFRESHED:
+			++stats.refreshed;
+			break;
+		case FileState::MISSING:
+			stats.missing.push_back(files[i].path);
+			break;
+		}
+	}
+	return stats;
+}
+
+// ******************* FileMetadataStore *******************
+
+FileMetadataStore::FileMetadataStore(const FileMetadataStore& other)
+{
+	std::shared_lock<std::shared_mutex> guard(other.m_lock);
+	m_files = other.m_files;
+}
+
+FileMetadataStore& FileMetadataStore::operator=(const FileMetadataStore& other)
+{
+	if (this != &other) {
+		std::unordered_map<std::string, FileMetadata> files;
+		{
+			std::shared_lock<std::shared_mutex> guard(other.m_lock);
+			files = other.m_files;
+		}
+		std::unique_lock<std::shared_mutex> guard(m_lock);
+		m_files.swap(files);
+	}
+	return *this;
+}
+
+bool FileMetadataStore::find(const std::string& path, FileMetadata& metadata) const
+{
+	std::shared_lock<std::shared_mutex> guard(m_lock);
+	auto found = m_files.find(path);
+	if (found == m_files.end()) {
+		return false;
+	}
+	metadata = found->second;
+	return true;
+}
+
+void FileMetadataStore::forEach(const std::function<void(const FileMetadata&)>& fn) const
+{
+	std::shared_lock<std::shared_mutex> guard(m_lock);
+	for (const auto& entry : m_files) {
+		fn(entry.second);
+	}
+}
+
+void FileMetadataStore::store(const std::vector<FileMetadata>& files)
+{
+	std::unique_lock<std::shared_mutex> guard(m_lock);
+	for (const FileMetadata& metadata : files) {
+		m_files[metadata.path] = metadata;
+	}
+}
+
+void FileMetadataStore::clear()
+{
+	std::unique_lock<std::shared_mutex> guard(m_lock);
+	m_files.clear();
+}
+
+size_t FileMetadataStore::size() const
+{
+	std::shared_lock<std::shared_mutex> guard(m_lock);
+	return m_files.size();
+}
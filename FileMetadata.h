@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ThreadPool.h"
+
+#define FILE_HEADER_BYTES 64				// enough for the dimensions of every format but JPEG
+#define FILE_VERIFY_THRESHOLD 32			// fewer files are verified on the calling thread
+
+struct Image;
+
+enum class ImageFormat : uint8_t
+{
+	UNKNOWN = 0,
+	BMP,
+	GIF,
+	JPEG,
+	PNG,
+	PNM
+};
+
+enum class FileState
+{
+	CURRENT,		// same size and modification time, the record was kept
+	REFRESHED,		// the file changed (or was never read), the record was read again
+	MISSING
+};
+
+/*
+ * FileMetadata - what the gallery knows about the file of a picture without opening it: size,
+ * modification time and, read from the image header, the format and dimensions (0 when the
+ * format is unknown). Images ImageDecoder can decode also get their PerceptualHash. Records are
+ * captured when a picture is added and trusted as long as a stat of the file reports the same
+ * size and modification time.
+ */
+struct FileMetadata
+{
+	std::string path;
+	uint64_t size { 0 };
+	int64_t modifiedTime { -1 };	// seconds since 1970, -1 until the file was read
+	int width { 0 };
+	int height { 0 };
+	ImageFormat format { ImageFormat::UNKNOWN };
+	bool hasPerceptualHash { false };
+	uint64_t perceptualHash { 0 };
+
+	// stats the file, reads its header and hashes the decodable ones, whose pixels go to image when
+	// it is given (left empty for the others); false when it can not be opened
+	static bool read(const std::string& path, FileMetadata& metadata, Image* image = nullptr);
+	// stats the file and reads it again only when size or modification time changed
+	FileState revalidate();
+
+	const char* getFormatName() const;
+	std::string describe() const;		// "PNG 640x480, 1.2 MB"
+
+	struct VerifyStats
+	{
+		size_t current { 0 };
+		size_t refreshed { 0 };
+		std::vector<std::string> missing;
+	};
+
+	// revalidates every record, split over the threads of parallelism; the states are written
+	// to states (same order as files)
+	static VerifyStats verifyAll(std::vector<FileMetadata>& files, std::vector<FileState>& states, const Parallelism& parallelism);
+};
+
+/*
+ * FileMetadataStore - the records of the in-memory backends, keyed by path.
+ * Thread safe: listings look records up while the verifier stores them.
+ */
+class FileMetadataStore
+{
+public:
+	FileMetadataStore() = default;
+	FileMetadataStore(const FileMetadataStore& other);
+	FileMetadataStore& operator=(const FileMetadataStore& other);
+
+	bool find(const std::string& path, FileMetadata& metadata) const;
+	void forEach(const std::function<void(const FileMetadata&)>& fn) const;
+	void store(const std::vector<FileMetadata>& files);
+	void clear();
+	size_t size() const;
+
+private:
+	mutable std::shared_mutex m_lock;
+	std::unordered_map<std::string, FileMetadata> m_files;
+};
@@ -0,0 +1,1117 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Benchmark.h"
+#include "BinaryFormat.h"
+#include "ConcurrentMemoryAccess.h"
+#include "ContentStore.h"
+#include "DatabaseAcses.h"
+#include "DurableMemoryAccess.h"
+#include "MemoryAccess.h"
+#include "MyException.h"
+#include "PerceptualHash.h"
+#include "ShardedMemoryAccess.h"
+#include "TagSet.h"
+#include "ThreadPool.h"
+#include "ThumbnailCache.h"
+#include "TieredDataAccess.h"
+#include "Timestamp.h"
+#include "WorkloadGenerator.h"
+
+#define BENCH_DB_FILE "gallery_bench.sqlite"
+#define BENCH_DURABLE_BASE "gallery_bench_durable"
+#define BENCH_THUMBNAILS_DIR "gallery_bench_thumbnails"
+#define BENCH_IMPORT_DIR "gallery_bench_import"
+
+/*
+ * gallery_bench - replays the same seeded workload against MemoryAccess and DatabaseAccess
+ * and prints throughput and p50/p99 latency per operation as JSON.
+ * "durable" (not part of "both") runs DurableMemoryAccess with its default group commit window.
+ * "concurrent" (not part of "both") runs ConcurrentMemoryAccess, populated in one update(), with
+ * --readers threads scanning the statistics for the whole mixed phase.
+ * "sharded" (not part of "both") runs ShardedMemoryAccess with the mixed phase dealt out
+ * round robin to --writers threads.
+ * "tiered" (not part of "both") runs TieredDataAccess over a fresh database with a hot tier
+ * of --budget bytes, and adds its hit and eviction counters.
+ *
+ * usage: gallery_bench [--backend memory|durable|concurrent|sharded|tiered|database|both] [--seed N]
+ *                      [--users N] [--albums N] [--pictures N] [--tags N] [--zipf S] [--ops N]
+ *                      [--readers N] [--writers N] [--shards N] [--budget BYTES] [--out FILE]
+ *        gallery_bench --mode tagset [--seed N] [--out FILE]
+ *        gallery_bench --mode columns [workload options] [--out FILE]
+ *        gallery_bench --mode scaling [workload options] [--threads N] [--out FILE]
+ *        gallery_bench --mode ingest [workload options] [--out FILE]
+ *        gallery_bench --mode duplicates [--seed N] [--hashes N] [--out FILE]
+ *        gallery_bench --mode thumbnails [--seed N] [--images N] [--threads N] [--out FILE]
+ *        gallery_bench --mode import [--seed N] [--images N] [--threads N] [--out FILE]
+ *
+ * --mode tagset compares the memory, copy and lookup cost of TagSet with the std::set<int> it
+ * replaced, for pictures with 1 to 256 tags.
+ * --mode columns populates a MemoryAccess with the workload and times the statistics that
+ * scan every picture, on the picture columns and as a walk over the album and picture lists.
+ * --mode scaling times the same statistics split over a pool of 1, 2, ... --threads threads
+ * (default: one per core), with the parallel threshold at 0 so every size is split.
+ * --mode ingest counts the allocations of populating a MemoryAccess with the workload, once
+ * through the copying createAlbum/addPictureToAlbumByName overloads and once through the moving ones.
+ * --mode duplicates builds a PerceptualIndex over --hashes synthetic hashes, clustered like copies of
+ * the same pictures, and times its radius searches against the linear scan and the grouping of all of them.
+ * --mode thumbnails writes --images 1920x1080 PPM files and times making their thumbnails on
+ * --threads threads, asking for them again (all cache hits) and the downscale alone.
+ * --mode import writes --images 4 MB files, a quarter of them copies of others, and times
+ * importing them into a ContentStore on 1 and on --threads threads, and importing them again.
+ * --mode fuzz-binary encodes --rounds random galleries with BinaryWriter, checks they decode back,
+ * then truncates and mutates the encoded bytes and decodes them through the views and the to*
+ * functions: anything but a MyException (or a wrong decode) is counted as a failure and the
+ * exit code is 1. Malformed input that crashes stops the run, which is the point of running it
+ * under a sanitizer.
+ */
+
+struct BenchOptions
+{
+	WorkloadConfig workload;
+	std::string mode { "backends" };
+	std::string backend { "both" };
+	int readers { 2 };
+	int writers { 4 };
+	int shards { SHARDED_DEFAULT_SHARDS };
+	size_t budget { TIERED_DEFAULT_BUDGET };
+	int threads { static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u)) };
+	size_t hashes { 1000000 };
+	int images { 32 };
+	int rounds { 200 };
+	std::string outFile;
+};
+
+// snapshot and journal generations of the durable backend
+static void removeDurableFiles()
+{
+	std::string prefix = std::string(BENCH_DURABLE_BASE) + ".";
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(".", error)) {
+		if (entry.path().filename().string().compare(0, prefix.size(), prefix) == 0) {
+			std::filesystem::remove(entry.path(), error);
+		}
+	}
+}
+
+static BenchOptions parseArguments(int argc, char** argv)
+{
+	BenchOptions options;
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string key = argv[i];
+		std::string value = argv[i + 1];
+
+		if (key == "--mode") {
+			options.mode = value;
+		}
+		else if (key == "--backend") {
+			options.backend = value;
+		}
+		else if (key == "--seed") {
+			options.workload.seed = std::stoull(value);
+		}
+		else if (key == "--users") {
+			options.workload.users = std::stoi(value);
+		}
+		else if (key == "--albums") {
+			options.workload.albumsPerUser = std::stoi(value);
+		}
+		else if (key == "--pictures") {
+			options.workload.picturesPerAlbum = std::stoi(value);
+		}
+		else if (key == "--tags") {
+			options.workload.tags = std::stoi(value);
+		}
+		else if (key == "--zipf") {
+			options.workload.zipfExponent = std::stod(value);
+		}
+		else if (key == "--ops") {
+			options.workload.operations = std::stoi(value);
+		}
+		else if (key == "--readers") {
+			options.readers = std::stoi(value);
+		}
+		else if (key == "--writers") {
+			options.writers = std::max(std::stoi(value), 1);
+		}
+		else if (key == "--budget") {
+			options.budget = std::stoull(value);
+		}
+		else if (key == "--threads") {
+			options.threads = std::max(std::stoi(value), 1);
+		}
+		else if (key == "--shards") {
+			options.shards = std::max(std::stoi(value), 1);
+		}
+		else if (key == "--hashes") {
+			options.hashes = std::stoull(value);
+		}
+		else if (key == "--images") {
+			options.images = std::max(std::stoi(value), 1);
+		}
+		else if (key == "--rounds") {
+			options.rounds = std::max(std::stoi(value), 1);
+		}
+		else if (key == "--out") {
+			options.outFile = value;
+		}
+		else {
+			throw std::invalid_argument("Unknown option " + key);
+		}
+	}
+
+	return options;
+}
+
+static void replay(IDataAccess& dataAccess, const WorkloadGenerator& generator,
+	const std::vector<Operation>& operations, LatencyRecorder& recorder)
+{
+	for (const auto& operation : operations) {
+		auto start = std::chrono::steady_clock::now();
+		try {
+			generator.execute(dataAccess, operation);
+		}
+		catch (const std::exception&) {
+			// e.g. top tagged queries before anything is tagged, still a measured call
+		}
+		recorder.record(WorkloadGenerator::getOperationName(operation.type), std::chrono::steady_clock::now() - start);
+	}
+}
+
+static void runBackend(const std::string& name, IDataAccess& dataAccess, const WorkloadGenerator& generator, std::ostream& out)
+{
+	LatencyRecorder populate;
+	LatencyRecorder mixed;
+
+	replay(dataAccess, generator, generator.getPopulateOperations(), populate);
+	replay(dataAccess, generator, generator.getMixedOperations(), mixed);
+
+	out << "    {\n      \"backend\": \"" << name << "\",\n      \"populate\": ";
+	populate.writeJson(out, "      ");
+	out << ",\n      \"mixed\": ";
+	mixed.writeJson(out, "      ");
+	out << "\n    }";
+}
+
+static void runTieredBackend(size_t budget, const WorkloadGenerator& generator, std::ostream& out)
+{
+	std::remove(BENCH_DB_FILE);
+	TieringOptions tiering;
+	tiering.dbFileName = BENCH_DB_FILE;
+	tiering.memoryBudget = budget;
+	TieredDataAccess dataAccess(tiering);
+	dataAccess.open();
+
+	LatencyRecorder populate;
+	LatencyRecorder mixed;
+	replay(dataAccess, generator, generator.getPopulateOperations(), populate);
+	replay(dataAccess, generator, generator.getMixedOperations(), mixed);
+	TieredDataAccess::Stats stats = dataAccess.getStats();
+	dataAccess.close();
+	std::remove(BENCH_DB_FILE);
+
+	out << "    {\n      \"backend\": \"tiered\",\n      \"budget\": " << budget
+		<< ",\n      \"hit_ratio\": " << stats.getHitRatio() << ", \"hits\": " << stats.hits << ", \"misses\": " << stats.misses
+		<< ",\n      \"faulted_albums\": " << stats.faultedAlbums << ", \"evictions\": " << stats.evictions
+		<< ", \"evicted_albums\": " << stats.evictedAlbums << ", \"resident_albums\": " << stats.residentAlbums
+		<< ", \"resident_bytes\": " << stats.residentBytes << ",\n      \"populate\": ";
+	populate.writeJson(out, "      ");
+	out << ",\n      \"mixed\": ";
+	mixed.writeJson(out, "      ");
+	out << "\n    }";
+}
+
+static void runConcurrentBackend(int readers, const WorkloadGenerator& generator, std::ostream& out)
+{
+	ConcurrentMemoryAccess dataAccess;
+	LatencyRecorder populate;
+	LatencyRecorder mixed;
+
+	// one version for the whole population instead of one per call
+	dataAccess.update([&](VersionedMemoryAccess& data) {
+		replay(data, generator, generator.getPopulateOperations(), populate);
+	});
+
+	std::atomic<bool> done { false };
+	std::atomic<size_t> scans { 0 };
+	std::vector<std::thread> scanners;
+	for (int i = 0; i < readers; ++i) {
+		scanners.emplace_back([&]() {
+			while (!done) {
+				try {
+					dataAccess.getTopTaggedPicture();
+					dataAccess.getTopTaggedUser();
+				}
+				catch (const std::exception&) {
+					// nothing tagged yet
+				}
+				++scans;
+			}
+		});
+	}
+
+	replay(dataAccess, generator, generator.getMixedOperations(), mixed);
+	done = true;
+	for (auto& scanner : scanners) {
+		scanner.join();
+	}
+
+	out << "    {\n      \"backend\": \"concurrent\",\n      \"readers\": " << readers
+		<< ",\n      \"reader_scans\": " << scans << ",\n      \"versions\": " << dataAccess.getPublishedVersions()
+		<< ",\n      \"populate\": ";
+	populate.writeJson(out, "      ");
+	out << ",\n      \"mixed\": ";
+	mixed.writeJson(out, "      ");
+	out << "\n    }";
+}
+
+static void runShardedBackend(int shards, int writers, const WorkloadGenerator& generator, std::ostream& out)
+{
+	ShardedMemoryAccess dataAccess(shards);
+	LatencyRecorder populate;
+	LatencyRecorder mixed;
+
+	replay(dataAccess, generator, generator.getPopulateOperations(), populate);
+
+	const auto& operations = generator.getMixedOperations();
+	std::vector<LatencyRecorder> recorders(writers);
+	std::vector<std::thread> threads;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < writers; ++i) {
+		threads.emplace_back([&, i]() {
+			std::vector<Operation> share;
+			for (size_t op = i; op < operations.size(); op += writers) {
+				share.push_back(operations[op]);
+			}
+			replay(dataAccess, generator, share, recorders[i]);
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+
+	for (const auto& recorder : recorders) {
+		mixed.merge(recorder);
+	}
+
+	out << "    {\n      \"backend\": \"sharded\",\n      \"shards\": " << shards << ",\n      \"writers\": " << writers
+		<< ",\n      \"mixed_ops_per_sec\": " << operations.size() / wall.count() << ",\n      \"populate\": ";
+	populate.writeJson(out, "      ");
+	out << ",\n      \"mixed\": ";
+	mixed.writeJson(out, "      ");
+	out << "\n    }";
+}
+
+static int writeResults(const BenchOptions& options, const std::stringstream& json)
+{
+	if (options.outFile.empty()) {
+		std::cout << json.str();
+	}
+	else {
+		std::ofstream(options.outFile) << json.str();
+	}
+	return 0;
+}
+
+#define TAGSET_BENCH_PICTURES 20000
+#define TAGSET_BENCH_LOOKUPS 1000000
+
+// builds TAGSET_BENCH_PICTURES sets of tagsPerPicture random ids, then times copying and looking them up
+template <typename Set>
+static void measureTagSets(int tagsPerPicture, uint64_t seed, std::ostream& out)
+{
+	Rng rng(seed);
+	std::vector<Set> sets;
+	std::vector<int> taggedIds;
+	sets.reserve(TAGSET_BENCH_PICTURES);
+	taggedIds.reserve(TAGSET_BENCH_PICTURES);
+
+	auto before = AllocationCounter::now();
+	for (int i = 0; i < TAGSET_BENCH_PICTURES; ++i) {
+		Set set;
+		while (static_cast<int>(set.size()) < tagsPerPicture) {
+			int id = static_cast<int>(rng.next() % 100000);
+			if (set.find(id) == set.end()) {
+				set.insert(id);
+				taggedIds.push_back(id);
+			}
+		}
+		sets.push_back(std::move(set));
+	}
+	auto after = AllocationCounter::now();
+	double bytesPerSet = static_cast<double>(after.liveBytes - before.liveBytes) / TAGSET_BENCH_PICTURES + sizeof(Set);
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<Set> copies(sets);
+	std::chrono::duration<double, std::nano> copying = std::chrono::steady_clock::now() - start;
+
+	// half of the lookups hit: the last id tagged in each picture
+	std::vector<int> probes(TAGSET_BENCH_LOOKUPS);
+	for (int i = 0; i < TAGSET_BENCH_LOOKUPS; ++i) {
+		int picture = i % TAGSET_BENCH_PICTURES;
+		probes[i] = (i & 1) ? taggedIds[(picture + 1) * tagsPerPicture - 1] : static_cast<int>(rng.next() % 100000);
+	}
+
+	size_t found = 0;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < TAGSET_BENCH_LOOKUPS; ++i) {
+		const Set& set = sets[i % TAGSET_BENCH_PICTURES];
+		found += set.find(probes[i]) != set.end();
+	}
+	std::chrono::duration<double, std::nano> lookups = std::chrono::steady_clock::now() - start;
+
+	out << "{ \"bytes_per_picture\": " << bytesPerSet << ", \"copy_ns\": " << copying.count() / TAGSET_BENCH_PICTURES
+		<< ", \"lookup_ns\": " << lookups.count() / TAGSET_BENCH_LOOKUPS << ", \"found\": " << found << " }";
+}
+
+static void runTagSetBenchmark(uint64_t seed, std::ostream& out)
+{
+	out << "{\n  \"tagset\": [\n";
+
+	bool first = true;
+	for (int tags : { 1, 2, 4, 8, 32, 256 }) {
+		out << (first ? "" : ",\n") << "    { \"tags\": " << tags << ",\n      \"std_set\": ";
+		measureTagSets<std::set<int>>(tags, seed, out);
+		out << ",\n      \"tag_set\": ";
+		measureTagSets<TagSet>(tags, seed, out);
+		out << " }";
+		first = false;
+	}
+	out << "\n  ]\n}\n";
+}
+
+#define COLUMNS_BENCH_REPEATS 20
+
+// exposes the album list, so the bench can time the walk the columns replaced
+class ColumnsBenchAccess : public MemoryAccess
+{
+public:
+	using MemoryAccess::albums;
+};
+
+template <typename Function>
+static void timeRepeated(LatencyRecorder& recorder, const std::string& name, Function fn)
+{
+	for (int i = 0; i < COLUMNS_BENCH_REPEATS; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		fn();
+		recorder.record(name, std::chrono::steady_clock::now() - start);
+	}
+}
+
+static void runColumnsBenchmark(const WorkloadGenerator& generator, std::ostream& out)
+{
+	ColumnsBenchAccess dataAccess;
+	LatencyRecorder populate;
+	replay(dataAccess, generator, generator.getPopulateOperations(), populate);
+
+	LatencyRecorder scans;
+	volatile int sink = 0;
+
+	timeRepeated(scans, "top_tagged_picture_columns", [&]() {
+		sink = dataAccess.getTopTaggedPicture().getId();
+	});
+	timeRepeated(scans, "top_tagged_picture_walk", [&]() {
+		int currentMax = 0;
+		const Picture* mostTagged = nullptr;
+		for (const Album& album : dataAccess.albums()) {
+			album.forEachPicture([&](const Picture& picture) {
+				if (picture.getTagsCount() > currentMax) {
+					currentMax = picture.getTagsCount();
+					mostTagged = &picture;
+				}
+			});
+		}
+		sink = mostTagged == nullptr ? 0 : mostTagged->getId();
+	});
+
+	timeRepeated(scans, "album_aggregates_columns", [&]() {
+		sink = static_cast<int>(dataAccess.getAlbumsStatistics().size());
+	});
+	timeRepeated(scans, "album_aggregates_walk", [&]() {
+		int albums = 0;
+		for (const Album& album : dataAccess.albums()) {
+			int pictures = 0;
+			int tags = 0;
+			int maxTags = 0;
+			int64_t newest = INT64_MIN;
+			album.forEachPicture([&](const Picture& picture) {
+				++pictures;
+				tags += picture.getTagsCount();
+				maxTags = std::max(maxTags, picture.getTagsCount());
+				newest = std::max(newest, picture.getCreationTime());
+			});
+			albums += pictures + tags + maxTags > 0 || newest > 0;
+		}
+		sink = albums;
+	});
+
+	TagAdjacency adjacency;
+	timeRepeated(scans, "tag_adjacency_build", [&]() {
+		adjacency = dataAccess.buildTagAdjacency();
+	});
+	timeRepeated(scans, "count_tags_of_user_adjacency", [&]() {
+		sink = adjacency.countTagsOfUser(1);
+	});
+	timeRepeated(scans, "count_tags_of_user_index", [&]() {
+		sink = dataAccess.countTagsOfUser(User(1, ""));
+	});
+
+	out << "{\n  \"columns\": {\n    \"vectorized\": " << (PictureColumns::isVectorized() ? "true" : "false")
+		<< ",\n    \"pictures\": " << adjacency.offsets.size() - 1 << ",\n    \"tags\": " << adjacency.users.size()
+		<< ",\n    \"scans\": ";
+	scans.writeJson(out, "    ");
+	out << "\n  }\n}\n";
+}
+
+// sends the moved albums and pictures to the copying overloads, the ingest path before they existed
+class CopyingIngestAccess : public MemoryAccess
+{
+public:
+	using MemoryAccess::createAlbum;
+	using MemoryAccess::addPictureToAlbumByName;
+
+	void createAlbum(Album&& album) override
+	{
+		MemoryAccess::createAlbum(static_cast<const Album&>(album));
+	}
+
+	void addPictureToAlbumByName(const std::string& albumName, Picture&& picture) override
+	{
+		MemoryAccess::addPictureToAlbumByName(albumName, static_cast<const Picture&>(picture));
+	}
+};
+
+// the populate phase without a LatencyRecorder, whose samples would be counted as allocations too
+static void populate(IDataAccess& dataAccess, const WorkloadGenerator& generator)
+{
+	for (const auto& operation : generator.getPopulateOperations()) {
+		try {
+			generator.execute(dataAccess, operation);
+		}
+		catch (const std::exception&) {
+			// counted like replay() does
+		}
+	}
+}
+
+static void measureIngest(const std::string& path, MemoryAccess& dataAccess, const WorkloadGenerator& generator, std::ostream& out)
+{
+	const auto& operations = generator.getPopulateOperations();
+	size_t pictures = std::count_if(operations.begin(), operations.end(), [](const Operation& operation) {
+		return operation.type == OperationType::ADD_PICTURE;
+	});
+
+	auto before = AllocationCounter::now();
+	auto start = std::chrono::steady_clock::now();
+	populate(dataAccess, generator);
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	auto after = AllocationCounter::now();
+
+	size_t allocations = after.allocations - before.allocations;
+	size_t bytes = after.bytes - before.bytes;
+	out << "    { \"path\": \"" << path << "\", \"allocations\": " << allocations << ", \"bytes\": " << bytes
+		<< ", \"live_bytes\": " << after.liveBytes - before.liveBytes
+		<< ", \"allocations_per_picture\": " << static_cast<double>(allocations) / std::max<size_t>(pictures, 1)
+		<< ", \"bytes_per_picture\": " << static_cast<double>(bytes) / std::max<size_t>(pictures, 1)
+		<< ", \"ms\": " << elapsed.count() << " }";
+}
+
+static void runIngestBenchmark(const WorkloadGenerator& generator, std::ostream& out)
+{
+	// names and directories are interned by the first population, neither measured one pays for it
+	{
+		MemoryAccess warmUp;
+		populate(warmUp, generator);
+	}
+
+	out << "{\n  \"ingest\": [\n";
+	{
+		CopyingIngestAccess copying;
+		measureIngest("copy", copying, generator, out);
+	}
+	out << ",\n";
+	{
+		MemoryAccess moving;
+		measureIngest("move", moving, generator, out);
+	}
+	out << "\n  ]\n}\n";
+}
+
+static void runScalingBenchmark(const WorkloadGenerator& generator, int maxThreads, std::ostream& out)
+{
+	MemoryAccess dataAccess;
+	LatencyRecorder populate;
+	replay(dataAccess, generator, generator.getPopulateOperations(), populate);
+	TagAdjacency adjacency = dataAccess.buildTagAdjacency();
+
+	out << "{\n  \"scaling\": [";
+	for (int threads = 1; threads <= maxThreads; ++threads) {
+		ThreadPool pool(threads);
+		Parallelism parallelism;
+		parallelism.pool = &pool;
+		parallelism.threshold = 0;
+		dataAccess.setParallelism(parallelism);
+
+		LatencyRecorder scans;
+		volatile int sink = 0;
+		timeRepeated(scans, "top_tagged_picture", [&]() {
+			sink = dataAccess.getTopTaggedPicture().getId();
+		});
+		timeRepeated(scans, "top_tagged_user", [&]() {
+			sink = dataAccess.getTopTaggedUser().getId();
+		});
+		timeRepeated(scans, "album_aggregates", [&]() {
+			sink = static_cast<int>(dataAccess.getAlbumsStatistics().size());
+		});
+		timeRepeated(scans, "count_albums_tagged_of_user_adjacency", [&]() {
+			sink = adjacency.countAlbumsTaggedOfUser(1, parallelism);
+		});
+
+		out << (threads == 1 ? "\n" : ",\n") << "    { \"threads\": " << threads << ", \"scans\": ";
+		scans.writeJson(out, "      ");
+		out << " }";
+	}
+	out << "\n  ]\n}\n";
+}
+
+#define DUPLICATES_BENCH_CLUSTER 4		// copies of a picture, each a few bits away from the original
+#define DUPLICATES_BENCH_QUERIES 200
+
+static void runDuplicatesBenchmark(uint64_t seed, size_t count, std::ostream& out)
+{
+	std::mt19937_64 random(seed);
+	std::vector<uint64_t> hashes;
+	hashes.reserve(count);
+	while (hashes.size() < count) {
+		uint64_t original = random();
+		for (int copy = 0; copy < DUPLICATES_BENCH_CLUSTER && hashes.size() < count; ++copy) {
+			uint64_t hash = original;
+			for (int flips = static_cast<int>(random() % 5); flips > 0; --flips) {
+				hash ^= 1ull << (random() % 64);
+			}
+			hashes.push_back(hash);
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	PerceptualIndex index(hashes);
+	std::chrono::duration<double, std::milli> building = std::chrono::steady_clock::now() - start;
+
+	out << "{\n  \"duplicates\": { \"hashes\": " << count << ", \"vectorized_scan\": " << (PerceptualIndex::isVectorized() ? "true" : "false")
+		<< ", \"index_ms\": " << building.count() << ",\n    \"searches\": [";
+	bool first = true;
+	for (int radius : { 0, 3, PERCEPTUAL_DUPLICATE_DISTANCE, 10, 16 }) {
+		LatencyRecorder searches;
+		size_t found = 0;
+		for (int i = 0; i < DUPLICATES_BENCH_QUERIES; ++i) {
+			uint64_t query = hashes[random() % hashes.size()];
+			auto begin = std::chrono::steady_clock::now();
+			found += index.findWithin(query, radius).size();
+			searches.record("index", std::chrono::steady_clock::now() - begin);
+
+			std::vector<uint32_t> matches;
+			begin = std::chrono::steady_clock::now();
+			PerceptualIndex::scan(hashes.data(), hashes.size(), query, radius, matches);
+			searches.record("scan", std::chrono::steady_clock::now() - begin);
+		}
+		out << (first ? "\n" : ",\n") << "      { \"radius\": " << radius << ", \"found\": " << found << ", \"latency\": ";
+		searches.writeJson(out, "        ");
+		out << " }";
+		first = false;
+	}
+
+	start = std::chrono::steady_clock::now();
+	auto groups = index.findGroups(PERCEPTUAL_DUPLICATE_DISTANCE, Parallelism());
+	std::chrono::duration<double, std::milli> grouping = std::chrono::steady_clock::now() - start;
+	out << "\n    ],\n    \"groups\": " << groups.size() << ", \"group_ms\": " << grouping.count() << " }\n}\n";
+}
+
+#define THUMBNAILS_BENCH_WIDTH 1920
+#define THUMBNAILS_BENCH_HEIGHT 1080
+
+static void runThumbnailsBenchmark(uint64_t seed, int images, int threads, std::ostream& out)
+{
+	std::error_code error;
+	std::filesystem::remove_all(BENCH_THUMBNAILS_DIR, error);
+	std::filesystem::create_directories(std::string(BENCH_THUMBNAILS_DIR) + "/pictures", error);
+
+	// smooth gradients with noise, every picture different
+	std::mt19937_64 random(seed);
+	std::vector<std::string> paths;
+	Image sample;
+	for (int i = 0; i < images; ++i) {
+		Image image;
+		image.width = THUMBNAILS_BENCH_WIDTH;
+		image.height = THUMBNAILS_BENCH_HEIGHT;
+		image.pixels.resize(static_cast<size_t>(image.width) * image.height * 3);
+		uint64_t offset = random();
+		for (size_t p = 0; p < image.pixels.size(); ++p) {
+			image.pixels[p] = static_cast<uint8_t>((p / 3 % image.width + p / 3 / image.width + offset + (random() & 15)) & 0xFF);
+		}
+		paths.push_back(std::string(BENCH_THUMBNAILS_DIR) + "/pictures/" + std::to_string(i) + ".ppm");
+		std::ofstream file(paths.back(), std::ios::binary);
+		file << "P6\n" << image.width << " " << image.height << "\n255\n";
+		file.write(reinterpret_cast<const char*>(image.pixels.data()), static_cast<std::streamsize>(image.pixels.size()));
+		if (i == 0) {
+			sample = std::move(image);
+		}
+	}
+
+	LatencyRecorder downscales;
+	for (int i = 0; i < COLUMNS_BENCH_REPEATS; ++i) {
+		Image thumbnail;
+		auto start = std::chrono::steady_clock::now();
+		ThumbnailCache::downscale(sample, THUMBNAIL_EDGE, thumbnail);
+		downscales.record("downscale", std::chrono::steady_clock::now() - start);
+	}
+
+	// threads workers, the calling thread only waits
+	ThumbnailCache cache(std::string(BENCH_THUMBNAILS_DIR) + "/cache", THUMBNAIL_CACHE_BYTES, threads + 1);
+	// every path requested at once, prefetch would keep only the first THUMBNAIL_PREFETCH_LIMIT
+	auto start = std::chrono::steady_clock::now();
+	for (const std::string& path : paths) {
+		cache.request(path);
+	}
+	cache.wait();
+	std::chrono::duration<double, std::milli> cold = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	for (const std::string& path : paths) {
+		cache.request(path).get();
+	}
+	std::chrono::duration<double, std::milli> warm = std::chrono::steady_clock::now() - start;
+	ThumbnailCache::Stats stats = cache.getStats();
+
+	out << "{\n  \"thumbnails\": { \"images\": " << images << ", \"threads\": " << threads
+		<< ", \"vectorized_downscale\": " << (ThumbnailCache::isVectorized() ? "true" : "false")
+		<< ", \"cold_ms\": " << cold.count() << ", \"warm_ms\": " << warm.count()
+		<< ", \"decodes\": " << stats.decodes << ", \"hits\": " << stats.hits << ", \"cache_bytes\": " << stats.bytes << ",\n    \"latency\": ";
+	downscales.writeJson(out, "    ");
+	out << " }\n}\n";
+
+	std::filesystem::remove_all(BENCH_THUMBNAILS_DIR, error);
+}
+
+#define IMPORT_BENCH_BYTES (4 * 1024 * 1024)
+
+static void runImportBenchmark(uint64_t seed, int images, int threads, std::ostream& out)
+{
+	std::error_code error;
+	std::filesystem::remove_all(BENCH_IMPORT_DIR, error);
+	std::filesystem::create_directories(std::string(BENCH_IMPORT_DIR) + "/pictures", error);
+
+	std::mt19937_64 random(seed);
+	std::vector<std::string> paths;
+	std::vector<uint64_t> content(IMPORT_BENCH_BYTES / sizeof(uint64_t));
+	for (int i = 0; i < images; ++i) {
+		// every fourth file repeats the one before it
+		if (i % 4 != 3) {
+			for (uint64_t& word : content) {
+				word = random();
+			}
+		}
+		paths.push_back(std::string(BENCH_IMPORT_DIR) + "/pictures/" + std::to_string(i) + ".png");
+		std::ofstream file(paths.back(), std::ios::binary);
+		file.write(reinterpret_cast<const char*>(content.data()), IMPORT_BENCH_BYTES);
+	}
+
+	ThreadPool pool(threads);
+	out << "{\n  \"import\": { \"images\": " << images << ", \"megabytes\": " << images * (IMPORT_BENCH_BYTES >> 20) << ", \"runs\": [";
+	bool first = true;
+	for (int runThreads : { 1, threads }) {
+		std::filesystem::remove_all(std::string(BENCH_IMPORT_DIR) + "/store", error);
+		ContentStore store(std::string(BENCH_IMPORT_DIR) + "/store");
+		Parallelism parallelism;
+		parallelism.pool = &pool;
+		parallelism.threshold = runThreads == 1 ? paths.size() + 1 : 0;
+
+		ContentStore::ImportStats cold;
+		auto start = std::chrono::steady_clock::now();
+		store.import(paths, parallelism, cold);
+		std::chrono::duration<double, std::milli> coldTime = std::chrono::steady_clock::now() - start;
+
+		ContentStore::ImportStats warm;
+		start = std::chrono::steady_clock::now();
+		store.import(paths, parallelism, warm);
+		std::chrono::duration<double, std::milli> warmTime = std::chrono::steady_clock::now() - start;
+
+		out << (first ? "\n" : ",\n") << "    { \"threads\": " << runThreads << ", \"cold_ms\": " << coldTime.count()
+			<< ", \"hashed\": " << cold.hashed << ", \"copied\": " << cold.copied << ", \"again_ms\": " << warmTime.count()
+			<< ", \"again_hashed\": " << warm.hashed << " }";
+		first = false;
+	}
+	out << "\n  ] }\n}\n";
+
+	std::filesystem::remove_all(BENCH_IMPORT_DIR, error);
+}
+
+#define FUZZ_BINARY_MUTATIONS 64		// mutated copies of each encoded gallery
+#define FUZZ_BINARY_TRUNCATED_BYTES 512	// payloads up to this size are cut at every length
+
+struct BinaryFuzzStats
+{
+	size_t buffers { 0 };
+	size_t records { 0 };		// decoded without an error
+	size_t rejected { 0 };		// MyException, as malformed input must
+	size_t failures { 0 };
+};
+
+// letters, and now and then any byte
+static std::string makeFuzzString(Rng& rng, int maxLength)
+{
+	std::string text(static_cast<size_t>(rng.nextInt(maxLength + 1)), 'a');
+	bool binary = rng.nextInt(5) == 0;
+	for (char& c : text) {
+		c = binary ? static_cast<char>(rng.next()) : static_cast<char>('a' + rng.nextInt(26));
+	}
+	return text;
+}
+
+static Picture makeFuzzPicture(Rng& rng)
+{
+	std::string path = rng.nextInt(3) == 0 ? makeFuzzString(rng, 8)
+		: "C:\\" + makeFuzzString(rng, 5) + "\\" + makeFuzzString(rng, 6) + ".bmp";
+	std::string date = rng.nextInt(4) == 0 ? makeFuzzString(rng, 20) : Timestamp::format(rng.nextInt(2000000000));
+	Picture picture(static_cast<int>(rng.next()), makeFuzzString(rng, 12), path, date);
+	picture.setAlbumId(static_cast<int>(rng.next()));
+
+	int tags = rng.nextInt(4) == 0 ? rng.nextInt(300) : rng.nextInt(6);
+	for (int i = 0; i < tags; ++i) {
+		picture.tagUser(rng.nextInt(2000) - 1000);
+	}
+	return picture;
+}
+
+static Album makeFuzzAlbum(Rng& rng)
+{
+	Album album(static_cast<int>(rng.next()), makeFuzzString(rng, 10), Timestamp::format(rng.nextInt(2000000000)));
+	album.setId(static_cast<int>(rng.next()));
+
+	int pictures = rng.nextInt(3) == 0 ? rng.nextInt(100) : rng.nextInt(5);
+	for (int i = 0; i < pictures; ++i) {
+		album.addPicture(makeFuzzPicture(rng));
+	}
+	return album;
+}
+
+// the getters of a view against the object it builds, false on any difference
+static bool checkPictureView(const PictureView& view)
+{
+	Picture picture = view.toPicture();
+	if (view.getId() != picture.getId() || view.getAlbumId() != picture.getAlbumId() || view.getName() != picture.getName()
+		|| view.getPath() != picture.getPath() || view.getCreationDate() != picture.getCreationDate()
+		|| view.getTagsCount() != picture.getTagsCount()) {
+		return false;
+	}
+
+	int index = 0;
+	for (int userId : picture.getUserTags()) {
+		if (view.getTag(index++) != userId || !view.isUserTagged(userId)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool checkAlbumView(const AlbumView& view)
+{
+	Album album = view.toAlbum();
+	if (view.getId() != album.getId() || view.getOwnerId() != album.getOwnerId() || view.getName() != album.getName()
+		|| view.getCreationDate() != album.getCreationDate() || view.getPicturesCount() != static_cast<int>(album.pictures().size())) {
+		return false;
+	}
+
+	bool same = true;
+	view.forEachPicture([&same](const PictureView& picture) {
+		same = same && checkPictureView(picture);
+	});
+	return same;
+}
+
+/**
+ * decodeFuzzBuffer - Decodes every record of a buffer through the views and the to* functions.
+ * Params: bytes - a whole stream, possibly malformed; stats - counters to add to
+ * Returns: true if every record decoded, false if the input was rejected (or a failure counted).
+ */
+static bool decodeFuzzBuffer(const std::string& bytes, BinaryFuzzStats& stats)
+{
+	++stats.buffers;
+	try {
+		BinaryReader reader(bytes.data(), bytes.size());
+		bool valid = true;
+		while (reader.next()) {
+			// a malformed record does not stop the ones after it
+			try {
+				bool same = true;
+				switch (reader.getKind()) {
+				case BinaryKind::USER: {
+					UserView view = reader.getUser();
+					same = view.toUser().getName() == view.getName();
+					break;
+				}
+				case BinaryKind::PICTURE:
+					same = checkPictureView(reader.getPicture());
+					break;
+				case BinaryKind::ALBUM:
+					same = checkAlbumView(reader.getAlbum());
+					break;
+				default:
+					throw MyException("Unknown binary record");
+				}
+
+				if (!same) {
+					++stats.failures;
+					valid = false;
+				}
+				else {
+					++stats.records;
+				}
+			}
+			catch (const MyException&) {
+				++stats.rejected;
+				valid = false;
+			}
+		}
+		return valid;
+	}
+	catch (const MyException&) {
+		++stats.rejected;
+	}
+	catch (const std::exception&) {
+		++stats.failures;
+	}
+	return false;
+}
+
+// every cut of a payload is missing bytes its lengths and counts promise, so each must throw
+template <typename View>
+static void truncateFuzzPayload(const std::string& payload, BinaryFuzzStats& stats)
+{
+	size_t step = payload.size() <= FUZZ_BINARY_TRUNCATED_BYTES ? 1 : payload.size() / FUZZ_BINARY_TRUNCATED_BYTES + 1;
+	for (size_t size = 0; size < payload.size(); size += step) {
+		++stats.buffers;
+		try {
+			View view(payload.data(), size);
+			++stats.failures;
+		}
+		catch (const MyException&) {
+			++stats.rejected;
+		}
+		catch (const std::exception&) {
+			++stats.failures;
+		}
+	}
+}
+
+static std::string mutateFuzzBuffer(Rng& rng, std::string bytes)
+{
+	size_t at = bytes.empty() ? 0 : static_cast<size_t>(rng.next() % bytes.size());
+	switch (rng.nextInt(6)) {
+	case 0:		// truncated
+		bytes.resize(at);
+		break;
+	case 1:		// a few bits flipped
+		for (int flips = rng.nextInt(4) + 1; flips > 0 && !bytes.empty(); --flips) {
+			bytes[static_cast<size_t>(rng.next() % bytes.size())] ^= static_cast<char>(1 << rng.nextInt(8));
+		}
+		break;
+	case 2: {	// a length or count overwritten with a large, small or random value
+		static const uint32_t values[] = { 0, 1, 0x7FFFFFFF, 0xFFFFFFFF };
+		uint32_t value = rng.nextInt(2) == 0 ? values[rng.nextInt(4)] : static_cast<uint32_t>(rng.next());
+		for (int i = 0; i < 4 && at + i < bytes.size(); ++i) {
+			bytes[at + i] = static_cast<char>(value >> (8 * i));
+		}
+		break;
+	}
+	case 3: {	// a slice copied over another place
+		size_t from = bytes.empty() ? 0 : static_cast<size_t>(rng.next() % bytes.size());
+		size_t length = std::min<size_t>(rng.nextInt(64) + 1, bytes.size() - std::max(from, at));
+		std::copy_n(bytes.begin() + from, length, bytes.begin() + at);
+		break;
+	}
+	case 4:		// random bytes inserted
+		bytes.insert(at, makeFuzzString(rng, 16));
+		break;
+	default:	// a range erased
+		bytes.erase(at, static_cast<size_t>(rng.nextInt(32) + 1));
+		break;
+	}
+	return bytes;
+}
+
+static int runBinaryFuzz(uint64_t seed, int rounds, std::ostream& out)
+{
+	Rng rng(seed);
+	BinaryFuzzStats stats;
+	size_t roundTrips = 0;
+
+	for (int round = 0; round < rounds; ++round) {
+		std::string encoded;
+		{
+			BinaryWriter writer([&encoded](const char* data, size_t size) { encoded.append(data, size); });
+			for (int i = rng.nextInt(8); i > 0; --i) {
+				switch (rng.nextInt(3)) {
+				case 0:
+					writer.write(User(static_cast<int>(rng.next()), makeFuzzString(rng, 12)));
+					break;
+				case 1: {
+					Picture picture = makeFuzzPicture(rng);
+					std::string payload;
+					BinaryWriter::encode(picture, payload);
+					truncateFuzzPayload<PictureView>(payload, stats);
+					writer.write(picture);
+					break;
+				}
+				default: {
+					Album album = makeFuzzAlbum(rng);
+					std::string payload;
+					BinaryWriter::encode(album, payload);
+					truncateFuzzPayload<AlbumView>(payload, stats);
+					writer.write(album);
+					break;
+				}
+				}
+			}
+		}
+
+		// the stream as written decodes in full
+		if (decodeFuzzBuffer(encoded, stats)) {
+			++roundTrips;
+		}
+		else {
+			++stats.failures;
+		}
+
+		for (int i = 0; i < FUZZ_BINARY_MUTATIONS; ++i) {
+			std::string mutated = mutateFuzzBuffer(rng, encoded);
+			// a few mutations in a row, so errors behind the first one are reached too
+			for (int more = rng.nextInt(3); more > 0; --more) {
+				mutated = mutateFuzzBuffer(rng, mutated);
+			}
+			decodeFuzzBuffer(mutated, stats);
+		}
+	}
+
+	out << "{\n  \"fuzz_binary\": { \"seed\": " << seed << ", \"rounds\": " << rounds << ", \"round_trips\": " << roundTrips
+		<< ", \"buffers\": " << stats.buffers << ", \"records\": " << stats.records << ", \"rejected\": " << stats.rejected
+		<< ", \"failures\": " << stats.failures << " }\n}\n";
+	return stats.failures == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+	try {
+		options = parseArguments(argc, argv);
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	std::stringstream json;
+	if (options.mode == "tagset") {
+		runTagSetBenchmark(options.workload.seed, json);
+		return writeResults(options, json);
+	}
+
+	if (options.mode == "fuzz-binary") {
+		int failed = runBinaryFuzz(options.workload.seed, options.rounds, json);
+		writeResults(options, json);
+		return failed;
+	}
+
+	if (options.mode == "import") {
+		runImportBenchmark(options.workload.seed, options.images, options.threads, json);
+		return writeResults(options, json);
+	}
+	if (options.mode == "thumbnails") {
+		runThumbnailsBenchmark(options.workload.seed, options.images, options.threads, json);
+		return writeResults(options, json);
+	}
+	if (options.mode == "duplicates") {
+		runDuplicatesBenchmark(options.workload.seed, options.hashes, json);
+		return writeResults(options, json);
+	}
+
+	WorkloadGenerator generator(options.workload);
+	if (options.mode == "columns") {
+		runColumnsBenchmark(generator, json);
+		return writeResults(options, json);
+	}
+	if (options.mode == "scaling") {
+		runScalingBenchmark(generator, options.threads, json);
+		return writeResults(options, json);
+	}
+	if (options.mode == "ingest") {
+		runIngestBenchmark(generator, json);
+		return writeResults(options, json);
+	}
+	const WorkloadConfig& config = options.workload;
+
+	json << "{\n  \"config\": { \"seed\": " << config.seed << ", \"users\": " << config.users
+		<< ", \"albums_per_user\": " << config.albumsPerUser << ", \"pictures_per_album\": " << config.picturesPerAlbum
+		<< ", \"tags\": " << config.tags << ", \"zipf\": " << config.zipfExponent << ", \"operations\": " << config.operations
+		<< " },\n  \"results\": [\n";
+
+	bool first = true;
+	if (options.backend == "memory" || options.backend == "both") {
+		// no open(): the dummy users it creates would collide with the generated ids
+		MemoryAccess memoryAccess;
+		runBackend("memory", memoryAccess, generator, json);
+		first = false;
+	}
+	if (options.backend == "durable") {
+		removeDurableFiles();
+		DurabilityOptions durability;
+		durability.basePath = BENCH_DURABLE_BASE;
+		DurableMemoryAccess durableAccess(durability);
+		durableAccess.open();
+		json << (first ? "" : ",\n");
+		runBackend("durable", durableAccess, generator, json);
+		durableAccess.close();
+		removeDurableFiles();
+		first = false;
+	}
+	if (options.backend == "sharded") {
+		json << (first ? "" : ",\n");
+		runShardedBackend(options.shards, options.writers, generator, json);
+		first = false;
+	}
+	if (options.backend == "concurrent") {
+		json << (first ? "" : ",\n");
+		runConcurrentBackend(options.readers, generator, json);
+		first = false;
+	}
+	if (options.backend == "tiered") {
+		json << (first ? "" : ",\n");
+		runTieredBackend(options.budget, generator, json);
+		first = false;
+	}
+	if (options.backend == "database" || options.backend == "both") {
+		std::remove(BENCH_DB_FILE);
+		DatabaseAccess databaseAccess(BENCH_DB_FILE);
+		databaseAccess.open();
+		json << (first ? "" : ",\n");
+		runBackend("database", databaseAccess, generator, json);
+		databaseAccess.close();
+		std::remove(BENCH_DB_FILE);
+	}
+	json << "\n  ]\n}\n";
+
+	return writeResults(options, json);
+}
@@ -1,6 +1,10 @@
 #pragma once
+#include <functional>
 #include <list>
+#include <vector>
 #include "Album.h"
+#include "FileMetadata.h"
+#include "ListingOrder.h"
 #include "User.h"
 
 class IDataAccess
@@ -12,18 +16,138 @@ public:
 	virtual const std::list<Album> getAlbums() = 0;
 	virtual const std::list<Album> getAlbumsOfUser(const User& user) = 0;
 	virtual void createAlbum(const Album& album) = 0;
+	// takes the album over instead of copying it; backends that store objects override it,
+	// the default copies like the overload above
+	virtual void createAlbum(Album&& album)
+	{
+		createAlbum(static_cast<const Album&>(album));
+	}
 	virtual void deleteAlbum(const std::string& albumName, int userId) = 0;
 	virtual bool doesAlbumExists(const std::string& albumName, int userId) = 0;
 	virtual Album openAlbum(const std::string& albumName) = 0;
 	virtual void closeAlbum(Album& pAlbum) = 0;
 	virtual void printAlbums() = 0;
 
+	// read access without copies: the album or picture handed to fn is only valid during the call
+	// and fn must not change the data access. Backends that keep their data in memory pass their
+	// own objects, the defaults below go through the copying getters.
+	virtual void forEachAlbum(const std::function<void(const Album&)>& fn)
+	{
+		for (const Album& album : getAlbums()) {
+			fn(album);
+		}
+	}
+
+	virtual void forEachAlbumOfUser(const User& user, const std::function<void(const Album&)>& fn)
+	{
+		for (const Album& album : getAlbumsOfUser(user)) {
+			fn(album);
+		}
+	}
+
+	// every picture of every album (of one user), with its tags, in album order; fn also gets the
+	// album, which may come without its pictures. Unlike the album visitors these reach the
+	// pictures on every backend, the defaults walk the pictures the album visitors hand out
+	virtual void forEachPicture(const std::function<void(const Album&, const Picture&)>& fn)
+	{
+		forEachAlbum([&fn](const Album& album) {
+			album.forEachPicture([&fn, &album](const Picture& picture) {
+				fn(album, picture);
+			});
+		});
+	}
+
+	virtual void forEachPictureOfUser(const User& user, const std::function<void(const Album&, const Picture&)>& fn)
+	{
+		forEachAlbumOfUser(user, [&fn](const Album& album) {
+			album.forEachPicture([&fn, &album](const Picture& picture) {
+				fn(album, picture);
+			});
+		});
+	}
+
+	// returns false (fn is not called) when the album has no such picture
+	virtual bool visitPicture(const std::string& albumName, const std::string& pictureName, const std::function<void(const Picture&)>& fn)
+	{
+		if (!doesPictureExistsInAlbum(albumName, pictureName)) {
+			return false;
+		}
+		fn(getPictureFromAlbum(albumName, pictureName));
+		return true;
+	}
+
+	// ordered listings, see ListingOrder. Backends with an index on the order override these,
+	// the defaults sort the copying getters' results
+	virtual std::list<Album> getAlbumsSorted(const ListingOrder& order)
+	{
+		const std::list<Album> albums = getAlbums();
+		std::vector<const Album*> ordered;
+		for (const Album& album : albums) {
+			ordered.push_back(&album);
+		}
+		order.apply(ordered);
+
+		std::list<Album> sorted;
+		for (const Album* album : ordered) {
+			sorted.push_back(*album);
+		}
+		return sorted;
+	}
+
+	// the pictures of the album openAlbum(albumName) returns
+	virtual std::list<Picture> getPicturesSorted(const std::string& albumName, const ListingOrder& order)
+	{
+		const Album album = openAlbum(albumName);
+		std::vector<const Picture*> ordered;
+		album.forEachPicture([&ordered](const Picture& picture) {
+			ordered.push_back(&picture);
+		});
+		order.apply(ordered);
+
+		std::list<Picture> sorted;
+		for (const Picture* picture : ordered) {
+			sorted.push_back(*picture);
+		}
+		return sorted;
+	}
+
     // picture related
 	virtual void addPictureToAlbumByName(const std::string& albumName, const Picture& picture) = 0;
+	virtual void addPictureToAlbumByName(const std::string& albumName, Picture&& picture)
+	{
+		addPictureToAlbumByName(albumName, static_cast<const Picture&>(picture));
+	}
 	virtual void removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName) = 0;
 	virtual void tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) = 0;
 	virtual void untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) = 0;
 
+	// metadata of picture files, keyed by path (see FileMetadata). Listings read it instead of
+	// the file system; backends that keep none find nothing and drop what they are given
+	virtual bool getFileMetadata(const std::string& /*path*/, FileMetadata& /*metadata*/)
+	{
+		return false;
+	}
+	// the records of many files at once (e.g. the pictures of a listed album), fn gets the ones
+	// that exist in no order; backends that pay per lookup fetch them together
+	virtual void getFilesMetadata(const std::vector<std::string>& paths, const std::function<void(const FileMetadata&)>& fn)
+	{
+		FileMetadata metadata;
+		for (const std::string& path : paths) {
+			if (getFileMetadata(path, metadata)) {
+				fn(metadata);
+			}
+		}
+	}
+	virtual void storeFileMetadata(const std::vector<FileMetadata>& /*files*/)
+	{
+		// Left empty
+	}
+	// every stored record, in no order; fn must not change the data access
+	virtual void forEachFileMetadata(const std::function<void(const FileMetadata&)>& /*fn*/)
+	{
+		// Left empty
+	}
+
 	// user related
 	virtual void printUsers() =0;
 	virtual User getUser(int userId) = 0;
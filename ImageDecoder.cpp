@@ -0,0 +1,715 @@
+#include "ImageDecoder.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#define INFLATE_MAX_BITS 15
+#define INFLATE_LENGTH_CODES 286
+#define INFLATE_DISTANCE_CODES 30
+#define INFLATE_FIXED_LENGTH_CODES 288
+
+// ******************* Inflate *******************
+// RFC 1950 / 1951, decoded a code bit at a time over canonical Huffman tables
+
+struct InflateBits
+{
+	const uint8_t* data;
+	size_t size;
+	size_t position { 0 };
+	uint32_t buffer { 0 };
+	int count { 0 };
+	bool overrun { false };
+
+	int get(int need)
+	{
+		uint32_t value = buffer;
+		while (count < need) {
+			if (position >= size) {
+				overrun = true;
+				return 0;
+			}
+			value |= static_cast<uint32_t>(data[position++]) << count;
+			count += 8;
+		}
+		buffer = value >> need;
+		count -= need;
+		return static_cast<int>(value & ((1u << need) - 1));
+	}
+};
+
+struct InflateTable
+{
+	int16_t counts[INFLATE_MAX_BITS + 1];
+	int16_t symbols[INFLATE_FIXED_LENGTH_CODES];
+};
+
+/**
+ * buildTable - Builds the canonical Huffman table of a list of code lengths.
+ * Params: table - receives the table; lengths, count - the code length of every symbol
+ * Returns: false when the lengths over-subscribe the code space.
+ */
+static bool buildTable(InflateTable& table, const uint8_t* lengths, int count)
+{
+	std::memset(table.counts, 0, sizeof(table.counts));
+	for (int symbol = 0; symbol < count; ++symbol) {
+		++table.counts[lengths[symbol]];
+	}
+
+	int left = 1;
+	for (int length = 1; length <= INFLATE_MAX_BITS; ++length) {
+		left <<= 1;
+		left -= table.counts[length];
+		if (left < 0) {
+			return false;
+		}
+	}
+
+	int16_t offsets[INFLATE_MAX_BITS + 1];
+	offsets[1] = 0;
+	for (int length = 1; length < INFLATE_MAX_BITS; ++length) {
+		offsets[length + 1] = offsets[length] + table.counts[length];
+	}
+	for (int symbol = 0; symbol < count; ++symbol) {
+		if (lengths[symbol] != 0) {
+			table.symbols[offsets[lengths[symbol]]++] = static_cast<int16_t>(symbol);
+		}
+	}
+	return true;
+}
+
+static int decodeSymbol(InflateBits& bits, const InflateTable& table)
+{
+	int code = 0;
+	int first = 0;
+	int index = 0;
+	for (int length = 1; length <= INFLATE_MAX_BITS; ++length) {
+		code |= bits.get(1);
+		int count = table.counts[length];
+		if (code - count < first) {
+			return table.symbols[index + (code - first)];
+		}
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+	return -1;
+}
+
+/**
+ * inflateCodes - Decodes the literals and matches of one compressed block.
+ * Params: bits - the stream; lengths, distances - the block's tables; out - receives the bytes;
+ *         limit - the most bytes out may hold
+ * Returns: false for a corrupt or truncated block, or one that would pass the limit.
+ */
+static bool inflateCodes(InflateBits& bits, const InflateTable& lengths, const InflateTable& distances, std::vector<uint8_t>& out, size_t limit)
+{
+	static const int16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static const int16_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static const int16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	static const int16_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	while (true) {
+		int symbol = decodeSymbol(bits, lengths);
+		if (symbol < 0 || bits.overrun) {
+			return false;
+		}
+		if (symbol < 256) {
+			if (out.size() >= limit) {
+				return false;
+			}
+			out.push_back(static_cast<uint8_t>(symbol));
+			continue;
+		}
+		if (symbol == 256) {
+			return true;
+		}
+
+		symbol -= 257;
+		if (symbol >= 29) {
+			return false;
+		}
+		size_t length = lengthBase[symbol] + bits.get(lengthExtra[symbol]);
+		int distanceSymbol = decodeSymbol(bits, distances);
+		if (distanceSymbol < 0 || distanceSymbol >= 30) {
+			return false;
+		}
+		size_t distance = distanceBase[distanceSymbol] + bits.get(distanceExtra[distanceSymbol]);
+		if (bits.overrun || distance > out.size() || length > limit - out.size()) {
+			return false;
+		}
+		// byte by byte, a match may overlap the bytes it produces
+		size_t from = out.size() - distance;
+		for (size_t i = 0; i < length; ++i) {
+			out.push_back(out[from + i]);
+		}
+	}
+}
+
+static bool inflateStored(InflateBits& bits, std::vector<uint8_t>& out, size_t limit)
+{
+	// stored blocks start on a byte boundary
+	bits.buffer = 0;
+	bits.count = 0;
+	if (bits.size - bits.position < 4) {
+		return false;
+	}
+	const uint8_t* header = bits.data + bits.position;
+	size_t length = header[0] | (header[1] << 8);
+	size_t complement = header[2] | (header[3] << 8);
+	bits.position += 4;
+	if (length != (~complement & 0xFFFF) || length > bits.size - bits.position || length > limit - out.size()) {
+		return false;
+	}
+	out.insert(out.end(), bits.data + bits.position, bits.data + bits.position + length);
+	bits.position += length;
+	return true;
+}
+
+static bool inflateFixed(InflateBits& bits, std::vector<uint8_t>& out, size_t limit)
+{
+	static InflateTable lengths;
+	static InflateTable distances;
+	static const bool built = []() {
+		uint8_t codeLengths[INFLATE_FIXED_LENGTH_CODES];
+		int symbol = 0;
+		for (; symbol < 144; ++symbol) {
+			codeLengths[symbol] = 8;
+		}
+		for (; symbol < 256; ++symbol) {
+			codeLengths[symbol] = 9;
+		}
+		for (; symbol < 280; ++symbol) {
+			codeLengths[symbol] = 7;
+		}
+		for (; symbol < INFLATE_FIXED_LENGTH_CODES; ++symbol) {
+			codeLengths[symbol] = 8;
+		}
+		buildTable(lengths, codeLengths, INFLATE_FIXED_LENGTH_CODES);
+		std::memset(codeLengths, 5, INFLATE_DISTANCE_CODES);
+		buildTable(distances, codeLengths, INFLATE_DISTANCE_CODES);
+		return true;
+	}();
+	(void)built;
+
+	return inflateCodes(bits, lengths, distances, out, limit);
+}
+
+static bool inflateDynamic(InflateBits& bits, std::vector<uint8_t>& out, size_t limit)
+{
+	static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	int lengthsCount = bits.get(5) + 257;
+	int distancesCount = bits.get(5) + 1;
+	int codesCount = bits.get(4) + 4;
+	if (bits.overrun || lengthsCount > INFLATE_LENGTH_CODES || distancesCount > INFLATE_DISTANCE_CODES) {
+		return false;
+	}
+
+	uint8_t codeLengths[INFLATE_LENGTH_CODES + INFLATE_DISTANCE_CODES] = { 0 };
+	for (int i = 0; i < codesCount; ++i) {
+		codeLengths[order[i]] = static_cast<uint8_t>(bits.get(3));
+	}
+	InflateTable codes;
+	if (!buildTable(codes, codeLengths, 19)) {
+		return false;
+	}
+
+	// the code lengths of both tables, run length coded
+	std::memset(codeLengths, 0, sizeof(codeLengths));
+	int index = 0;
+	while (index < lengthsCount + distancesCount) {
+		int symbol = decodeSymbol(bits, codes);
+		if (symbol < 0 || bits.overrun) {
+			return false;
+		}
+		if (symbol < 16) {
+			codeLengths[index++] = static_cast<uint8_t>(symbol);
+			continue;
+		}
+
+		uint8_t repeated = 0;
+		int times = 0;
+		if (symbol == 16) {
+			if (index == 0) {
+				return false;
+			}
+			repeated = codeLengths[index - 1];
+			times = 3 + bits.get(2);
+		}
+		else if (symbol == 17) {
+			times = 3 + bits.get(3);
+		}
+		else {
+			times = 11 + bits.get(7);
+		}
+		if (index + times > lengthsCount + distancesCount) {
+			return false;
+		}
+		while (times-- > 0) {
+			codeLengths[index++] = repeated;
+		}
+	}
+	if (codeLengths[256] == 0) {
+		return false;	// no end of block code
+	}
+
+	InflateTable lengths;
+	InflateTable distances;
+	if (!buildTable(lengths, codeLengths, lengthsCount) || !buildTable(distances, codeLengths + lengthsCount, distancesCount)) {
+		return false;
+	}
+	return inflateCodes(bits, lengths, distances, out, limit);
+}
+
+/**
+ * inflateZlib - Decompresses a zlib stream (RFC 1950) and checks its Adler-32.
+ * Params: data, size - the stream; out - receives the bytes; limit - the most bytes to accept
+ * Returns: false for a corrupt, truncated or too large stream.
+ */
+static bool inflateZlib(const uint8_t* data, size_t size, std::vector<uint8_t>& out, size_t limit)
+{
+	// compression method 8 (deflate), no preset dictionary
+	if (size < 6 || (data[0] & 0x0F) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20) != 0) {
+		return false;
+	}
+
+	InflateBits bits { data, size - 4 };
+	bits.position = 2;
+	bool last = false;
+	while (!last) {
+		last = bits.get(1) == 1;
+		int type = bits.get(2);
+		if (bits.overrun) {
+			return false;
+		}
+
+		bool decoded = false;
+		switch (type) {
+		case 0:
+			decoded = inflateStored(bits, out, limit);
+			break;
+		case 1:
+			decoded = inflateFixed(bits, out, limit);
+			break;
+		case 2:
+			decoded = inflateDynamic(bits, out, limit);
+			break;
+		default:
+			break;
+		}
+		if (!decoded) {
+			return false;
+		}
+	}
+
+	uint32_t a = 1;
+	uint32_t b = 0;
+	for (uint8_t byte : out) {
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	const uint8_t* checksum = data + size - 4;
+	uint32_t expected = (static_cast<uint32_t>(checksum[0]) << 24) | (checksum[1] << 16) | (checksum[2] << 8) | checksum[3];
+	return ((b << 16) | a) == expected;
+}
+
+// ******************* Formats *******************
+
+static uint32_t readBigEndian32(const uint8_t* bytes)
+{
+	return (static_cast<uint32_t>(bytes[0]) << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+}
+
+static uint32_t readLittleEndian32(const uint8_t* bytes)
+{
+	return (static_cast<uint32_t>(bytes[3]) << 24) | (bytes[2] << 16) | (bytes[1] << 8) | bytes[0];
+}
+
+static bool allocate(Image& image, int64_t width, int64_t height)
+{
+	if (width <= 0 || height <= 0 || width > IMAGE_MAX_PIXELS || height > IMAGE_MAX_PIXELS || width * height > IMAGE_MAX_PIXELS) {
+		return false;
+	}
+	image.width = static_cast<int>(width);
+	image.height = static_cast<int>(height);
+	image.pixels.assign(static_cast<size_t>(width * height) * 3, 0);
+	return true;
+}
+
+static int paeth(int left, int up, int upLeft)
+{
+	int estimate = left + up - upLeft;
+	int toLeft = std::abs(estimate - left);
+	int toUp = std::abs(estimate - up);
+	int toUpLeft = std::abs(estimate - upLeft);
+	if (toLeft <= toUp && toLeft <= toUpLeft) {
+		return left;
+	}
+	return toUp <= toUpLeft ? up : upLeft;
+}
+
+/**
+ * decodePng - Decodes a PNG file: IHDR, PLTE and the IDAT stream, unfiltered row by row.
+ * Params: data, size - the file; image - receives the pixels
+ * Returns: false for unsupported (interlaced) or malformed files.
+ */
+static bool decodePng(const uint8_t* data, size_t size, Image& image)
+{
+	size_t position = 8;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	int depth = 0;
+	int colorType = -1;
+	uint8_t palette[256 * 3] = { 0 };
+	size_t paletteSize = 0;
+	std::vector<uint8_t> compressed;
+
+	// [u32 length][4 type][data][u32 crc]
+	while (position + 12 <= size) {
+		uint32_t length = readBigEndian32(data + position);
+		const uint8_t* type = data + position + 4;
+		const uint8_t* chunk = data + position + 8;
+		if (length > size - position - 12) {
+			return false;
+		}
+
+		if (std::memcmp(type, "IHDR", 4) == 0) {
+			if (length < 13 || chunk[10] != 0 || chunk[11] != 0 || chunk[12] != 0) {
+				return false;	// another compression or filter method, or interlaced
+			}
+			width = readBigEndian32(chunk);
+			height = readBigEndian32(chunk + 4);
+			depth = chunk[8];
+			colorType = chunk[9];
+		}
+		else if (std::memcmp(type, "PLTE", 4) == 0) {
+			paletteSize = std::min<size_t>(length / 3, 256);
+			std::memcpy(palette, chunk, paletteSize * 3);
+		}
+		else if (std::memcmp(type, "IDAT", 4) == 0) {
+			compressed.insert(compressed.end(), chunk, chunk + length);
+		}
+		else if (std::memcmp(type, "IEND", 4) == 0) {
+			break;
+		}
+		position += 12 + length;
+	}
+
+	int channels = 0;
+	switch (colorType) {
+	case 0:
+	case 3:
+		channels = 1;
+		break;
+	case 2:
+		channels = 3;
+		break;
+	case 4:
+		channels = 2;
+		break;
+	case 6:
+		channels = 4;
+		break;
+	default:
+		return false;
+	}
+	bool validDepth = depth == 8 || depth == 16 || (depth < 8 && (colorType == 0 || colorType == 3) && (depth == 1 || depth == 2 || depth == 4));
+	if (!validDepth || (colorType == 3 && (depth == 16 || paletteSize == 0)) || width > INT32_MAX || height > INT32_MAX) {
+		return false;
+	}
+	if (!allocate(image, width, height)) {
+		return false;
+	}
+
+	size_t bitsPerPixel = static_cast<size_t>(channels) * depth;
+	size_t stride = (width * bitsPerPixel + 7) / 8;
+	size_t filterBytes = std::max<size_t>(1, bitsPerPixel / 8);
+	std::vector<uint8_t> raw;
+	raw.reserve((stride + 1) * height);
+	if (!inflateZlib(compressed.data(), compressed.size(), raw, (stride + 1) * height) || raw.size() != (stride + 1) * height) {
+		return false;
+	}
+
+	std::vector<uint8_t> previous(stride, 0);
+	for (uint32_t y = 0; y < height; ++y) {
+		uint8_t* row = raw.data() + y * (stride + 1) + 1;
+		uint8_t filter = row[-1];
+		for (size_t i = 0; i < stride; ++i) {
+			int left = i >= filterBytes ? row[i - filterBytes] : 0;
+			int up = previous[i];
+			int upLeft = i >= filterBytes ? previous[i - filterBytes] : 0;
+			switch (filter) {
+			case 0:
+				break;
+			case 1:
+				row[i] = static_cast<uint8_t>(row[i] + left);
+				break;
+			case 2:
+				row[i] = static_cast<uint8_t>(row[i] + up);
+				break;
+			case 3:
+				row[i] = static_cast<uint8_t>(row[i] + ((left + up) >> 1));
+				break;
+			case 4:
+				row[i] = static_cast<uint8_t>(row[i] + paeth(left, up, upLeft));
+				break;
+			default:
+				return false;
+			}
+		}
+		std::memcpy(previous.data(), row, stride);
+
+		uint8_t* pixel = image.pixels.data() + static_cast<size_t>(y) * width * 3;
+		for (uint32_t x = 0; x < width; ++x, pixel += 3) {
+			if (depth < 8) {
+				// packed from the high bits; gray samples are scaled to 8 bits
+				size_t bit = x * depth;
+				int value = (row[bit / 8] >> (8 - depth - bit % 8)) & ((1 << depth) - 1);
+				if (colorType == 3) {
+					if (static_cast<size_t>(value) >= paletteSize) {
+						return false;
+					}
+					std::memcpy(pixel, palette + value * 3, 3);
+				}
+				else {
+					std::memset(pixel, value * 255 / ((1 << depth) - 1), 3);
+				}
+				continue;
+			}
+
+			// 16 bit samples keep their high byte
+			const uint8_t* sample = row + x * bitsPerPixel / 8;
+			size_t step = depth / 8;
+			if (colorType == 3) {
+				if (sample[0] >= paletteSize) {
+					return false;
+				}
+				std::memcpy(pixel, palette + sample[0] * 3, 3);
+			}
+			else if (channels < 3) {
+				std::memset(pixel, sample[0], 3);
+			}
+			else {
+				pixel[0] = sample[0];
+				pixel[1] = sample[step];
+				pixel[2] = sample[2 * step];
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * decodeBmp - Decodes an uncompressed Windows bitmap (BITMAPINFOHEADER or later).
+ * Params: data, size - the file; image - receives the pixels
+ * Returns: false for compressed, OS/2 or malformed files.
+ */
+static bool decodeBmp(const uint8_t* data, size_t size, Image& image)
+{
+	if (size < 54) {
+		return false;
+	}
+	uint32_t pixelsOffset = readLittleEndian32(data + 10);
+	uint32_t headerSize = readLittleEndian32(data + 14);
+	int32_t width = static_cast<int32_t>(readLittleEndian32(data + 18));
+	int32_t height = static_cast<int32_t>(readLittleEndian32(data + 22));
+	int bits = data[28] | (data[29] << 8);
+	uint32_t compression = readLittleEndian32(data + 30);
+	uint32_t colors = readLittleEndian32(data + 46);
+
+	// BI_BITFIELDS is accepted for 32 bits with the usual BGRA masks
+	bool supported = bits == 1 || bits == 4 || bits == 8 || bits == 24 || bits == 32;
+	if (headerSize < 40 || !supported || (compression != 0 && !(compression == 3 && bits == 32)) || height == INT32_MIN) {
+		return false;
+	}
+	bool bottomUp = height > 0;
+	if (!allocate(image, width, bottomUp ? height : -static_cast<int64_t>(height))) {
+		return false;
+	}
+
+	const uint8_t* palette = nullptr;
+	if (bits <= 8) {
+		colors = colors == 0 ? (1u << bits) : std::min<uint32_t>(colors, 1u << bits);
+		if (headerSize > size - 14 || static_cast<size_t>(colors) * 4 > size - 14 - headerSize) {
+			return false;
+		}
+		palette = data + 14 + headerSize;
+	}
+
+	size_t stride = (static_cast<size_t>(image.width) * bits + 31) / 32 * 4;
+	if (pixelsOffset > size || stride * image.height > size - pixelsOffset) {
+		return false;
+	}
+
+	for (int y = 0; y < image.height; ++y) {
+		const uint8_t* row = data + pixelsOffset + stride * (bottomUp ? image.height - 1 - y : y);
+		uint8_t* pixel = image.pixels.data() + static_cast<size_t>(y) * image.width * 3;
+		for (int x = 0; x < image.width; ++x, pixel += 3) {
+			const uint8_t* color;
+			if (bits <= 8) {
+				size_t bit = static_cast<size_t>(x) * bits;
+				uint32_t index = (row[bit / 8] >> (8 - bits - bit % 8)) & ((1u << bits) - 1);
+				if (index >= colors) {
+					return false;
+				}
+				color = palette + index * 4;
+			}
+			else {
+				color = row + static_cast<size_t>(x) * (bits / 8);
+			}
+			// stored blue, green, red
+			pixel[0] = color[2];
+			pixel[1] = color[1];
+			pixel[2] = color[0];
+		}
+	}
+	return true;
+}
+
+/**
+ * readPnmNumber - Reads the next decimal number of a PNM header or plain body.
+ * Params: data, size - the file; position - moved past the number; value - receives it
+ * Returns: false when no number comes before the end of the file.
+ */
+static bool readPnmNumber(const uint8_t* data, size_t size, size_t& position, int64_t& value)
+{
+	while (position < size && (isspace(data[position]) || data[position] == '#')) {
+		if (data[position] == '#') {
+			while (position < size && data[position] != '\n') {
+				++position;
+			}
+		}
+		else {
+			++position;
+		}
+	}
+	size_t start = position;
+	value = 0;
+	while (position < size && isdigit(data[position]) && value < INT32_MAX) {
+		value = value * 10 + (data[position] - '0');
+		++position;
+	}
+	return position != start;
+}
+
+/**
+ * decodePnm - Decodes PBM, PGM and PPM, plain (P1 - P3) and raw (P4 - P6), up to 16 bits.
+ * Params: data, size - the file; image - receives the pixels
+ * Returns: false for malformed or truncated files.
+ */
+static bool decodePnm(const uint8_t* data, size_t size, Image& image)
+{
+	int kind = data[1] - '0';
+	bool plain = kind <= 3;
+	int channels = (kind == 3 || kind == 6) ? 3 : 1;
+	bool bitmap = kind == 1 || kind == 4;
+
+	size_t position = 2;
+	int64_t width = 0;
+	int64_t height = 0;
+	int64_t maxValue = 1;
+	if (!readPnmNumber(data, size, position, width) || !readPnmNumber(data, size, position, height)) {
+		return false;
+	}
+	if (!bitmap && (!readPnmNumber(data, size, position, maxValue) || maxValue <= 0 || maxValue > 65535)) {
+		return false;
+	}
+	if (!allocate(image, width, height)) {
+		return false;
+	}
+	// a single whitespace byte separates the header from a raw body
+	++position;
+
+	size_t sampleBytes = maxValue > 255 ? 2 : 1;
+	size_t rowBytes = bitmap ? (static_cast<size_t>(width) + 7) / 8 : static_cast<size_t>(width) * channels * sampleBytes;
+	if (!plain && (position > size || rowBytes * height > size - position)) {
+		return false;
+	}
+
+	const uint8_t* body = data + std::min(position, size);
+	for (int y = 0; y < image.height; ++y) {
+		const uint8_t* row = plain ? nullptr : body + rowBytes * y;
+		uint8_t* pixel = image.pixels.data() + static_cast<size_t>(y) * image.width * 3;
+		for (int x = 0; x < image.width; ++x, pixel += 3) {
+			if (bitmap) {
+				int64_t black = 0;
+				if (plain) {
+					// plain bitmaps may run their digits together
+					while (position < size && (isspace(data[position]) || data[position] == '#')) {
+						position = data[position] == '#' ? static_cast<size_t>(std::find(data + position, data + size, '\n') - data) : position + 1;
+					}
+					if (position >= size) {
+						return false;
+					}
+					black = data[position++] == '1';
+				}
+				else {
+					black = (row[x / 8] >> (7 - x % 8)) & 1;
+				}
+				std::memset(pixel, black ? 0 : 255, 3);
+				continue;
+			}
+
+			for (int channel = 0; channel < channels; ++channel) {
+				int64_t value = 0;
+				if (plain) {
+					if (!readPnmNumber(data, size, position, value)) {
+						return false;
+					}
+				}
+				else {
+					const uint8_t* sample = row + (static_cast<size_t>(x) * channels + channel) * sampleBytes;
+					value = sampleBytes == 2 ? (sample[0] << 8) | sample[1] : sample[0];
+				}
+				pixel[channel] = static_cast<uint8_t>(std::min<int64_t>(value, maxValue) * 255 / maxValue);
+			}
+			if (channels == 1) {
+				pixel[1] = pixel[0];
+				pixel[2] = pixel[0];
+			}
+		}
+	}
+	return true;
+}
+
+// ******************* ImageDecoder *******************
+
+bool ImageDecoder::canDecode(ImageFormat format)
+{
+	return format == ImageFormat::BMP || format == ImageFormat::PNM || format == ImageFormat::PNG;
+}
+
+bool ImageDecoder::decode(const std::string& path, Image& image)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return decode(data.data(), data.size(), image);
+}
+
+bool ImageDecoder::decode(const uint8_t* data, size_t size, Image& image)
+{
+	static const uint8_t pngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+	bool decoded = false;
+	if (size >= 8 && std::memcmp(data, pngSignature, 8) == 0) {
+		decoded = decodePng(data, size, image);
+	}
+	else if (size >= 2 && data[0] == 'B' && data[1] == 'M') {
+		decoded = decodeBmp(data, size, image);
+	}
+	else if (size >= 3 && data[0] == 'P' && data[1] >= '1' && data[1] <= '6' && isspace(data[2])) {
+		decoded = decodePnm(data, size, image);
+	}
+
+	if (!decoded) {
+		image = Image();
+	}
+	return decoded;
+}
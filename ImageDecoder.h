@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "FileMetadata.h"
+
+#define IMAGE_MAX_PIXELS (64 * 1024 * 1024)		// larger images are refused, not decoded
+
+/*
+ * Image - decoded pixels, 8 bit RGB, row by row from the top, 3 bytes per pixel.
+ */
+struct Image
+{
+	int width { 0 };
+	int height { 0 };
+	std::vector<uint8_t> pixels;
+};
+
+/*
+ * ImageDecoder - decodes the formats the gallery can read without external libraries:
+ * BMP (uncompressed 1, 4, 8, 24 and 32 bits), PBM / PGM / PPM (plain and raw) and PNG
+ * (every color type and bit depth, not interlaced; the zlib stream is inflated here).
+ * Alpha is dropped. Malformed, truncated or unsupported input makes decode return false,
+ * it never throws for bad files.
+ */
+class ImageDecoder
+{
+public:
+	static bool canDecode(ImageFormat format);
+
+	static bool decode(const std::string& path, Image& image);
+	static bool decode(const uint8_t* data, size_t size, Image& image);
+};
@@ -0,0 +1,78 @@
+#include "ListingOrder.h"
+#include <algorithm>
+#include <string>
+#include <utility>
+
+/**
+ * orderBy - Partially sorts items by (key, insertion position) and keeps the first ones.
+ * Params: items - in insertion order, replaced by the ordered ones; order - direction and limit;
+ *         getKey - the key of an item
+ * Returns: None
+ */
+template <typename T, typename GetKey>
+static void orderBy(std::vector<const T*>& items, const ListingOrder& order, GetKey getKey)
+{
+	using Key = decltype(getKey(*items.front()));
+	std::vector<std::pair<Key, size_t>> keys;
+	keys.reserve(items.size());
+	for (size_t position = 0; position < items.size(); ++position) {
+		keys.emplace_back(getKey(*items[position]), position);
+	}
+
+	size_t count = order.getCount(keys.size());
+	bool descending = order.descending;
+	std::partial_sort(keys.begin(), keys.begin() + count, keys.end(), [descending](const auto& left, const auto& right) {
+		return descending ? right < left : left < right;
+	});
+
+	std::vector<const T*> ordered;
+	ordered.reserve(count);
+	for (size_t rank = 0; rank < count; ++rank) {
+		ordered.push_back(items[keys[rank].second]);
+	}
+	items.swap(ordered);
+}
+
+void ListingOrder::apply(std::vector<const Album*>& albums) const
+{
+	switch (key) {
+	case ListingKey::BY_CREATION:
+		orderBy(albums, *this, [](const Album& album) { return album.getCreationTime(); });
+		break;
+	case ListingKey::BY_NAME:
+		orderBy(albums, *this, [](const Album& album) { return album.getName(); });
+		break;
+	case ListingKey::BY_TAGS:
+		orderBy(albums, *this, [](const Album& album) { return getTagsCount(album); });
+		break;
+	}
+}
+
+void ListingOrder::apply(std::vector<const Picture*>& pictures) const
+{
+	switch (key) {
+	case ListingKey::BY_CREATION:
+		orderBy(pictures, *this, [](const Picture& picture) { return picture.getCreationTime(); });
+		break;
+	case ListingKey::BY_NAME:
+		orderBy(pictures, *this, [](const Picture& picture) { return picture.getName(); });
+		break;
+	case ListingKey::BY_TAGS:
+		orderBy(pictures, *this, [](const Picture& picture) { return picture.getTagsCount(); });
+		break;
+	}
+}
+
+size_t ListingOrder::getCount(size_t available) const
+{
+	return limit == 0 ? available : std::min(limit, available);
+}
+
+int ListingOrder::getTagsCount(const Album& album)
+{
+	int tagsCount = 0;
+	album.forEachPicture([&tagsCount](const Picture& picture) {
+		tagsCount += picture.getTagsCount();
+	});
+	return tagsCount;
+}
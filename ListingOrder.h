@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "Album.h"
+
+enum class ListingKey
+{
+	BY_CREATION,	// creation date
+	BY_NAME,
+	BY_TAGS			// tags of the picture, or of all the pictures of the album
+};
+
+/*
+ * ListingOrder - how an ordered listing of albums or pictures is sorted and cut.
+ * Ties keep insertion order, and descending is the exact reverse of ascending, so the
+ * newest first listing of equal dates starts with the last inserted one.
+ */
+struct ListingOrder
+{
+	ListingKey key { ListingKey::BY_CREATION };
+	bool descending { false };
+	size_t limit { 0 };		// 0 lists everything
+
+	// sorts items given in insertion order and keeps the first limit of them, O(n log limit)
+	void apply(std::vector<const Album*>& albums) const;
+	void apply(std::vector<const Picture*>& pictures) const;
+
+	size_t getCount(size_t available) const;
+	static int getTagsCount(const Album& album);
+};
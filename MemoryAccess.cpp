@@ -1,20 +1,67 @@
 ﻿#include <map>
+#include <set>
 #include <algorithm>
 
 #include "ItemNotFoundException.h"
 #include "MemoryAccess.h"
 
+#define PICTURES_TABLE "PICTURES"
+#define USERS_TABLE "USERS"
+#define ALBUMS_TABLE "ALBUMS"
 
 
+
+MemoryAccess::MemoryAccess(const MemoryAccess& other)
+{
+	copyLiveData(other);
+}
+
+MemoryAccess& MemoryAccess::operator=(const MemoryAccess& other)
+{
+	if (this != &other) {
+		copyLiveData(other);
+	}
+	return *this;
+}
+
+/**
+ * copyLiveData - Copies another store without its tombstones: deleted albums are left out and
+ *                the tags of deleted users are removed from the copied pictures.
+ * Params: other - the store to copy
+ * Returns: None
+ */
+void MemoryAccess::copyLiveData(const MemoryAccess& other)
+{
+	m_albums.clear();
+	for (const Album& album : other.m_albums) {
+		if (!other.isDeleted(album)) {
+			m_albums.push_back(other.getLiveCopy(album));
+		}
+	}
+	m_users = other.m_users;
+	m_nextIds = other.m_nextIds;
+	m_files = other.m_files;
+	m_parallelism = other.m_parallelism;
+	m_compactionBudget = other.m_compactionBudget;
+
+	m_deletedUserTags.clear();
+	m_deletedAlbums.clear();
+	m_albumsToErase.clear();
+	m_compaction = CompactionStats();
+	rebuildIndexes();
+}
+
 void MemoryAccess::printAlbums() 
 {
-	if(m_albums.empty()) {
+	if(m_albums.size() == m_deletedAlbums.size()) {
 		throw MyException("There are no existing albums.");
 	}
 	std::cout << "Album list:" << std::endl;
 	std::cout << "-----------" << std::endl;
 	for (const Album& album: m_albums) 	{
-		std::cout << std::setw(5) << "* " << album;
+		if (!isDeleted(album)) {
+			std::cout << std::setw(5) << "* " << album;
+		}
 	}
 }
 
@@ -28,7 +75,7 @@ bool MemoryAccess::open()
 		User user(i, name.str());
 		createUser(user);
 
-		m_albums.push_back(createDummyAlbum(user));
+		createAlbum(createDummyAlbum(user));
 	}
 
 	return true;
@@ -38,17 +85,152 @@ void MemoryAccess::clear()
 {
 	m_users.clear();
 	m_albums.clear();
+	m_nextIds.clear();
+	m_usersById.clear();
+	m_albumsByName.clear();
+	m_albumsByOwnerAndName.clear();
+	m_albumsByOwner.clear();
+	m_tagsByUser.clear();
+	m_columns.clear();
+	m_creation.clear();
+	m_files.clear();
+	m_deletedUserTags.clear();
+	m_deletedAlbums.clear();
+	m_albumsToErase.clear();
 }
 
-auto MemoryAccess::getAlbumIfExists(const std::string & albumName)
+const std::list<User>& MemoryAccess::users() const
 {
-	auto result = std::find_if(std::begin(m_albums), std::end(m_albums), [&](auto& album) { return album.getName() == albumName; });
+	return m_users;
+}
 
-	if (result == std::end(m_albums)) {
+const std::list<Album>& MemoryAccess::albums() const
+{
+	return m_albums;
+}
+
+int MemoryAccess::getTheNextId(const std::string& tableName)
+{
+	auto found = m_nextIds.find(tableName);
+	return found == m_nextIds.end() ? 1 : found->second;
+}
+
+void MemoryAccess::updateNextId(const std::string& tableName, int usedId)
+{
+	int& nextId = m_nextIds[tableName];
+	if (usedId >= nextId) {
+		nextId = usedId + 1;
+	}
+}
+
+size_t MemoryAccess::AlbumKeyHash::operator()(const std::pair<int, Symbol>& key) const
+{
+	return std::hash<uint64_t>()((static_cast<uint64_t>(key.first) << 32) | key.second);
+}
+
+MemoryAccess::AlbumIterator MemoryAccess::getAlbumIfExists(const std::string & albumName)
+{
+	auto result = m_albumsByName.find(SymbolTable::find(albumName));
+
+	if (result == m_albumsByName.end()) {
 		throw ItemNotFoundException("Album not exists: ", albumName);
 	}
-	return result;
+	// same name under several owners: the first created one, like the scan used to return
+	return result->second.front();
+}
 
+/**
+ * rebuildIndexes - Builds every index from scratch out of the user and album lists.
+ */
+void MemoryAccess::rebuildIndexes()
+{
+	m_usersById.clear();
+	m_albumsByName.clear();
+	m_albumsByOwnerAndName.clear();
+	m_albumsByOwner.clear();
+	m_tagsByUser.clear();
+	m_columns.clear();
+	m_creation.clear();
+
+	for (auto user = m_users.begin(); user != m_users.end(); ++user) {
+		m_usersById.emplace(user->getId(), user);
+	}
+	for (auto album = m_albums.begin(); album != m_albums.end(); ++album) {
+		indexAlbum(album);
+		indexAlbumTags(*album);
+	}
+}
+
+void MemoryAccess::indexAlbum(AlbumIterator album)
+{
+	m_albumsByName[album->getNameSymbol()].push_back(album);
+	m_albumsByOwnerAndName.emplace(std::make_pair(album->getOwnerId(), album->getNameSymbol()), album);
+	m_albumsByOwner[album->getOwnerId()].push_back(album);
+
+	const Album* columnsAlbum = &*album;
+	m_columns.addAlbum(columnsAlbum);
+	m_creation.addAlbum(columnsAlbum);
+	album->forEachPicture([this, columnsAlbum](const Picture& picture) {
+		m_columns.addPicture(columnsAlbum, &picture);
+		m_creation.addPicture(columnsAlbum, &picture);
+	});
+}
+
+/**
+ * unlinkAlbum - Removes an album from the lookup indexes and from the albums by creation date,
+ *               without looking at its pictures: they stay in the columns, the creation index
+ *               and the tag index until eraseAlbum.
+ */
+void MemoryAccess::unlinkAlbum(AlbumIterator album)
+{
+	// cleanUserData drops the owner's whole entry before unlinking the albums
+	auto removeFrom = [album](auto& index, const auto& key) {
+		auto found = index.find(key);
+		if (found == index.end()) {
+			return;
+		}
+		auto& albums = found->second;
+		albums.erase(std::find(albums.begin(), albums.end(), album));
+		if (albums.empty()) {
+			index.erase(found);
+		}
+	};
+
+	m_creation.removeAlbum(&*album);
+	removeFrom(m_albumsByName, album->getNameSymbol());
+	removeFrom(m_albumsByOwner, album->getOwnerId());
+	m_albumsByOwnerAndName.erase(std::make_pair(album->getOwnerId(), album->getNameSymbol()));
+}
+
+/**
+ * tombstoneAlbum - Deletes an album for every query at once and queues it for compaction.
+ */
+void MemoryAccess::tombstoneAlbum(AlbumIterator album)
+{
+	unlinkAlbum(album);
+	m_columns.hideAlbum(&*album);
+	m_deletedAlbums.insert(&*album);
+	m_albumsToErase.push_back(album);
+}
+
+/**
+ * eraseAlbum - Frees a tombstoned album: drops its pictures from the columns and the creation
+ *              index, its tags from the tag index and its node from the store.
+ */
+void MemoryAccess::eraseAlbum(AlbumIterator album)
+{
+	album->forEachPicture([this](const Picture& picture) {
+		m_columns.removePicture(&picture);
+		m_creation.removePicture(&picture);
+	});
+	m_columns.removeAlbum(&*album);
+	unindexAlbumTags(*album);
+	m_deletedAlbums.erase(&*album);
+
+	m_compaction.erasedPictures += album->pictures().size();
+	m_compaction.reclaimedBytes += album->getMemoryUsage();
+	++m_compaction.erasedAlbums;
+	m_albums.erase(album);
 }
 
 Album MemoryAccess::createDummyAlbum(const User& user)
@@ -69,84 +251,386 @@ Album MemoryAccess::createDummyAlbum(const User& user)
 	return album;
 }
 
+void MemoryAccess::indexTag(Album& album, const Picture& picture, int userId)
+{
+	UserTags& tags = m_tagsByUser[userId];
+	if (tags.pictures[&album].insert(&picture).second) {
+		++tags.tagsCount;
+	}
+}
+
+void MemoryAccess::unindexTag(Album& album, const Picture& picture, int userId)
+{
+	auto user = m_tagsByUser.find(userId);
+	if (user == m_tagsByUser.end()) {
+		return;
+	}
+
+	auto albumTags = user->second.pictures.find(&album);
+	if (albumTags == user->second.pictures.end() || albumTags->second.erase(&picture) == 0) {
+		return;
+	}
+
+	--user->second.tagsCount;
+	if (albumTags->second.empty()) {
+		user->second.pictures.erase(albumTags);
+	}
+	if (user->second.tagsCount == 0) {
+		m_tagsByUser.erase(user);
+	}
+}
+
+/**
+ * indexAlbumTags - Adds the tags an album already carries (e.g. a created album) to the tag index.
+ */
+void MemoryAccess::indexAlbumTags(Album& album)
+{
+	album.forEachPicture([this, &album](const Picture& picture) {
+		for (int userId : picture.getUserTags()) {
+			indexTag(album, picture, userId);
+		}
+	});
+}
+
+/**
+ * unindexAlbumTags - Drops every tag of an album from the tag index.
+ */
+void MemoryAccess::unindexAlbumTags(Album& album)
+{
+	std::set<int> taggedUsers;
+	album.forEachPicture([&taggedUsers](const Picture& picture) {
+		taggedUsers.insert(picture.getUserTags().begin(), picture.getUserTags().end());
+	});
+
+	for (int userId : taggedUsers) {
+		// the tags of deleted users are in m_deletedUserTags, compaction removes them before the album
+		auto user = m_tagsByUser.find(userId);
+		if (user == m_tagsByUser.end()) {
+			continue;
+		}
+		auto albumTags = user->second.pictures.find(&album);
+
+		user->second.tagsCount -= static_cast<int>(albumTags->second.size());
+		user->second.pictures.erase(albumTags);
+		if (user->second.tagsCount == 0) {
+			m_tagsByUser.erase(user);
+		}
+	}
+}
+
 const std::list<Album> MemoryAccess::getAlbums() 
 {
-	return m_albums;
+	if (m_deletedAlbums.empty() && m_deletedUserTags.empty()) {
+		return m_albums;
+	}
+
+	std::list<Album> albums;
+	for (const Album& album : m_albums) {
+		if (!isDeleted(album)) {
+			albums.push_back(getLiveCopy(album));
+		}
+	}
+	return albums;
 }
 
 const std::list<Album> MemoryAccess::getAlbumsOfUser(const User& user) 
 {	
 	std::list<Album> albumsOfUser;
-	for (const auto& album: m_albums) {
-		if (album.getOwnerId() == user.getId()) {
-			albumsOfUser.push_back(album);
+	auto owned = m_albumsByOwner.find(user.getId());
+	if (owned != m_albumsByOwner.end()) {
+		for (const auto& album : owned->second) {
+			albumsOfUser.push_back(getLiveCopy(*album));
 		}
 	}
 	return albumsOfUser;
 }
 
+// qualified, so a derived class overriding both overloads does not see the call twice
 void MemoryAccess::createAlbum(const Album& album)
 {
-	m_albums.push_back(album);
+	MemoryAccess::createAlbum(Album(album));
+}
+
+void MemoryAccess::createAlbum(Album&& album)
+{
+	if (doesAlbumExists(album.getName(), album.getOwnerId())) {
+		throw MyException("Album " + album.getName() + " of user@" + std::to_string(album.getOwnerId()) + " already exists");
+	}
+
+	// tags of deleted ids are new tags, the old ones go first
+	if (!m_deletedUserTags.empty()) {
+		album.forEachPicture([this](const Picture& picture) {
+			for (int userId : picture.getUserTags()) {
+				flushDeletedUser(userId);
+			}
+		});
+	}
+
+	m_albums.push_back(std::move(album));
+	Album& stored = m_albums.back();
+	indexAlbum(std::prev(m_albums.end()));
+	indexAlbumTags(stored);
+	updateNextId(ALBUMS_TABLE, stored.getId());
+	stored.forEachPicture([this](const Picture& picture) {
+		updateNextId(PICTURES_TABLE, picture.getId());
+	});
+	compactAfterChange();
 }
 
 void MemoryAccess::deleteAlbum(const std::string& albumName, int userId)
 {
-	for (auto iter = m_albums.begin(); iter != m_albums.end(); iter++) {
-		if ( iter->getName() == albumName && iter->getOwnerId() == userId ) {
-			iter = m_albums.erase(iter);
-			return;
-		}
+	auto found = m_albumsByOwnerAndName.find(std::make_pair(userId, SymbolTable::find(albumName)));
+	if (found != m_albumsByOwnerAndName.end()) {
+		tombstoneAlbum(found->second);
+		compactAfterChange();
 	}
 }
 
 bool MemoryAccess::doesAlbumExists(const std::string& albumName, int userId) 
 {
-	for (const auto& album: m_albums) {
-		if ( (album.getName() == albumName) && (album.getOwnerId() == userId) ) {
-			return true;
+	return m_albumsByOwnerAndName.count(std::make_pair(userId, SymbolTable::find(albumName))) != 0;
+}
+
+Album MemoryAccess::openAlbum(const std::string& albumName) 
+{
+	auto found = m_albumsByName.find(SymbolTable::find(albumName));
+	if (found == m_albumsByName.end()) {
+		throw MyException("No album with name " + albumName + " exists");
+	}
+	return getLiveCopy(*found->second.front());
+}
+
+// the albums are visited as stored, or as live copies while tags of deleted users are pending
+void MemoryAccess::forEachAlbum(const std::function<void(const Album&)>& fn)
+{
+	for (const Album& album : m_albums) {
+		if (isDeleted(album)) {
+			continue;
+		}
+		if (m_deletedUserTags.empty()) {
+			fn(album);
+		}
+		else {
+			fn(getLiveCopy(album));
 		}
 	}
+}
 
-	return false;
+void MemoryAccess::forEachAlbumOfUser(const User& user, const std::function<void(const Album&)>& fn)
+{
+	auto owned = m_albumsByOwner.find(user.getId());
+	if (owned != m_albumsByOwner.end()) {
+		for (const auto& album : owned->second) {
+			if (m_deletedUserTags.empty()) {
+				fn(*album);
+			}
+			else {
+				fn(getLiveCopy(*album));
+			}
+		}
+	}
 }
 
-Album MemoryAccess::openAlbum(const std::string& albumName) 
+bool MemoryAccess::visitPicture(const std::string& albumName, const std::string& pictureName, const std::function<void(const Picture&)>& fn)
 {
-	for (auto& album: m_albums)	{
-		if (albumName == album.getName()) {
-			return album;
+	const Picture* picture = findPicture(albumName, pictureName);
+	if (picture == nullptr) {
+		return false;
+	}
+	if (m_deletedUserTags.empty()) {
+		fn(*picture);
+	}
+	else {
+		fn(getLiveCopy(*picture));
+	}
+	return true;
+}
+
+/**
+ * getAlbumsSorted - Lists the albums in the given order.
+ * Params: order - key, direction and limit
+ * Returns: Copies of the albums (without the tags of deleted users).
+ */
+std::list<Album> MemoryAccess::getAlbumsSorted(const ListingOrder& order)
+{
+	std::vector<const Album*> ordered;
+	// tags of deleted users are still on the stored pictures, the tags order counts the live copies
+	std::list<Album> liveCopies;
+
+	if (order.key == ListingKey::BY_CREATION) {
+		// deleted albums are out of the creation index already, their pictures are not
+		ordered = m_creation.getAlbums(order.descending, order.limit);
+	}
+	else {
+		for (const Album& album : m_albums) {
+			if (isDeleted(album)) {
+				continue;
+			}
+			if (order.key == ListingKey::BY_TAGS && !m_deletedUserTags.empty()) {
+				liveCopies.push_back(getLiveCopy(album));
+				ordered.push_back(&liveCopies.back());
+			}
+			else {
+				ordered.push_back(&album);
+			}
 		}
+		order.apply(ordered);
 	}
-	throw MyException("No album with name " + albumName + " exists");
+
+	std::list<Album> sorted;
+	for (const Album* album : ordered) {
+		sorted.push_back(getLiveCopy(*album));
+	}
+	return sorted;
+}
+
+/**
+ * getPicturesSorted - Lists the pictures of an album in the given order.
+ * Params: albumName - the album, under several owners the first created one (like openAlbum);
+ *         order - key, direction and limit
+ * Returns: Copies of the pictures (without the tags of deleted users).
+ */
+std::list<Picture> MemoryAccess::getPicturesSorted(const std::string& albumName, const ListingOrder& order)
+{
+	auto album = getAlbumIfExists(albumName);
+	std::vector<const Picture*> ordered;
+	std::list<Picture> liveCopies;
+
+	if (order.key == ListingKey::BY_CREATION) {
+		ordered = m_creation.getPictures(&*album, order.descending, order.limit);
+	}
+	else {
+		album->forEachPicture([this, &order, &ordered, &liveCopies](const Picture& picture) {
+			if (order.key == ListingKey::BY_TAGS && !m_deletedUserTags.empty()) {
+				liveCopies.push_back(getLiveCopy(picture));
+				ordered.push_back(&liveCopies.back());
+			}
+			else {
+				ordered.push_back(&picture);
+			}
+		});
+		order.apply(ordered);
+	}
+
+	std::list<Picture> sorted;
+	for (const Picture* picture : ordered) {
+		sorted.push_back(getLiveCopy(*picture));
+	}
+	return sorted;
+}
+
+/**
+ * findAlbum - Finds an album by name without copying it.
+ * Params: albumName - the album, under several owners the first created one (like openAlbum)
+ * Returns: The stored album, nullptr if there is none.
+ */
+const Album* MemoryAccess::findAlbum(const std::string& albumName) const
+{
+	auto found = m_albumsByName.find(SymbolTable::find(albumName));
+	return found == m_albumsByName.end() ? nullptr : &*found->second.front();
+}
+
+/**
+ * findPicture - Finds a picture of an album without copying it.
+ * Params: albumName - the album (see findAlbum), pictureName - the picture
+ * Returns: The stored picture, nullptr if the album or the picture does not exist.
+ */
+const Picture* MemoryAccess::findPicture(const std::string& albumName, const std::string& pictureName) const
+{
+	const Album* album = findAlbum(albumName);
+	return album == nullptr ? nullptr : album->findPicture(pictureName);
 }
 
 void MemoryAccess::addPictureToAlbumByName(const std::string& albumName, const Picture& picture) 
+{
+	MemoryAccess::addPictureToAlbumByName(albumName, Picture(picture));
+}
+
+void MemoryAccess::addPictureToAlbumByName(const std::string& albumName, Picture&& picture) 
 {
 	auto result = getAlbumIfExists(albumName);
 
-	(*result).addPicture(picture);
+	// tags of deleted ids are new tags, the old ones go first
+	for (int userId : picture.getUserTags()) {
+		flushDeletedUser(userId);
+	}
+
+	const Picture& added = (*result).addPicture(std::move(picture));
+	updateNextId(PICTURES_TABLE, added.getId());
+
+	for (int userId : added.getUserTags()) {
+		indexTag(*result, added, userId);
+	}
+	m_columns.addPicture(&*result, &added);
+	m_creation.addPicture(&*result, &added);
+	compactAfterChange();
 }
 
 void MemoryAccess::removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName) 
 {
 	auto result = getAlbumIfExists(albumName);
 
+	const Picture* picture = (*result).findPicture(pictureName);
+	if (picture != nullptr) {
+		// copy the ids, untagging edits the set we would be iterating
+		TagSet taggedUsers = picture->getUserTags();
+		for (int userId : taggedUsers) {
+			unindexTag(*result, *picture, userId);
+			removeDeletedUserTag(*result, *picture, userId);
+		}
+		m_columns.removePicture(picture);
+		m_creation.removePicture(picture);
+	}
+
 	(*result).removePicture(pictureName);
+	compactAfterChange();
 }
 
 void MemoryAccess::tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
 {
 	auto result = getAlbumIfExists(albumName);
 
-	(*result).tagUserInPicture(userId, pictureName);
+	// a deleted id used again starts without the old tags
+	flushDeletedUser(userId);
+
+	// a name given more than once tags every picture with it
+	Album& album = *result;
+	album.tagUserInPicture(userId, pictureName);
+	album.forEachPicture(pictureName, [this, &album, userId](const Picture& picture) {
+		indexTag(album, picture, userId);
+		m_columns.updateTagsCount(&picture);
+	});
+	compactAfterChange();
 }
 
 void MemoryAccess::untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
 {
 	auto result = getAlbumIfExists(albumName);
 
-	(*result).untagUserInPicture(userId, pictureName);
+	flushDeletedUser(userId);
+
+	Album& album = *result;
+	album.untagUserInPicture(userId, pictureName);
+	album.forEachPicture(pictureName, [this, &album, userId](const Picture& picture) {
+		unindexTag(album, picture, userId);
+		m_columns.updateTagsCount(&picture);
+	});
+	compactAfterChange();
+}
+
+bool MemoryAccess::getFileMetadata(const std::string& path, FileMetadata& metadata)
+{
+	return m_files.find(path, metadata);
+}
+
+void MemoryAccess::storeFileMetadata(const std::vector<FileMetadata>& files)
+{
+	m_files.store(files);
+}
+
+void MemoryAccess::forEachFileMetadata(const std::function<void(const FileMetadata&)>& fn)
+{
+	m_files.forEach(fn);
 }
 
 void MemoryAccess::closeAlbum(Album& ) 
@@ -154,6 +638,38 @@ void MemoryAccess::closeAlbum(Album& )
 	// basically here we would like to delete the allocated memory we got from openAlbum
 }
 
+bool MemoryAccess::doesPictureExistsInAlbum(const std::string& albumName, const std::string& pictureName)
+{
+	auto result = getAlbumIfExists(albumName);
+
+	return (*result).doesPictureExists(pictureName);
+}
+
+Picture MemoryAccess::getPictureFromAlbum(const std::string& albumName, const std::string& pictureName)
+{
+	auto result = getAlbumIfExists(albumName);
+
+	return getLiveCopy((*result).getPicture(pictureName));
+}
+
+bool MemoryAccess::isUserTaggedInPicture(const User& user, const Picture& picture)
+{
+	return picture.isUserTagged(user) && m_deletedUserTags.count(user.getId()) == 0;
+}
+
+std::list<User> MemoryAccess::getUsersTaggedInPicture(const Picture& picture)
+{
+	std::list<User> users;
+
+	for (const auto& userId : picture.getUserTags()) {
+		if (doesUserExists(userId)) {
+			users.push_back(getUser(userId));
+		}
+	}
+
+	return users;
+}
+
 // ******************* User ******************* 
 void MemoryAccess::printUsers()
 {
@@ -165,10 +681,9 @@ void MemoryAccess::printUsers()
 }
 
 User MemoryAccess::getUser(int userId) {
-	for (const auto& user : m_users) {
-		if (user.getId() == userId) {
-			return user;
-		}
+	auto found = m_usersById.find(userId);
+	if (found != m_usersById.end()) {
+		return *found->second;
 	}
 
 	throw ItemNotFoundException("User", userId);
@@ -176,49 +691,71 @@ User MemoryAccess::getUser(int userId) {
 
 void MemoryAccess::createUser(User& user)
 {
+	// ids are unique, like the USERS primary key
+	if (doesUserExists(user.getId())) {
+		return;
+	}
+
+	flushDeletedUser(user.getId());
 	m_users.push_back(user);
+	m_usersById.emplace(user.getId(), std::prev(m_users.end()));
+	updateNextId(USERS_TABLE, user.getId());
+	compactAfterChange();
 }
 
 void MemoryAccess::deleteUser(const User& user)
 {
-	if (doesUserExists(user.getId())) {
-	
-		for (auto iter = m_users.begin(); iter != m_users.end(); ++iter) {
-			if (*iter == user) {
-				iter = m_users.erase(iter);
-			}
-		}
-
+	auto found = m_usersById.find(user.getId());
+	if (found != m_usersById.end()) {
+		m_users.erase(found->second);
+		m_usersById.erase(found);
+		cleanUserData(user);
+		compactAfterChange();
+	}
+}
 
-		for (auto albums = m_albums.begin(); albums != m_albums.end(); ++albums)
-		{
-			albums->untagUserInAlbum(user.getId());
-		}
+/**
+ * cleanUserData - Removes the tags of a user and the albums the user owns, but not the user.
+ *                 Both are tombstoned: every query skips them at once, compaction frees them.
+ *                 Neither the tagged pictures nor the pictures of the owned albums are visited.
+ * Params: user - the user whose data is removed
+ * Returns: None
+ */
+void MemoryAccess::cleanUserData(const User& user)
+{
+	// the user's tags move out of the tag index as they are, the pictures (and the tags counts
+	// in the columns) keep them until compaction
+	auto tags = m_tagsByUser.find(user.getId());
+	if (tags != m_tagsByUser.end()) {
+		flushDeletedUser(user.getId());
+		m_deletedUserTags[user.getId()] = std::move(tags->second);
+		m_tagsByUser.erase(tags);
+	}
 
-		for (auto iter = m_albums.begin(); iter != m_albums.end(); )
-		{
-			if (iter->getOwnerId() == user.getId())
-			{
-				iter = m_albums.erase(iter);
-			}
-			else
-			{
-				++iter;
-			}
+	auto owned = m_albumsByOwner.find(user.getId());
+	if (owned != m_albumsByOwner.end()) {
+		std::vector<AlbumIterator> albums = std::move(owned->second);
+		m_albumsByOwner.erase(owned);
+		for (auto album : albums) {
+			tombstoneAlbum(album);
 		}
-
 	}
 }
 
 bool MemoryAccess::doesUserExists(int userId) 
 {
-	auto iter = m_users.begin();
+	return m_usersById.count(userId) != 0;
+}
+
+bool MemoryAccess::doesUserExists(const std::string& name)
+{
+	Symbol symbol = SymbolTable::find(name);
 	for (const auto& user : m_users) {
-		if (user.getId() == userId) {
+		if (user.getNameSymbol() == symbol) {
 			return true;
 		}
 	}
-	
+
 	return false;
 }
 
@@ -226,50 +763,20 @@ bool MemoryAccess::doesUserExists(int userId)
 // user statistics
 int MemoryAccess::countAlbumsOwnedOfUser(const User& user) 
 {
-	int albumsCount = 0;
-
-	for (const auto& album: m_albums) {
-		if (album.getOwnerId() == user.getId()) {
-			++albumsCount;
-		}
-	}
-
-	return albumsCount;
+	auto owned = m_albumsByOwner.find(user.getId());
+	return owned == m_albumsByOwner.end() ? 0 : static_cast<int>(owned->second.size());
 }
 
 int MemoryAccess::countAlbumsTaggedOfUser(const User& user) 
 {
-	int albumsCount = 0;
-
-	for (const auto& album: m_albums) {
-		const std::list<Picture>& pics = album.getPictures();
-		
-		for (const auto& picture: pics)	{
-			if (picture.isUserTagged(user))	{
-				albumsCount++;
-				break;
-			}
-		}
-	}
-
-	return albumsCount;
+	auto tags = m_tagsByUser.find(user.getId());
+	return tags == m_tagsByUser.end() ? 0 : getLiveAlbumsCount(tags->second);
 }
 
 int MemoryAccess::countTagsOfUser(const User& user) 
 {
-	int tagsCount = 0;
-
-	for (const auto& album: m_albums) {
-		const std::list<Picture>& pics = album.getPictures();
-		
-		for (const auto& picture: pics)	{
-			if (picture.isUserTagged(user))	{
-				tagsCount++;
-			}
-		}
-	}
-
-	return tagsCount;
+	auto tags = m_tagsByUser.find(user.getId());
+	return tags == m_tagsByUser.end() ? 0 : getLiveTagsCount(tags->second);
 }
 
 float MemoryAccess::averageTagsPerAlbumOfUser(const User& user) 
@@ -285,35 +792,48 @@ float MemoryAccess::averageTagsPerAlbumOfUser(const User& user)
 
 User MemoryAccess::getTopTaggedUser()
 {
-	std::map<int, int> userTagsCountMap;
-
-	auto albumsIter = m_albums.begin();
-	for (const auto& album: m_albums) {
-		for (const auto& picture: album.getPictures()) {
-			
-			const std::set<int>& userTags = picture.getUserTags();
-			for (const auto& user: userTags ) {
-				//As map creates default constructed values, 
-				//users which we haven't yet encountered will start from 0
-				userTagsCountMap[user]++;
-			}
-		}
-	}
-
-	if (userTagsCountMap.size() == 0) {
+	if (m_tagsByUser.size() == 0) {
 		throw MyException("There isn't any tagged user.");
 	}
 
-	int topTaggedUser = -1;
-	int currentMax = -1;
-	for (auto entry: userTagsCountMap) {
-		if (entry.second < currentMax) {
-			continue;
+	// the tag index already holds every user's count, on a tie the higher id wins.
+	// Many users are split by hash buckets, each chunk keeps its best and the bests are merged the same way
+	struct Best
+	{
+		int user { -1 };
+		int tagsCount { -1 };
+
+		void consider(int candidate, int candidateTags)
+		{
+			if (candidateTags > tagsCount || (candidateTags == tagsCount && candidate > user)) {
+				user = candidate;
+				tagsCount = candidateTags;
+			}
 		}
+	};
+
+	size_t buckets = m_tagsByUser.bucket_count();
+	size_t chunks = m_parallelism.getChunks(m_tagsByUser.size()) > 1 ? m_parallelism.getChunks(buckets) : 1;
+	std::vector<Best> partial(chunks);
+
+	m_parallelism.run(chunks, [this, buckets, chunks, &partial](size_t chunk) {
+		size_t end = Parallelism::getChunkBegin(buckets, chunks, chunk + 1);
+		for (size_t bucket = Parallelism::getChunkBegin(buckets, chunks, chunk); bucket < end; ++bucket) {
+			for (auto entry = m_tagsByUser.begin(bucket); entry != m_tagsByUser.end(bucket); ++entry) {
+				// users tagged only in deleted albums are not tagged anymore
+				int tagsCount = getLiveTagsCount(entry->second);
+				if (tagsCount > 0) {
+					partial[chunk].consider(entry->first, tagsCount);
+				}
+			}
+		}
+	});
 
-		topTaggedUser = entry.first;
-		currentMax = entry.second;
+	Best best;
+	for (const Best& candidate : partial) {
+		best.consider(candidate.user, candidate.tagsCount);
 	}
+	int topTaggedUser = best.user;
 
 	if ( -1 == topTaggedUser ) {
 		throw MyException("Failed to find most tagged user");
@@ -324,41 +844,306 @@ User MemoryAccess::getTopTaggedUser()
 
 Picture MemoryAccess::getTopTaggedPicture()
 {
-	int currentMax = -1;
-	const Picture* mostTaggedPic = nullptr;
-	for (const auto& album: m_albums) {
-		for (const Picture& picture: album.getPictures()) {
-			int tagsCount = picture.getTagsCount();
-			if (tagsCount == 0) {
+	// a scan of the tags count column, ties go to the earliest album and picture like a walk would
+	const Picture* mostTaggedPic = m_columns.findTopTagged(m_parallelism, getPendingUntags());
+	if ( mostTaggedPic == nullptr ) {
+		throw MyException("There isn't any tagged picture.");
+	}
+
+	return getLiveCopy(*mostTaggedPic);
+}
+
+/**
+ * getAlbumsStatistics - Pictures, tags, most tags on a picture and newest picture of every album.
+ * Params: None
+ * Returns: One entry per album, in no particular order.
+ */
+std::list<MemoryAccess::AlbumStatistics> MemoryAccess::getAlbumsStatistics() const
+{
+	std::list<AlbumStatistics> statistics;
+	for (const auto& aggregate : m_columns.aggregateByAlbum(m_parallelism, getPendingUntags())) {
+		const Album* album = m_columns.getAlbumOfSlot(aggregate.albumSlot);
+		statistics.push_back({ album->getName(), album->getOwnerId(), aggregate.pictures, aggregate.tags,
+			aggregate.maxTags, aggregate.newestCreationTime });
+	}
+	return statistics;
+}
+
+void MemoryAccess::setParallelism(const Parallelism& parallelism)
+{
+	m_parallelism = parallelism;
+}
+
+TagAdjacency MemoryAccess::buildTagAdjacency() const
+{
+	if (m_deletedUserTags.empty()) {
+		return m_columns.buildTagAdjacency();
+	}
+	return m_columns.buildTagAdjacency([this](int userId) { return m_deletedUserTags.count(userId) != 0; });
+}
+
+/**
+ * getTagsCountOfUsers - Returns the number of tags of every tagged user.
+ * Params: None
+ * Returns: user id -> tags count, users without tags are left out.
+ */
+std::unordered_map<int, int> MemoryAccess::getTagsCountOfUsers() const
+{
+	std::unordered_map<int, int> counts;
+	counts.reserve(m_tagsByUser.size());
+	for (const auto& entry : m_tagsByUser) {
+		int tagsCount = getLiveTagsCount(entry.second);
+		if (tagsCount > 0) {
+			counts.emplace(entry.first, tagsCount);
+		}
+	}
+	return counts;
+}
+
+std::list<Picture> MemoryAccess::getTaggedPicturesOfUser(const User& user)
+{
+	std::list<Picture> pictures;
+
+	auto tags = m_tagsByUser.find(user.getId());
+	if (tags != m_tagsByUser.end()) {
+		for (const auto& albumTags : tags->second.pictures) {
+			if (isDeleted(*albumTags.first)) {
 				continue;
 			}
+			for (const Picture* picture : albumTags.second) {
+				pictures.push_back(getLiveCopy(*picture));
+			}
+		}
+	}
 
-			if (tagsCount <= currentMax) {
-				continue;
+	return pictures;
+}
+
+// ******************* Tombstones *******************
+bool MemoryAccess::isDeleted(const Album& album) const
+{
+	return !m_deletedAlbums.empty() && m_deletedAlbums.count(&album) != 0;
+}
+
+/**
+ * getLiveTagsCount - The tags of a user that are not in deleted albums.
+ */
+int MemoryAccess::getLiveTagsCount(const UserTags& tags) const
+{
+	int tagsCount = tags.tagsCount;
+	if (tags.pictures.size() < m_deletedAlbums.size()) {
+		for (const auto& albumTags : tags.pictures) {
+			if (isDeleted(*albumTags.first)) {
+				tagsCount -= static_cast<int>(albumTags.second.size());
 			}
+		}
+		return tagsCount;
+	}
 
-			mostTaggedPic = &picture;
-			currentMax = tagsCount;
+	for (const Album* album : m_deletedAlbums) {
+		auto albumTags = tags.pictures.find(const_cast<Album*>(album));
+		if (albumTags != tags.pictures.end()) {
+			tagsCount -= static_cast<int>(albumTags->second.size());
 		}
 	}
-	if ( nullptr == mostTaggedPic ) {
-		throw MyException("There isn't any tagged picture.");
+	return tagsCount;
+}
+
+/**
+ * getLiveAlbumsCount - The albums a user is tagged in that are not deleted.
+ */
+int MemoryAccess::getLiveAlbumsCount(const UserTags& tags) const
+{
+	int albumsCount = static_cast<int>(tags.pictures.size());
+	if (tags.pictures.size() < m_deletedAlbums.size()) {
+		for (const auto& albumTags : tags.pictures) {
+			albumsCount -= isDeleted(*albumTags.first) ? 1 : 0;
+		}
+		return albumsCount;
 	}
 
-	return *mostTaggedPic;	
+	for (const Album* album : m_deletedAlbums) {
+		albumsCount -= static_cast<int>(tags.pictures.count(const_cast<Album*>(album)));
+	}
+	return albumsCount;
 }
 
-std::list<Picture> MemoryAccess::getTaggedPicturesOfUser(const User& user)
+/**
+ * getLiveCopy - Copies a stored picture (or album) without the tags of deleted users.
+ */
+Picture MemoryAccess::getLiveCopy(const Picture& picture) const
 {
-	std::list<Picture> pictures;
+	Picture copy(picture);
+	for (const auto& deleted : m_deletedUserTags) {
+		copy.untagUser(deleted.first);
+	}
+	return copy;
+}
 
-	for (const auto& album: m_albums) {
-		for (const auto& picture: album.getPictures()) {
-			if (picture.isUserTagged(user)) {
-				pictures.push_back(picture);
+Album MemoryAccess::getLiveCopy(const Album& album) const
+{
+	Album copy(album);
+	for (const auto& deleted : m_deletedUserTags) {
+		copy.untagUserInAlbum(deleted.first);
+	}
+	return copy;
+}
+
+/**
+ * getPendingUntags - The tags of deleted users still on pictures, by picture, for the column scans.
+ *                    Costs as much as the pending tags, not as the columns.
+ */
+PictureColumns::PendingUntags MemoryAccess::getPendingUntags() const
+{
+	PictureColumns::PendingUntags pending;
+	for (const auto& deleted : m_deletedUserTags) {
+		for (const auto& albumTags : deleted.second.pictures) {
+			for (const Picture* picture : albumTags.second) {
+				++pending[picture];
 			}
 		}
 	}
+	return pending;
+}
 
-	return pictures;
+/**
+ * removeDeletedUserTag - Forgets one pending tag of a deleted user without touching the picture,
+ *                        for a picture that is removed with its tags anyway.
+ */
+void MemoryAccess::removeDeletedUserTag(Album& album, const Picture& picture, int userId)
+{
+	auto deleted = m_deletedUserTags.find(userId);
+	if (deleted == m_deletedUserTags.end()) {
+		return;
+	}
+
+	auto albumTags = deleted->second.pictures.find(&album);
+	if (albumTags == deleted->second.pictures.end() || albumTags->second.erase(&picture) == 0) {
+		return;
+	}
+
+	--deleted->second.tagsCount;
+	if (albumTags->second.empty()) {
+		deleted->second.pictures.erase(albumTags);
+	}
+	if (deleted->second.pictures.empty()) {
+		m_deletedUserTags.erase(deleted);
+	}
+}
+
+/**
+ * removeDeletedUserTag - Removes one pending tag of a deleted user from its picture.
+ * Returns: false if no tag was pending.
+ */
+bool MemoryAccess::removeDeletedUserTag()
+{
+	if (m_deletedUserTags.empty()) {
+		return false;
+	}
+
+	auto deleted = m_deletedUserTags.begin();
+	auto albumTags = deleted->second.pictures.begin();
+	const Picture* picture = *albumTags->second.begin();
+
+	const_cast<Picture*>(picture)->untagUser(deleted->first);
+	m_columns.updateTagsCount(picture);
+	++m_compaction.removedTags;
+	removeDeletedUserTag(*albumTags->first, *picture, deleted->first);
+	return true;
+}
+
+/**
+ * flushDeletedUser - Removes every pending tag of a deleted user, before the id is used again.
+ */
+void MemoryAccess::flushDeletedUser(int userId)
+{
+	auto deleted = m_deletedUserTags.find(userId);
+	if (deleted == m_deletedUserTags.end()) {
+		return;
+	}
+
+	for (const auto& albumTags : deleted->second.pictures) {
+		for (const Picture* picture : albumTags.second) {
+			const_cast<Picture*>(picture)->untagUser(userId);
+			m_columns.updateTagsCount(picture);
+			++m_compaction.removedTags;
+		}
+	}
+	m_deletedUserTags.erase(deleted);
+}
+
+/**
+ * compactTombstones - Frees tombstoned tags and albums until the budget runs out.
+ *                     Pending tags go first, they may point into albums waiting to be erased.
+ * Params: budget - how long to work; the clock is read every few tags and after every album
+ * Returns: true if nothing is left to compact.
+ */
+bool MemoryAccess::compactTombstones(std::chrono::microseconds budget)
+{
+	if (m_deletedUserTags.empty() && m_albumsToErase.empty()) {
+		return true;
+	}
+
+	++m_compaction.slices;
+	auto deadline = std::chrono::steady_clock::now() + budget;
+	size_t removedTags = 0;
+	while (removeDeletedUserTag()) {
+		if (++removedTags % MEMORY_COMPACTION_CLOCK_TAGS == 0 && std::chrono::steady_clock::now() >= deadline) {
+			return false;
+		}
+	}
+
+	while (!m_albumsToErase.empty()) {
+		AlbumIterator album = m_albumsToErase.front();
+		m_albumsToErase.pop_front();
+		eraseAlbum(album);
+		if (!m_albumsToErase.empty() && std::chrono::steady_clock::now() >= deadline) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * compactTombstones - Frees every tombstoned tag and album.
+ */
+void MemoryAccess::compactTombstones()
+{
+	if (m_deletedUserTags.empty() && m_albumsToErase.empty()) {
+		return;
+	}
+
+	++m_compaction.slices;
+	while (removeDeletedUserTag()) {
+		// Left empty
+	}
+	while (!m_albumsToErase.empty()) {
+		eraseAlbum(m_albumsToErase.front());
+		m_albumsToErase.pop_front();
+	}
+}
+
+void MemoryAccess::compactAfterChange()
+{
+	if (!m_deletedUserTags.empty() || !m_albumsToErase.empty()) {
+		compactTombstones(m_compactionBudget);
+	}
+}
+
+// a budget of 0 still frees a few tags or one album per change
+void MemoryAccess::setCompactionBudget(std::chrono::microseconds budget)
+{
+	m_compactionBudget = budget;
+}
+
+MemoryAccess::CompactionStats MemoryAccess::getCompactionStats() const
+{
+	CompactionStats stats = m_compaction;
+	stats.pendingUsers = m_deletedUserTags.size();
+	stats.pendingTags = 0;
+	for (const auto& deleted : m_deletedUserTags) {
+		stats.pendingTags += deleted.second.tagsCount;
+	}
+	stats.pendingAlbums = m_albumsToErase.size();
+	return stats;
 }
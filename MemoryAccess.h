@@ -1,8 +1,19 @@
 ﻿#pragma once
+#include <chrono>
+#include <deque>
 #include <list>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include "Album.h"
+#include "CreationIndex.h"
 #include "User.h"
 #include "IDataAccess.h"
+#include "PictureColumns.h"
+
+#define MEMORY_COMPACTION_BUDGET_US 200
+#define MEMORY_COMPACTION_CLOCK_TAGS 64		// tags removed between two reads of the clock
 
 class MemoryAccess : public IDataAccess
 {
@@ -11,22 +22,45 @@ public:
 	MemoryAccess() = default;
 	virtual ~MemoryAccess() = default;
 
+	// the indexes point into this object's lists, a copy builds its own
+	MemoryAccess(const MemoryAccess& other);
+	MemoryAccess& operator=(const MemoryAccess& other);
+
 	// album related
 	const std::list<Album> getAlbums() override;
 	const std::list<Album> getAlbumsOfUser(const User& user) override;
+	// the const overloads copy and go through the moving ones
 	void createAlbum(const Album& album) override;
+	void createAlbum(Album&& album) override;
 	void deleteAlbum(const std::string& albumName, int userId) override;
 	bool doesAlbumExists(const std::string& albumName, int userId) override;
 	Album openAlbum(const std::string& albumName) override;
 	void closeAlbum(Album &pAlbum) override;
 	void printAlbums() override;
 
+	void forEachAlbum(const std::function<void(const Album&)>& fn) override;
+	void forEachAlbumOfUser(const User& user, const std::function<void(const Album&)>& fn) override;
+	bool visitPicture(const std::string& albumName, const std::string& pictureName, const std::function<void(const Picture&)>& fn) override;
+
+	// creation order comes from the maintained CreationIndex, names and tags are sorted on demand
+	std::list<Album> getAlbumsSorted(const ListingOrder& order) override;
+	std::list<Picture> getPicturesSorted(const std::string& albumName, const ListingOrder& order) override;
+
+	// lookups into the stored objects, nullptr when missing; valid until the next change
+	const Album* findAlbum(const std::string& albumName) const;
+	const Picture* findPicture(const std::string& albumName, const std::string& pictureName) const;
+
 	// picture related
 	void addPictureToAlbumByName(const std::string& albumName, const Picture& picture) override;
+	void addPictureToAlbumByName(const std::string& albumName, Picture&& picture) override;
 	void removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName) override;
 	void tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
 	void untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
 
+	bool getFileMetadata(const std::string& path, FileMetadata& metadata) override;
+	void storeFileMetadata(const std::vector<FileMetadata>& files) override;
+	void forEachFileMetadata(const std::function<void(const FileMetadata&)>& fn) override;
+
 	// user related
 	void printUsers() override;
 	void createUser(User& user) override;
@@ -49,12 +83,125 @@ public:
 	void close() override {};
 	void clear() override;
 
+	bool doesPictureExistsInAlbum(const std::string& albumName, const std::string& pictureName) override;
+	int getTheNextId(const std::string& tableName) override;
+	Picture getPictureFromAlbum(const std::string& albumName, const std::string& pictureName) override;
+	bool isUserTaggedInPicture(const User& user, const Picture& picture) override;
+	std::list<User> getUsersTaggedInPicture(const Picture& picture) override;
+	bool doesUserExists(const std::string& name) override;
+
+	struct AlbumStatistics
+	{
+		std::string albumName;
+		int ownerId;
+		int pictures;
+		int tags;
+		int maxTags;
+		int64_t newestCreationTime;		// seconds since 1970, see Timestamp
+	};
+
+	// bulk analytics over the picture columns, split over a thread pool once they are large enough.
+	// The columns only drop deleted tags and albums as they are compacted, these (and
+	// getTopTaggedPicture) leave the pending ones out of the scan like the listings do
+	void setParallelism(const Parallelism& parallelism);
+	std::list<AlbumStatistics> getAlbumsStatistics() const;
+	TagAdjacency buildTagAdjacency() const;
+
+	// deleteUser and deleteAlbum leave tombstones that every query skips at once; the tags and
+	// albums behind them are freed a slice at a time, after each change or by compactTombstones
+	struct CompactionStats
+	{
+		size_t pendingUsers { 0 };		// deleted users whose tags are still on pictures
+		size_t pendingTags { 0 };
+		size_t pendingAlbums { 0 };		// deleted albums still in memory
+		size_t removedTags { 0 };
+		size_t erasedAlbums { 0 };
+		size_t erasedPictures { 0 };
+		size_t reclaimedBytes { 0 };	// estimated, see Album::getMemoryUsage
+		size_t slices { 0 };
+	};
+	bool compactTombstones(std::chrono::microseconds budget);
+	void compactTombstones();
+	void setCompactionBudget(std::chrono::microseconds budget);
+	CompactionStats getCompactionStats() const;
+
+	// building blocks for stores that spread the albums of one user over several MemoryAccess
+	void cleanUserData(const User& user);
+	std::unordered_map<int, int> getTagsCountOfUsers() const;
+
+protected:
+	// as stored: tombstoned albums and tags are in there until compaction frees them
+	const std::list<User>& users() const;
+	const std::list<Album>& albums() const;
+
 private:
+	using AlbumIterator = std::list<Album>::iterator;
+	using UserIterator = std::list<User>::iterator;
+
+	struct AlbumKeyHash
+	{
+		size_t operator()(const std::pair<int, Symbol>& key) const;
+	};
+
+	// list nodes never move, so the indexes below stay valid until their own element is erased
 	std::list<Album> m_albums;
 	std::list<User> m_users;
+	std::map<std::string, int> m_nextIds;
+
+	std::unordered_map<int, UserIterator> m_usersById;
+	// names are looked up once (SymbolTable::find) and the indexes keyed by their symbols
+	std::unordered_map<Symbol, std::vector<AlbumIterator>> m_albumsByName;		// in creation order
+	std::unordered_map<std::pair<int, Symbol>, AlbumIterator, AlbumKeyHash> m_albumsByOwnerAndName;
+	std::unordered_map<int, std::vector<AlbumIterator>> m_albumsByOwner;			// in creation order
+
+	// inverted tag index: user id -> the pictures (grouped by album) the user is tagged in
+	struct UserTags
+	{
+		int tagsCount { 0 };
+		std::unordered_map<Album*, std::unordered_set<const Picture*>> pictures;
+	};
+	std::unordered_map<int, UserTags> m_tagsByUser;
+
+	// the pictures again, as columns for the statistics that scan all of them
+	PictureColumns m_columns;
+	Parallelism m_parallelism;
+	CreationIndex m_creation;
+	FileMetadataStore m_files;		// thread safe on its own
+
+	// tombstones: the tags of deleted users, already out of m_tagsByUser but still on the pictures
+	// and in the tags counts of the columns, and deleted albums, already out of the lookup indexes
+	// but with their pictures still in the columns (hidden) and the creation index
+	std::unordered_map<int, UserTags> m_deletedUserTags;
+	std::unordered_set<const Album*> m_deletedAlbums;
+	std::deque<AlbumIterator> m_albumsToErase;
+	std::chrono::microseconds m_compactionBudget { MEMORY_COMPACTION_BUDGET_US };
+	CompactionStats m_compaction;
+
+	void updateNextId(const std::string& tableName, int usedId);
+
+	AlbumIterator getAlbumIfExists(const std::string& albumName);
+	void copyLiveData(const MemoryAccess& other);
+	void rebuildIndexes();
+	void indexAlbum(AlbumIterator album);
+	void unlinkAlbum(AlbumIterator album);
+	void tombstoneAlbum(AlbumIterator album);
+	void eraseAlbum(AlbumIterator album);
+	bool removeDeletedUserTag();
+	void removeDeletedUserTag(Album& album, const Picture& picture, int userId);
+	void flushDeletedUser(int userId);
+	void compactAfterChange();
+
+	bool isDeleted(const Album& album) const;
+	int getLiveTagsCount(const UserTags& tags) const;
+	int getLiveAlbumsCount(const UserTags& tags) const;
+	Picture getLiveCopy(const Picture& picture) const;
+	Album getLiveCopy(const Album& album) const;
+	PictureColumns::PendingUntags getPendingUntags() const;
 
-	auto getAlbumIfExists(const std::string& albumName);
+	void indexTag(Album& album, const Picture& picture, int userId);
+	void unindexTag(Album& album, const Picture& picture, int userId);
+	void indexAlbumTags(Album& album);
+	void unindexAlbumTags(Album& album);
 
 	Album createDummyAlbum(const User& user);
-	void cleanUserData(const User& userId);
 };
@@ -0,0 +1,479 @@
+#include "MemoryJournal.h"
+#include "MyException.h"
+#include <cstring>
+#include <filesystem>
+#include <vector>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// ******************* RecordWriter ******************* 
+void RecordWriter::putUInt8(uint8_t value)
+{
+	m_bytes.push_back(static_cast<char>(value));
+}
+
+void RecordWriter::putInt32(int32_t value)
+{
+	putUInt32(static_cast<uint32_t>(value));
+}
+
+void RecordWriter::putUInt32(uint32_t value)
+{
+	for (int i = 0; i < 4; ++i) {
+		m_bytes.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+	}
+}
+
+void RecordWriter::putUInt64(uint64_t value)
+{
+	for (int i = 0; i < 8; ++i) {
+		m_bytes.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+	}
+}
+
+void RecordWriter::putString(const std::string& value)
+{
+	putUInt32(static_cast<uint32_t>(value.size()));
+	m_bytes.append(value);
+}
+
+void RecordWriter::putUser(const User& user)
+{
+	putInt32(user.getId());
+	putString(user.getName());
+}
+
+void RecordWriter::putPicture(const Picture& picture)
+{
+	putInt32(picture.getId());
+	putString(picture.getName());
+	putString(picture.getPath());
+	putString(picture.getCreationDate());
+	putUInt32(static_cast<uint32_t>(picture.getTagsCount()));
+	for (int userId : picture.getUserTags()) {
+		putInt32(userId);
+	}
+}
+
+void RecordWriter::putAlbum(const Album& album)
+{
+	putInt32(album.getId());
+	putInt32(album.getOwnerId());
+	putString(album.getName());
+	putString(album.getCreationDate());
+
+	const std::list<Picture>& pictures = album.pictures();
+	putUInt32(static_cast<uint32_t>(pictures.size()));
+	for (const auto& picture : pictures) {
+		putPicture(picture);
+	}
+}
+
+const std::string& RecordWriter::getBytes() const
+{
+	return m_bytes;
+}
+
+void RecordWriter::clear()
+{
+	m_bytes.clear();
+}
+
+
+// ******************* RecordReader ******************* 
+RecordReader::RecordReader(const char* data, size_t size) :
+	m_data(data), m_size(size)
+{
+	// Left empty
+}
+
+const char* RecordReader::take(size_t bytes)
+{
+	if (m_size - m_position < bytes) {
+		throw MyException("Journal record is truncated");
+	}
+	const char* at = m_data + m_position;
+	m_position += bytes;
+	return at;
+}
+
+uint8_t RecordReader::getUInt8()
+{
+	return static_cast<uint8_t>(*take(1));
+}
+
+int32_t RecordReader::getInt32()
+{
+	return static_cast<int32_t>(getUInt32());
+}
+
+uint32_t RecordReader::getUInt32()
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(take(4));
+	uint32_t value = 0;
+	for (int i = 0; i < 4; ++i) {
+		value |= static_cast<uint32_t>(bytes[i]) << (8 * i);
+	}
+	return value;
+}
+
+uint64_t RecordReader::getUInt64()
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(take(8));
+	uint64_t value = 0;
+	for (int i = 0; i < 8; ++i) {
+		value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+	}
+	return value;
+}
+
+std::string RecordReader::getString()
+{
+	uint32_t size = getUInt32();
+	const char* bytes = take(size);
+	return std::string(bytes, size);
+}
+
+User RecordReader::getUser()
+{
+	int id = getInt32();
+	return User(id, getString());
+}
+
+Picture RecordReader::getPicture()
+{
+	int id = getInt32();
+	std::string name = getString();
+	std::string path = getString();
+	std::string creationDate = getString();
+	Picture picture(id, name, path, creationDate);
+
+	uint32_t tags = getUInt32();
+	for (uint32_t i = 0; i < tags; ++i) {
+		picture.tagUser(getInt32());
+	}
+	return picture;
+}
+
+Album RecordReader::getAlbum()
+{
+	int id = getInt32();
+	int ownerId = getInt32();
+	std::string name = getString();
+	Album album(ownerId, name, getString());
+	album.setId(id);
+
+	uint32_t pictures = getUInt32();
+	for (uint32_t i = 0; i < pictures; ++i) {
+		album.addPicture(getPicture());
+	}
+	return album;
+}
+
+bool RecordReader::atEnd() const
+{
+	return m_position == m_size;
+}
+
+
+// ******************* MemoryJournal ******************* 
+MemoryJournal::MemoryJournal(std::chrono::milliseconds groupCommitWindow) :
+	m_groupCommitWindow(groupCommitWindow)
+{
+	// Left empty
+}
+
+MemoryJournal::~MemoryJournal()
+{
+	close();
+}
+
+/**
+ * open - Opens (or creates) a journal file for appending and starts the flusher.
+ * Params: path - journal file
+ * Returns: None
+ */
+void MemoryJournal::open(const std::string& path)
+{
+	m_file = fopen(path.c_str(), "ab");
+	if (m_file == nullptr) {
+		throw MyException("Failed to open journal " + path);
+	}
+	fseek(m_file, 0, SEEK_END);
+	m_fileBytes = static_cast<uint64_t>(ftell(m_file));
+	// the records are synced with the file, its name has to be synced once with the directory
+	syncDirectory(getDirectory(path));
+
+	m_stop = false;
+	m_failure.clear();
+	m_flusher = std::thread(&MemoryJournal::flusherLoop, this);
+}
+
+/**
+ * close - Flushes everything still pending and closes the journal.
+ */
+void MemoryJournal::close()
+{
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+		if (m_file == nullptr) {
+			return;
+		}
+		drain(guard);
+		m_stop = true;
+	}
+	m_hasPending.notify_all();
+	m_flusher.join();
+
+	fclose(m_file);
+	m_file = nullptr;
+}
+
+/**
+ * append - Queues a record for the next group commit.
+ * Params: payload - encoded record
+ * Returns: Ticket to pass to waitDurable.
+ */
+uint64_t MemoryJournal::append(const std::string& payload)
+{
+	char header[8];
+	uint32_t size = static_cast<uint32_t>(payload.size());
+	uint32_t crc = checksum(payload.data(), payload.size());
+	for (int i = 0; i < 4; ++i) {
+		header[i] = static_cast<char>((size >> (8 * i)) & 0xFF);
+		header[4 + i] = static_cast<char>((crc >> (8 * i)) & 0xFF);
+	}
+
+	uint64_t ticket;
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		throwIfFailed();
+		m_pending.append(header, sizeof(header));
+		m_pending.append(payload);
+		ticket = ++m_appended;
+	}
+	m_hasPending.notify_one();
+	return ticket;
+}
+
+/**
+ * waitDurable - Blocks until the record of a ticket reached the disk.
+ * Throws MyException if the journal failed before it did.
+ */
+void MemoryJournal::waitDurable(uint64_t ticket)
+{
+	std::unique_lock<std::mutex> guard(m_lock);
+	m_flushed.wait(guard, [&] { return m_durable >= ticket || !m_failure.empty(); });
+	if (m_durable < ticket) {
+		throwIfFailed();
+	}
+}
+
+/**
+ * rotate - Makes everything appended so far durable and continues in a new file.
+ * Params: newPath - file the following records go to
+ * Returns: None
+ */
+void MemoryJournal::rotate(const std::string& newPath)
+{
+	std::unique_lock<std::mutex> guard(m_lock);
+	drain(guard);
+	throwIfFailed();
+
+	FILE* next = fopen(newPath.c_str(), "ab");
+	if (next == nullptr) {
+		throw MyException("Failed to open journal " + newPath);
+	}
+	syncDirectory(getDirectory(newPath));
+	fclose(m_file);
+	m_file = next;
+	m_fileBytes = 0;
+}
+
+uint64_t MemoryJournal::getFileBytes() const
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	return m_fileBytes;
+}
+
+// waits (with the lock held by guard) until the flusher wrote (or, once failed, dropped) everything that is pending
+void MemoryJournal::drain(std::unique_lock<std::mutex>& guard)
+{
+	while (m_writing || !m_pending.empty()) {
+		m_hasPending.notify_all();
+		m_flushed.wait(guard);
+	}
+}
+
+// with the lock held
+void MemoryJournal::throwIfFailed() const
+{
+	if (!m_failure.empty()) {
+		throw MyException(m_failure);
+	}
+}
+
+void MemoryJournal::flusherLoop()
+{
+	std::unique_lock<std::mutex> guard(m_lock);
+	while (true) {
+		m_hasPending.wait(guard, [&] { return m_stop || !m_pending.empty(); });
+		if (m_pending.empty() && m_stop) {
+			return;
+		}
+
+		// let more records join this commit
+		if (!m_stop && m_groupCommitWindow.count() > 0) {
+			guard.unlock();
+			std::this_thread::sleep_for(m_groupCommitWindow);
+			guard.lock();
+		}
+
+		std::string batch;
+		batch.swap(m_pending);
+		uint64_t batchTicket = m_appended;
+		FILE* file = m_file;
+		m_writing = true;
+
+		guard.unlock();
+		bool written = fwrite(batch.data(), 1, batch.size(), file) == batch.size() && fflush(file) == 0 && syncFile(file);
+		guard.lock();
+
+		m_writing = false;
+		if (written) {
+			m_fileBytes += batch.size();
+			m_durable = batchTicket;
+		}
+		else {
+			// the tail of the file is unknown now, a later batch would follow a torn record that
+			// replay stops at, so nothing more is written
+			m_failure = "Failed to write the journal to disk";
+			m_pending.clear();
+		}
+		m_flushed.notify_all();
+	}
+}
+
+/**
+ * syncFile - Forces what was written to a file (and flushed from its buffer) to the disk.
+ * Params: file - open file
+ * Returns: false if the disk did not confirm it.
+ */
+bool MemoryJournal::syncFile(FILE* file)
+{
+#ifdef _WIN32
+	return _commit(_fileno(file)) == 0;
+#else
+	return fsync(fileno(file)) == 0;
+#endif
+}
+
+/**
+ * syncDirectory - Forces the entries of a directory (files created, renamed or removed in it) to the disk.
+ * Params: directory - path of the directory
+ * Returns: false if the disk did not confirm it.
+ */
+bool MemoryJournal::syncDirectory(const std::string& directory)
+{
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(directory.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	bool synced = FlushFileBuffers(handle) != 0;
+	CloseHandle(handle);
+	return synced;
+#else
+	int handle = ::open(directory.c_str(), O_RDONLY);
+	if (handle < 0) {
+		return false;
+	}
+	bool synced = fsync(handle) == 0;
+	::close(handle);
+	return synced;
+#endif
+}
+
+std::string MemoryJournal::getDirectory(const std::string& path)
+{
+	std::filesystem::path parent = std::filesystem::path(path).parent_path();
+	return parent.empty() ? std::string(".") : parent.string();
+}
+
+/**
+ * checksum - CRC-32 (IEEE) of a buffer.
+ */
+uint32_t MemoryJournal::checksum(const char* data, size_t size)
+{
+	static const std::vector<uint32_t> table = [] {
+		std::vector<uint32_t> entries(256);
+		for (uint32_t i = 0; i < 256; ++i) {
+			uint32_t value = i;
+			for (int bit = 0; bit < 8; ++bit) {
+				value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+			}
+			entries[i] = value;
+		}
+		return entries;
+	}();
+
+	uint32_t crc = 0xFFFFFFFFu;
+	for (size_t i = 0; i < size; ++i) {
+		crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+	}
+	return crc ^ 0xFFFFFFFFu;
+}
+
+/**
+ * replay - Feeds every intact record of a journal file to a callback.
+ * Params: path - journal file, apply - called with a reader over each record's payload
+ * Returns: Number of records replayed. Reading stops at the first torn or corrupt record
+ *          (a crash in the middle of a write only ever damages the tail).
+ */
+size_t MemoryJournal::replay(const std::string& path, const std::function<void(RecordReader&)>& apply)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == nullptr) {
+		return 0;
+	}
+
+	std::string contents;
+	char chunk[1 << 16];
+	size_t read;
+	while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+		contents.append(chunk, read);
+	}
+	fclose(file);
+
+	size_t records = 0;
+	size_t position = 0;
+	while (contents.size() - position >= 8) {
+		RecordReader header(contents.data() + position, 8);
+		uint32_t size = header.getUInt32();
+		uint32_t crc = header.getUInt32();
+		if (contents.size() - position - 8 < size) {
+			break;
+		}
+
+		const char* payload = contents.data() + position + 8;
+		if (checksum(payload, size) != crc) {
+			break;
+		}
+
+		RecordReader reader(payload, size);
+		apply(reader);
+		++records;
+		position += 8 + size;
+	}
+
+	return records;
+}
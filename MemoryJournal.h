@@ -0,0 +1,118 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Album.h"
+#include "User.h"
+
+/*
+ * RecordWriter - little endian encoder for journal records and snapshots.
+ */
+class RecordWriter
+{
+public:
+	void putUInt8(uint8_t value);
+	void putInt32(int32_t value);
+	void putUInt32(uint32_t value);
+	void putUInt64(uint64_t value);
+	void putString(const std::string& value);
+	void putUser(const User& user);
+	void putPicture(const Picture& picture);
+	void putAlbum(const Album& album);
+
+	const std::string& getBytes() const;
+	void clear();
+
+private:
+	std::string m_bytes;
+};
+
+/*
+ * RecordReader - decoder for what RecordWriter wrote, throws MyException on truncated input.
+ */
+class RecordReader
+{
+public:
+	RecordReader(const char* data, size_t size);
+
+	uint8_t getUInt8();
+	int32_t getInt32();
+	uint32_t getUInt32();
+	uint64_t getUInt64();
+	std::string getString();
+	User getUser();
+	Picture getPicture();
+	Album getAlbum();
+
+	bool atEnd() const;
+
+private:
+	const char* m_data;
+	size_t m_size;
+	size_t m_position { 0 };
+
+	const char* take(size_t bytes);
+};
+
+/*
+ * MemoryJournal - append only file of checksummed records with group commit.
+ * Appenders only copy their record into a pending buffer; a flusher thread writes
+ * everything that gathered during the group commit window with one write and one
+ * fsync, then wakes whoever waits for durability.
+ *
+ * On disk every record is [u32 length][u32 crc32 of payload][payload].
+ *
+ * A batch the disk did not take (short write, failed flush or fsync) fails the journal for
+ * good: nothing is written after it, and append, waitDurable and rotate throw MyException
+ * until the journal is opened again.
+ */
+class MemoryJournal
+{
+public:
+	explicit MemoryJournal(std::chrono::milliseconds groupCommitWindow);
+	~MemoryJournal();
+	MemoryJournal(const MemoryJournal&) = delete;
+	MemoryJournal& operator=(const MemoryJournal&) = delete;
+
+	void open(const std::string& path);
+	void close();
+
+	uint64_t append(const std::string& payload);
+	void waitDurable(uint64_t ticket);
+	void rotate(const std::string& newPath);
+
+	uint64_t getFileBytes() const;
+
+	static uint32_t checksum(const char* data, size_t size);
+	static size_t replay(const std::string& path, const std::function<void(RecordReader&)>& apply);
+
+	// for other files that have to be on disk before a journal is dropped, e.g. snapshots
+	static bool syncFile(FILE* file);
+	static bool syncDirectory(const std::string& directory);
+	static std::string getDirectory(const std::string& path);	// "." for a bare file name
+
+private:
+	std::chrono::milliseconds m_groupCommitWindow;
+	FILE* m_file { nullptr };
+	std::string m_pending;
+	uint64_t m_appended { 0 };
+	uint64_t m_durable { 0 };
+	uint64_t m_fileBytes { 0 };
+	bool m_writing { false };
+	bool m_stop { false };
+	std::string m_failure;		// why the journal failed, empty while it works
+
+	mutable std::mutex m_lock;
+	std::condition_variable m_hasPending;
+	std::condition_variable m_flushed;
+	std::thread m_flusher;
+
+	void flusherLoop();
+	void drain(std::unique_lock<std::mutex>& guard);
+	void throwIfFailed() const;
+};
@@ -0,0 +1,312 @@
+#include "PerceptualHash.h"
+#include <algorithm>
+#include <numeric>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define HASH_COLUMNS 9
+#define HASH_ROWS 8
+#define SLICE_BITS 16
+#define SLICE_VALUES (1 << SLICE_BITS)
+
+// ******************* Kernels *******************
+static int popcount64(uint64_t bits)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	return static_cast<int>(__popcnt64(bits));
+#elif defined(_MSC_VER)
+	return static_cast<int>(__popcnt(static_cast<uint32_t>(bits)) + __popcnt(static_cast<uint32_t>(bits >> 32)));
+#else
+	return __builtin_popcountll(bits);
+#endif
+}
+
+static uint32_t sliceOf(uint64_t hash, int slice)
+{
+	return static_cast<uint32_t>(hash >> (slice * SLICE_BITS)) & (SLICE_VALUES - 1);
+}
+
+void PerceptualIndex::scan(const uint64_t* hashes, size_t count, uint64_t hash, int radius, std::vector<uint32_t>& matches)
+{
+	if (radius < 0) {
+		return;
+	}
+
+	size_t i = 0;
+#if defined(__AVX2__)
+	// popcount of 4 hashes at once: a nibble lookup per byte, then the bytes of each lane summed
+	const __m256i nibbleCounts = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i lowNibbles = _mm256_set1_epi8(0x0F);
+	const __m256i query = _mm256_set1_epi64x(static_cast<long long>(hash));
+	const __m256i limit = _mm256_set1_epi64x(radius);
+	for (; i + 4 <= count; i += 4) {
+		__m256i difference = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(hashes + i)), query);
+		__m256i low = _mm256_shuffle_epi8(nibbleCounts, _mm256_and_si256(difference, lowNibbles));
+		__m256i high = _mm256_shuffle_epi8(nibbleCounts, _mm256_and_si256(_mm256_srli_epi16(difference, 4), lowNibbles));
+		__m256i distances = _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+		int farther = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(distances, limit)));
+		int within = ~farther & 0xF;
+		while (within != 0) {
+			int lane = popcount64(static_cast<uint64_t>((within & -within) - 1));
+			matches.push_back(static_cast<uint32_t>(i + lane));
+			within &= within - 1;
+		}
+	}
+#endif
+	for (; i < count; ++i) {
+		if (popcount64(hashes[i] ^ hash) <= radius) {
+			matches.push_back(static_cast<uint32_t>(i));
+		}
+	}
+}
+
+bool PerceptualIndex::isVectorized()
+{
+#if defined(__AVX2__)
+	return true;
+#else
+	return false;
+#endif
+}
+
+// ******************* PerceptualHash *******************
+
+/**
+ * compute - Averages the luminance of the image over a 9 x 8 grid and compares neighbours.
+ * Params: image - decoded pixels, any size
+ * Returns: The hash, row by row from the top with the first comparison in the highest bit.
+ */
+uint64_t PerceptualHash::compute(const Image& image)
+{
+	if (image.width <= 0 || image.height <= 0) {
+		return 0;
+	}
+
+	uint64_t sums[HASH_ROWS][HASH_COLUMNS] = { { 0 } };
+	uint32_t counts[HASH_ROWS][HASH_COLUMNS] = { { 0 } };
+	std::vector<uint8_t> columnCells(image.width);
+	for (int x = 0; x < image.width; ++x) {
+		columnCells[x] = static_cast<uint8_t>(static_cast<int64_t>(x) * HASH_COLUMNS / image.width);
+	}
+
+	const uint8_t* pixel = image.pixels.data();
+	for (int y = 0; y < image.height; ++y) {
+		int row = static_cast<int>(static_cast<int64_t>(y) * HASH_ROWS / image.height);
+		uint64_t* rowSums = sums[row];
+		uint32_t* rowCounts = counts[row];
+		for (int x = 0; x < image.width; ++x, pixel += 3) {
+			// ITU-R BT.601 luma in 8 bit fixed point
+			rowSums[columnCells[x]] += (77 * pixel[0] + 150 * pixel[1] + 29 * pixel[2]) >> 8;
+			++rowCounts[columnCells[x]];
+		}
+	}
+
+	// averages in 1/256 steps; cells an image too small for the grid left empty take the pixel under their centre
+	uint64_t cells[HASH_ROWS][HASH_COLUMNS];
+	for (int row = 0; row < HASH_ROWS; ++row) {
+		for (int column = 0; column < HASH_COLUMNS; ++column) {
+			if (counts[row][column] != 0) {
+				cells[row][column] = sums[row][column] * 256 / counts[row][column];
+				continue;
+			}
+			int64_t x = static_cast<int64_t>(2 * column + 1) * image.width / (2 * HASH_COLUMNS);
+			int64_t y = static_cast<int64_t>(2 * row + 1) * image.height / (2 * HASH_ROWS);
+			const uint8_t* centre = image.pixels.data() + (y * image.width + x) * 3;
+			cells[row][column] = static_cast<uint64_t>((77 * centre[0] + 150 * centre[1] + 29 * centre[2]) >> 8) * 256;
+		}
+	}
+
+	uint64_t hash = 0;
+	for (int row = 0; row < HASH_ROWS; ++row) {
+		for (int column = 0; column + 1 < HASH_COLUMNS; ++column) {
+			hash = (hash << 1) | (cells[row][column] > cells[row][column + 1] ? 1 : 0);
+		}
+	}
+	return hash;
+}
+
+int PerceptualHash::distance(uint64_t first, uint64_t second)
+{
+	return popcount64(first ^ second);
+}
+
+// ******************* PerceptualIndex *******************
+
+/**
+ * PerceptualIndex - Builds the slice tables with a counting sort per slice.
+ * Params: hashes - the indexed hashes, positions in them identify the results
+ */
+PerceptualIndex::PerceptualIndex(std::vector<uint64_t> hashes) :
+	m_hashes(std::move(hashes))
+{
+	for (int slice = 0; slice < PERCEPTUAL_INDEX_CHUNKS; ++slice) {
+		std::vector<uint32_t>& offsets = m_offsets[slice];
+		offsets.assign(SLICE_VALUES + 1, 0);
+		for (uint64_t hash : m_hashes) {
+			++offsets[sliceOf(hash, slice) + 1];
+		}
+		std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+		std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+		std::vector<uint32_t>& positions = m_positions[slice];
+		positions.resize(m_hashes.size());
+		for (size_t position = 0; position < m_hashes.size(); ++position) {
+			positions[next[sliceOf(m_hashes[position], slice)]++] = static_cast<uint32_t>(position);
+		}
+	}
+}
+
+size_t PerceptualIndex::size() const
+{
+	return m_hashes.size();
+}
+
+uint64_t PerceptualIndex::getHash(size_t position) const
+{
+	return m_hashes[position];
+}
+
+/**
+ * forEachCandidate - Calls found(position) once for every hash within radius (at most
+ * PERCEPTUAL_INDEX_MAX_RADIUS). A hash is reported from the first slice it is close enough on,
+ * the later slices that would find it again skip it.
+ */
+template <typename Function>
+void PerceptualIndex::forEachCandidate(uint64_t hash, int radius, Function found) const
+{
+	int sliceRadius = radius / PERCEPTUAL_INDEX_CHUNKS;
+	for (int slice = 0; slice < PERCEPTUAL_INDEX_CHUNKS; ++slice) {
+		const std::vector<uint32_t>& offsets = m_offsets[slice];
+		const std::vector<uint32_t>& positions = m_positions[slice];
+
+		auto probe = [&](uint32_t value) {
+			for (uint32_t i = offsets[value]; i < offsets[value + 1]; ++i) {
+				uint32_t position = positions[i];
+				uint64_t difference = m_hashes[position] ^ hash;
+				if (popcount64(difference) > radius) {
+					continue;
+				}
+				bool reported = false;
+				for (int before = 0; before < slice && !reported; ++before) {
+					reported = popcount64(sliceOf(difference, before)) <= sliceRadius;
+				}
+				if (!reported) {
+					found(position);
+				}
+			}
+		};
+
+		// the slice values at most sliceRadius (0 to 2) bits away
+		uint32_t value = sliceOf(hash, slice);
+		probe(value);
+		for (int first = 0; sliceRadius >= 1 && first < SLICE_BITS; ++first) {
+			probe(value ^ (1u << first));
+			for (int second = first + 1; sliceRadius >= 2 && second < SLICE_BITS; ++second) {
+				probe(value ^ (1u << first) ^ (1u << second));
+			}
+		}
+	}
+}
+
+std::vector<uint32_t> PerceptualIndex::findWithin(uint64_t hash, int radius) const
+{
+	std::vector<uint32_t> matches;
+	if (radius > PERCEPTUAL_INDEX_MAX_RADIUS) {
+		scan(m_hashes.data(), m_hashes.size(), hash, radius, matches);
+		return matches;
+	}
+	if (radius >= 0) {
+		forEachCandidate(hash, radius, [&matches](uint32_t position) {
+			matches.push_back(position);
+		});
+		std::sort(matches.begin(), matches.end());
+	}
+	return matches;
+}
+
+std::vector<std::pair<uint32_t, uint32_t>> PerceptualIndex::findPairs(int radius, const Parallelism& parallelism) const
+{
+	size_t count = m_hashes.size();
+	size_t chunks = parallelism.getChunks(count);
+	std::vector<std::vector<std::pair<uint32_t, uint32_t>>> chunkPairs(chunks);
+
+	parallelism.run(chunks, [this, radius, count, chunks, &chunkPairs](size_t chunk) {
+		std::vector<uint32_t> matches;
+		size_t end = Parallelism::getChunkBegin(count, chunks, chunk + 1);
+		for (size_t first = Parallelism::getChunkBegin(count, chunks, chunk); first < end; ++first) {
+			matches.clear();
+			if (radius > PERCEPTUAL_INDEX_MAX_RADIUS) {
+				// only the later hashes, every pair is found from its first position
+				scan(m_hashes.data() + first + 1, count - first - 1, m_hashes[first], radius, matches);
+				for (uint32_t& match : matches) {
+					match += static_cast<uint32_t>(first + 1);
+				}
+			}
+			else {
+				forEachCandidate(m_hashes[first], radius, [first, &matches](uint32_t position) {
+					if (position > first) {
+						matches.push_back(position);
+					}
+				});
+				std::sort(matches.begin(), matches.end());
+			}
+			for (uint32_t second : matches) {
+				chunkPairs[chunk].emplace_back(static_cast<uint32_t>(first), second);
+			}
+		}
+	});
+
+	std::vector<std::pair<uint32_t, uint32_t>> pairs;
+	for (auto& found : chunkPairs) {
+		pairs.insert(pairs.end(), found.begin(), found.end());
+	}
+	return pairs;
+}
+
+std::vector<std::vector<uint32_t>> PerceptualIndex::findGroups(int radius, const Parallelism& parallelism) const
+{
+	// union-find over the pairs, the smaller position becomes the root
+	std::vector<uint32_t> parents(m_hashes.size());
+	std::iota(parents.begin(), parents.end(), 0);
+	auto root = [&parents](uint32_t position) {
+		while (parents[position] != position) {
+			parents[position] = parents[parents[position]];
+			position = parents[position];
+		}
+		return position;
+	};
+	for (const auto& pair : findPairs(radius, parallelism)) {
+		uint32_t first = root(pair.first);
+		uint32_t second = root(pair.second);
+		if (first != second) {
+			parents[std::max(first, second)] = std::min(first, second);
+		}
+	}
+
+	std::vector<uint32_t> sizes(m_hashes.size(), 0);
+	for (uint32_t position = 0; position < m_hashes.size(); ++position) {
+		++sizes[root(position)];
+	}
+
+	// a root is the smallest position of its group, so groups start in position order
+	std::vector<int> groupOfRoot(m_hashes.size(), -1);
+	std::vector<std::vector<uint32_t>> groups;
+	for (uint32_t position = 0; position < m_hashes.size(); ++position) {
+		uint32_t top = root(position);
+		if (sizes[top] < 2) {
+			continue;
+		}
+		if (groupOfRoot[top] < 0) {
+			groupOfRoot[top] = static_cast<int>(groups.size());
+			groups.emplace_back();
+			groups.back().reserve(sizes[top]);
+		}
+		groups[groupOfRoot[top]].push_back(position);
+	}
+	return groups;
+}
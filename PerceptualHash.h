@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "ImageDecoder.h"
+#include "ThreadPool.h"
+
+#define PERCEPTUAL_INDEX_CHUNKS 4				// 16 bit slices of a hash, one table each
+#define PERCEPTUAL_INDEX_MAX_RADIUS 11			// wider searches scan every hash
+#define PERCEPTUAL_DUPLICATE_DISTANCE 6			// differing bits that still make a near duplicate
+
+/*
+ * PerceptualHash - 64 bit difference hash (dHash) of an image: the luminance is averaged down to
+ * 9 x 8 cells and every bit says whether a cell is brighter than its right neighbour. Scaling,
+ * recompression and small edits flip few bits, so near duplicates are hashes a short Hamming
+ * distance apart.
+ */
+class PerceptualHash
+{
+public:
+	static uint64_t compute(const Image& image);
+	static int distance(uint64_t first, uint64_t second);
+};
+
+/*
+ * PerceptualIndex - multi-index hash table over a fixed set of hashes. Each 16 bit slice of a hash
+ * has its own table; two hashes within distance r agree to within r / 4 bits on at least one slice,
+ * so a search probes the slice values that close to the query and checks the hashes found there.
+ * Every candidate is counted with a popcount, and the wide searches fall back to scan(), a linear
+ * popcount scan (AVX2 when the build enables it).
+ */
+class PerceptualIndex
+{
+public:
+	explicit PerceptualIndex(std::vector<uint64_t> hashes);
+
+	size_t size() const;
+	uint64_t getHash(size_t position) const;
+
+	// positions of the hashes within radius of hash, each once, ascending
+	std::vector<uint32_t> findWithin(uint64_t hash, int radius) const;
+
+	// every pair (first < second) of positions within radius, split over parallelism
+	std::vector<std::pair<uint32_t, uint32_t>> findPairs(int radius, const Parallelism& parallelism) const;
+
+	// the positions linked by pairs within radius, groups of two or more ordered by their first position
+	std::vector<std::vector<uint32_t>> findGroups(int radius, const Parallelism& parallelism) const;
+
+	// appends the i in [0, count) with distance(hashes[i], hash) <= radius to matches, ascending
+	static void scan(const uint64_t* hashes, size_t count, uint64_t hash, int radius, std::vector<uint32_t>& matches);
+	static bool isVectorized();
+
+private:
+	std::vector<uint64_t> m_hashes;
+	// per slice: the positions sorted by slice value, and where each value starts (65536 + 1)
+	std::vector<uint32_t> m_offsets[PERCEPTUAL_INDEX_CHUNKS];
+	std::vector<uint32_t> m_positions[PERCEPTUAL_INDEX_CHUNKS];
+
+	template <typename Function>
+	void forEachCandidate(uint64_t hash, int radius, Function found) const;
+};
@@ -1,18 +1,31 @@
 ﻿#include "Picture.h"
-#include <ctime>
-#include <sstream>
+#include "DirectoryTable.h"
+#include "Timestamp.h"
+#include <type_traits>
+#include <utility>
 
+// lists and vectors of pictures move them instead of copying when they grow or are handed over
+static_assert(std::is_nothrow_move_constructible<Picture>::value && std::is_nothrow_move_assignable<Picture>::value,
+	"Picture moves must not throw");
+
+
+Picture::Picture() :
+	m_pictureId(0), m_directoryId(NO_DIRECTORY), m_creationTime(0), _albumId(0)
+{
+	// Left empty
+}
 
 Picture::Picture(int id, const std::string& name): 
-	m_pictureId(id), m_name(name), m_pathOnDisk(""), m_creationDate("")
+	m_pictureId(id), m_name(name), m_directoryId(NO_DIRECTORY), m_fileName(""), m_creationTime(0), m_creationDate("")
 {
 	setCreationDateNow();
 }
 
-Picture::Picture(int id, const std::string& name, const std::string& pathOnDisk, const std::string& creationDate)
-	: m_pictureId(id), m_name(name), m_pathOnDisk(pathOnDisk), m_creationDate(creationDate)
+Picture::Picture(int id, const std::string& name, const std::string& pathOnDisk, std::string creationDate)
+	: m_pictureId(id), m_name(name), m_directoryId(NO_DIRECTORY),
+	m_creationTime(Timestamp::parse(creationDate)), m_creationDate(std::move(creationDate))
 {
-	// Left empty
+	setPath(pathOnDisk);
 }
 
 int Picture::getId() const
@@ -27,22 +40,48 @@ void Picture::setId(int id)
 
 const std::string& Picture::getName() const
 {
-	return m_name;
+	return m_name.get();
+}
+
+Symbol Picture::getNameSymbol() const
+{
+	return m_name.getSymbol();
 }
 
 void Picture::setName(const std::string& name)
 {
-	m_name = name;
+	m_name = InternedName(name);
 }
 
-const std::string& Picture::getPath() const
+std::string Picture::getPath() const
 {
-	return m_pathOnDisk;
+	if (m_directoryId == NO_DIRECTORY) {
+		return m_fileName;
+	}
+	return DirectoryTable::getPath(m_directoryId) + m_fileName;
 }
 
 void Picture::setPath(const std::string& location)
 {
-	m_pathOnDisk = location;
+	std::string directory;
+	DirectoryTable::splitPath(location, directory, m_fileName);
+	m_directoryId = directory.empty() ? NO_DIRECTORY : DirectoryTable::intern(directory);
+}
+
+int Picture::getDirectoryId() const
+{
+	return m_directoryId;
+}
+
+const std::string& Picture::getFileName() const
+{
+	return m_fileName;
+}
+
+void Picture::setFileLocation(int directoryId, std::string fileName)
+{
+	m_directoryId = directoryId;
+	m_fileName = std::move(fileName);
 }
 
 const std::string& Picture::getCreationDate() const
@@ -50,27 +89,31 @@ const std::string& Picture::getCreationDate() const
 	return m_creationDate;
 }
 
-void Picture::setCreationDate(const std::string& creationTime)
+int64_t Picture::getCreationTime() const
 {
-	m_creationDate = creationTime;
+	return m_creationTime;
+}
+
+void Picture::setCreationDate(std::string creationTime)
+{
+	m_creationTime = Timestamp::parse(creationTime);
+	m_creationDate = std::move(creationTime);
 }
 
 void Picture::setCreationDateNow()
 {
-	time_t now = time(nullptr);
-	std::stringstream oss;
-	oss << std::put_time(localtime(&now), "%d/%m/%Y %H:%M:%S");
-	m_creationDate = oss.str();
+	m_creationTime = Timestamp::now();
+	m_creationDate = Timestamp::format(m_creationTime);
 }
 
 bool Picture::isUserTagged(const User& user) const
 {
-	return std::find(m_usersTags.begin(), m_usersTags.end(), user.getId()) != m_usersTags.end();
+	return m_usersTags.contains(user.getId());
 }
 
 bool Picture::isUserTagged(int userId) const
 {
-	return std::find(m_usersTags.begin(), m_usersTags.end(), userId) != m_usersTags.end();
+	return m_usersTags.contains(userId);
 }
 
 void Picture::tagUser(const User& user)
@@ -85,16 +128,12 @@ void Picture::tagUser(int userId)
 
 void Picture::untagUser(const User& user)
 {
-	if (isUserTagged(user)) {
-		m_usersTags.erase(std::find(m_usersTags.begin(), m_usersTags.end(), user.getId()));
-	}
+	m_usersTags.erase(user.getId());
 }
 
 void Picture::untagUser(int userId)
 {
-	if (isUserTagged(userId)) {
-		m_usersTags.erase(std::find(m_usersTags.begin(), m_usersTags.end(), userId));
-	}
+	m_usersTags.erase(userId);
 }
 
 int Picture::getTagsCount() const
@@ -102,19 +141,24 @@ int Picture::getTagsCount() const
 	return m_usersTags.size();
 }
 
-const std::set<int>& Picture::getUserTags() const
+const TagSet& Picture::getUserTags() const
 {
 	return m_usersTags;
 }
 
+size_t Picture::getMemoryUsage() const
+{
+	return sizeof(Picture) + LIST_NODE_OVERHEAD + m_fileName.capacity() + m_creationDate.capacity() + m_usersTags.getHeapBytes();
+}
+
 std::string Picture::getLocation() const
 {
-	return this->_location;
+	return getPath();
 }
 
 void Picture::setLocation(const std::string& val)
 {
-	this->_location = val;
+	setPath(val);
 }
 
 int Picture::getAlbumId() const
@@ -134,7 +178,7 @@ bool Picture::operator==(const Picture& other) const
 
 std::ostream& operator<<(std::ostream& strOut, const Picture& pic) {
 	strOut << "Picture@" << pic.m_pictureId << ": ["
-		<< pic.m_name << ", " << pic.m_creationDate << ", " << pic.m_pathOnDisk <<
+		<< pic.getName() << ", " << pic.m_creationDate << ", " << pic.getPath() <<
 		"] " << pic.getTagsCount() << " users tagged : ";
 	
 	for (const auto user :  pic.m_usersTags) {
@@ -1,27 +1,42 @@
 ﻿#pragma once
+#include "SymbolTable.h"
+#include "TagSet.h"
 #include "User.h"
-#include <set>
+#include <cstdint>
 #include <string>
 #include <memory>
 #include <iomanip>
 
+// the two links of a std::list node
+#define LIST_NODE_OVERHEAD (2 * sizeof(void*))
+
 class Picture
 {
 public:
+	// decoding: a row fills the fields in, so there is no creation time to take
+	Picture();
 	Picture(int id, const std::string& name);
-	Picture(int id, const std::string& name, const std::string& pathOnDisk, const std::string& creationDate);
+	// strings the picture keeps are taken by value, so a caller done with them can move them in
+	Picture(int id, const std::string& name, const std::string& pathOnDisk, std::string creationDate);
 
 	int getId() const;
 	void setId(int id);
 
 	const std::string& getName() const;
+	Symbol getNameSymbol() const;
 	void setName(const std::string& name);
 
-	const std::string& getPath() const;
+	std::string getPath() const;
 	void setPath(const std::string& location);
 
+	int getDirectoryId() const;
+	const std::string& getFileName() const;
+	void setFileLocation(int directoryId, std::string fileName);
+
 	const std::string& getCreationDate() const;
-	void setCreationDate(const std::string& creationTime);
+	// the creation date as a number, see Timestamp
+	int64_t getCreationTime() const;
+	void setCreationDate(std::string creationTime);
 	void setCreationDateNow();
 
 	bool isUserTagged(const User& user) const;
@@ -32,7 +47,10 @@ public:
 	void untagUser(int userId);
 	int getTagsCount() const;
 
-	const std::set<int>& getUserTags() const;
+	const TagSet& getUserTags() const;
+
+	// estimated bytes the picture takes in a list (itself, its strings and tags)
+	size_t getMemoryUsage() const;
 
 	std::string getLocation() const;
 	void setLocation(const std::string& val);
@@ -45,10 +63,12 @@ public:
 
 private:
 	int m_pictureId;
-	std::string m_name;
-	std::string m_pathOnDisk;
+	InternedName m_name;
+	// the path on disk is kept as an interned directory (see DirectoryTable) and a file name
+	int m_directoryId;
+	std::string m_fileName;
+	int64_t m_creationTime;
 	std::string m_creationDate;
-	std::set<int> m_usersTags;
-	std::string _location;
+	TagSet m_usersTags;
 	int _albumId;
 };
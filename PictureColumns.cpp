@@ -0,0 +1,449 @@
+#include "PictureColumns.h"
+#include <algorithm>
+#include <iterator>
+#include <unordered_set>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+// ******************* Kernels ******************* 
+#if defined(__AVX2__)
+static int popcount32(uint32_t bits)
+{
+#if defined(_MSC_VER)
+	return static_cast<int>(__popcnt(bits));
+#else
+	return __builtin_popcount(bits);
+#endif
+}
+#endif
+
+static int32_t maxOf(const int32_t* values, size_t count)
+{
+	int32_t result = 0;
+	size_t i = 0;
+#if defined(__AVX2__)
+	__m256i best = _mm256_setzero_si256();
+	for (; i + 8 <= count; i += 8) {
+		best = _mm256_max_epi32(best, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)));
+	}
+	alignas(32) int32_t lanes[8];
+	_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), best);
+	result = *std::max_element(lanes, lanes + 8);
+#endif
+	for (; i < count; ++i) {
+		result = std::max(result, values[i]);
+	}
+	return result;
+}
+
+static int countEqual(const int32_t* values, size_t count, int32_t value)
+{
+	int result = 0;
+	size_t i = 0;
+#if defined(__AVX2__)
+	__m256i wanted = _mm256_set1_epi32(value);
+	for (; i + 8 <= count; i += 8) {
+		__m256i equal = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)), wanted);
+		result += popcount32(static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(equal))));
+	}
+#endif
+	for (; i < count; ++i) {
+		result += values[i] == value;
+	}
+	return result;
+}
+
+// calls found(index) for every values[index] == value, in increasing index order
+template <typename Function>
+static void forEachEqual(const int32_t* values, size_t count, int32_t value, Function found)
+{
+	size_t i = 0;
+#if defined(__AVX2__)
+	__m256i wanted = _mm256_set1_epi32(value);
+	for (; i + 8 <= count; i += 8) {
+		__m256i equal = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)), wanted);
+		uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(equal)));
+		while (mask != 0) {
+			int lane = popcount32((mask & (0 - mask)) - 1);
+			found(i + lane);
+			mask &= mask - 1;
+		}
+	}
+#endif
+	for (; i < count; ++i) {
+		if (values[i] == value) {
+			found(i);
+		}
+	}
+}
+
+bool PictureColumns::isVectorized()
+{
+#if defined(__AVX2__)
+	return true;
+#else
+	return false;
+#endif
+}
+
+// ******************* Albums ******************* 
+uint32_t PictureColumns::addAlbum(const Album* album)
+{
+	uint32_t slot;
+	if (m_freeSlots.empty()) {
+		slot = static_cast<uint32_t>(m_slotAlbums.size());
+		m_slotAlbums.push_back(album);
+		m_hiddenSlots.push_back(0);
+	}
+	else {
+		slot = m_freeSlots.back();
+		m_freeSlots.pop_back();
+		m_slotAlbums[slot] = album;
+	}
+
+	m_albums[album] = { slot, m_nextAlbumSequence++, 0 };
+	return slot;
+}
+
+/**
+ * removeAlbum - Frees the slot of an album, its pictures must have been removed already.
+ */
+void PictureColumns::removeAlbum(const Album* album)
+{
+	auto found = m_albums.find(album);
+	if (found == m_albums.end()) {
+		return;
+	}
+
+	uint32_t slot = found->second.slot;
+	if (m_hiddenSlots[slot] != 0) {
+		m_hiddenSlots[slot] = 0;
+		--m_hiddenCount;
+	}
+	m_slotAlbums[slot] = nullptr;
+	m_freeSlots.push_back(slot);
+	m_albums.erase(found);
+}
+
+/**
+ * hideAlbum - Leaves an album and its rows out of the scans until removeAlbum.
+ */
+void PictureColumns::hideAlbum(const Album* album)
+{
+	auto found = m_albums.find(album);
+	if (found == m_albums.end() || m_hiddenSlots[found->second.slot] != 0) {
+		return;
+	}
+
+	m_hiddenSlots[found->second.slot] = 1;
+	++m_hiddenCount;
+}
+
+uint32_t PictureColumns::getAlbumSlot(const Album* album) const
+{
+	auto found = m_albums.find(album);
+	return found == m_albums.end() ? NO_ROW : found->second.slot;
+}
+
+const Album* PictureColumns::getAlbumOfSlot(uint32_t slot) const
+{
+	return slot < m_slotAlbums.size() ? m_slotAlbums[slot] : nullptr;
+}
+
+// ******************* Pictures ******************* 
+void PictureColumns::addPicture(const Album* album, const Picture* picture)
+{
+	AlbumSlot& slot = m_albums.at(album);
+	uint32_t row = static_cast<uint32_t>(m_pictures.size());
+
+	m_pictures.push_back(picture);
+	m_pictureIds.push_back(picture->getId());
+	m_albumSlots.push_back(slot.slot);
+	m_tagsCounts.push_back(picture->getTagsCount());
+	m_creationTimes.push_back(picture->getCreationTime());
+	m_order.push_back((static_cast<uint64_t>(slot.sequence) << 32) | slot.nextPosition++);
+	m_rows.emplace(picture, row);
+}
+
+/**
+ * removePicture - Drops the row of a picture, the last row takes its place.
+ */
+void PictureColumns::removePicture(const Picture* picture)
+{
+	auto found = m_rows.find(picture);
+	if (found == m_rows.end()) {
+		return;
+	}
+
+	uint32_t row = found->second;
+	uint32_t last = static_cast<uint32_t>(m_pictures.size() - 1);
+	m_rows.erase(found);
+
+	if (row != last) {
+		m_pictures[row] = m_pictures[last];
+		m_pictureIds[row] = m_pictureIds[last];
+		m_albumSlots[row] = m_albumSlots[last];
+		m_tagsCounts[row] = m_tagsCounts[last];
+		m_creationTimes[row] = m_creationTimes[last];
+		m_order[row] = m_order[last];
+		m_rows[m_pictures[row]] = row;
+	}
+
+	m_pictures.pop_back();
+	m_pictureIds.pop_back();
+	m_albumSlots.pop_back();
+	m_tagsCounts.pop_back();
+	m_creationTimes.pop_back();
+	m_order.pop_back();
+}
+
+void PictureColumns::updateTagsCount(const Picture* picture)
+{
+	updateTagsCount(picture, picture->getTagsCount());
+}
+
+void PictureColumns::updateTagsCount(const Picture* picture, int tagsCount)
+{
+	auto found = m_rows.find(picture);
+	if (found != m_rows.end()) {
+		m_tagsCounts[found->second] = tagsCount;
+	}
+}
+
+void PictureColumns::clear()
+{
+	m_pictures.clear();
+	m_pictureIds.clear();
+	m_albumSlots.clear();
+	m_tagsCounts.clear();
+	m_creationTimes.clear();
+	m_order.clear();
+	m_rows.clear();
+	m_albums.clear();
+	m_slotAlbums.clear();
+	m_hiddenSlots.clear();
+	m_hiddenCount = 0;
+	m_freeSlots.clear();
+	m_nextAlbumSequence = 0;
+}
+
+size_t PictureColumns::size() const
+{
+	return m_pictures.size();
+}
+
+bool PictureColumns::isHiddenRow(size_t row) const
+{
+	return m_hiddenCount != 0 && m_hiddenSlots[m_albumSlots[row]] != 0;
+}
+
+/**
+ * getLiveTagsCounts - The tags count column without pending untags, hidden rows count 0 tags.
+ * Params: pending - tags to take off; live - filled when the column itself is not live
+ * Returns: The column itself when nothing is hidden or pending, else live.
+ */
+const std::vector<int32_t>& PictureColumns::getLiveTagsCounts(const PendingUntags& pending, std::vector<int32_t>& live) const
+{
+	if (m_hiddenCount == 0 && pending.empty()) {
+		return m_tagsCounts;
+	}
+
+	live = m_tagsCounts;
+	for (const auto& untags : pending) {
+		auto found = m_rows.find(untags.first);
+		if (found != m_rows.end()) {
+			live[found->second] -= untags.second;
+		}
+	}
+	if (m_hiddenCount != 0) {
+		for (size_t row = 0; row < live.size(); ++row) {
+			if (m_hiddenSlots[m_albumSlots[row]] != 0) {
+				live[row] = 0;
+			}
+		}
+	}
+	return live;
+}
+
+// ******************* Scans ******************* 
+
+/**
+ * findTopTagged - Finds the picture with the most tags.
+ * Params: parallelism - how to split the scan; pending - tags not to count
+ * Returns: The picture, nullptr if no picture is tagged.
+ * Note: on a tie the picture of the earliest created album, and earliest in it, wins.
+ */
+const Picture* PictureColumns::findTopTagged(const Parallelism& parallelism, const PendingUntags& pending) const
+{
+	struct Best
+	{
+		int32_t tags { 0 };
+		uint32_t row { NO_ROW };
+	};
+
+	std::vector<int32_t> live;
+	const std::vector<int32_t>& tagsCounts = getLiveTagsCounts(pending, live);
+	size_t rows = tagsCounts.size();
+	size_t chunks = parallelism.getChunks(rows);
+	std::vector<Best> partial(chunks);
+
+	parallelism.run(chunks, [this, &tagsCounts, rows, chunks, &partial](size_t chunk) {
+		size_t begin = Parallelism::getChunkBegin(rows, chunks, chunk);
+		size_t end = Parallelism::getChunkBegin(rows, chunks, chunk + 1);
+		Best& best = partial[chunk];
+
+		best.tags = maxOf(tagsCounts.data() + begin, end - begin);
+		if (best.tags == 0) {
+			return;
+		}
+		forEachEqual(tagsCounts.data() + begin, end - begin, best.tags, [this, begin, &best](size_t offset) {
+			uint32_t row = static_cast<uint32_t>(begin + offset);
+			if (best.row == NO_ROW || m_order[row] < m_order[best.row]) {
+				best.row = row;
+			}
+		});
+	});
+
+	// the same rule across the chunks: most tags, then the lowest order
+	Best best;
+	for (const Best& candidate : partial) {
+		if (candidate.tags > best.tags || (candidate.tags == best.tags && candidate.row != NO_ROW && m_order[candidate.row] < m_order[best.row])) {
+			best = candidate;
+		}
+	}
+
+	return best.row == NO_ROW ? nullptr : m_pictures[best.row];
+}
+
+/**
+ * aggregateByAlbum - Pictures, tags, most tags on one picture and newest picture of every album.
+ * Params: parallelism - how to split the scan, each chunk fills its own per album totals;
+ *         pending - tags not to count
+ * Returns: One entry per album that is not hidden, by slot.
+ */
+std::vector<PictureColumns::AlbumAggregate> PictureColumns::aggregateByAlbum(const Parallelism& parallelism, const PendingUntags& pending) const
+{
+	std::vector<int32_t> live;
+	const std::vector<int32_t>& tagsCounts = getLiveTagsCounts(pending, live);
+	size_t rows = m_pictures.size();
+	size_t chunks = parallelism.getChunks(rows);
+	std::vector<std::vector<AlbumAggregate>> partial(chunks);
+
+	parallelism.run(chunks, [this, &tagsCounts, rows, chunks, &partial](size_t chunk) {
+		std::vector<AlbumAggregate>& slots = partial[chunk];
+		slots.resize(m_slotAlbums.size());
+		for (uint32_t slot = 0; slot < slots.size(); ++slot) {
+			slots[slot] = { slot, 0, 0, 0, INT64_MIN };
+		}
+
+		size_t end = Parallelism::getChunkBegin(rows, chunks, chunk + 1);
+		for (size_t row = Parallelism::getChunkBegin(rows, chunks, chunk); row < end; ++row) {
+			AlbumAggregate& album = slots[m_albumSlots[row]];
+			int32_t tags = tagsCounts[row];
+			++album.pictures;
+			album.tags += tags;
+			album.maxTags = std::max(album.maxTags, tags);
+			album.newestCreationTime = std::max(album.newestCreationTime, m_creationTimes[row]);
+		}
+	});
+
+	std::vector<AlbumAggregate>& slots = partial.front();
+	for (size_t chunk = 1; chunk < chunks; ++chunk) {
+		for (size_t slot = 0; slot < slots.size(); ++slot) {
+			const AlbumAggregate& other = partial[chunk][slot];
+			slots[slot].pictures += other.pictures;
+			slots[slot].tags += other.tags;
+			slots[slot].maxTags = std::max(slots[slot].maxTags, other.maxTags);
+			slots[slot].newestCreationTime = std::max(slots[slot].newestCreationTime, other.newestCreationTime);
+		}
+	}
+
+	std::vector<AlbumAggregate> aggregates;
+	aggregates.reserve(m_albums.size());
+	for (const auto& album : slots) {
+		if (m_slotAlbums[album.albumSlot] != nullptr && m_hiddenSlots[album.albumSlot] == 0) {
+			aggregates.push_back(album);
+		}
+	}
+	return aggregates;
+}
+
+TagAdjacency PictureColumns::buildTagAdjacency(const std::function<bool(int)>& isSkipped) const
+{
+	TagAdjacency adjacency;
+	adjacency.offsets.reserve(m_pictures.size() + 1);
+	adjacency.rowAlbums = m_albumSlots;
+
+	size_t tags = 0;
+	for (int32_t count : m_tagsCounts) {
+		tags += count;
+	}
+	adjacency.users.reserve(tags);
+
+	adjacency.offsets.push_back(0);
+	for (size_t row = 0; row < m_pictures.size(); ++row) {
+		// the rows of hidden albums stay, empty, so rowAlbums still lines up
+		if (!isHiddenRow(row)) {
+			const TagSet& tags = m_pictures[row]->getUserTags();
+			if (!isSkipped) {
+				adjacency.users.insert(adjacency.users.end(), tags.begin(), tags.end());
+			}
+			else {
+				std::copy_if(tags.begin(), tags.end(), std::back_inserter(adjacency.users), [&isSkipped](int userId) { return !isSkipped(userId); });
+			}
+		}
+		adjacency.offsets.push_back(static_cast<uint32_t>(adjacency.users.size()));
+	}
+	return adjacency;
+}
+
+int TagAdjacency::countTagsOfUser(int userId, const Parallelism& parallelism) const
+{
+	size_t tags = users.size();
+	size_t chunks = parallelism.getChunks(tags);
+	std::vector<int> partial(chunks);
+
+	parallelism.run(chunks, [this, userId, tags, chunks, &partial](size_t chunk) {
+		size_t begin = Parallelism::getChunkBegin(tags, chunks, chunk);
+		size_t end = Parallelism::getChunkBegin(tags, chunks, chunk + 1);
+		partial[chunk] = countEqual(users.data() + begin, end - begin, userId);
+	});
+
+	int count = 0;
+	for (int chunkCount : partial) {
+		count += chunkCount;
+	}
+	return count;
+}
+
+int TagAdjacency::countAlbumsTaggedOfUser(int userId, const Parallelism& parallelism) const
+{
+	size_t tags = users.size();
+	size_t chunks = parallelism.getChunks(tags);
+	std::vector<std::unordered_set<uint32_t>> partial(chunks);
+
+	parallelism.run(chunks, [this, userId, tags, chunks, &partial](size_t chunk) {
+		size_t begin = Parallelism::getChunkBegin(tags, chunks, chunk);
+		size_t end = Parallelism::getChunkBegin(tags, chunks, chunk + 1);
+
+		// the row holding the first position of the chunk, then positions only move forward
+		size_t row = std::upper_bound(offsets.begin(), offsets.end(), static_cast<uint32_t>(begin)) - offsets.begin() - 1;
+		forEachEqual(users.data() + begin, end - begin, userId, [this, begin, &row, &partial, chunk](size_t offset) {
+			while (offsets[row + 1] <= begin + offset) {
+				++row;
+			}
+			partial[chunk].insert(rowAlbums[row]);
+		});
+	});
+
+	std::unordered_set<uint32_t>& albums = partial.front();
+	for (size_t chunk = 1; chunk < chunks; ++chunk) {
+		albums.insert(partial[chunk].begin(), partial[chunk].end());
+	}
+	return static_cast<int>(albums.size());
+}
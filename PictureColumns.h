@@ -0,0 +1,105 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include "Album.h"
+#include "ThreadPool.h"
+
+#define NO_ROW UINT32_MAX
+
+/*
+ * TagAdjacency - the user tags of every picture in compressed sparse row form: the users
+ * tagged in row r are users[offsets[r] .. offsets[r + 1]). An immutable snapshot, built by
+ * PictureColumns::buildTagAdjacency for bulk analytics over all the tags.
+ */
+struct TagAdjacency
+{
+	std::vector<uint32_t> offsets;
+	std::vector<int32_t> users;
+	std::vector<uint32_t> rowAlbums;	// album slot of each row
+
+	int countTagsOfUser(int userId, const Parallelism& parallelism = Parallelism()) const;
+	int countAlbumsTaggedOfUser(int userId, const Parallelism& parallelism = Parallelism()) const;
+};
+
+/*
+ * PictureColumns - structure of arrays copy of the pictures of a MemoryAccess, one row per
+ * picture, kept up to date by MemoryAccess as pictures are added, removed and tagged.
+ * Statistics that look at every picture scan these contiguous columns (AVX2 when the build
+ * enables it, plain loops otherwise) instead of walking album and picture list nodes.
+ * Large scans are split over a thread pool; the partial results are merged so the answer is
+ * the one a single thread gives.
+ *
+ * Rows are not kept in any order (a removed row is replaced by the last one); the order
+ * column holds the album creation sequence and the picture position in the album, so ties
+ * are broken exactly like a walk over the albums would.
+ *
+ * Deletes may reach the columns late: a hidden album keeps its rows until they are removed,
+ * and the scans take the tags still on pictures but already deleted (PendingUntags) off the
+ * tags counts. Both are left out of every scan.
+ */
+class PictureColumns
+{
+public:
+	// tags to leave out of the tags counts, by picture
+	using PendingUntags = std::unordered_map<const Picture*, int>;
+
+	struct AlbumAggregate
+	{
+		uint32_t albumSlot;
+		int pictures;
+		int tags;
+		int maxTags;
+		int64_t newestCreationTime;
+	};
+
+	// albums get a dense slot (reused after deletion) that the album column refers to
+	uint32_t addAlbum(const Album* album);
+	void removeAlbum(const Album* album);
+	void hideAlbum(const Album* album);
+	uint32_t getAlbumSlot(const Album* album) const;
+	const Album* getAlbumOfSlot(uint32_t slot) const;
+
+	void addPicture(const Album* album, const Picture* picture);
+	void removePicture(const Picture* picture);
+	void updateTagsCount(const Picture* picture);
+	void updateTagsCount(const Picture* picture, int tagsCount);
+	void clear();
+
+	size_t size() const;
+	const Picture* findTopTagged(const Parallelism& parallelism = Parallelism(), const PendingUntags& pending = PendingUntags()) const;
+	std::vector<AlbumAggregate> aggregateByAlbum(const Parallelism& parallelism = Parallelism(), const PendingUntags& pending = PendingUntags()) const;
+	// tags whose user isSkipped returns true are left out
+	TagAdjacency buildTagAdjacency(const std::function<bool(int)>& isSkipped = nullptr) const;
+
+	static bool isVectorized();
+
+private:
+	struct AlbumSlot
+	{
+		uint32_t slot;
+		uint32_t sequence;			// creation order of the album
+		uint32_t nextPosition;		// position the next picture added to the album gets
+	};
+
+	// the columns, index = row
+	std::vector<const Picture*> m_pictures;
+	std::vector<int32_t> m_pictureIds;
+	std::vector<uint32_t> m_albumSlots;
+	std::vector<int32_t> m_tagsCounts;
+	std::vector<int64_t> m_creationTimes;
+	std::vector<uint64_t> m_order;		// album sequence << 32 | position in the album
+
+	std::unordered_map<const Picture*, uint32_t> m_rows;
+	std::unordered_map<const Album*, AlbumSlot> m_albums;
+	std::vector<const Album*> m_slotAlbums;
+	std::vector<uint8_t> m_hiddenSlots;		// index = slot
+	size_t m_hiddenCount { 0 };
+	std::vector<uint32_t> m_freeSlots;
+	uint32_t m_nextAlbumSequence { 0 };
+
+	bool isHiddenRow(size_t row) const;
+	const std::vector<int32_t>& getLiveTagsCounts(const PendingUntags& pending, std::vector<int32_t>& live) const;
+};
@@ -0,0 +1,395 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <utility>
+
+#include "ItemNotFoundException.h"
+#include "ShardedMemoryAccess.h"
+
+
+ShardedMemoryAccess::ShardedMemoryAccess(size_t shardsCount) :
+	m_pool(std::min<size_t>(std::max<size_t>(shardsCount, 1), std::max(std::thread::hardware_concurrency(), 1u)))
+{
+	m_shards.resize(std::max<size_t>(shardsCount, 1));
+	for (auto& shard : m_shards) {
+		shard = std::make_unique<Shard>();
+	}
+}
+
+size_t ShardedMemoryAccess::getShardsCount() const
+{
+	return m_shards.size();
+}
+
+ShardedMemoryAccess::Shard& ShardedMemoryAccess::shardOf(const std::string& albumName)
+{
+	// symbols are dense, consecutive names land on consecutive shards
+	return *m_shards[SymbolTable::find(albumName) % m_shards.size()];
+}
+
+bool ShardedMemoryAccess::open()
+{
+	// the same dummy users and albums MemoryAccess::open creates
+	MemoryAccess dummies;
+	dummies.open();
+	dummies.forEachAlbum([this, &dummies](const Album& album) {
+		User owner = dummies.getUser(album.getOwnerId());
+		createUser(owner);
+		createAlbum(album);
+	});
+
+	return true;
+}
+
+void ShardedMemoryAccess::clear()
+{
+	for (auto& shard : m_shards) {
+		withShard(*shard, [](MemoryAccess& albums) { albums.clear(); });
+	}
+
+	std::unique_lock<std::shared_mutex> guard(m_usersLock);
+	m_users.clear();
+	m_files.clear();
+}
+
+/**
+ * getTheNextId - Returns the next free id of a table, over every shard.
+ */
+int ShardedMemoryAccess::getTheNextId(const std::string& tableName)
+{
+	int nextId;
+	{
+		std::shared_lock<std::shared_mutex> guard(m_usersLock);
+		nextId = m_users.getTheNextId(tableName);
+	}
+
+	for (auto& shard : m_shards) {
+		nextId = std::max(nextId, withShard(*shard, [&tableName](MemoryAccess& albums) { return albums.getTheNextId(tableName); }));
+	}
+	return nextId;
+}
+
+// ******************* Album ******************* 
+const std::list<Album> ShardedMemoryAccess::getAlbums()
+{
+	auto parts = scatter([](MemoryAccess& albums) { return albums.getAlbums(); });
+
+	std::list<Album> all;
+	for (auto& part : parts) {
+		all.splice(all.end(), part);
+	}
+	return all;
+}
+
+const std::list<Album> ShardedMemoryAccess::getAlbumsOfUser(const User& user)
+{
+	auto parts = scatter([&user](MemoryAccess& albums) { return albums.getAlbumsOfUser(user); }, false);
+
+	std::list<Album> all;
+	for (auto& part : parts) {
+		all.splice(all.end(), part);
+	}
+	return all;
+}
+
+// fn runs with the lock of the shard it is visiting held, one shard after the other
+void ShardedMemoryAccess::forEachAlbum(const std::function<void(const Album&)>& fn)
+{
+	for (auto& shard : m_shards) {
+		withShard(*shard, [&fn](MemoryAccess& albums) { albums.forEachAlbum(fn); });
+	}
+}
+
+void ShardedMemoryAccess::forEachAlbumOfUser(const User& user, const std::function<void(const Album&)>& fn)
+{
+	for (auto& shard : m_shards) {
+		withShard(*shard, [&user, &fn](MemoryAccess& albums) { albums.forEachAlbumOfUser(user, fn); });
+	}
+}
+
+bool ShardedMemoryAccess::visitPicture(const std::string& albumName, const std::string& pictureName, const std::function<void(const Picture&)>& fn)
+{
+	return withShard(shardOf(albumName), [&albumName, &pictureName, &fn](MemoryAccess& albums) { return albums.visitPicture(albumName, pictureName, fn); });
+}
+
+/**
+ * getAlbumsSorted - Takes the first albums of every shard in the given order and orders those again.
+ * Params: order - key, direction and limit; ties between shards go to the lower shard
+ * Returns: The albums.
+ */
+std::list<Album> ShardedMemoryAccess::getAlbumsSorted(const ListingOrder& order)
+{
+	auto parts = scatter([&order](MemoryAccess& albums) { return albums.getAlbumsSorted(order); });
+
+	std::list<Album> candidates;
+	for (auto& part : parts) {
+		candidates.splice(candidates.end(), part);
+	}
+
+	std::vector<const Album*> ordered;
+	for (const Album& album : candidates) {
+		ordered.push_back(&album);
+	}
+	order.apply(ordered);
+
+	std::list<Album> sorted;
+	for (const Album* album : ordered) {
+		sorted.push_back(*album);
+	}
+	return sorted;
+}
+
+std::list<Picture> ShardedMemoryAccess::getPicturesSorted(const std::string& albumName, const ListingOrder& order)
+{
+	return withShard(shardOf(albumName), [&albumName, &order](MemoryAccess& albums) { return albums.getPicturesSorted(albumName, order); });
+}
+
+void ShardedMemoryAccess::createAlbum(const Album& album)
+{
+	withShard(shardOf(album.getName()), [&album](MemoryAccess& albums) { albums.createAlbum(album); });
+}
+
+void ShardedMemoryAccess::createAlbum(Album&& album)
+{
+	withShard(shardOf(album.getName()), [&album](MemoryAccess& albums) { albums.createAlbum(std::move(album)); });
+}
+
+void ShardedMemoryAccess::deleteAlbum(const std::string& albumName, int userId)
+{
+	withShard(shardOf(albumName), [&albumName, userId](MemoryAccess& albums) { albums.deleteAlbum(albumName, userId); });
+}
+
+bool ShardedMemoryAccess::doesAlbumExists(const std::string& albumName, int userId)
+{
+	return withShard(shardOf(albumName), [&albumName, userId](MemoryAccess& albums) { return albums.doesAlbumExists(albumName, userId); });
+}
+
+Album ShardedMemoryAccess::openAlbum(const std::string& albumName)
+{
+	return withShard(shardOf(albumName), [&albumName](MemoryAccess& albums) { return albums.openAlbum(albumName); });
+}
+
+void ShardedMemoryAccess::closeAlbum(Album& )
+{
+	// albums are returned by value, nothing to release
+}
+
+void ShardedMemoryAccess::printAlbums()
+{
+	bool any = false;
+	forEachAlbum([&any](const Album& album) {
+		if (!any) {
+			std::cout << "Album list:" << std::endl;
+			std::cout << "-----------" << std::endl;
+			any = true;
+		}
+		std::cout << std::setw(5) << "* " << album;
+	});
+	if (!any) {
+		throw MyException("There are no existing albums.");
+	}
+}
+
+// ******************* Picture ******************* 
+void ShardedMemoryAccess::addPictureToAlbumByName(const std::string& albumName, const Picture& picture)
+{
+	withShard(shardOf(albumName), [&albumName, &picture](MemoryAccess& albums) { albums.addPictureToAlbumByName(albumName, picture); });
+}
+
+void ShardedMemoryAccess::addPictureToAlbumByName(const std::string& albumName, Picture&& picture)
+{
+	withShard(shardOf(albumName), [&albumName, &picture](MemoryAccess& albums) { albums.addPictureToAlbumByName(albumName, std::move(picture)); });
+}
+
+void ShardedMemoryAccess::removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName)
+{
+	withShard(shardOf(albumName), [&albumName, &pictureName](MemoryAccess& albums) { albums.removePictureFromAlbumByName(albumName, pictureName); });
+}
+
+void ShardedMemoryAccess::tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
+{
+	withShard(shardOf(albumName), [&albumName, &pictureName, userId](MemoryAccess& albums) { albums.tagUserInPicture(albumName, pictureName, userId); });
+}
+
+void ShardedMemoryAccess::untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
+{
+	withShard(shardOf(albumName), [&albumName, &pictureName, userId](MemoryAccess& albums) { albums.untagUserInPicture(albumName, pictureName, userId); });
+}
+
+bool ShardedMemoryAccess::getFileMetadata(const std::string& path, FileMetadata& metadata)
+{
+	return m_files.find(path, metadata);
+}
+
+void ShardedMemoryAccess::storeFileMetadata(const std::vector<FileMetadata>& files)
+{
+	m_files.store(files);
+}
+
+void ShardedMemoryAccess::forEachFileMetadata(const std::function<void(const FileMetadata&)>& fn)
+{
+	m_files.forEach(fn);
+}
+
+bool ShardedMemoryAccess::doesPictureExistsInAlbum(const std::string& albumName, const std::string& pictureName)
+{
+	return withShard(shardOf(albumName), [&albumName, &pictureName](MemoryAccess& albums) { return albums.doesPictureExistsInAlbum(albumName, pictureName); });
+}
+
+Picture ShardedMemoryAccess::getPictureFromAlbum(const std::string& albumName, const std::string& pictureName)
+{
+	return withShard(shardOf(albumName), [&albumName, &pictureName](MemoryAccess& albums) { return albums.getPictureFromAlbum(albumName, pictureName); });
+}
+
+bool ShardedMemoryAccess::isUserTaggedInPicture(const User& user, const Picture& picture)
+{
+	return picture.isUserTagged(user);
+}
+
+std::list<User> ShardedMemoryAccess::getUsersTaggedInPicture(const Picture& picture)
+{
+	std::shared_lock<std::shared_mutex> guard(m_usersLock);
+	return m_users.getUsersTaggedInPicture(picture);
+}
+
+// ******************* User ******************* 
+void ShardedMemoryAccess::printUsers()
+{
+	std::shared_lock<std::shared_mutex> guard(m_usersLock);
+	m_users.printUsers();
+}
+
+void ShardedMemoryAccess::createUser(User& user)
+{
+	std::unique_lock<std::shared_mutex> guard(m_usersLock);
+	m_users.createUser(user);
+}
+
+void ShardedMemoryAccess::deleteUser(const User& user)
+{
+	{
+		std::unique_lock<std::shared_mutex> guard(m_usersLock);
+		if (!m_users.doesUserExists(user.getId())) {
+			return;
+		}
+		m_users.deleteUser(user);
+	}
+
+	for (auto& shard : m_shards) {
+		withShard(*shard, [&user](MemoryAccess& albums) { albums.cleanUserData(user); });
+	}
+}
+
+bool ShardedMemoryAccess::doesUserExists(int userId)
+{
+	std::shared_lock<std::shared_mutex> guard(m_usersLock);
+	return m_users.doesUserExists(userId);
+}
+
+bool ShardedMemoryAccess::doesUserExists(const std::string& name)
+{
+	std::shared_lock<std::shared_mutex> guard(m_usersLock);
+	return m_users.doesUserExists(name);
+}
+
+User ShardedMemoryAccess::getUser(int userId)
+{
+	std::shared_lock<std::shared_mutex> guard(m_usersLock);
+	return m_users.getUser(userId);
+}
+
+// user statistics
+int ShardedMemoryAccess::countAlbumsOwnedOfUser(const User& user)
+{
+	return sumShards([&user](MemoryAccess& albums) { return albums.countAlbumsOwnedOfUser(user); });
+}
+
+int ShardedMemoryAccess::countAlbumsTaggedOfUser(const User& user)
+{
+	return sumShards([&user](MemoryAccess& albums) { return albums.countAlbumsTaggedOfUser(user); });
+}
+
+int ShardedMemoryAccess::countTagsOfUser(const User& user)
+{
+	return sumShards([&user](MemoryAccess& albums) { return albums.countTagsOfUser(user); });
+}
+
+float ShardedMemoryAccess::averageTagsPerAlbumOfUser(const User& user)
+{
+	int albumsTaggedCount = countAlbumsTaggedOfUser(user);
+
+	if ( 0 == albumsTaggedCount ) {
+		return 0;
+	}
+
+	return static_cast<float>(countTagsOfUser(user)) / albumsTaggedCount;
+}
+
+/**
+ * getTopTaggedUser - Adds up the tags count of every user over the shards, on a tie the higher id wins.
+ */
+User ShardedMemoryAccess::getTopTaggedUser()
+{
+	auto parts = scatter([](MemoryAccess& albums) { return albums.getTagsCountOfUsers(); });
+
+	std::unordered_map<int, int> totals;
+	for (const auto& part : parts) {
+		for (const auto& entry : part) {
+			totals[entry.first] += entry.second;
+		}
+	}
+
+	if (totals.empty()) {
+		throw MyException("There isn't any tagged user.");
+	}
+
+	int topTaggedUser = -1;
+	int currentMax = -1;
+	for (const auto& entry : totals) {
+		if (entry.second < currentMax || (entry.second == currentMax && entry.first < topTaggedUser)) {
+			continue;
+		}
+
+		topTaggedUser = entry.first;
+		currentMax = entry.second;
+	}
+
+	return getUser(topTaggedUser);
+}
+
+Picture ShardedMemoryAccess::getTopTaggedPicture()
+{
+	auto parts = scatter([](MemoryAccess& albums) -> std::optional<Picture> {
+		try {
+			return albums.getTopTaggedPicture();
+		}
+		catch (const MyException&) {
+			return std::nullopt;	// nothing tagged in this shard
+		}
+	});
+
+	const Picture* mostTaggedPic = nullptr;
+	for (const auto& part : parts) {
+		if (part.has_value() && (mostTaggedPic == nullptr || part->getTagsCount() > mostTaggedPic->getTagsCount())) {
+			mostTaggedPic = &*part;
+		}
+	}
+
+	if (mostTaggedPic == nullptr) {
+		throw MyException("There isn't any tagged picture.");
+	}
+
+	return *mostTaggedPic;
+}
+
+std::list<Picture> ShardedMemoryAccess::getTaggedPicturesOfUser(const User& user)
+{
+	auto parts = scatter([&user](MemoryAccess& albums) { return albums.getTaggedPicturesOfUser(user); }, false);
+
+	std::list<Picture> all;
+	for (auto& part : parts) {
+		all.splice(all.end(), part);
+	}
+	return all;
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
+#include <vector>
+#include "MemoryAccess.h"
+#include "ThreadPool.h"
+
+#define SHARDED_DEFAULT_SHARDS 16
+
+/*
+ * ShardedMemoryAccess - thread safe MemoryAccess split into shards so writers on
+ * different albums do not wait for each other.
+ * An album, with its pictures and tags, lives in the shard picked by the symbol of its name
+ * (every call names the album, and albums sharing a name stay in one shard, so "the first
+ * created album with this name" still means the same thing). Each shard is a MemoryAccess
+ * with its own lock and indexes; the users live in a separate store.
+ * Scans over every album scatter to the shards in parallel, on a pool made with the store, and
+ * merge the results; per user lookups, already answered by each shard's indexes, visit the
+ * shards in turn.
+ *
+ * Albums are listed shard by shard, and the top tagged picture ties go to the lower shard.
+ */
+class ShardedMemoryAccess : public IDataAccess
+{
+public:
+	explicit ShardedMemoryAccess(size_t shardsCount = SHARDED_DEFAULT_SHARDS);
+	virtual ~ShardedMemoryAccess() = default;
+
+	// album related
+	const std::list<Album> getAlbums() override;
+	const std::list<Album> getAlbumsOfUser(const User& user) override;
+	void createAlbum(const Album& album) override;
+	void createAlbum(Album&& album) override;
+	void deleteAlbum(const std::string& albumName, int userId) override;
+	bool doesAlbumExists(const std::string& albumName, int userId) override;
+	Album openAlbum(const std::string& albumName) override;
+	void closeAlbum(Album& pAlbum) override;
+	void printAlbums() override;
+
+	void forEachAlbum(const std::function<void(const Album&)>& fn) override;
+	void forEachAlbumOfUser(const User& user, const std::function<void(const Album&)>& fn) override;
+	bool visitPicture(const std::string& albumName, const std::string& pictureName, const std::function<void(const Picture&)>& fn) override;
+
+	std::list<Album> getAlbumsSorted(const ListingOrder& order) override;
+	std::list<Picture> getPicturesSorted(const std::string& albumName, const ListingOrder& order) override;
+
+	// picture related
+	void addPictureToAlbumByName(const std::string& albumName, const Picture& picture) override;
+	void addPictureToAlbumByName(const std::string& albumName, Picture&& picture) override;
+	void removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName) override;
+	void tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
+	void untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
+
+	// keyed by path, not by album, so they live outside the shards
+	bool getFileMetadata(const std::string& path, FileMetadata& metadata) override;
+	void storeFileMetadata(const std::vector<FileMetadata>& files) override;
+	void forEachFileMetadata(const std::function<void(const FileMetadata&)>& fn) override;
+
+	// user related
+	void printUsers() override;
+	void createUser(User& user) override;
+	void deleteUser(const User& user) override;
+	bool doesUserExists(int userId) override;
+	User getUser(int userId) override;
+
+	// user statistics
+	int countAlbumsOwnedOfUser(const User& user) override;
+	int countAlbumsTaggedOfUser(const User& user) override;
+	int countTagsOfUser(const User& user) override;
+	float averageTagsPerAlbumOfUser(const User& user) override;
+
+	// queries
+	User getTopTaggedUser() override;
+	Picture getTopTaggedPicture() override;
+	std::list<Picture> getTaggedPicturesOfUser(const User& user) override;
+
+	bool open() override;
+	void close() override {};
+	void clear() override;
+
+	bool doesPictureExistsInAlbum(const std::string& albumName, const std::string& pictureName) override;
+	int getTheNextId(const std::string& tableName) override;
+	Picture getPictureFromAlbum(const std::string& albumName, const std::string& pictureName) override;
+	bool isUserTaggedInPicture(const User& user, const Picture& picture) override;
+	std::list<User> getUsersTaggedInPicture(const Picture& picture) override;
+	bool doesUserExists(const std::string& name) override;
+
+	size_t getShardsCount() const;
+
+private:
+	struct Shard
+	{
+		std::mutex lock;
+		MemoryAccess albums;	// holds no users
+	};
+
+	std::vector<std::unique_ptr<Shard>> m_shards;
+	std::shared_mutex m_usersLock;
+	MemoryAccess m_users;		// holds no albums
+	FileMetadataStore m_files;
+	// scatter's workers, one thread per shard at most; apart from the default pool the shards' own
+	// scans use, so a task of this pool never waits for this pool
+	ThreadPool m_pool;
+
+	Shard& shardOf(const std::string& albumName);
+
+	// runs fn on the shard with its lock held
+	template <typename Function>
+	auto withShard(Shard& shard, Function fn) -> decltype(fn(shard.albums))
+	{
+		std::lock_guard<std::mutex> guard(shard.lock);
+		return fn(shard.albums);
+	}
+
+	// runs fn on every shard, in parallel on m_pool for scans and in turn for lookups too cheap to
+	// fan out. Results are in shard order.
+	template <typename Function>
+	auto scatter(Function fn, bool parallel = true) -> std::vector<std::decay_t<decltype(fn(std::declval<MemoryAccess&>()))>>
+	{
+		// getAlbums() returns a const list, the results are kept as plain values
+		using Result = std::decay_t<decltype(fn(std::declval<MemoryAccess&>()))>;
+
+		std::vector<Result> results(m_shards.size());
+		auto runShard = [this, &fn, &results](size_t shard) {
+			results[shard] = withShard(*m_shards[shard], fn);
+		};
+		if (parallel) {
+			m_pool.parallelFor(m_shards.size(), runShard);
+		}
+		else {
+			for (size_t shard = 0; shard < m_shards.size(); ++shard) {
+				runShard(shard);
+			}
+		}
+		return results;
+	}
+
+	// adds up fn over the shards, one after the other (for lookups too cheap to fan out)
+	template <typename Function>
+	int sumShards(Function fn)
+	{
+		int sum = 0;
+		for (auto& shard : m_shards) {
+			sum += withShard(*shard, fn);
+		}
+		return sum;
+	}
+};
@@ -0,0 +1,212 @@
+#include "SymbolTable.h"
+#include "MyException.h"
+#include <mutex>
+#include <utility>
+
+std::atomic<SymbolTable::Page*> SymbolTable::m_pages[SYMBOL_PAGES];
+
+// never destroyed: model objects held by other statics release their names at exit
+SymbolTable::State& SymbolTable::getState()
+{
+	static State* state = new State();
+	return *state;
+}
+
+// the symbol was handed out by add, which published its page and chunk first
+SymbolTable::Entry& SymbolTable::getEntry(Symbol symbol)
+{
+	Page* page = m_pages[symbol >> (SYMBOL_CHUNK_BITS + SYMBOL_PAGE_BITS)].load(std::memory_order_acquire);
+	Entry* chunk = page->chunks[(symbol >> SYMBOL_CHUNK_BITS) & (SYMBOL_PAGE_SIZE - 1)].load(std::memory_order_acquire);
+	return chunk[symbol & (SYMBOL_CHUNK_SIZE - 1)];
+}
+
+// called with the lock held alone; a freed symbol is taken before a new one
+Symbol SymbolTable::add(const std::string& name)
+{
+	State& state = getState();
+	Symbol symbol;
+	if (!state.freeSymbols.empty()) {
+		symbol = state.freeSymbols.back();
+		state.freeSymbols.pop_back();
+	}
+	else {
+		if (state.nextSymbol == UNKNOWN_SYMBOL) {
+			throw MyException("Too many distinct names");
+		}
+		symbol = state.nextSymbol++;
+
+		std::atomic<Page*>& page = m_pages[symbol >> (SYMBOL_CHUNK_BITS + SYMBOL_PAGE_BITS)];
+		if (page.load(std::memory_order_relaxed) == nullptr) {
+			page.store(new Page(), std::memory_order_release);
+		}
+		std::atomic<Entry*>& chunk = page.load(std::memory_order_relaxed)->chunks[(symbol >> SYMBOL_CHUNK_BITS) & (SYMBOL_PAGE_SIZE - 1)];
+		if (chunk.load(std::memory_order_relaxed) == nullptr) {
+			chunk.store(new Entry[SYMBOL_CHUNK_SIZE], std::memory_order_release);
+		}
+	}
+
+	Entry& entry = getEntry(symbol);
+	entry.name = name;
+	entry.references.store(1, std::memory_order_relaxed);
+	state.symbols.emplace(entry.name, symbol);
+	return symbol;
+}
+
+/**
+ * intern - Returns the symbol of a name, registering it if it is not interned, with one reference.
+ * Params: name - album, picture or user name
+ * Returns: The symbol of the name.
+ */
+Symbol SymbolTable::intern(const std::string& name)
+{
+	if (name.empty()) {
+		return EMPTY_SYMBOL;
+	}
+
+	State& state = getState();
+	{
+		// a known name only counts a reference, many threads can do that at once
+		std::shared_lock<std::shared_mutex> guard(state.lock);
+		auto found = state.symbols.find(name);
+		if (found != state.symbols.end()) {
+			getEntry(found->second).references.fetch_add(1, std::memory_order_relaxed);
+			return found->second;
+		}
+	}
+
+	std::unique_lock<std::shared_mutex> guard(state.lock);
+	auto found = state.symbols.find(name);
+	if (found != state.symbols.end()) {
+		getEntry(found->second).references.fetch_add(1, std::memory_order_relaxed);
+		return found->second;
+	}
+	return add(name);
+}
+
+// the caller holds a reference already, nothing can free the symbol meanwhile
+void SymbolTable::retain(Symbol symbol)
+{
+	if (symbol != EMPTY_SYMBOL && symbol != UNKNOWN_SYMBOL) {
+		getEntry(symbol).references.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+/**
+ * release - Drops a reference to a symbol, freeing the name with the last one.
+ */
+void SymbolTable::release(Symbol symbol)
+{
+	if (symbol == EMPTY_SYMBOL || symbol == UNKNOWN_SYMBOL) {
+		return;
+	}
+
+	Entry& entry = getEntry(symbol);
+	if (entry.references.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+		return;
+	}
+
+	// intern may have found the name again before the lock, or another release freed it already
+	State& state = getState();
+	std::unique_lock<std::shared_mutex> guard(state.lock);
+	auto found = state.symbols.find(entry.name);
+	if (entry.references.load(std::memory_order_relaxed) != 0 || found == state.symbols.end() || found->second != symbol) {
+		return;
+	}
+
+	state.symbols.erase(found);
+	std::string().swap(entry.name);
+	state.freeSymbols.push_back(symbol);
+}
+
+/**
+ * find - Looks a name up without registering it (e.g. the name a caller searches for).
+ * Params: name - album, picture or user name
+ * Returns: The symbol of the name or UNKNOWN_SYMBOL, which matches no stored name.
+ * Note: a symbol matches stored objects only while they hold it, so it is safe to compare with
+ *       them even if the name is freed and its symbol reused after the call.
+ */
+Symbol SymbolTable::find(const std::string& name)
+{
+	if (name.empty()) {
+		return EMPTY_SYMBOL;
+	}
+
+	State& state = getState();
+	std::shared_lock<std::shared_mutex> guard(state.lock);
+	auto found = state.symbols.find(name);
+	return found == state.symbols.end() ? UNKNOWN_SYMBOL : found->second;
+}
+
+/**
+ * getName - Returns the name of a symbol.
+ * Params: symbol - a symbol held by an InternedName
+ * Returns: The name, valid while the symbol is held.
+ */
+const std::string& SymbolTable::getName(Symbol symbol)
+{
+	static const std::string empty;
+	if (symbol == EMPTY_SYMBOL || symbol == UNKNOWN_SYMBOL) {
+		return empty;
+	}
+	return getEntry(symbol).name;
+}
+
+// the names interned now, the empty one aside
+size_t SymbolTable::size()
+{
+	State& state = getState();
+	std::shared_lock<std::shared_mutex> guard(state.lock);
+	return state.symbols.size();
+}
+
+// ******************* InternedName *******************
+InternedName::InternedName(const std::string& name) :
+	m_symbol(SymbolTable::intern(name))
+{
+	// Left empty
+}
+
+InternedName::InternedName(const InternedName& other) :
+	m_symbol(other.m_symbol)
+{
+	SymbolTable::retain(m_symbol);
+}
+
+InternedName::InternedName(InternedName&& other) noexcept :
+	m_symbol(std::exchange(other.m_symbol, EMPTY_SYMBOL))
+{
+	// Left empty
+}
+
+InternedName& InternedName::operator=(const InternedName& other)
+{
+	// retained first, other may hold the last reference to our symbol
+	SymbolTable::retain(other.m_symbol);
+	SymbolTable::release(m_symbol);
+	m_symbol = other.m_symbol;
+	return *this;
+}
+
+InternedName& InternedName::operator=(InternedName&& other) noexcept
+{
+	if (this != &other) {
+		SymbolTable::release(m_symbol);
+		m_symbol = std::exchange(other.m_symbol, EMPTY_SYMBOL);
+	}
+	return *this;
+}
+
+InternedName::~InternedName()
+{
+	SymbolTable::release(m_symbol);
+}
+
+Symbol InternedName::getSymbol() const
+{
+	return m_symbol;
+}
+
+const std::string& InternedName::get() const
+{
+	return SymbolTable::getName(m_symbol);
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using Symbol = uint32_t;
+
+#define EMPTY_SYMBOL 0				// the empty name, always interned
+#define UNKNOWN_SYMBOL UINT32_MAX	// find() of a name that is not interned
+
+#define SYMBOL_CHUNK_BITS 12		// names per chunk
+#define SYMBOL_PAGE_BITS 10			// chunks per page
+#define SYMBOL_CHUNK_SIZE (1 << SYMBOL_CHUNK_BITS)
+#define SYMBOL_PAGE_SIZE (1 << SYMBOL_PAGE_BITS)
+#define SYMBOL_PAGES (1 << (32 - SYMBOL_CHUNK_BITS - SYMBOL_PAGE_BITS))
+
+/*
+ * SymbolTable - process wide intern table of album, picture and user names.
+ * The model classes keep the 32 bit symbol of their name (see InternedName), so comparing names
+ * is comparing integers and copying a model object copies no string. Every symbol counts the
+ * InternedNames holding it; the last one to go frees the name and its symbol is given out again,
+ * so names decoded from database rows do not pile up.
+ * getName() takes no lock: the names sit in chunks that never move once published. find() and
+ * intern() of a known name share a reader lock, only new and freed names take it alone.
+ */
+class SymbolTable
+{
+public:
+	static Symbol find(const std::string& name);
+	static const std::string& getName(Symbol symbol);
+	static size_t size();
+
+private:
+	friend class InternedName;
+
+	struct Entry
+	{
+		std::string name;
+		std::atomic<uint32_t> references { 0 };
+	};
+
+	struct Page
+	{
+		std::atomic<Entry*> chunks[SYMBOL_PAGE_SIZE];
+	};
+
+	struct State
+	{
+		std::shared_mutex lock;
+		// the keys view the names in the chunks, every name is stored once
+		std::unordered_map<std::string_view, Symbol> symbols;
+		std::vector<Symbol> freeSymbols;
+		Symbol nextSymbol { EMPTY_SYMBOL + 1 };
+	};
+
+	static std::atomic<Page*> m_pages[SYMBOL_PAGES];
+
+	static State& getState();
+
+	// each intern or retain is matched by one release
+	static Symbol intern(const std::string& name);
+	static void retain(Symbol symbol);
+	static void release(Symbol symbol);
+
+	static Entry& getEntry(Symbol symbol);
+	static Symbol add(const std::string& name);
+};
+
+/*
+ * InternedName - a name held as its symbol. The symbol means this name for as long as an
+ * InternedName holds it: copies take another reference, moves hand theirs over.
+ */
+class InternedName
+{
+public:
+	InternedName() = default;
+	explicit InternedName(const std::string& name);
+	InternedName(const InternedName& other);
+	InternedName(InternedName&& other) noexcept;
+	InternedName& operator=(const InternedName& other);
+	InternedName& operator=(InternedName&& other) noexcept;
+	~InternedName();
+
+	Symbol getSymbol() const;
+	const std::string& get() const;
+
+private:
+	Symbol m_symbol { EMPTY_SYMBOL };
+};
@@ -0,0 +1,207 @@
+#include "TagSet.h"
+#include <algorithm>
+
+
+TagSet::TagSet() noexcept :
+	m_size(0), m_capacity(TAG_SET_INLINE_CAPACITY)
+{
+	// Left empty
+}
+
+TagSet::TagSet(std::initializer_list<int> ids) :
+	TagSet()
+{
+	for (int id : ids) {
+		insert(id);
+	}
+}
+
+TagSet::TagSet(const TagSet& other) :
+	TagSet()
+{
+	reserve(other.m_size);
+	std::copy(other.begin(), other.end(), data());
+	m_size = other.m_size;
+}
+
+TagSet::TagSet(TagSet&& other) noexcept :
+	TagSet()
+{
+	steal(other);
+}
+
+TagSet& TagSet::operator=(const TagSet& other)
+{
+	if (this != &other) {
+		m_size = 0;
+		reserve(other.m_size);
+		std::copy(other.begin(), other.end(), data());
+		m_size = other.m_size;
+	}
+	return *this;
+}
+
+TagSet& TagSet::operator=(TagSet&& other) noexcept
+{
+	if (this != &other) {
+		release();
+		steal(other);
+	}
+	return *this;
+}
+
+TagSet::~TagSet()
+{
+	release();
+}
+
+bool TagSet::isInline() const
+{
+	return m_capacity == TAG_SET_INLINE_CAPACITY;
+}
+
+int* TagSet::data()
+{
+	return isInline() ? m_inline : m_heap;
+}
+
+const int* TagSet::data() const
+{
+	return isInline() ? m_inline : m_heap;
+}
+
+// grows the storage to hold at least capacity ids, keeping the current ones
+void TagSet::reserve(uint32_t capacity)
+{
+	if (capacity <= m_capacity) {
+		return;
+	}
+
+	uint32_t newCapacity = std::max(capacity, m_capacity * 2);
+	int* grown = new int[newCapacity];
+	std::copy(begin(), end(), grown);
+
+	release();
+	m_heap = grown;
+	m_capacity = newCapacity;
+}
+
+// takes the ids of other, which is left empty; this must hold no heap array
+void TagSet::steal(TagSet& other) noexcept
+{
+	m_size = other.m_size;
+	m_capacity = other.m_capacity;
+	if (other.isInline()) {
+		std::copy(other.m_inline, other.m_inline + other.m_size, m_inline);
+	}
+	else {
+		m_heap = other.m_heap;
+		other.m_capacity = TAG_SET_INLINE_CAPACITY;
+	}
+	other.m_size = 0;
+}
+
+void TagSet::release()
+{
+	if (!isInline()) {
+		delete[] m_heap;
+		m_capacity = TAG_SET_INLINE_CAPACITY;
+	}
+}
+
+TagSet::const_iterator TagSet::begin() const
+{
+	return data();
+}
+
+TagSet::const_iterator TagSet::end() const
+{
+	return data() + m_size;
+}
+
+size_t TagSet::size() const
+{
+	return m_size;
+}
+
+bool TagSet::empty() const
+{
+	return m_size == 0;
+}
+
+TagSet::const_iterator TagSet::find(int id) const
+{
+	if (isInline()) {
+		// a few ids, a scan beats the branches of a binary search
+		return std::find(begin(), end(), id);
+	}
+
+	const_iterator position = std::lower_bound(begin(), end(), id);
+	return (position != end() && *position == id) ? position : end();
+}
+
+bool TagSet::contains(int id) const
+{
+	return find(id) != end();
+}
+
+/**
+ * insert - Adds an id, keeping the ids sorted.
+ * Params: id - user id
+ * Returns: false if the id was already in the set.
+ */
+bool TagSet::insert(int id)
+{
+	const int* position = std::lower_bound(begin(), end(), id);
+	if (position != end() && *position == id) {
+		return false;
+	}
+
+	size_t index = position - begin();
+	reserve(m_size + 1);
+	int* ids = data();
+	std::copy_backward(ids + index, ids + m_size, ids + m_size + 1);
+	ids[index] = id;
+	++m_size;
+	return true;
+}
+
+/**
+ * erase - Removes an id.
+ * Params: id - user id
+ * Returns: false if the id was not in the set.
+ */
+bool TagSet::erase(int id)
+{
+	const int* position = std::lower_bound(begin(), end(), id);
+	if (position == end() || *position != id) {
+		return false;
+	}
+
+	int* ids = data();
+	size_t index = position - begin();
+	std::copy(ids + index + 1, ids + m_size, ids + index);
+	--m_size;
+	return true;
+}
+
+void TagSet::clear()
+{
+	release();
+	m_size = 0;
+}
+
+size_t TagSet::getHeapBytes() const
+{
+	return isInline() ? 0 : m_capacity * sizeof(int);
+}
+
+bool TagSet::operator==(const TagSet& other) const
+{
+	return m_size == other.m_size && std::equal(begin(), end(), other.begin());
+}
+
+bool TagSet::operator!=(const TagSet& other) const
+{
+	return !(*this == other);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+#define TAG_SET_INLINE_CAPACITY 4
+
+/*
+ * TagSet - the ids of the users tagged in a picture, sorted and unique like the std::set it replaces.
+ * Up to TAG_SET_INLINE_CAPACITY ids live inside the object; more move to one sorted heap array,
+ * searched with a binary search. Copying a picture copies at most one array instead of a tree.
+ */
+class TagSet
+{
+public:
+	using const_iterator = const int*;
+
+	TagSet() noexcept;
+	TagSet(std::initializer_list<int> ids);
+	TagSet(const TagSet& other);
+	TagSet(TagSet&& other) noexcept;
+	TagSet& operator=(const TagSet& other);
+	TagSet& operator=(TagSet&& other) noexcept;
+	~TagSet();
+
+	const_iterator begin() const;
+	const_iterator end() const;
+	size_t size() const;
+	bool empty() const;
+
+	const_iterator find(int id) const;
+	bool contains(int id) const;
+	bool insert(int id);
+	bool erase(int id);
+	void clear();
+
+	size_t getHeapBytes() const;
+
+	bool operator==(const TagSet& other) const;
+	bool operator!=(const TagSet& other) const;
+
+private:
+	uint32_t m_size;
+	uint32_t m_capacity;
+	union
+	{
+		int m_inline[TAG_SET_INLINE_CAPACITY];
+		int* m_heap;
+	};
+
+	bool isInline() const;
+	int* data();
+	const int* data() const;
+	void reserve(uint32_t capacity);
+	void steal(TagSet& other) noexcept;
+	void release();
+};
@@ -0,0 +1,74 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+
+ThreadPool::ThreadPool(size_t threads)
+{
+	// the caller of parallelFor is one of the threads
+	size_t workers = threads > 1 ? threads - 1 : 0;
+	m_workers.reserve(workers);
+	for (size_t i = 0; i < workers; ++i) {
+		m_workers.emplace_back(&ThreadPool::work, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_stopping = true;
+	}
+	m_hasTasks.notify_all();
+	for (auto& worker : m_workers) {
+		worker.join();
+	}
+}
+
+size_t ThreadPool::getThreadsCount() const
+{
+	return m_workers.size() + 1;
+}
+
+void ThreadPool::work()
+{
+	for (;;) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> guard(m_lock);
+			m_hasTasks.wait(guard, [this]() { return m_stopping || !m_tasks.empty(); });
+			if (m_tasks.empty()) {
+				return;
+			}
+			task = std::move(m_tasks.front());
+			m_tasks.pop();
+		}
+		task();
+	}
+}
+
+/**
+ * getDefault - The process wide pool, one thread per core.
+ */
+ThreadPool& ThreadPool::getDefault()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+ThreadPool& Parallelism::getPool() const
+{
+	return pool != nullptr ? *pool : ThreadPool::getDefault();
+}
+
+size_t Parallelism::getChunks(size_t items) const
+{
+	if (items < threshold || items < 2) {
+		return 1;
+	}
+	return std::min(getPool().getThreadsCount(), items);
+}
+
+size_t Parallelism::getChunkBegin(size_t items, size_t chunks, size_t chunk)
+{
+	return items / chunks * chunk + std::min(chunk, items % chunks);
+}
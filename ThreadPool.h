@@ -0,0 +1,127 @@
+#pragma once
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#define PARALLEL_THRESHOLD (64 * 1024)
+
+class ThreadPool;
+
+/*
+ * Parallelism - how a scan is split up: into one chunk per thread of pool (ThreadPool::getDefault()
+ * when null), once it covers at least threshold items. Smaller scans stay on the calling thread.
+ */
+struct Parallelism
+{
+	ThreadPool* pool { nullptr };
+	size_t threshold { PARALLEL_THRESHOLD };
+
+	ThreadPool& getPool() const;
+	size_t getChunks(size_t items) const;
+
+	// fn(chunk) for every chunk, a single chunk runs inline without touching the pool
+	template <typename Function>
+	void run(size_t chunks, Function fn) const;
+
+	// [begin, end) of a chunk, the chunks cover the items in order
+	static size_t getChunkBegin(size_t items, size_t chunks, size_t chunk);
+};
+
+/*
+ * ThreadPool - fixed set of worker threads running submitted tasks in order.
+ * parallelFor splits a job into chunks, runs the first one on the calling thread and
+ * returns once all of them are done. Do not call it from inside a task of the same pool.
+ */
+class ThreadPool
+{
+public:
+	explicit ThreadPool(size_t threads = std::thread::hardware_concurrency());
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// the threads that work on a parallelFor: the workers and the caller
+	size_t getThreadsCount() const;
+
+	template <typename Function>
+	auto submit(Function fn) -> std::future<decltype(fn())>
+	{
+		auto task = std::make_shared<std::packaged_task<decltype(fn())()>>(std::move(fn));
+		auto result = task->get_future();
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_tasks.push([task]() { (*task)(); });
+		}
+		m_hasTasks.notify_one();
+		return result;
+	}
+
+	// calls fn(chunk) for every chunk in [0, chunks), exceptions are rethrown to the caller
+	template <typename Function>
+	void parallelFor(size_t chunks, Function fn)
+	{
+		if (m_workers.empty()) {
+			for (size_t chunk = 0; chunk < chunks; ++chunk) {
+				fn(chunk);
+			}
+			return;
+		}
+
+		std::vector<std::future<void>> pending;
+		pending.reserve(chunks);
+		for (size_t chunk = 1; chunk < chunks; ++chunk) {
+			pending.push_back(submit([&fn, chunk]() { fn(chunk); }));
+		}
+
+		// every chunk refers to fn, so all of them finish before an exception leaves
+		std::exception_ptr error;
+		try {
+			if (chunks > 0) {
+				fn(0);
+			}
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+		for (auto& result : pending) {
+			try {
+				result.get();
+			}
+			catch (...) {
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+		}
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+
+	static ThreadPool& getDefault();
+
+private:
+	std::vector<std::thread> m_workers;
+	std::queue<std::function<void()>> m_tasks;
+	std::mutex m_lock;
+	std::condition_variable m_hasTasks;
+	bool m_stopping { false };
+
+	void work();
+};
+
+template <typename Function>
+void Parallelism::run(size_t chunks, Function fn) const
+{
+	if (chunks == 1) {
+		fn(0);
+		return;
+	}
+	getPool().parallelFor(chunks, fn);
+}
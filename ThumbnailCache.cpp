@@ -0,0 +1,540 @@
+#include "ThumbnailCache.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define THUMBNAIL_KEY_DIGITS 16
+#define THUMBNAIL_EXTENSION ".bmp"
+#define BITMAP_HEADER_BYTES 54
+
+// ******************* Files *******************
+
+/**
+ * statFile - Reads the size and modification time of a file.
+ * Params: path - the file; size, modifiedTime - receive them
+ * Returns: false when there is no such file.
+ */
+static bool statFile(const std::string& path, uint64_t& size, int64_t& modifiedTime)
+{
+	std::error_code error;
+	size = std::filesystem::file_size(path, error);
+	if (error) {
+		return false;
+	}
+	auto time = std::filesystem::last_write_time(path, error);
+	if (error) {
+		return false;
+	}
+	modifiedTime = static_cast<int64_t>(time.time_since_epoch().count());
+	return true;
+}
+
+static bool readFile(const std::string& path, std::vector<uint8_t>& bytes)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) {
+		return false;
+	}
+	std::streamoff size = file.tellg();
+	if (size < 0) {
+		return false;
+	}
+	bytes.resize(static_cast<size_t>(size));
+	file.seekg(0);
+	return size == 0 || file.read(reinterpret_cast<char*>(bytes.data()), size);
+}
+
+// FNV-1a 64 of the file content
+static uint64_t hashContent(const std::vector<uint8_t>& bytes)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (uint8_t byte : bytes) {
+		hash = (hash ^ byte) * 1099511628211ull;
+	}
+	return hash;
+}
+
+// "<16 hex digits>.bmp", the key back from a thumbnail name
+static bool parseThumbnailName(const std::string& name, uint64_t& key)
+{
+	if (name.size() != THUMBNAIL_KEY_DIGITS + sizeof(THUMBNAIL_EXTENSION) - 1 ||
+		name.compare(THUMBNAIL_KEY_DIGITS, std::string::npos, THUMBNAIL_EXTENSION) != 0) {
+		return false;
+	}
+	for (int i = 0; i < THUMBNAIL_KEY_DIGITS; ++i) {
+		if (!isxdigit(static_cast<unsigned char>(name[i]))) {
+			return false;
+		}
+	}
+	key = std::strtoull(name.substr(0, THUMBNAIL_KEY_DIGITS).c_str(), nullptr, 16);
+	return true;
+}
+
+/**
+ * writeBitmap - Writes an image as an uncompressed 24 bit BMP, which every viewer opens.
+ * Params: path - the file, replaced; image - the pixels
+ * Returns: false when the file could not be written.
+ */
+static bool writeBitmap(const std::string& path, const Image& image)
+{
+	size_t stride = (static_cast<size_t>(image.width) * 3 + 3) / 4 * 4;
+	size_t pixelBytes = stride * image.height;
+	std::vector<uint8_t> file(BITMAP_HEADER_BYTES + pixelBytes, 0);
+
+	auto put = [&file](size_t offset, uint32_t value, int count) {
+		for (int i = 0; i < count; ++i) {
+			file[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+		}
+	};
+	file[0] = 'B';
+	file[1] = 'M';
+	put(2, static_cast<uint32_t>(file.size()), 4);
+	put(10, BITMAP_HEADER_BYTES, 4);
+	put(14, 40, 4);		// BITMAPINFOHEADER
+	put(18, static_cast<uint32_t>(image.width), 4);
+	put(22, static_cast<uint32_t>(image.height), 4);
+	put(26, 1, 2);
+	put(28, 24, 2);
+	put(34, static_cast<uint32_t>(pixelBytes), 4);
+
+	// bottom up, BGR
+	for (int y = 0; y < image.height; ++y) {
+		const uint8_t* source = image.pixels.data() + static_cast<size_t>(y) * image.width * 3;
+		uint8_t* target = file.data() + BITMAP_HEADER_BYTES + static_cast<size_t>(image.height - 1 - y) * stride;
+		for (int x = 0; x < image.width; ++x, source += 3, target += 3) {
+			target[0] = source[2];
+			target[1] = source[1];
+			target[2] = source[0];
+		}
+	}
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+	return static_cast<bool>(out);
+}
+
+// ******************* Downscale *******************
+
+// sums[i] += row[i] for the bytes of one source row
+static void accumulateRow(const uint8_t* row, uint32_t* sums, size_t count)
+{
+	size_t i = 0;
+#if defined(__AVX2__)
+	for (; i + 8 <= count; i += 8) {
+		__m256i bytes = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + i)));
+		__m256i total = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sums + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(sums + i), _mm256_add_epi32(total, bytes));
+	}
+#endif
+	for (; i < count; ++i) {
+		sums[i] += row[i];
+	}
+}
+
+void ThumbnailCache::downscale(const Image& source, int maxEdge, Image& target)
+{
+	int longest = std::max(source.width, source.height);
+	if (longest <= maxEdge) {
+		target = source;
+		return;
+	}
+	target.width = std::max(1, static_cast<int>(static_cast<int64_t>(source.width) * maxEdge / longest));
+	target.height = std::max(1, static_cast<int>(static_cast<int64_t>(source.height) * maxEdge / longest));
+	target.pixels.assign(static_cast<size_t>(target.width) * target.height * 3, 0);
+
+	// the source rows of a target row are summed column by column, then every target pixel adds
+	// up the columns it covers; the target is never larger, so every box holds a pixel at least
+	size_t rowBytes = static_cast<size_t>(source.width) * 3;
+	std::vector<uint32_t> sums(rowBytes);
+	for (int y = 0; y < target.height; ++y) {
+		int top = static_cast<int>(static_cast<int64_t>(y) * source.height / target.height);
+		int bottom = static_cast<int>(static_cast<int64_t>(y + 1) * source.height / target.height);
+		std::fill(sums.begin(), sums.end(), 0);
+		for (int row = top; row < bottom; ++row) {
+			accumulateRow(source.pixels.data() + row * rowBytes, sums.data(), rowBytes);
+		}
+
+		uint8_t* pixel = target.pixels.data() + static_cast<size_t>(y) * target.width * 3;
+		for (int x = 0; x < target.width; ++x, pixel += 3) {
+			int left = static_cast<int>(static_cast<int64_t>(x) * source.width / target.width);
+			int right = static_cast<int>(static_cast<int64_t>(x + 1) * source.width / target.width);
+			uint64_t area = static_cast<uint64_t>(right - left) * (bottom - top);
+			uint64_t totals[3] = { 0, 0, 0 };
+			for (const uint32_t* column = sums.data() + left * 3; column < sums.data() + right * 3; column += 3) {
+				totals[0] += column[0];
+				totals[1] += column[1];
+				totals[2] += column[2];
+			}
+			for (int channel = 0; channel < 3; ++channel) {
+				pixel[channel] = static_cast<uint8_t>((totals[channel] + area / 2) / area);
+			}
+		}
+	}
+}
+
+bool ThumbnailCache::isVectorized()
+{
+#if defined(__AVX2__)
+	return true;
+#else
+	return false;
+#endif
+}
+
+// ******************* ThumbnailCache *******************
+
+ThumbnailCache::ThumbnailCache(const std::string& directory, uint64_t budget, size_t threads) :
+	m_directory(directory), m_budget(budget), m_pool(std::max<size_t>(threads, 2))
+{
+	// (the callers never run jobs themselves, so the pool has one worker at least)
+	std::error_code error;
+	std::filesystem::create_directories(m_directory, error);
+
+	// the thumbnails of earlier runs, least recently used first
+	std::vector<std::pair<std::filesystem::file_time_type, std::pair<uint64_t, uint64_t>>> found;
+	for (const auto& entry : std::filesystem::directory_iterator(m_directory, error)) {
+		uint64_t key = 0;
+		std::error_code entryError;
+		if (!parseThumbnailName(entry.path().filename().string(), key)) {
+			if (entry.path().extension() == ".tmp") {
+				std::filesystem::remove(entry.path(), entryError);	// a run stopped while writing it
+			}
+			continue;
+		}
+		uint64_t bytes = entry.file_size(entryError);
+		if (entryError) {
+			continue;
+		}
+		auto time = entry.last_write_time(entryError);
+		if (!entryError) {
+			found.push_back({ time, { key, bytes } });
+		}
+	}
+	std::sort(found.begin(), found.end());
+
+	std::lock_guard<std::mutex> guard(m_lock);
+	for (const auto& thumbnail : found) {
+		insert(thumbnail.second.first, thumbnail.second.second);
+	}
+	evict();
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+	// the prefetches no worker took are dropped, the thumbnails being made are finished
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_prefetches.clear();
+	}
+	wait();
+	saveRecency();
+}
+
+std::shared_future<std::string> ThumbnailCache::request(const std::string& path)
+{
+	std::string thumbnail;
+	if (findCached(path, thumbnail)) {
+		std::promise<std::string> ready;
+		ready.set_value(thumbnail);
+		return ready.get_future().share();
+	}
+	return enqueue(path, nullptr);
+}
+
+void ThumbnailCache::prefetch(const std::vector<std::string>& paths)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	// the pictures listed last are the ones about to be looked at
+	m_prefetches.assign(paths.begin(), paths.begin() + std::min<size_t>(paths.size(), THUMBNAIL_PREFETCH_LIMIT));
+
+	// a job per worker at most, the requests still get their turn between the paths
+	size_t workers = m_pool.getThreadsCount() - 1;
+	while (m_prefetchJobs < workers && m_prefetchJobs < m_prefetches.size()) {
+		++m_prefetchJobs;
+		m_pool.submit([this]() { prefetchNext(); });
+	}
+}
+
+/**
+ * prefetchNext - Runs on the pool: answers the next prefetched path like a request would, then
+ * queues itself again behind the jobs submitted meanwhile, until no path is left.
+ */
+void ThumbnailCache::prefetchNext()
+{
+	std::string path;
+	std::promise<std::string> done;
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		// a path requested meanwhile is being made already
+		while (!m_prefetches.empty() && m_pending.count(m_prefetches.front()) != 0) {
+			m_prefetches.pop_front();
+		}
+		if (m_prefetches.empty()) {
+			--m_prefetchJobs;
+			m_prefetchesDone.notify_all();
+			return;
+		}
+		path = std::move(m_prefetches.front());
+		m_prefetches.pop_front();
+		m_pending.emplace(path, done.get_future().share());
+	}
+
+	// the stat of findCached is made here, on the worker
+	std::string thumbnail;
+	if (findCached(path, thumbnail)) {
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_pending.erase(path);
+	}
+	else {
+		thumbnail = runJob(path, nullptr);
+	}
+	done.set_value(thumbnail);
+	m_pool.submit([this]() { prefetchNext(); });
+}
+
+void ThumbnailCache::add(const std::string& path, Image image)
+{
+	enqueue(path, std::make_shared<Image>(std::move(image)));
+}
+
+void ThumbnailCache::wait()
+{
+	// the jobs leave m_pending as they finish, and may be queued while waiting
+	for (;;) {
+		std::vector<std::shared_future<std::string>> pending;
+		{
+			std::unique_lock<std::mutex> guard(m_lock);
+			m_prefetchesDone.wait(guard, [this]() { return m_prefetchJobs == 0; });
+			if (m_pending.empty()) {
+				return;
+			}
+			for (const auto& job : m_pending) {
+				pending.push_back(job.second);
+			}
+		}
+		for (const auto& job : pending) {
+			job.wait();
+		}
+	}
+}
+
+/**
+ * saveRecency - Stamps the thumbnails used in this run with increasing modification times in
+ * their order of use, so the next run orders them after the ones not used since.
+ */
+void ThumbnailCache::saveRecency()
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	// a millisecond apart, the most recent one now
+	auto time = std::filesystem::file_time_type::clock::now() - std::chrono::milliseconds(m_used.size());
+	for (auto key = m_recency.rbegin(); key != m_recency.rend(); ++key) {
+		if (m_used.count(*key) != 0) {
+			time += std::chrono::milliseconds(1);
+			std::error_code error;
+			std::filesystem::last_write_time(getThumbnailPath(*key), time, error);
+		}
+	}
+	m_used.clear();
+}
+
+ThumbnailCache::Stats ThumbnailCache::getStats() const
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	return m_stats;
+}
+
+std::string ThumbnailCache::getThumbnailPath(uint64_t key) const
+{
+	char name[THUMBNAIL_KEY_DIGITS + sizeof(THUMBNAIL_EXTENSION)];
+	std::snprintf(name, sizeof(name), "%016llx" THUMBNAIL_EXTENSION, static_cast<unsigned long long>(key));
+	return (std::filesystem::path(m_directory) / name).string();
+}
+
+/**
+ * findCached - Answers a request without the pool when the file did not change since its content
+ * was hashed and that content has a thumbnail (or is known not to decode).
+ * Params: path - the picture file; thumbnail - receives the thumbnail path, empty for a failure
+ * Returns: false when the file has to be read.
+ */
+bool ThumbnailCache::findCached(const std::string& path, std::string& thumbnail)
+{
+	uint64_t size = 0;
+	int64_t modifiedTime = 0;
+	if (!statFile(path, size, modifiedTime)) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> guard(m_lock);
+	auto known = m_keys.find(path);
+	if (known == m_keys.end() || known->second.size != size || known->second.modifiedTime != modifiedTime) {
+		return false;
+	}
+	uint64_t key = known->second.key;
+	if (m_failed.count(key) != 0) {
+		thumbnail.clear();
+		return true;
+	}
+	if (m_entries.count(key) == 0) {
+		return false;
+	}
+	touch(key);
+	++m_stats.hits;
+	thumbnail = getThumbnailPath(key);
+	return true;
+}
+
+std::shared_future<std::string> ThumbnailCache::enqueue(const std::string& path, std::shared_ptr<Image> image)
+{
+	std::lock_guard<std::mutex> guard(m_lock);
+	auto pending = m_pending.find(path);
+	if (pending != m_pending.end()) {
+		return pending->second;
+	}
+
+	// the job takes m_lock to leave m_pending, so it can not do that before it is in there
+	std::shared_future<std::string> result = m_pool.submit([this, path, image]() {
+		return runJob(path, image.get());
+	}).share();
+	m_pending.emplace(path, result);
+	return result;
+}
+
+/**
+ * runJob - Makes a thumbnail on the pool, then takes the path out of m_pending.
+ * Returns: the thumbnail path, empty when it can not be made.
+ */
+std::string ThumbnailCache::runJob(const std::string& path, const Image* image)
+{
+	std::string thumbnail;
+	bool failed = false;
+	try {
+		thumbnail = makeThumbnail(path, image);
+	}
+	catch (const std::exception&) {
+		failed = true;	// out of memory for a large image
+	}
+	std::lock_guard<std::mutex> guard(m_lock);
+	m_stats.failures += failed ? 1 : 0;
+	m_pending.erase(path);
+	return thumbnail;
+}
+
+/**
+ * makeThumbnail - Runs on the pool: hashes the file, and when its content has no thumbnail yet
+ * decodes it (unless image is already the decoded file), scales it down and writes the thumbnail.
+ * Params: path - the picture file; image - its decoded pixels, or nullptr
+ * Returns: the thumbnail path, empty when the file can not be read or decoded.
+ */
+std::string ThumbnailCache::makeThumbnail(const std::string& path, const Image* image)
+{
+	uint64_t size = 0;
+	int64_t modifiedTime = 0;
+	std::vector<uint8_t> bytes;
+	if (!statFile(path, size, modifiedTime) || !readFile(path, bytes)) {
+		std::lock_guard<std::mutex> guard(m_lock);
+		++m_stats.failures;
+		return "";
+	}
+	uint64_t key = hashContent(bytes);
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_keys[path] = { size, modifiedTime, key };
+		if (m_failed.count(key) != 0) {
+			return "";
+		}
+		if (m_entries.count(key) != 0) {
+			touch(key);
+			++m_stats.hits;
+			return getThumbnailPath(key);
+		}
+	}
+
+	Image decoded;
+	if (image == nullptr) {
+		bool isDecoded = ImageDecoder::decode(bytes.data(), bytes.size(), decoded);
+		std::lock_guard<std::mutex> guard(m_lock);
+		++m_stats.decodes;
+		if (!isDecoded) {
+			m_failed.insert(key);
+			++m_stats.failures;
+			return "";
+		}
+		image = &decoded;
+	}
+	std::vector<uint8_t>().swap(bytes);
+
+	Image thumbnailImage;
+	downscale(*image, THUMBNAIL_EDGE, thumbnailImage);
+	std::vector<uint8_t>().swap(decoded.pixels);
+
+	// written aside and renamed, so a thumbnail on disk is always complete; every worker has its
+	// own temporary name, two of them may be making the same thumbnail
+	std::string thumbnail = getThumbnailPath(key);
+	std::string temporary = thumbnail + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	std::error_code error;
+	if (writeBitmap(temporary, thumbnailImage)) {
+		std::filesystem::rename(temporary, thumbnail, error);
+	}
+	else {
+		error = std::make_error_code(std::errc::io_error);
+	}
+	uint64_t thumbnailBytes = error ? 0 : std::filesystem::file_size(thumbnail, error);
+
+	std::lock_guard<std::mutex> guard(m_lock);
+	if (error) {
+		std::error_code ignored;
+		std::filesystem::remove(temporary, ignored);
+		++m_stats.failures;
+		return "";
+	}
+	++m_stats.generated;
+	insert(key, thumbnailBytes);
+	m_used.insert(key);
+	evict();
+	return thumbnail;
+}
+
+// the callers hold m_lock
+void ThumbnailCache::insert(uint64_t key, uint64_t bytes)
+{
+	if (m_entries.count(key) != 0) {
+		touch(key);
+		return;
+	}
+	m_recency.push_front(key);
+	m_entries.emplace(key, Entry { bytes, m_recency.begin() });
+	m_stats.bytes += bytes;
+	++m_stats.thumbnails;
+}
+
+void ThumbnailCache::touch(uint64_t key)
+{
+	auto entry = m_entries.find(key);
+	m_recency.splice(m_recency.begin(), m_recency, entry->second.recency);
+	// the file is left alone, saveRecency writes the order once
+	m_used.insert(key);
+}
+
+void ThumbnailCache::evict()
+{
+	// the most recent one stays, even when it alone is over the budget
+	while (m_stats.bytes > m_budget && m_recency.size() > 1) {
+		uint64_t key = m_recency.back();
+		std::error_code error;
+		std::filesystem::remove(getThumbnailPath(key), error);
+		m_stats.bytes -= m_entries[key].bytes;
+		m_entries.erase(key);
+		m_used.erase(key);
+		m_recency.pop_back();
+		--m_stats.thumbnails;
+		++m_stats.evictions;
+	}
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <cstddef>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "ImageDecoder.h"
+#include "ThreadPool.h"
+
+#define THUMBNAIL_CACHE_DIR "thumbnails"
+#define THUMBNAIL_CACHE_BYTES (64 * 1024 * 1024)	// thumbnails beyond it are evicted, least recently used first
+#define THUMBNAIL_EDGE 160							// longest side of a thumbnail, in pixels
+#define THUMBNAIL_PREFETCH_LIMIT 64					// paths a prefetch keeps, the first ones given
+
+/*
+ * ThumbnailCache - small BMP copies of the pictures, kept in a directory and named after a 64 bit
+ * hash of the file content, so copies of a picture share one thumbnail and an edited file gets a
+ * new one. Thumbnails are made on a pool of their own: from an image already decoded (add, when a
+ * picture is added) or by decoding the file (request, on a miss). A file being worked on is never
+ * queued twice, and a file whose size and modification time did not change is not read again, so
+ * browsing decodes every full size image at most once. A prefetch only queues its paths: the
+ * workers take them one at a time, behind the requests, and a new prefetch replaces the paths
+ * not taken yet. The directory is kept under its byte budget by evicting the least recently used
+ * thumbnails. Hits reorder them in memory only; saveRecency (run by the destructor) stamps the
+ * thumbnails used in this run with modification times in that order, which the next run reads.
+ */
+class ThumbnailCache
+{
+public:
+	struct Stats
+	{
+		size_t hits { 0 };			// requests answered without decoding
+		size_t decodes { 0 };		// full size images decoded
+		size_t generated { 0 };		// thumbnails written
+		size_t failures { 0 };		// files that could not be read or decoded
+		size_t evictions { 0 };
+		size_t thumbnails { 0 };
+		uint64_t bytes { 0 };
+	};
+
+	explicit ThumbnailCache(const std::string& directory = THUMBNAIL_CACHE_DIR, uint64_t budget = THUMBNAIL_CACHE_BYTES,
+		size_t threads = std::thread::hardware_concurrency());
+	~ThumbnailCache();
+	ThumbnailCache(const ThumbnailCache&) = delete;
+	ThumbnailCache& operator=(const ThumbnailCache&) = delete;
+
+	// the path of the thumbnail of the file, made on the pool when needed; empty when it can not be made
+	std::shared_future<std::string> request(const std::string& path);
+	// requests the paths in the background, e.g. the pictures of an album being listed; the caller
+	// does not touch the files
+	void prefetch(const std::vector<std::string>& paths);
+	// makes the thumbnail of the file from its decoded image, on the pool
+	void add(const std::string& path, Image image);
+	// returns once every queued thumbnail and prefetch is done
+	void wait();
+	// writes the order of use to the directory, for the next run
+	void saveRecency();
+
+	Stats getStats() const;
+
+	// box filter: every pixel of target is the average of the pixels of source it covers
+	static void downscale(const Image& source, int maxEdge, Image& target);
+	static bool isVectorized();
+
+private:
+	struct ContentKey
+	{
+		uint64_t size;
+		int64_t modifiedTime;
+		uint64_t key;
+	};
+
+	struct Entry
+	{
+		uint64_t bytes;
+		std::list<uint64_t>::iterator recency;
+	};
+
+	std::string m_directory;
+	uint64_t m_budget;
+
+	mutable std::mutex m_lock;
+	std::unordered_map<std::string, ContentKey> m_keys;		// path -> content key, while size and time match
+	std::unordered_map<uint64_t, Entry> m_entries;			// content key -> thumbnail on disk
+	std::list<uint64_t> m_recency;							// content keys, most recently used first
+	std::unordered_set<uint64_t> m_failed;					// content that does not decode
+	std::unordered_map<std::string, std::shared_future<std::string>> m_pending;
+	std::unordered_set<uint64_t> m_used;					// content keys used in this run, see saveRecency
+	std::deque<std::string> m_prefetches;					// paths no worker took yet
+	size_t m_prefetchJobs { 0 };							// on the pool, each takes one path at a time
+	std::condition_variable m_prefetchesDone;
+	Stats m_stats;
+
+	// last, so its workers finish the queued jobs before the members above go away
+	ThreadPool m_pool;
+
+	std::string getThumbnailPath(uint64_t key) const;
+	bool findCached(const std::string& path, std::string& thumbnail);
+	std::shared_future<std::string> enqueue(const std::string& path, std::shared_ptr<Image> image);
+	void prefetchNext();
+	std::string runJob(const std::string& path, const Image* image);
+	std::string makeThumbnail(const std::string& path, const Image* image);
+	void insert(uint64_t key, uint64_t bytes);
+	void touch(uint64_t key);
+	void evict();
+};
@@ -0,0 +1,448 @@
+#include "TieredDataAccess.h"
+#include <algorithm>
+#include "MyException.h"
+
+
+double TieredDataAccess::Stats::getHitRatio() const
+{
+	size_t reads = hits + misses;
+	return reads == 0 ? 0 : static_cast<double>(hits) / reads;
+}
+
+TieredDataAccess::TieredDataAccess(const TieringOptions& options) :
+	m_options(options), m_cold(options.dbFileName)
+{
+	// Left empty
+}
+
+bool TieredDataAccess::open()
+{
+	return m_cold.open();
+}
+
+void TieredDataAccess::close()
+{
+	m_cold.close();
+	clear();
+}
+
+void TieredDataAccess::clear()
+{
+	m_cold.clear();
+	m_hot.clear();
+	m_resident.clear();
+	m_recentlyUsed.clear();
+	m_residentBytes = 0;
+}
+
+TieredDataAccess::Stats TieredDataAccess::getStats() const
+{
+	Stats stats = m_stats;
+	stats.residentAlbums = 0;
+	for (const auto& resident : m_resident) {
+		stats.residentAlbums += resident.second.owners.size();
+	}
+	stats.residentBytes = m_residentBytes;
+	return stats;
+}
+
+// ******************* Residency *******************
+/**
+ * findResident - Looks an album name up in the hot tier and marks it as the most recently used.
+ * Params: albumName - the name
+ * Returns: The resident entry, nullptr if the name is not in the hot tier.
+ */
+TieredDataAccess::Resident* TieredDataAccess::findResident(const std::string& albumName)
+{
+	auto found = m_resident.find(SymbolTable::find(albumName));
+	if (found == m_resident.end()) {
+		return nullptr;
+	}
+
+	m_recentlyUsed.splice(m_recentlyUsed.begin(), m_recentlyUsed, found->second.recentlyUsed);
+	return &found->second;
+}
+
+/**
+ * fault - Makes an album name resident for a read, loading its albums from SQLite on a miss.
+ * Params: albumName - the name
+ * Returns: The resident entry, nullptr if SQLite has no album with that name.
+ */
+TieredDataAccess::Resident* TieredDataAccess::fault(const std::string& albumName)
+{
+	Resident* resident = findResident(albumName);
+	if (resident != nullptr) {
+		++m_stats.hits;
+		return resident;
+	}
+
+	++m_stats.misses;
+	std::list<Album> albums = m_cold.loadAlbums(albumName);
+	if (albums.empty()) {
+		return nullptr;
+	}
+
+	Symbol name = albums.front().getNameSymbol();
+	Resident& loaded = m_resident[name];
+	for (const Album& album : albums) {
+		m_hot.createAlbum(album);
+		loaded.owners.push_back(album.getOwnerId());
+		loaded.bytes += album.getMemoryUsage();
+	}
+	loaded.recentlyUsed = m_recentlyUsed.insert(m_recentlyUsed.begin(), name);
+	m_residentBytes += loaded.bytes;
+	m_stats.faultedAlbums += albums.size();
+
+	evict();
+	return &loaded;
+}
+
+void TieredDataAccess::drop(Symbol name)
+{
+	auto found = m_resident.find(name);
+	if (found == m_resident.end()) {
+		return;
+	}
+
+	// a copy: the name is freed with the last album holding it
+	std::string albumName = SymbolTable::getName(name);
+	for (int owner : found->second.owners) {
+		m_hot.deleteAlbum(albumName, owner);
+	}
+	m_residentBytes -= found->second.bytes;
+	m_recentlyUsed.erase(found->second.recentlyUsed);
+	m_resident.erase(found);
+}
+
+// the most recently used name always stays, even when it alone is over the budget
+void TieredDataAccess::evict()
+{
+	while (m_residentBytes > m_options.memoryBudget && m_recentlyUsed.size() > 1) {
+		Symbol coldest = m_recentlyUsed.back();
+		++m_stats.evictions;
+		m_stats.evictedAlbums += m_resident[coldest].owners.size();
+		drop(coldest);
+	}
+}
+
+void TieredDataAccess::resize(Resident& resident, long long bytes)
+{
+	resident.bytes += bytes;
+	m_residentBytes += bytes;
+	evict();
+}
+
+void TieredDataAccess::recountResidentBytes()
+{
+	for (auto& resident : m_resident) {
+		resident.second.bytes = 0;
+	}
+	m_hot.forEachAlbum([this](const Album& album) {
+		auto resident = m_resident.find(album.getNameSymbol());
+		if (resident != m_resident.end()) {
+			resident->second.bytes += album.getMemoryUsage();
+		}
+	});
+
+	m_residentBytes = 0;
+	for (const auto& resident : m_resident) {
+		m_residentBytes += resident.second.bytes;
+	}
+}
+
+// ******************* Album *******************
+const std::list<Album> TieredDataAccess::getAlbums()
+{
+	return m_cold.getAlbums();
+}
+
+const std::list<Album> TieredDataAccess::getAlbumsOfUser(const User& user)
+{
+	return m_cold.getAlbumsOfUser(user);
+}
+
+void TieredDataAccess::createAlbum(const Album& album)
+{
+	m_cold.createAlbum(album);
+
+	// the name is loaded again as stored on its next read
+	drop(album.getNameSymbol());
+}
+
+void TieredDataAccess::deleteAlbum(const std::string& albumName, int userId)
+{
+	m_cold.deleteAlbum(albumName, userId);
+	drop(SymbolTable::find(albumName));
+}
+
+bool TieredDataAccess::doesAlbumExists(const std::string& albumName, int userId)
+{
+	// a resident name has all of its albums in the hot tier
+	if (findResident(albumName) != nullptr) {
+		++m_stats.hits;
+		return m_hot.doesAlbumExists(albumName, userId);
+	}
+
+	++m_stats.misses;
+	return m_cold.doesAlbumExists(albumName, userId);
+}
+
+Album TieredDataAccess::openAlbum(const std::string& albumName)
+{
+	if (fault(albumName) == nullptr) {
+		throw MyException("No album with name " + albumName + " exists");
+	}
+	return m_hot.openAlbum(albumName);
+}
+
+void TieredDataAccess::closeAlbum(Album& )
+{
+	// albums are returned by value, nothing to release
+}
+
+void TieredDataAccess::printAlbums()
+{
+	m_cold.printAlbums();
+}
+
+void TieredDataAccess::forEachPicture(const std::function<void(const Album&, const Picture&)>& fn)
+{
+	m_cold.forEachPicture(fn);
+}
+
+void TieredDataAccess::forEachPictureOfUser(const User& user, const std::function<void(const Album&, const Picture&)>& fn)
+{
+	m_cold.forEachPictureOfUser(user, fn);
+}
+
+bool TieredDataAccess::visitPicture(const std::string& albumName, const std::string& pictureName, const std::function<void(const Picture&)>& fn)
+{
+	if (fault(albumName) == nullptr) {
+		return false;
+	}
+	return m_hot.visitPicture(albumName, pictureName, fn);
+}
+
+std::list<Album> TieredDataAccess::getAlbumsSorted(const ListingOrder& order)
+{
+	return m_cold.getAlbumsSorted(order);
+}
+
+// the pictures of one album name are answered like openAlbum, from the hot tier
+std::list<Picture> TieredDataAccess::getPicturesSorted(const std::string& albumName, const ListingOrder& order)
+{
+	if (fault(albumName) == nullptr) {
+		throw MyException("No album with name " + albumName + " exists");
+	}
+	return m_hot.getPicturesSorted(albumName, order);
+}
+
+// ******************* Picture *******************
+void TieredDataAccess::addPictureToAlbumByName(const std::string& albumName, const Picture& picture)
+{
+	m_cold.addPictureToAlbumByName(albumName, picture);
+
+	Resident* resident = findResident(albumName);
+	if (resident == nullptr) {
+		return;
+	}
+
+	// the hot copy looks like the row: the id SQLite gave it and no tags
+	Picture stored(picture);
+	stored.setId(m_cold.getPictureFromAlbum(albumName, picture.getName()).getId());
+	for (int userId : picture.getUserTags()) {
+		stored.untagUser(userId);
+	}
+	m_hot.addPictureToAlbumByName(albumName, stored);
+	resize(*resident, stored.getMemoryUsage());
+}
+
+void TieredDataAccess::removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName)
+{
+	m_cold.removePictureFromAlbumByName(albumName, pictureName);
+
+	Resident* resident = findResident(albumName);
+	if (resident == nullptr) {
+		return;
+	}
+
+	const Picture* picture = m_hot.findPicture(albumName, pictureName);
+	if (picture != nullptr) {
+		long long bytes = picture->getMemoryUsage();
+		m_hot.removePictureFromAlbumByName(albumName, pictureName);
+		resize(*resident, -bytes);
+	}
+}
+
+// tags load the album: the hot copy knows the picture id, so SQLite only runs the write itself
+void TieredDataAccess::tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
+{
+	const Picture* picture = fault(albumName) == nullptr ? nullptr : m_hot.findPicture(albumName, pictureName);
+	if (picture == nullptr) {
+		m_cold.tagUserInPicture(albumName, pictureName, userId);
+		return;
+	}
+
+	m_cold.tagUserInPictureById(picture->getId(), userId);
+	m_hot.tagUserInPicture(albumName, pictureName, userId);
+	resize(*findResident(albumName), sizeof(int));
+}
+
+void TieredDataAccess::untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
+{
+	const Picture* picture = fault(albumName) == nullptr ? nullptr : m_hot.findPicture(albumName, pictureName);
+	if (picture == nullptr) {
+		m_cold.untagUserInPicture(albumName, pictureName, userId);
+		return;
+	}
+
+	m_cold.untagUserInPictureById(picture->getId(), userId);
+	m_hot.untagUserInPicture(albumName, pictureName, userId);
+	resize(*findResident(albumName), -static_cast<long long>(sizeof(int)));
+}
+
+bool TieredDataAccess::getFileMetadata(const std::string& path, FileMetadata& metadata)
+{
+	return m_cold.getFileMetadata(path, metadata);
+}
+
+void TieredDataAccess::getFilesMetadata(const std::vector<std::string>& paths, const std::function<void(const FileMetadata&)>& fn)
+{
+	m_cold.getFilesMetadata(paths, fn);
+}
+
+void TieredDataAccess::storeFileMetadata(const std::vector<FileMetadata>& files)
+{
+	m_cold.storeFileMetadata(files);
+}
+
+void TieredDataAccess::forEachFileMetadata(const std::function<void(const FileMetadata&)>& fn)
+{
+	m_cold.forEachFileMetadata(fn);
+}
+
+bool TieredDataAccess::doesPictureExistsInAlbum(const std::string& albumName, const std::string& pictureName)
+{
+	if (fault(albumName) == nullptr) {
+		return m_cold.doesPictureExistsInAlbum(albumName, pictureName);
+	}
+	return m_hot.findPicture(albumName, pictureName) != nullptr;
+}
+
+Picture TieredDataAccess::getPictureFromAlbum(const std::string& albumName, const std::string& pictureName)
+{
+	if (fault(albumName) == nullptr) {
+		return m_cold.getPictureFromAlbum(albumName, pictureName);
+	}
+	return m_hot.getPictureFromAlbum(albumName, pictureName);
+}
+
+bool TieredDataAccess::isUserTaggedInPicture(const User& user, const Picture& picture)
+{
+	return m_cold.isUserTaggedInPicture(user, picture);
+}
+
+std::list<User> TieredDataAccess::getUsersTaggedInPicture(const Picture& picture)
+{
+	return m_cold.getUsersTaggedInPicture(picture);
+}
+
+// ******************* User *******************
+void TieredDataAccess::printUsers()
+{
+	m_cold.printUsers();
+}
+
+User TieredDataAccess::getUser(int userId)
+{
+	if (m_hot.doesUserExists(userId)) {
+		return m_hot.getUser(userId);
+	}
+
+	User user = m_cold.getUser(userId);
+	m_hot.createUser(user);
+	return user;
+}
+
+void TieredDataAccess::createUser(User& user)
+{
+	m_cold.createUser(user);
+	m_hot.createUser(user);
+}
+
+void TieredDataAccess::deleteUser(const User& user)
+{
+	m_cold.deleteUser(user);
+
+	// the hot tier drops the user's albums and tags, the entries follow. Users are only hot once
+	// read or created, but their albums and tags may be hot without them
+	if (m_hot.doesUserExists(user.getId())) {
+		m_hot.deleteUser(user);
+	}
+	else {
+		m_hot.cleanUserData(user);
+	}
+	for (auto resident = m_resident.begin(); resident != m_resident.end();) {
+		auto& owners = resident->second.owners;
+		owners.erase(std::remove(owners.begin(), owners.end(), user.getId()), owners.end());
+		if (owners.empty()) {
+			m_recentlyUsed.erase(resident->second.recentlyUsed);
+			resident = m_resident.erase(resident);
+		}
+		else {
+			++resident;
+		}
+	}
+	recountResidentBytes();
+}
+
+bool TieredDataAccess::doesUserExists(int userId)
+{
+	return m_hot.doesUserExists(userId) || m_cold.doesUserExists(userId);
+}
+
+bool TieredDataAccess::doesUserExists(const std::string& name)
+{
+	return m_cold.doesUserExists(name);
+}
+
+int TieredDataAccess::getTheNextId(const std::string& tableName)
+{
+	return m_cold.getTheNextId(tableName);
+}
+
+// ******************* Statistics *******************
+int TieredDataAccess::countAlbumsOwnedOfUser(const User& user)
+{
+	return m_cold.countAlbumsOwnedOfUser(user);
+}
+
+int TieredDataAccess::countAlbumsTaggedOfUser(const User& user)
+{
+	return m_cold.countAlbumsTaggedOfUser(user);
+}
+
+int TieredDataAccess::countTagsOfUser(const User& user)
+{
+	return m_cold.countTagsOfUser(user);
+}
+
+float TieredDataAccess::averageTagsPerAlbumOfUser(const User& user)
+{
+	return m_cold.averageTagsPerAlbumOfUser(user);
+}
+
+User TieredDataAccess::getTopTaggedUser()
+{
+	return m_cold.getTopTaggedUser();
+}
+
+Picture TieredDataAccess::getTopTaggedPicture()
+{
+	return m_cold.getTopTaggedPicture();
+}
+
+std::list<Picture> TieredDataAccess::getTaggedPicturesOfUser(const User& user)
+{
+	return m_cold.getTaggedPicturesOfUser(user);
+}
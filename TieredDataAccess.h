@@ -0,0 +1,134 @@
+#pragma once
+#include <cstddef>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "DatabaseAcses.h"
+#include "MemoryAccess.h"
+
+#define TIERED_DEFAULT_BUDGET (64 * 1024 * 1024)
+
+struct TieringOptions
+{
+	std::string dbFileName { DEFAULT_DB_FILE };
+	size_t memoryBudget { TIERED_DEFAULT_BUDGET };		// estimated bytes of the resident albums
+};
+
+/*
+ * TieredDataAccess - a MemoryAccess hot tier in front of a DatabaseAccess cold tier.
+ * Albums are resident by name: reading an album, or a picture of it, loads every album with
+ * that name from SQLite (pictures and tags included), so the hot tier answers for the name
+ * as a whole. Writes go through to SQLite first and are applied to resident albums.
+ * Tagging loads the album too (the hot copy has the picture id SQLite needs); the other
+ * writes to albums that are not resident do not load them.
+ * Once the resident albums go over the memory budget, the least recently used names are
+ * evicted. Users are small and stay in the hot tier once seen.
+ * Queries over all albums or users (listings, statistics, top tagged) run on SQLite, which
+ * always has every write.
+ */
+class TieredDataAccess : public IDataAccess
+{
+public:
+	struct Stats
+	{
+		size_t hits { 0 };				// album reads answered by the hot tier
+		size_t misses { 0 };			// album reads that went to SQLite
+		size_t faultedAlbums { 0 };		// albums loaded from SQLite
+		size_t evictions { 0 };			// album names evicted for the budget
+		size_t evictedAlbums { 0 };
+		size_t residentAlbums { 0 };
+		size_t residentBytes { 0 };
+
+		double getHitRatio() const;
+	};
+
+	explicit TieredDataAccess(const TieringOptions& options = TieringOptions());
+	virtual ~TieredDataAccess() = default;
+
+	// album related
+	const std::list<Album> getAlbums() override;
+	const std::list<Album> getAlbumsOfUser(const User& user) override;
+	void createAlbum(const Album& album) override;
+	void deleteAlbum(const std::string& albumName, int userId) override;
+	bool doesAlbumExists(const std::string& albumName, int userId) override;
+	Album openAlbum(const std::string& albumName) override;
+	void closeAlbum(Album& pAlbum) override;
+	void printAlbums() override;
+
+	bool visitPicture(const std::string& albumName, const std::string& pictureName, const std::function<void(const Picture&)>& fn) override;
+	// the cold tier has every picture, these do not fault the albums in
+	void forEachPicture(const std::function<void(const Album&, const Picture&)>& fn) override;
+	void forEachPictureOfUser(const User& user, const std::function<void(const Album&, const Picture&)>& fn) override;
+
+	std::list<Album> getAlbumsSorted(const ListingOrder& order) override;
+	std::list<Picture> getPicturesSorted(const std::string& albumName, const ListingOrder& order) override;
+
+	// picture related
+	void addPictureToAlbumByName(const std::string& albumName, const Picture& picture) override;
+	void removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName) override;
+	void tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
+	void untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
+
+	// always in the database, the hot tier only holds albums
+	bool getFileMetadata(const std::string& path, FileMetadata& metadata) override;
+	void getFilesMetadata(const std::vector<std::string>& paths, const std::function<void(const FileMetadata&)>& fn) override;
+	void storeFileMetadata(const std::vector<FileMetadata>& files) override;
+	void forEachFileMetadata(const std::function<void(const FileMetadata&)>& fn) override;
+
+	// user related
+	void printUsers() override;
+	User getUser(int userId) override;
+	void createUser(User& user) override;
+	void deleteUser(const User& user) override;
+	bool doesUserExists(int userId) override;
+
+	// user statistics
+	int countAlbumsOwnedOfUser(const User& user) override;
+	int countAlbumsTaggedOfUser(const User& user) override;
+	int countTagsOfUser(const User& user) override;
+	float averageTagsPerAlbumOfUser(const User& user) override;
+
+	// queries
+	User getTopTaggedUser() override;
+	Picture getTopTaggedPicture() override;
+	std::list<Picture> getTaggedPicturesOfUser(const User& user) override;
+
+	bool open() override;
+	void close() override;
+	void clear() override;
+
+	bool doesPictureExistsInAlbum(const std::string& albumName, const std::string& pictureName) override;
+	int getTheNextId(const std::string& tableName) override;
+	Picture getPictureFromAlbum(const std::string& albumName, const std::string& pictureName) override;
+	bool isUserTaggedInPicture(const User& user, const Picture& picture) override;
+	std::list<User> getUsersTaggedInPicture(const Picture& picture) override;
+	bool doesUserExists(const std::string& name) override;
+
+	Stats getStats() const;
+
+private:
+	// every album of one name that is in the hot tier
+	struct Resident
+	{
+		std::list<Symbol>::iterator recentlyUsed;
+		std::vector<int> owners;
+		size_t bytes { 0 };
+	};
+
+	TieringOptions m_options;
+	DatabaseAccess m_cold;
+	MemoryAccess m_hot;
+
+	std::unordered_map<Symbol, Resident> m_resident;
+	std::list<Symbol> m_recentlyUsed;		// most recently used first
+	size_t m_residentBytes { 0 };
+	Stats m_stats;
+
+	Resident* findResident(const std::string& albumName);
+	Resident* fault(const std::string& albumName);
+	void drop(Symbol name);
+	void evict();
+	void recountResidentBytes();
+	void resize(Resident& resident, long long bytes);
+};
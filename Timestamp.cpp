@@ -0,0 +1,113 @@
+#include "Timestamp.h"
+#include <cstdio>
+#include <ctime>
+
+#define SECONDS_PER_DAY 86400
+
+/**
+ * daysFromCivil - Counts the days from 1970-01-01 to a date of the proleptic Gregorian calendar.
+ * Params: year, month (1 - 12), day (1 - 31)
+ * Returns: The days, negative before 1970.
+ */
+static int64_t daysFromCivil(int64_t year, int month, int day)
+{
+	year -= month <= 2;
+	int64_t era = (year >= 0 ? year : year - 399) / 400;
+	int64_t yearOfEra = year - era * 400;
+	int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+	return era * 146097 + dayOfEra - 719468;
+}
+
+/**
+ * civilFromDays - The inverse of daysFromCivil.
+ * Params: days - days from 1970-01-01; year, month, day - receive the date
+ * Returns: None
+ */
+static void civilFromDays(int64_t days, int64_t& year, int& month, int& day)
+{
+	days += 719468;
+	int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+	int64_t dayOfEra = days - era * 146097;
+	int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+	int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+	int64_t shiftedMonth = (5 * dayOfYear + 2) / 153;
+
+	day = static_cast<int>(dayOfYear - (153 * shiftedMonth + 2) / 5 + 1);
+	month = static_cast<int>(shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9);
+	year = yearOfEra + era * 400 + (month <= 2);
+}
+
+// localtime is asked once a second per thread, the clock read in between is the whole cost
+int64_t Timestamp::now()
+{
+	thread_local time_t cachedSecond = -1;
+	thread_local int64_t cachedTime = 0;
+
+	time_t second = time(nullptr);
+	if (second != cachedSecond) {
+		std::tm local {};
+#ifdef _WIN32
+		localtime_s(&local, &second);
+#else
+		localtime_r(&second, &local);
+#endif
+		cachedTime = daysFromCivil(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday) * SECONDS_PER_DAY
+			+ local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec;
+		cachedSecond = second;
+	}
+	return cachedTime;
+}
+
+/**
+ * format - Writes a time as "dd/mm/yyyy hh:mm:ss", the text Album and Picture keep.
+ * Params: time - a time given by now() or parse()
+ * Returns: The text.
+ */
+std::string Timestamp::format(int64_t time)
+{
+	thread_local int64_t cachedTime = INT64_MIN;
+	thread_local char cachedText[32];
+	thread_local int cachedLength = 0;
+
+	if (time != cachedTime) {
+		int64_t days = (time >= 0 ? time : time - (SECONDS_PER_DAY - 1)) / SECONDS_PER_DAY;
+		int64_t secondOfDay = time - days * SECONDS_PER_DAY;
+		int64_t year = 0;
+		int month = 0;
+		int day = 0;
+		civilFromDays(days, year, month, day);
+
+		cachedLength = std::snprintf(cachedText, sizeof(cachedText), "%02d/%02d/%04lld %02d:%02d:%02d", day, month,
+			static_cast<long long>(year), static_cast<int>(secondOfDay / 3600), static_cast<int>(secondOfDay / 60 % 60),
+			static_cast<int>(secondOfDay % 60));
+		cachedTime = time;
+	}
+	return std::string(cachedText, cachedLength);
+}
+
+int64_t Timestamp::parse(const std::string& text)
+{
+	int fields[6] = { 0 };
+	const char separators[6] = { '/', '/', ' ', ':', ':', '\0' };
+	size_t position = 0;
+
+	for (int field = 0; field < 6; ++field) {
+		size_t start = position;
+		while (position < text.size() && text[position] >= '0' && text[position] <= '9') {
+			fields[field] = fields[field] * 10 + (text[position] - '0');
+			++position;
+		}
+		if (position == start) {
+			return 0;
+		}
+		if (separators[field] != '\0') {
+			if (position >= text.size() || text[position] != separators[field]) {
+				return 0;
+			}
+			++position;
+		}
+	}
+
+	return daysFromCivil(fields[2], fields[1], fields[0]) * SECONDS_PER_DAY + fields[3] * 3600 + fields[4] * 60 + fields[5];
+}
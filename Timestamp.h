@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+/*
+ * Timestamp - creation times of albums and pictures as an integer: the local wall clock in
+ * seconds since 1970, read as UTC. That is what the stored "dd/mm/yyyy hh:mm:ss" text parses
+ * to, so a time taken now and one loaded from text compare the same way.
+ * Every function is thread-safe: the conversions of the last second are cached per thread,
+ * so stamping many objects in a row reads the clock and copies text, nothing more.
+ */
+class Timestamp
+{
+public:
+	static int64_t now();
+	static std::string format(int64_t time);
+	// 0 when the text is not in the "dd/mm/yyyy hh:mm:ss" format
+	static int64_t parse(const std::string& text);
+};
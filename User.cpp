@@ -1,5 +1,9 @@
 ﻿#include "User.h"
 #include <iomanip>
+#include <type_traits>
+
+static_assert(std::is_nothrow_move_constructible<User>::value && std::is_nothrow_move_assignable<User>::value,
+	"User moves must not throw");
 
 
 User::User(int id, const std::string& name) : 
@@ -20,12 +24,17 @@ void User::setId(int id)
 
 const std::string& User::getName() const
 {
-	return m_name;
+	return m_name.get();
+}
+
+Symbol User::getNameSymbol() const
+{
+	return m_name.getSymbol();
 }
 
 void User::setName(const std::string& name)
 {
-	m_name = name;
+	m_name = InternedName(name);
 }
 
 bool User::operator==(const User& other) const
@@ -43,6 +52,6 @@ bool User::operator<(const User& oUser) const
 }
 
 std::ostream& operator<<(std::ostream& strOut, const User& user) {
-	strOut << std::setw(5) <<"   + @" << user.m_id << " - " << user.m_name;
+	strOut << std::setw(5) <<"   + @" << user.m_id << " - " << user.getName();
 	return strOut;
 }
\ No newline at end of file
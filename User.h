@@ -1,6 +1,7 @@
 ﻿#pragma once
 #include <string>
 #include <iostream>
+#include "SymbolTable.h"
 
 class User
 {
@@ -12,6 +13,7 @@ public:
 	void setId(int id);
 
 	const std::string& getName() const;
+	Symbol getNameSymbol() const;
 	void setName(const std::string& name);
 
 	bool operator==(const User& other) const;
@@ -21,5 +23,5 @@ public:
 
 private:
 	int m_id;
-	std::string m_name;
+	InternedName m_name;
 };
\ No newline at end of file
@@ -0,0 +1,208 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#define VERSIONED_MAP_BITS 4								// key bits per level
+#define VERSIONED_MAP_FANOUT (1 << VERSIONED_MAP_BITS)
+#define VERSIONED_MAP_LEVELS (32 / VERSIONED_MAP_BITS)
+
+/**
+ * newEditToken - A token no node or value was ever made with, see VersionedMap.
+ */
+inline uint64_t newEditToken()
+{
+	static std::atomic<uint64_t> next { 1 };
+	return next++;
+}
+
+/*
+ * VersionedMap - map from 32 bit keys to values whose copies share their nodes: a 16 way trie
+ * with one level per 4 bits of the key, so a change copies the 8 nodes on the path to its key
+ * and every other node stays shared with the copies. A node remembers the edit token it was
+ * made with, and a change made with the same token changes it in place: many changes made with
+ * one token copy each node once. A token must not be used again once the map has been copied.
+ * Keys are visited in increasing order.
+ */
+template <typename Value>
+class VersionedMap
+{
+public:
+	using Key = uint32_t;
+
+	bool empty() const { return m_size == 0; }
+	size_t size() const { return m_size; }
+
+	const Value* find(Key key) const
+	{
+		const Node* node = m_root.get();
+		for (int level = 0; node != nullptr && level < VERSIONED_MAP_LEVELS - 1; ++level) {
+			node = static_cast<const Inner*>(node)->children[getDigit(key, level)].get();
+		}
+		if (node == nullptr) {
+			return nullptr;
+		}
+
+		const auto& value = static_cast<const Leaf*>(node)->values[getDigit(key, VERSIONED_MAP_LEVELS - 1)];
+		return value ? &*value : nullptr;
+	}
+
+	// the value of key, copied out of shared nodes so it can be changed; nullptr (and no copy) when absent
+	Value* edit(Key key, uint64_t token)
+	{
+		if (find(key) == nullptr) {
+			return nullptr;
+		}
+		return &*ownLeaf(key, token).values[getDigit(key, VERSIONED_MAP_LEVELS - 1)];
+	}
+
+	// the value of key, added as Value() when absent
+	Value& add(Key key, uint64_t token)
+	{
+		Leaf& leaf = ownLeaf(key, token);
+		auto& value = leaf.values[getDigit(key, VERSIONED_MAP_LEVELS - 1)];
+		if (!value) {
+			value.emplace();
+			++leaf.count;
+			++m_size;
+		}
+		return *value;
+	}
+
+	void set(Key key, Value value, uint64_t token)
+	{
+		Leaf& leaf = ownLeaf(key, token);
+		auto& stored = leaf.values[getDigit(key, VERSIONED_MAP_LEVELS - 1)];
+		if (!stored) {
+			++leaf.count;
+			++m_size;
+		}
+		stored = std::move(value);
+	}
+
+	bool erase(Key key, uint64_t token)
+	{
+		if (find(key) == nullptr) {
+			return false;
+		}
+
+		eraseFrom(m_root, key, 0, token);
+		if (m_root->count == 0) {
+			m_root.reset();
+		}
+		--m_size;
+		return true;
+	}
+
+	void clear()
+	{
+		m_root.reset();
+		m_size = 0;
+	}
+
+	// fn(key, value) for every entry, by increasing key
+	template <typename Function>
+	void forEach(Function fn) const
+	{
+		if (m_root != nullptr) {
+			visit(*m_root, 0, 0, fn);
+		}
+	}
+
+private:
+	struct Node
+	{
+		uint64_t token { 0 };
+		int count { 0 };		// slots in use
+	};
+
+	struct Inner : Node
+	{
+		std::array<std::shared_ptr<Node>, VERSIONED_MAP_FANOUT> children;
+	};
+
+	struct Leaf : Node
+	{
+		std::array<std::optional<Value>, VERSIONED_MAP_FANOUT> values;
+	};
+
+	std::shared_ptr<Node> m_root;
+	size_t m_size { 0 };
+
+	static size_t getDigit(Key key, int level)
+	{
+		return (key >> ((VERSIONED_MAP_LEVELS - 1 - level) * VERSIONED_MAP_BITS)) & (VERSIONED_MAP_FANOUT - 1);
+	}
+
+	// the node made private to token: made when missing, copied when another token made it
+	template <typename T>
+	static T& own(std::shared_ptr<Node>& node, uint64_t token)
+	{
+		if (node == nullptr) {
+			node = std::make_shared<T>();
+			node->token = token;
+		}
+		else if (node->token != token) {
+			node = std::make_shared<T>(static_cast<const T&>(*node));
+			node->token = token;
+		}
+		return static_cast<T&>(*node);
+	}
+
+	Leaf& ownLeaf(Key key, uint64_t token)
+	{
+		std::shared_ptr<Node>* node = &m_root;
+		for (int level = 0; level < VERSIONED_MAP_LEVELS - 1; ++level) {
+			Inner& inner = own<Inner>(*node, token);
+			node = &inner.children[getDigit(key, level)];
+			if (*node == nullptr) {
+				++inner.count;
+			}
+		}
+		return own<Leaf>(*node, token);
+	}
+
+	// key is in the map; empty nodes on its path are dropped by their parents
+	static void eraseFrom(std::shared_ptr<Node>& node, Key key, int level, uint64_t token)
+	{
+		if (level == VERSIONED_MAP_LEVELS - 1) {
+			Leaf& leaf = own<Leaf>(node, token);
+			leaf.values[getDigit(key, level)].reset();
+			--leaf.count;
+			return;
+		}
+
+		Inner& inner = own<Inner>(node, token);
+		std::shared_ptr<Node>& child = inner.children[getDigit(key, level)];
+		eraseFrom(child, key, level + 1, token);
+		if (child->count == 0) {
+			child.reset();
+			--inner.count;
+		}
+	}
+
+	template <typename Function>
+	static void visit(const Node& node, int level, Key prefix, Function& fn)
+	{
+		if (level == VERSIONED_MAP_LEVELS - 1) {
+			const Leaf& leaf = static_cast<const Leaf&>(node);
+			for (size_t digit = 0; digit < VERSIONED_MAP_FANOUT; ++digit) {
+				if (leaf.values[digit]) {
+					fn(static_cast<Key>((prefix << VERSIONED_MAP_BITS) | digit), *leaf.values[digit]);
+				}
+			}
+			return;
+		}
+
+		const Inner& inner = static_cast<const Inner&>(node);
+		for (size_t digit = 0; digit < VERSIONED_MAP_FANOUT; ++digit) {
+			if (inner.children[digit] != nullptr) {
+				visit(*inner.children[digit], level + 1, static_cast<Key>((prefix << VERSIONED_MAP_BITS) | digit), fn);
+			}
+		}
+	}
+};
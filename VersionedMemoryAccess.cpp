@@ -0,0 +1,606 @@
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+
+#include "ItemNotFoundException.h"
+#include "MemoryAccess.h"
+#include "VersionedMemoryAccess.h"
+
+#define PICTURES_TABLE "PICTURES"
+#define USERS_TABLE "USERS"
+#define ALBUMS_TABLE "ALBUMS"
+
+
+VersionedMemoryAccess::VersionedMemoryAccess() :
+	m_token(newEditToken())
+{
+	// Left empty
+}
+
+VersionedMemoryAccess::VersionedMemoryAccess(const VersionedMemoryAccess& other) :
+	m_albums(other.m_albums),
+	m_albumsByName(other.m_albumsByName),
+	m_albumsByOwner(other.m_albumsByOwner),
+	m_tagsByUser(other.m_tagsByUser),
+	m_users(other.m_users),
+	m_userSequences(other.m_userSequences),
+	m_nextIds(other.m_nextIds),
+	m_nextAlbum(other.m_nextAlbum),
+	m_nextUser(other.m_nextUser),
+	m_token(newEditToken())
+{
+	other.m_token = newEditToken();
+}
+
+bool VersionedMemoryAccess::open()
+{
+	// the same dummy users and albums MemoryAccess::open creates
+	MemoryAccess dummies;
+	dummies.open();
+	dummies.forEachAlbum([this, &dummies](const Album& album) {
+		User owner = dummies.getUser(album.getOwnerId());
+		createUser(owner);
+		createAlbum(album);
+	});
+
+	return true;
+}
+
+void VersionedMemoryAccess::clear()
+{
+	m_albums.clear();
+	m_albumsByName.clear();
+	m_albumsByOwner.clear();
+	m_tagsByUser.clear();
+	m_users.clear();
+	m_userSequences.clear();
+	m_nextIds.clear();
+}
+
+// ids may be negative, the keys only have to be distinct
+uint32_t VersionedMemoryAccess::getKey(int id)
+{
+	return static_cast<uint32_t>(id);
+}
+
+int VersionedMemoryAccess::getTheNextId(const std::string& tableName)
+{
+	auto found = m_nextIds.find(tableName);
+	return found == m_nextIds.end() ? 1 : found->second;
+}
+
+void VersionedMemoryAccess::updateNextId(const std::string& tableName, int usedId)
+{
+	int& nextId = m_nextIds[tableName];
+	if (usedId >= nextId) {
+		nextId = usedId + 1;
+	}
+}
+
+// ******************* Album *******************
+const Album& VersionedMemoryAccess::getAlbum(uint32_t sequence) const
+{
+	return (*m_albums.find(sequence))->album;
+}
+
+/**
+ * editAlbum - Returns a stored album that can be changed: copied first unless this object stored it.
+ */
+Album& VersionedMemoryAccess::editAlbum(uint32_t sequence)
+{
+	uint64_t token = m_token;
+	std::shared_ptr<StoredAlbum>& stored = *m_albums.edit(sequence, token);
+	if (stored->token != token) {
+		stored = std::make_shared<StoredAlbum>(StoredAlbum { token, stored->album });
+	}
+	return stored->album;
+}
+
+// same name under several owners: the first created one, like MemoryAccess
+const uint32_t* VersionedMemoryAccess::findAlbum(const std::string& albumName) const
+{
+	const std::vector<uint32_t>* named = m_albumsByName.find(SymbolTable::find(albumName));
+	return named == nullptr ? nullptr : &named->front();
+}
+
+const uint32_t* VersionedMemoryAccess::findAlbum(const std::string& albumName, int userId) const
+{
+	const std::vector<uint32_t>* named = m_albumsByName.find(SymbolTable::find(albumName));
+	if (named != nullptr) {
+		for (const uint32_t& sequence : *named) {
+			if (getAlbum(sequence).getOwnerId() == userId) {
+				return &sequence;
+			}
+		}
+	}
+	return nullptr;
+}
+
+uint32_t VersionedMemoryAccess::getAlbumIfExists(const std::string& albumName) const
+{
+	const uint32_t* sequence = findAlbum(albumName);
+	if (sequence == nullptr) {
+		throw ItemNotFoundException("Album not exists: ", albumName);
+	}
+	return *sequence;
+}
+
+const std::list<Album> VersionedMemoryAccess::getAlbums()
+{
+	std::list<Album> albums;
+	m_albums.forEach([&albums](uint32_t, const std::shared_ptr<StoredAlbum>& stored) {
+		albums.push_back(stored->album);
+	});
+	return albums;
+}
+
+const std::list<Album> VersionedMemoryAccess::getAlbumsOfUser(const User& user)
+{
+	std::list<Album> albums;
+	forEachAlbumOfUser(user, [&albums](const Album& album) {
+		albums.push_back(album);
+	});
+	return albums;
+}
+
+void VersionedMemoryAccess::forEachAlbum(const std::function<void(const Album&)>& fn)
+{
+	m_albums.forEach([&fn](uint32_t, const std::shared_ptr<StoredAlbum>& stored) {
+		fn(stored->album);
+	});
+}
+
+void VersionedMemoryAccess::forEachAlbumOfUser(const User& user, const std::function<void(const Album&)>& fn)
+{
+	const VersionedMap<bool>* owned = m_albumsByOwner.find(getKey(user.getId()));
+	if (owned != nullptr) {
+		owned->forEach([this, &fn](uint32_t sequence, bool) {
+			fn(getAlbum(sequence));
+		});
+	}
+}
+
+bool VersionedMemoryAccess::visitPicture(const std::string& albumName, const std::string& pictureName, const std::function<void(const Picture&)>& fn)
+{
+	const uint32_t* sequence = findAlbum(albumName);
+	const Picture* picture = sequence == nullptr ? nullptr : getAlbum(*sequence).findPicture(pictureName);
+	if (picture == nullptr) {
+		return false;
+	}
+	fn(*picture);
+	return true;
+}
+
+// every order is sorted on demand, the albums come in creation order as ListingOrder expects
+std::list<Album> VersionedMemoryAccess::getAlbumsSorted(const ListingOrder& order)
+{
+	std::vector<const Album*> ordered;
+	ordered.reserve(m_albums.size());
+	m_albums.forEach([&ordered](uint32_t, const std::shared_ptr<StoredAlbum>& stored) {
+		ordered.push_back(&stored->album);
+	});
+	order.apply(ordered);
+
+	std::list<Album> sorted;
+	for (const Album* album : ordered) {
+		sorted.push_back(*album);
+	}
+	return sorted;
+}
+
+std::list<Picture> VersionedMemoryAccess::getPicturesSorted(const std::string& albumName, const ListingOrder& order)
+{
+	const Album& album = getAlbum(getAlbumIfExists(albumName));
+	std::vector<const Picture*> ordered;
+	album.forEachPicture([&ordered](const Picture& picture) {
+		ordered.push_back(&picture);
+	});
+	order.apply(ordered);
+
+	std::list<Picture> sorted;
+	for (const Picture* picture : ordered) {
+		sorted.push_back(*picture);
+	}
+	return sorted;
+}
+
+void VersionedMemoryAccess::createAlbum(const Album& album)
+{
+	VersionedMemoryAccess::createAlbum(Album(album));
+}
+
+void VersionedMemoryAccess::createAlbum(Album&& album)
+{
+	if (doesAlbumExists(album.getName(), album.getOwnerId())) {
+		throw MyException("Album " + album.getName() + " of user@" + std::to_string(album.getOwnerId()) + " already exists");
+	}
+
+	uint64_t token = m_token;
+	uint32_t sequence = m_nextAlbum++;
+	updateNextId(ALBUMS_TABLE, album.getId());
+	album.forEachPicture([this](const Picture& picture) {
+		updateNextId(PICTURES_TABLE, picture.getId());
+	});
+	addAlbumTags(sequence, album, 1);
+
+	m_albumsByName.add(album.getNameSymbol(), token).push_back(sequence);
+	m_albumsByOwner.add(getKey(album.getOwnerId()), token).set(sequence, true, token);
+	m_albums.set(sequence, std::make_shared<StoredAlbum>(StoredAlbum { token, std::move(album) }), token);
+}
+
+void VersionedMemoryAccess::deleteAlbum(const std::string& albumName, int userId)
+{
+	const uint32_t* sequence = findAlbum(albumName, userId);
+	if (sequence != nullptr) {
+		removeAlbum(*sequence);
+	}
+}
+
+/**
+ * removeAlbum - Drops an album from the store and from every index.
+ */
+void VersionedMemoryAccess::removeAlbum(uint32_t sequence)
+{
+	uint64_t token = m_token;
+	// the stored album stays alive while the indexes change, they never touch m_albums
+	std::shared_ptr<StoredAlbum> stored = *m_albums.find(sequence);
+	const Album& album = stored->album;
+
+	addAlbumTags(sequence, album, -1);
+
+	std::vector<uint32_t>& named = *m_albumsByName.edit(album.getNameSymbol(), token);
+	named.erase(std::find(named.begin(), named.end(), sequence));
+	if (named.empty()) {
+		m_albumsByName.erase(album.getNameSymbol(), token);
+	}
+
+	VersionedMap<bool>& owned = *m_albumsByOwner.edit(getKey(album.getOwnerId()), token);
+	owned.erase(sequence, token);
+	if (owned.empty()) {
+		m_albumsByOwner.erase(getKey(album.getOwnerId()), token);
+	}
+
+	m_albums.erase(sequence, token);
+}
+
+bool VersionedMemoryAccess::doesAlbumExists(const std::string& albumName, int userId)
+{
+	return findAlbum(albumName, userId) != nullptr;
+}
+
+Album VersionedMemoryAccess::openAlbum(const std::string& albumName)
+{
+	const uint32_t* sequence = findAlbum(albumName);
+	if (sequence == nullptr) {
+		throw MyException("No album with name " + albumName + " exists");
+	}
+	return getAlbum(*sequence);
+}
+
+void VersionedMemoryAccess::closeAlbum(Album& )
+{
+	// albums are returned by value, nothing to release
+}
+
+void VersionedMemoryAccess::printAlbums()
+{
+	if (m_albums.empty()) {
+		throw MyException("There are no existing albums.");
+	}
+	std::cout << "Album list:" << std::endl;
+	std::cout << "-----------" << std::endl;
+	m_albums.forEach([](uint32_t, const std::shared_ptr<StoredAlbum>& stored) {
+		std::cout << std::setw(5) << "* " << stored->album;
+	});
+}
+
+// ******************* Picture *******************
+void VersionedMemoryAccess::addPictureToAlbumByName(const std::string& albumName, const Picture& picture)
+{
+	VersionedMemoryAccess::addPictureToAlbumByName(albumName, Picture(picture));
+}
+
+void VersionedMemoryAccess::addPictureToAlbumByName(const std::string& albumName, Picture&& picture)
+{
+	uint32_t sequence = getAlbumIfExists(albumName);
+
+	const Picture& added = editAlbum(sequence).addPicture(std::move(picture));
+	updateNextId(PICTURES_TABLE, added.getId());
+	for (int userId : added.getUserTags()) {
+		addTags(sequence, added.getNameSymbol(), userId, 1);
+	}
+}
+
+void VersionedMemoryAccess::removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName)
+{
+	uint32_t sequence = getAlbumIfExists(albumName);
+
+	const Picture* picture = getAlbum(sequence).findPicture(pictureName);
+	if (picture == nullptr) {
+		throw ItemNotFoundException("Picture", pictureName);
+	}
+
+	for (int userId : picture->getUserTags()) {
+		addTags(sequence, picture->getNameSymbol(), userId, -1);
+	}
+	editAlbum(sequence).removePicture(pictureName);
+}
+
+void VersionedMemoryAccess::tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
+{
+	uint32_t sequence = getAlbumIfExists(albumName);
+
+	// a name given more than once tags every picture with it
+	Symbol name = SymbolTable::find(pictureName);
+	int untagged = 0;
+	getAlbum(sequence).forEachPicture(name, [userId, &untagged](const Picture& picture) {
+		untagged += picture.isUserTagged(userId) ? 0 : 1;
+	});
+	if (untagged == 0) {
+		return;
+	}
+
+	editAlbum(sequence).tagUserInPicture(userId, pictureName);
+	addTags(sequence, name, userId, untagged);
+}
+
+void VersionedMemoryAccess::untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
+{
+	uint32_t sequence = getAlbumIfExists(albumName);
+
+	Symbol name = SymbolTable::find(pictureName);
+	int tagged = 0;
+	getAlbum(sequence).forEachPicture(name, [userId, &tagged](const Picture& picture) {
+		tagged += picture.isUserTagged(userId) ? 1 : 0;
+	});
+	if (tagged == 0) {
+		return;
+	}
+
+	editAlbum(sequence).untagUserInPicture(userId, pictureName);
+	addTags(sequence, name, userId, -tagged);
+}
+
+bool VersionedMemoryAccess::doesPictureExistsInAlbum(const std::string& albumName, const std::string& pictureName)
+{
+	return getAlbum(getAlbumIfExists(albumName)).doesPictureExists(pictureName);
+}
+
+Picture VersionedMemoryAccess::getPictureFromAlbum(const std::string& albumName, const std::string& pictureName)
+{
+	return getAlbum(getAlbumIfExists(albumName)).getPicture(pictureName);
+}
+
+bool VersionedMemoryAccess::isUserTaggedInPicture(const User& user, const Picture& picture)
+{
+	return picture.isUserTagged(user);
+}
+
+std::list<User> VersionedMemoryAccess::getUsersTaggedInPicture(const Picture& picture)
+{
+	std::list<User> users;
+
+	for (int userId : picture.getUserTags()) {
+		if (doesUserExists(userId)) {
+			users.push_back(getUser(userId));
+		}
+	}
+
+	return users;
+}
+
+// ******************* User *******************
+void VersionedMemoryAccess::printUsers()
+{
+	std::cout << "Users list:" << std::endl;
+	std::cout << "-----------" << std::endl;
+	m_users.forEach([](uint32_t, const User& user) {
+		std::cout << user << std::endl;
+	});
+}
+
+User VersionedMemoryAccess::getUser(int userId)
+{
+	const uint32_t* sequence = m_userSequences.find(getKey(userId));
+	if (sequence != nullptr) {
+		return *m_users.find(*sequence);
+	}
+
+	throw ItemNotFoundException("User", userId);
+}
+
+void VersionedMemoryAccess::createUser(User& user)
+{
+	// ids are unique, like the USERS primary key
+	if (doesUserExists(user.getId())) {
+		return;
+	}
+
+	uint64_t token = m_token;
+	uint32_t sequence = m_nextUser++;
+	m_users.set(sequence, user, token);
+	m_userSequences.set(getKey(user.getId()), sequence, token);
+	updateNextId(USERS_TABLE, user.getId());
+}
+
+/**
+ * deleteUser - Removes a user with the albums it owns and its tags. The owned albums go first,
+ *              their tags leave with them and the other albums are copied once each.
+ */
+void VersionedMemoryAccess::deleteUser(const User& user)
+{
+	uint64_t token = m_token;
+	const uint32_t* sequence = m_userSequences.find(getKey(user.getId()));
+	if (sequence == nullptr) {
+		return;
+	}
+	m_users.erase(*sequence, token);
+	m_userSequences.erase(getKey(user.getId()), token);
+
+	const VersionedMap<bool>* owned = m_albumsByOwner.find(getKey(user.getId()));
+	if (owned != nullptr) {
+		// removeAlbum edits the map we would be visiting
+		std::vector<uint32_t> albums;
+		owned->forEach([&albums](uint32_t album, bool) {
+			albums.push_back(album);
+		});
+		for (uint32_t album : albums) {
+			removeAlbum(album);
+		}
+	}
+
+	const UserTags* tags = m_tagsByUser.find(getKey(user.getId()));
+	if (tags != nullptr) {
+		tags->pictures.forEach([this, &user](uint32_t album, const VersionedMap<int>&) {
+			editAlbum(album).untagUserInAlbum(user.getId());
+		});
+		m_tagsByUser.erase(getKey(user.getId()), token);
+	}
+}
+
+bool VersionedMemoryAccess::doesUserExists(int userId)
+{
+	return m_userSequences.find(getKey(userId)) != nullptr;
+}
+
+bool VersionedMemoryAccess::doesUserExists(const std::string& name)
+{
+	Symbol symbol = SymbolTable::find(name);
+	bool found = false;
+	m_users.forEach([symbol, &found](uint32_t, const User& user) {
+		found = found || user.getNameSymbol() == symbol;
+	});
+	return found;
+}
+
+// ******************* Tags *******************
+/**
+ * addTags - Counts tags of a user on the pictures with a name in an album, or uncounts them with
+ *           a negative count. Names, albums and users left without tags leave the index.
+ */
+void VersionedMemoryAccess::addTags(uint32_t sequence, Symbol pictureName, int userId, int count)
+{
+	uint64_t token = m_token;
+	UserTags& tags = m_tagsByUser.add(getKey(userId), token);
+	tags.tagsCount += count;
+
+	VersionedMap<int>& named = tags.pictures.add(sequence, token);
+	int& pictures = named.add(pictureName, token);
+	pictures += count;
+	if (pictures == 0) {
+		named.erase(pictureName, token);
+	}
+	if (named.empty()) {
+		tags.pictures.erase(sequence, token);
+	}
+	if (tags.tagsCount == 0) {
+		m_tagsByUser.erase(getKey(userId), token);
+	}
+}
+
+// sign 1 counts every tag of the album, -1 uncounts them
+void VersionedMemoryAccess::addAlbumTags(uint32_t sequence, const Album& album, int sign)
+{
+	// user id, picture name -> tags
+	std::map<std::pair<int, Symbol>, int> tagsByUser;
+	album.forEachPicture([&tagsByUser](const Picture& picture) {
+		for (int userId : picture.getUserTags()) {
+			++tagsByUser[std::make_pair(userId, picture.getNameSymbol())];
+		}
+	});
+
+	for (const auto& tags : tagsByUser) {
+		addTags(sequence, tags.first.second, tags.first.first, sign * tags.second);
+	}
+}
+
+// user statistics
+int VersionedMemoryAccess::countAlbumsOwnedOfUser(const User& user)
+{
+	const VersionedMap<bool>* owned = m_albumsByOwner.find(getKey(user.getId()));
+	return owned == nullptr ? 0 : static_cast<int>(owned->size());
+}
+
+int VersionedMemoryAccess::countAlbumsTaggedOfUser(const User& user)
+{
+	const UserTags* tags = m_tagsByUser.find(getKey(user.getId()));
+	return tags == nullptr ? 0 : static_cast<int>(tags->pictures.size());
+}
+
+int VersionedMemoryAccess::countTagsOfUser(const User& user)
+{
+	const UserTags* tags = m_tagsByUser.find(getKey(user.getId()));
+	return tags == nullptr ? 0 : tags->tagsCount;
+}
+
+float VersionedMemoryAccess::averageTagsPerAlbumOfUser(const User& user)
+{
+	int albumsTaggedCount = countAlbumsTaggedOfUser(user);
+
+	if ( 0 == albumsTaggedCount ) {
+		return 0;
+	}
+
+	return static_cast<float>(countTagsOfUser(user)) / albumsTaggedCount;
+}
+
+User VersionedMemoryAccess::getTopTaggedUser()
+{
+	if (m_tagsByUser.empty()) {
+		throw MyException("There isn't any tagged user.");
+	}
+
+	// on a tie the higher id wins, like MemoryAccess
+	int topTaggedUser = -1;
+	int topTagsCount = -1;
+	m_tagsByUser.forEach([&topTaggedUser, &topTagsCount](uint32_t key, const UserTags& tags) {
+		int userId = static_cast<int>(key);
+		if (tags.tagsCount > topTagsCount || (tags.tagsCount == topTagsCount && userId > topTaggedUser)) {
+			topTaggedUser = userId;
+			topTagsCount = tags.tagsCount;
+		}
+	});
+
+	return getUser(topTaggedUser);
+}
+
+Picture VersionedMemoryAccess::getTopTaggedPicture()
+{
+	// ties go to the earliest album and picture
+	const Picture* mostTaggedPic = nullptr;
+	m_albums.forEach([&mostTaggedPic](uint32_t, const std::shared_ptr<StoredAlbum>& stored) {
+		stored->album.forEachPicture([&mostTaggedPic](const Picture& picture) {
+			if (picture.getTagsCount() > (mostTaggedPic == nullptr ? 0 : mostTaggedPic->getTagsCount())) {
+				mostTaggedPic = &picture;
+			}
+		});
+	});
+
+	if ( mostTaggedPic == nullptr ) {
+		throw MyException("There isn't any tagged picture.");
+	}
+
+	return *mostTaggedPic;
+}
+
+std::list<Picture> VersionedMemoryAccess::getTaggedPicturesOfUser(const User& user)
+{
+	std::list<Picture> pictures;
+
+	const UserTags* tags = m_tagsByUser.find(getKey(user.getId()));
+	if (tags != nullptr) {
+		// only the pictures with the tagged names, not every picture of the albums
+		tags->pictures.forEach([this, &user, &pictures](uint32_t album, const VersionedMap<int>& named) {
+			const Album& stored = getAlbum(album);
+			named.forEach([&stored, &user, &pictures](uint32_t name, int) {
+				stored.forEachPicture(static_cast<Symbol>(name), [&user, &pictures](const Picture& picture) {
+					if (picture.isUserTagged(user)) {
+						pictures.push_back(picture);
+					}
+				});
+			});
+		});
+	}
+
+	return pictures;
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+#include "Album.h"
+#include "IDataAccess.h"
+#include "User.h"
+#include "VersionedMap.h"
+
+/*
+ * VersionedMemoryAccess - MemoryAccess whose copies share everything they do not change.
+ * Albums, users and every index sit in VersionedMaps, so copying the store copies a few map
+ * roots, and a change made on a copy copies the album it touches and the map nodes on the way
+ * to it. Deleting a user removes its tags from the pictures at once instead of leaving
+ * tombstones, so a copy never carries work left over from another one.
+ *
+ * The answers are the ones MemoryAccess gives; file metadata is not kept (see IDataAccess).
+ * There are no picture columns or creation index: they point into the albums, and every copy
+ * of an album would have to repoint them. The tag index reaches pictures by name instead.
+ */
+class VersionedMemoryAccess : public IDataAccess
+{
+public:
+	VersionedMemoryAccess();
+	virtual ~VersionedMemoryAccess() = default;
+
+	// both sides stop changing the shared nodes in place, later changes copy them
+	VersionedMemoryAccess(const VersionedMemoryAccess& other);
+	VersionedMemoryAccess& operator=(const VersionedMemoryAccess& other) = delete;
+
+	// album related
+	const std::list<Album> getAlbums() override;
+	const std::list<Album> getAlbumsOfUser(const User& user) override;
+	void createAlbum(const Album& album) override;
+	void createAlbum(Album&& album) override;
+	void deleteAlbum(const std::string& albumName, int userId) override;
+	bool doesAlbumExists(const std::string& albumName, int userId) override;
+	Album openAlbum(const std::string& albumName) override;
+	void closeAlbum(Album& pAlbum) override;
+	void printAlbums() override;
+
+	void forEachAlbum(const std::function<void(const Album&)>& fn) override;
+	void forEachAlbumOfUser(const User& user, const std::function<void(const Album&)>& fn) override;
+	bool visitPicture(const std::string& albumName, const std::string& pictureName, const std::function<void(const Picture&)>& fn) override;
+
+	std::list<Album> getAlbumsSorted(const ListingOrder& order) override;
+	std::list<Picture> getPicturesSorted(const std::string& albumName, const ListingOrder& order) override;
+
+	// picture related
+	void addPictureToAlbumByName(const std::string& albumName, const Picture& picture) override;
+	void addPictureToAlbumByName(const std::string& albumName, Picture&& picture) override;
+	void removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName) override;
+	void tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
+	void untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
+
+	// user related
+	void printUsers() override;
+	void createUser(User& user) override;
+	void deleteUser(const User& user) override;
+	bool doesUserExists(int userId) override;
+	User getUser(int userId) override;
+
+	// user statistics
+	int countAlbumsOwnedOfUser(const User& user) override;
+	int countAlbumsTaggedOfUser(const User& user) override;
+	int countTagsOfUser(const User& user) override;
+	float averageTagsPerAlbumOfUser(const User& user) override;
+
+	// queries
+	User getTopTaggedUser() override;
+	Picture getTopTaggedPicture() override;
+	std::list<Picture> getTaggedPicturesOfUser(const User& user) override;
+
+	bool open() override;
+	void close() override {};
+	void clear() override;
+
+	bool doesPictureExistsInAlbum(const std::string& albumName, const std::string& pictureName) override;
+	int getTheNextId(const std::string& tableName) override;
+	Picture getPictureFromAlbum(const std::string& albumName, const std::string& pictureName) override;
+	bool isUserTaggedInPicture(const User& user, const Picture& picture) override;
+	std::list<User> getUsersTaggedInPicture(const Picture& picture) override;
+	bool doesUserExists(const std::string& name) override;
+
+private:
+	// an album changes in place only under the token it was stored with
+	struct StoredAlbum
+	{
+		uint64_t token;
+		Album album;
+	};
+
+	// album sequence -> picture name symbol -> tagged pictures with that name. Names, not
+	// pointers: a copied album has pictures of its own, the names stay
+	struct UserTags
+	{
+		int tagsCount { 0 };
+		VersionedMap<VersionedMap<int>> pictures;
+	};
+
+	// albums and users are keyed by a sequence given in creation order, so they are visited in that order
+	VersionedMap<std::shared_ptr<StoredAlbum>> m_albums;
+	VersionedMap<std::vector<uint32_t>> m_albumsByName;		// name symbol -> sequences, first created first
+	VersionedMap<VersionedMap<bool>> m_albumsByOwner;		// owner id -> sequences
+	VersionedMap<UserTags> m_tagsByUser;					// users with at least one tag
+	VersionedMap<User> m_users;
+	VersionedMap<uint32_t> m_userSequences;					// user id -> sequence
+	std::map<std::string, int> m_nextIds;
+	uint32_t m_nextAlbum { 0 };
+	uint32_t m_nextUser { 0 };
+
+	// the token of this object's changes; changed on both sides of a copy
+	mutable std::atomic<uint64_t> m_token;
+
+	static uint32_t getKey(int id);
+
+	const Album& getAlbum(uint32_t sequence) const;
+	Album& editAlbum(uint32_t sequence);
+	const uint32_t* findAlbum(const std::string& albumName) const;
+	const uint32_t* findAlbum(const std::string& albumName, int userId) const;
+	uint32_t getAlbumIfExists(const std::string& albumName) const;
+	void removeAlbum(uint32_t sequence);
+
+	void addTags(uint32_t sequence, Symbol pictureName, int userId, int count);
+	void addAlbumTags(uint32_t sequence, const Album& album, int sign);
+	void updateNextId(const std::string& tableName, int usedId);
+};
@@ -0,0 +1,283 @@
+#include "WorkloadGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#define SYNTHETIC_PATH "C:\\Pictures\\synthetic\\"
+
+// share (in percent) of each operation in the mixed phase
+#define TAG_SHARE 40
+#define UNTAG_SHARE 10
+#define STATISTICS_SHARE 20
+#define TOP_TAGGED_SHARE 10
+#define LISTING_SHARE 20
+
+
+Rng::Rng(uint64_t seed) :
+	m_state(seed)
+{
+	// Left empty
+}
+
+uint64_t Rng::next()
+{
+	uint64_t z = (m_state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+int Rng::nextInt(int bound)
+{
+	return static_cast<int>(next() % static_cast<uint64_t>(bound));
+}
+
+double Rng::nextDouble()
+{
+	return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+ZipfDistribution::ZipfDistribution(int n, double exponent) :
+	m_cdf(n)
+{
+	double sum = 0;
+	for (int k = 0; k < n; ++k) {
+		sum += 1.0 / std::pow(k + 1, exponent);
+		m_cdf[k] = sum;
+	}
+	for (auto& value : m_cdf) {
+		value /= sum;
+	}
+}
+
+int ZipfDistribution::operator()(Rng& rng) const
+{
+	auto found = std::lower_bound(m_cdf.begin(), m_cdf.end(), rng.nextDouble());
+	if (found == m_cdf.end()) {
+		return static_cast<int>(m_cdf.size()) - 1;
+	}
+	return static_cast<int>(found - m_cdf.begin());
+}
+
+
+/**
+ * WorkloadGenerator - Builds the populate and mixed operation sequences of a config.
+ * Params: config - sizes, skew and seed of the workload
+ */
+WorkloadGenerator::WorkloadGenerator(const WorkloadConfig& config) :
+	m_config(config), m_rng(config.seed), m_userPopularity(std::max(config.users, 1), config.zipfExponent)
+{
+	int albums = m_config.users * m_config.albumsPerUser;
+
+	for (int userId = 1; userId <= m_config.users; ++userId) {
+		m_populate.push_back({ OperationType::CREATE_USER, userId, 0, 0 });
+	}
+	for (int album = 0; album < albums; ++album) {
+		m_populate.push_back({ OperationType::CREATE_ALBUM, getAlbumOwner(album), album, 0 });
+		for (int picture = 0; picture < m_config.picturesPerAlbum; ++picture) {
+			m_populate.push_back({ OperationType::ADD_PICTURE, getAlbumOwner(album), album, picture });
+		}
+	}
+	for (int tag = 0; tag < m_config.tags; ++tag) {
+		Operation operation;
+		if (makeTag(operation)) {
+			m_populate.push_back(operation);
+		}
+	}
+
+	for (int i = 0; i < m_config.operations; ++i) {
+		int dice = m_rng.nextInt(100);
+		Operation operation { OperationType::USER_STATISTICS, pickTaggedUser(), 0, 0 };
+
+		if (dice < TAG_SHARE) {
+			if (!makeTag(operation)) {
+				continue;
+			}
+		}
+		else if ((dice -= TAG_SHARE) < UNTAG_SHARE) {
+			if (!makeUntag(operation)) {
+				continue;
+			}
+		}
+		else if ((dice -= UNTAG_SHARE) < STATISTICS_SHARE) {
+			operation.type = OperationType::USER_STATISTICS;
+		}
+		else if ((dice -= STATISTICS_SHARE) < TOP_TAGGED_SHARE) {
+			operation.type = dice % 2 == 0 ? OperationType::TOP_TAGGED_USER : OperationType::TOP_TAGGED_PICTURE;
+		}
+		else {
+			dice -= TOP_TAGGED_SHARE;
+			if (dice < LISTING_SHARE / 4) {
+				operation.type = OperationType::LIST_ALBUMS;
+			}
+			else if (dice < LISTING_SHARE / 2) {
+				operation.type = OperationType::LIST_ALBUMS_OF_USER;
+			}
+			else {
+				operation.type = OperationType::LIST_TAGGED_PICTURES;
+			}
+		}
+		m_mixed.push_back(operation);
+	}
+}
+
+const std::vector<Operation>& WorkloadGenerator::getPopulateOperations() const
+{
+	return m_populate;
+}
+
+const std::vector<Operation>& WorkloadGenerator::getMixedOperations() const
+{
+	return m_mixed;
+}
+
+int WorkloadGenerator::pickTaggedUser()
+{
+	// spread the popularity ranks over the ids so the hot users are not all the oldest ones
+	int rank = m_userPopularity(m_rng);
+	return static_cast<int>((static_cast<long long>(rank) * 7919) % m_config.users) + 1;
+}
+
+/**
+ * makeTag - Picks a (picture, user) pair that is not tagged yet.
+ * Params: operation - receives the tag operation
+ * Returns: false when no free pair was found after a few attempts.
+ */
+bool WorkloadGenerator::makeTag(Operation& operation)
+{
+	long long pictures = static_cast<long long>(m_config.users) * m_config.albumsPerUser * m_config.picturesPerAlbum;
+	if (pictures == 0) {
+		return false;
+	}
+
+	for (int attempt = 0; attempt < 8; ++attempt) {
+		long long picture = static_cast<long long>(m_rng.next() % static_cast<uint64_t>(pictures));
+		int userId = pickTaggedUser();
+		if (m_tagged.insert({ picture, userId }).second) {
+			m_taggedOrder.push_back({ picture, userId });
+			operation = { OperationType::TAG, userId,
+				static_cast<int>(picture / m_config.picturesPerAlbum), static_cast<int>(picture % m_config.picturesPerAlbum) };
+			return true;
+		}
+	}
+	return false;
+}
+
+bool WorkloadGenerator::makeUntag(Operation& operation)
+{
+	if (m_taggedOrder.empty()) {
+		return false;
+	}
+
+	size_t position = static_cast<size_t>(m_rng.next() % m_taggedOrder.size());
+	auto tag = m_taggedOrder[position];
+	forgetTag(position);
+	operation = { OperationType::UNTAG, tag.second,
+		static_cast<int>(tag.first / m_config.picturesPerAlbum), static_cast<int>(tag.first % m_config.picturesPerAlbum) };
+	return true;
+}
+
+void WorkloadGenerator::forgetTag(size_t position)
+{
+	m_tagged.erase(m_taggedOrder[position]);
+	m_taggedOrder[position] = m_taggedOrder.back();
+	m_taggedOrder.pop_back();
+}
+
+/**
+ * execute - Runs one operation against a backend.
+ * Params: dataAccess - backend to run on, operation - operation to run
+ * Returns: None
+ */
+void WorkloadGenerator::execute(IDataAccess& dataAccess, const Operation& operation) const
+{
+	switch (operation.type)
+	{
+	case OperationType::CREATE_USER:
+	{
+		User user(operation.userId, "user_" + std::to_string(operation.userId));
+		dataAccess.createUser(user);
+		break;
+	}
+	case OperationType::CREATE_ALBUM:
+	{
+		Album album(operation.userId, getAlbumName(operation.albumIndex));
+		album.setId(operation.albumIndex + 1);
+		dataAccess.createAlbum(std::move(album));
+		break;
+	}
+	case OperationType::ADD_PICTURE:
+	{
+		long long globalIndex = static_cast<long long>(operation.albumIndex) * m_config.picturesPerAlbum + operation.pictureIndex;
+		Picture picture(static_cast<int>(globalIndex + 1), getPictureName(operation.pictureIndex));
+		picture.setPath(SYNTHETIC_PATH + getAlbumName(operation.albumIndex) + "\\" + getPictureName(operation.pictureIndex) + ".bmp");
+		dataAccess.addPictureToAlbumByName(getAlbumName(operation.albumIndex), std::move(picture));
+		break;
+	}
+	case OperationType::TAG:
+		dataAccess.tagUserInPicture(getAlbumName(operation.albumIndex), getPictureName(operation.pictureIndex), operation.userId);
+		break;
+	case OperationType::UNTAG:
+		dataAccess.untagUserInPicture(getAlbumName(operation.albumIndex), getPictureName(operation.pictureIndex), operation.userId);
+		break;
+	case OperationType::USER_STATISTICS:
+	{
+		User user(operation.userId, "");
+		dataAccess.countAlbumsOwnedOfUser(user);
+		dataAccess.countAlbumsTaggedOfUser(user);
+		dataAccess.countTagsOfUser(user);
+		dataAccess.averageTagsPerAlbumOfUser(user);
+		break;
+	}
+	case OperationType::TOP_TAGGED_USER:
+		dataAccess.getTopTaggedUser();
+		break;
+	case OperationType::TOP_TAGGED_PICTURE:
+		dataAccess.getTopTaggedPicture();
+		break;
+	case OperationType::LIST_ALBUMS:
+		dataAccess.getAlbums();
+		break;
+	case OperationType::LIST_ALBUMS_OF_USER:
+		dataAccess.getAlbumsOfUser(User(operation.userId, ""));
+		break;
+	case OperationType::LIST_TAGGED_PICTURES:
+		dataAccess.getTaggedPicturesOfUser(User(operation.userId, ""));
+		break;
+	}
+}
+
+const char* WorkloadGenerator::getOperationName(OperationType type)
+{
+	switch (type)
+	{
+	case OperationType::CREATE_USER: return "create_user";
+	case OperationType::CREATE_ALBUM: return "create_album";
+	case OperationType::ADD_PICTURE: return "add_picture";
+	case OperationType::TAG: return "tag";
+	case OperationType::UNTAG: return "untag";
+	case OperationType::USER_STATISTICS: return "user_statistics";
+	case OperationType::TOP_TAGGED_USER: return "top_tagged_user";
+	case OperationType::TOP_TAGGED_PICTURE: return "top_tagged_picture";
+	case OperationType::LIST_ALBUMS: return "list_albums";
+	case OperationType::LIST_ALBUMS_OF_USER: return "list_albums_of_user";
+	case OperationType::LIST_TAGGED_PICTURES: return "list_tagged_pictures";
+	}
+	return "unknown";
+}
+
+std::string WorkloadGenerator::getAlbumName(int albumIndex) const
+{
+	return "album_" + std::to_string(albumIndex);
+}
+
+std::string WorkloadGenerator::getPictureName(int pictureIndex) const
+{
+	return "picture_" + std::to_string(pictureIndex);
+}
+
+int WorkloadGenerator::getAlbumOwner(int albumIndex) const
+{
+	return albumIndex / m_config.albumsPerUser + 1;
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <cstdint>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "IDataAccess.h"
+
+struct WorkloadConfig
+{
+	uint64_t seed { 42 };
+	int users { 100 };
+	int albumsPerUser { 3 };
+	int picturesPerAlbum { 20 };
+	int tags { 2000 };				// tags created while populating
+	double zipfExponent { 1.0 };	// skew of which users get tagged
+	int operations { 2000 };		// size of the mixed operation phase
+};
+
+enum class OperationType
+{
+	CREATE_USER,
+	CREATE_ALBUM,
+	ADD_PICTURE,
+	TAG,
+	UNTAG,
+	USER_STATISTICS,
+	TOP_TAGGED_USER,
+	TOP_TAGGED_PICTURE,
+	LIST_ALBUMS,
+	LIST_ALBUMS_OF_USER,
+	LIST_TAGGED_PICTURES
+};
+
+struct Operation
+{
+	OperationType type;
+	int userId;
+	int albumIndex;
+	int pictureIndex;
+};
+
+/*
+ * Rng - splitmix64, so a seed produces the same workload with every compiler and standard library.
+ */
+class Rng
+{
+public:
+	explicit Rng(uint64_t seed);
+
+	uint64_t next();
+	int nextInt(int bound);
+	double nextDouble();
+
+private:
+	uint64_t m_state;
+};
+
+/*
+ * ZipfDistribution - samples ranks 0..n-1 where rank k is drawn with probability proportional to 1/(k+1)^s.
+ */
+class ZipfDistribution
+{
+public:
+	ZipfDistribution(int n, double exponent);
+
+	int operator()(Rng& rng) const;
+
+private:
+	std::vector<double> m_cdf;
+};
+
+/*
+ * WorkloadGenerator - deterministic synthetic gallery: the dataset to populate and
+ * the mixed operation sequence to replay, identical for every IDataAccess backend.
+ */
+class WorkloadGenerator
+{
+public:
+	explicit WorkloadGenerator(const WorkloadConfig& config);
+
+	const std::vector<Operation>& getPopulateOperations() const;
+	const std::vector<Operation>& getMixedOperations() const;
+
+	void execute(IDataAccess& dataAccess, const Operation& operation) const;
+
+	static const char* getOperationName(OperationType type);
+	std::string getAlbumName(int albumIndex) const;
+	std::string getPictureName(int pictureIndex) const;
+	int getAlbumOwner(int albumIndex) const;
+
+private:
+	WorkloadConfig m_config;
+	Rng m_rng;
+	ZipfDistribution m_userPopularity;
+	std::set<std::pair<long long, int>> m_tagged;	// (global picture index, user id) pairs tagged so far
+	std::vector<std::pair<long long, int>> m_taggedOrder;
+	std::vector<Operation> m_populate;
+	std::vector<Operation> m_mixed;
+
+	int pickTaggedUser();
+	bool makeTag(Operation& operation);
+	bool makeUntag(Operation& operation);
+	void forgetTag(size_t position);
+};